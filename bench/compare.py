@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""Compares two `acorn_bench` JSON outputs and flags benchmarks which became slower.
+
+    acorn_bench --benchmark_repetitions=5 --benchmark_report_aggregates_only=true \
+        --benchmark_format=json --benchmark_out=current.json
+    bench/compare.py bench/baseline.json current.json [--threshold 10]
+
+`acorn_bench` must come from a Release build (`-DCMAKE_BUILD_TYPE=Release -Dbench=ON`), as the baseline does.
+
+Benchmarks are matched by name and compared on real time. When a run has repetitions only the mean aggregate is
+used. Exits with status 1 if any benchmark regressed by more than the threshold percentage.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load_times(path):
+    with open(path) as file:
+        data = json.load(file)
+
+    times = {}
+    aggregates = {}
+    for bench in data["benchmarks"]:
+        if bench.get("error_occurred"):
+            continue
+        if bench.get("run_type") == "aggregate":
+            if bench.get("aggregate_name") == "mean":
+                aggregates[bench["run_name"]] = bench["real_time"]
+        else:
+            times[bench.get("run_name", bench["name"])] = bench["real_time"]
+
+    times.update(aggregates)
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percentage slowdown reported as a regression (default 10)")
+    args = parser.parse_args()
+
+    baseline = load_times(args.baseline)
+    current = load_times(args.current)
+
+    regressions = 0
+    print(f"{'benchmark':<44} {'baseline':>12} {'current':>12} {'change':>9}")
+    for name in sorted(baseline.keys() & current.keys()):
+        base = baseline[name]
+        cur = current[name]
+        change = (cur - base) / base * 100.0 if base > 0 else 0.0
+
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<44} {base:>12.1f} {cur:>12.1f} {change:>+8.1f}%{flag}")
+
+    for name in sorted(baseline.keys() - current.keys()):
+        print(f"{name:<44} missing from current run")
+    for name in sorted(current.keys() - baseline.keys()):
+        print(f"{name:<44} not in baseline")
+
+    if regressions != 0:
+        print(f"\n{regressions} benchmark(s) regressed by more than {args.threshold:g}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""Measures the programs acorn generates, rather than the compiler itself.
+
+    bench/runtime.py --acorn build/acorn [--runs 5] [--threshold 10] [--min-ms 20]
+    bench/runtime.py --acorn build/acorn --update
+
+Compiles every program in samples/bench with each backend and optimization level, runs it several times and reports
+the median wall time and executable size against bench/runtime_baseline.json. JIT configurations have no executable,
+their time includes compiling. Each program states its exit code in a `expect-exit: <code>` comment, a different exit
+code fails the run.
+
+Exits with status 1 if any program exits wrongly, got slower than the threshold percentage or its executable grew by
+more than the size threshold percentage. A program which runs in less than `--min-ms` in the baseline or the current
+run is timing process startup rather than generated code, and a JIT configuration is mostly timing the compiler (which
+`acorn_bench` measures), so their time changes are shown in parentheses and never count as regressions. The corpus
+programs are that short until the language can express loops, which leaves the sizes as the meaningful comparison for
+now.
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+CORPUS = os.path.join(ROOT, "samples", "bench")
+BASELINE = os.path.join(ROOT, "bench", "runtime_baseline.json")
+
+# name: (compiler flags, runs through the JIT)
+CONFIGS = {
+    "llvm-O0": (["-O0"], False),
+    "llvm-O1": (["-O1"], False),
+    "llvm-O2": (["-O2"], False),
+    "llvm-O3": (["-O3"], False),
+    "llvm-Os": (["-Os"], False),
+    "native": (["--backend=native"], False),
+    "jit-O0": (["--jit", "-O0"], True),
+    "jit-O2": (["--jit", "-O2"], True),
+}
+
+
+def expected_exit(path):
+    with open(path) as file:
+        match = re.search(r"expect-exit: (\d+)", file.read())
+    return int(match.group(1)) if match else 0
+
+
+def timed_run(command, cwd):
+    start = time.perf_counter()
+    result = subprocess.run(command, cwd=cwd, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    return time.perf_counter() - start, result.returncode
+
+
+def measure(acorn, program, config, runs, work_dir):
+    flags, jit = CONFIGS[config]
+    source = os.path.join(work_dir, program + ".acorn")
+    exe = os.path.join(work_dir, program)
+    if os.path.exists(exe):
+        os.remove(exe)
+
+    if jit:
+        command = [acorn] + flags + [source]
+        size = None
+    else:
+        compiled = subprocess.run([acorn] + flags + [source], cwd=work_dir, stdout=subprocess.DEVNULL,
+                                  stderr=subprocess.DEVNULL)
+        if compiled.returncode != 0 or not os.path.exists(exe):
+            return None, None, f"failed to compile ({compiled.returncode})"
+        command = [exe]
+        size = os.path.getsize(exe)
+
+    times = []
+    for _ in range(runs):
+        elapsed, code = timed_run(command, work_dir)
+        if code != expected_exit(source):
+            return None, size, f"exited with {code}, expected {expected_exit(source)}"
+        times.append(elapsed)
+    return statistics.median(times) * 1000.0, size, None
+
+
+def change(current, base):
+    if current is None or base is None or base == 0:
+        return None
+    return (current - base) / base * 100.0
+
+
+def format_change(value):
+    return f"{value:+.1f}%" if value is not None else "-"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--acorn", required=True, help="path to the acorn executable")
+    parser.add_argument("--runs", type=int, default=5)
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percentage slowdown reported as a regression (default 10)")
+    parser.add_argument("--min-ms", type=float, default=20.0,
+                        help="median time below which a slowdown is not a regression (default 20)")
+    parser.add_argument("--size-threshold", type=float, default=0.0,
+                        help="percentage executable growth reported as a regression (default 0)")
+    parser.add_argument("--baseline", default=BASELINE)
+    parser.add_argument("--update", action="store_true", help="write the results as the new baseline")
+    args = parser.parse_args()
+
+    acorn = os.path.abspath(args.acorn)
+    baseline = {}
+    if not args.update and os.path.exists(args.baseline):
+        with open(args.baseline) as file:
+            baseline = json.load(file)
+
+    programs = sorted(name[:-len(".acorn")] for name in os.listdir(CORPUS) if name.endswith(".acorn"))
+    results = {}
+    failures = 0
+
+    print(f"{'benchmark':<24} {'median ms':>10} {'baseline':>10} {'change':>8} {'size':>9} {'baseline':>9} {'change':>8}")
+    with tempfile.TemporaryDirectory(prefix="acorn_runtime_") as work_dir:
+        for program in programs:
+            # Outputs are written next to the source, keep them out of the tree
+            shutil.copy(os.path.join(CORPUS, program + ".acorn"), work_dir)
+
+            for config in CONFIGS:
+                name = f"{program}/{config}"
+                median, size, error = measure(acorn, program, config, args.runs, work_dir)
+                if error is not None:
+                    print(f"{name:<24} {error}")
+                    failures += 1
+                    continue
+
+                results[name] = {"median_ms": round(median, 3), "size": size}
+                base = baseline.get(name, {})
+                time_change = change(median, base.get("median_ms"))
+                size_change = change(size, base.get("size"))
+                timed = time_change is not None and not CONFIGS[config][1] and \
+                    min(median, base["median_ms"]) >= args.min_ms
+
+                flags = []
+                if timed and time_change > args.threshold:
+                    flags.append("SLOWER")
+                if size_change is not None and size_change > args.size_threshold:
+                    flags.append("LARGER")
+                failures += len(flags) != 0
+
+                time_column = format_change(time_change) if timed or time_change is None \
+                    else f"({format_change(time_change)})"
+                print(f"{name:<24} {median:>10.3f} {base.get('median_ms', '-'):>10} {time_column:>8} "
+                      f"{size if size is not None else '-':>9} {base.get('size') or '-':>9} "
+                      f"{format_change(size_change):>8}  {' '.join(flags)}")
+
+    if args.update:
+        with open(args.baseline, "w") as file:
+            json.dump(results, file, indent=2, sort_keys=True)
+            file.write("\n")
+        print(f"\nWrote {args.baseline}")
+        return 0 if failures == 0 else 1
+
+    if failures != 0:
+        print(f"\n{failures} benchmark(s) failed or regressed")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
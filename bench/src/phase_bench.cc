@@ -0,0 +1,187 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+#include "source_gen.h"
+
+extern "C" {
+#include "lexer.h"
+#include "parser.h"
+#include "ast_lowering.h"
+#include "ast_to_mir.h"
+#include "module.h"
+}
+
+// SECTION: Helpers
+
+// Every phase reports the same rates so they can be compared across phases: bytes of source and top level decls.
+static void set_rates(benchmark::State &state, const std::string &source, const SourceShape &shape) {
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) source.size());
+    state.counters["decls"] = benchmark::Counter(source_decl_count(shape), benchmark::Counter::kIsIterationInvariantRate);
+    state.counters["bytes"] = (double) source.size();
+}
+
+static Ast parse(const std::string &source) {
+    Parser parser;
+    parser_init(&parser, (uint8_t *) source.c_str());
+    return parser_parse(&parser);
+}
+
+static void ast_free_lists(Ast *ast) {
+    token_list_free(&ast->tokens);
+    ast_node_list_free(&ast->nodes);
+    index_list_free(&ast->extra_data);
+    error_list_free(&ast->errors);
+    line_index_free(&ast->lines);
+}
+
+// SECTION: Phases
+
+static void BM_Lex(benchmark::State &state, SourcePreset preset) {
+    SourceShape shape = source_preset_shape(preset, (uint32_t) state.range(0));
+    std::string source = source_generate(shape);
+
+    uint64_t tokens = 0;
+    for (auto _ : state) {
+        Lexer lexer;
+        lexer_init(&lexer, (const uint8_t *) source.c_str());
+
+        Token tok;
+        tokens = 0;
+        while ((tok = lexer_next(&lexer)).type != TOK_EOF) {
+            benchmark::DoNotOptimize(tok);
+            tokens++;
+        }
+    }
+
+    set_rates(state, source, shape);
+    state.counters["tokens"] = benchmark::Counter((double) tokens, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+static void BM_Parse(benchmark::State &state, SourcePreset preset) {
+    SourceShape shape = source_preset_shape(preset, (uint32_t) state.range(0));
+    std::string source = source_generate(shape);
+
+    for (auto _ : state) {
+        // Lexing happens in `parser_init`, see `BM_Lex`
+        state.PauseTiming();
+        Parser parser;
+        parser_init(&parser, (uint8_t *) source.c_str());
+        state.ResumeTiming();
+
+        Ast ast = parser_parse(&parser);
+        benchmark::DoNotOptimize(ast.nodes.data);
+
+        state.PauseTiming();
+        ast_free_lists(&ast);
+        state.ResumeTiming();
+    }
+
+    set_rates(state, source, shape);
+}
+
+static void BM_Hir(benchmark::State &state, SourcePreset preset) {
+    SourceShape shape = source_preset_shape(preset, (uint32_t) state.range(0));
+    std::string source = source_generate(shape);
+    Ast ast = parse(source);
+
+    for (auto _ : state) {
+        Hir hir = ast_lower(&ast);
+        benchmark::DoNotOptimize(hir.instructions.data);
+
+        state.PauseTiming();
+        hir_free(&hir);
+        state.ResumeTiming();
+    }
+
+    ast_free_lists(&ast);
+    set_rates(state, source, shape);
+}
+
+static void BM_Mir(benchmark::State &state, SourcePreset preset) {
+    SourceShape shape = source_preset_shape(preset, (uint32_t) state.range(0));
+    std::string source = source_generate(shape);
+    Ast ast = parse(source);
+    AstNode *module = ast_get_node_tagged(&ast, ast_index_root, AST_MODULE);
+
+    for (auto _ : state) {
+        StringSet strings;
+        string_set_init(&strings);
+
+        // The same lowering as `decl_get_mir_in_module`, for every function in the file
+        for (AstIndex i = module->data.lhs; i <= module->data.rhs; i++) {
+            AstToMir lowering;
+            ast_to_mir_init(&lowering, &ast, &strings);
+            Mir mir = lower_ast_fn(&lowering, ast.extra_data.data[i]);
+            benchmark::DoNotOptimize(mir.instructions.data);
+
+            ast_to_mir_free(&lowering);
+            mir_free(&mir);
+        }
+
+        string_set_free(&strings);
+    }
+
+    ast_free_lists(&ast);
+    set_rates(state, source, shape);
+}
+
+// Everything before LLVM IR generation runs untimed, the timed part is `module_lower_main` at -O0.
+static void BM_LlvmCodegen(benchmark::State &state, SourcePreset preset) {
+    SourceShape shape = source_preset_shape(preset, (uint32_t) state.range(0));
+    std::string source = source_generate(shape);
+
+    // Modules are loaded from disk
+    char path[] = "/tmp/acorn_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0 || write(fd, source.c_str(), source.size()) != (ssize_t) source.size()) {
+        state.SkipWithError("Could not write the generated source");
+        return;
+    }
+    close(fd);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        Module module;
+        module_init(&module, path);
+        if (!module_parse(&module) || !module_lower_ast(&module)) {
+            state.SkipWithError("Generated source failed to compile");
+            break;
+        }
+        for (uint32_t i = 0; i < module.decls.size; i++) {
+            decl_get_mir_in_module(decl_list_get(&module.decls, i), &module);
+        }
+        state.ResumeTiming();
+
+        if (!module_lower_main(&module)) {
+            state.SkipWithError("Generated source failed to lower");
+            break;
+        }
+
+        state.PauseTiming();
+        module_free(&module);
+        state.ResumeTiming();
+    }
+
+    unlink(path);
+    set_rates(state, source, shape);
+}
+
+// SECTION: Registration
+// Each phase runs every preset at a small and a large scale, named eg `BM_Parse/deep_nesting/256`.
+
+#define BENCH_PHASE(fn) \
+    BENCHMARK_CAPTURE(fn, many_functions, SOURCE_MANY_FUNCTIONS)->Arg(16)->Arg(256)->Unit(benchmark::kMicrosecond); \
+    BENCHMARK_CAPTURE(fn, deep_nesting, SOURCE_DEEP_NESTING)->Arg(16)->Arg(256)->Unit(benchmark::kMicrosecond); \
+    BENCHMARK_CAPTURE(fn, long_blocks, SOURCE_LONG_BLOCKS)->Arg(16)->Arg(256)->Unit(benchmark::kMicrosecond); \
+    BENCHMARK_CAPTURE(fn, many_identifiers, SOURCE_MANY_IDENTIFIERS)->Arg(16)->Arg(256)->Unit(benchmark::kMicrosecond); \
+    BENCHMARK_CAPTURE(fn, long_strings, SOURCE_LONG_STRINGS)->Arg(64)->Arg(4096)->Unit(benchmark::kMicrosecond)
+
+BENCH_PHASE(BM_Lex);
+BENCH_PHASE(BM_Parse);
+BENCH_PHASE(BM_Hir);
+BENCH_PHASE(BM_Mir);
+BENCH_PHASE(BM_LlvmCodegen);
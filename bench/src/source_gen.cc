@@ -0,0 +1,93 @@
+#include "source_gen.h"
+
+#include <vector>
+
+SourceShape source_preset_shape(SourcePreset preset, uint32_t scale) {
+    switch (preset) {
+        case SOURCE_MANY_FUNCTIONS:
+            return {scale, 4, 2, 2, 4, 0};
+        case SOURCE_DEEP_NESTING:
+            return {8, 4, scale, 2, 4, 0};
+        case SOURCE_LONG_BLOCKS:
+            return {4, scale, 2, 2, 4, 0};
+        case SOURCE_MANY_IDENTIFIERS:
+            return {8, scale, 8, 8, 24, 0};
+        case SOURCE_LONG_STRINGS:
+            return {8, 8, 2, 2, 4, scale};
+    }
+    return {1, 1, 1, 1, 1, 0};
+}
+
+static std::string local_name(uint32_t fn, uint32_t stmt, uint32_t len) {
+    std::string name = "v" + std::to_string(fn) + "_" + std::to_string(stmt);
+    if (name.size() < len) name += '_';
+    while (name.size() < len) name += (char) ('a' + name.size() % 26);
+    return name;
+}
+
+// Left nested so the parser sees `expr_depth` levels of parentheses, eg `((v0 + v1) * 7)`.
+static std::string expression(const SourceShape &shape, const std::vector<std::string> &locals, uint32_t seed) {
+    static const char *ops[] = {" + ", " - ", " * "};
+
+    std::string expr;
+    for (uint32_t leaf = 0; leaf <= shape.expr_depth; leaf++) {
+        std::string operand;
+        if (leaf < shape.refs_per_expr) {
+            operand = locals[locals.size() - 1 - (leaf + seed) % locals.size()];
+        } else {
+            operand = std::to_string((leaf * 7 + seed) % 100);
+        }
+
+        if (leaf == 0) {
+            expr = operand;
+        } else {
+            expr = "(" + expr + ops[(leaf + seed) % 3] + operand + ")";
+        }
+    }
+    return expr;
+}
+
+static void function(const SourceShape &shape, uint32_t fn, std::string &out) {
+    out += "fn f" + std::to_string(fn) + "(a: i32, b: i32) i32 {\n";
+
+    std::vector<std::string> locals = {"a", "b"};
+    for (uint32_t stmt = 0; stmt < shape.stmts_per_fn; stmt++) {
+        std::string name = local_name(fn, stmt, shape.ident_len);
+        out += "    let " + name + ": i32 = " + expression(shape, locals, fn + stmt) + ";\n";
+        locals.push_back(name);
+
+        if (shape.string_len != 0) {
+            out += "    let s" + name + ": *i8 = \"";
+            for (uint32_t i = 0; i < shape.string_len; i++) out += (char) ('a' + (i + stmt) % 26);
+            out += "\";\n";
+        }
+    }
+
+    // Returning a local rather than an expression, expressions after a `let` are not typed against the return type.
+    if (fn > 0) {
+        out += "    let r: i32 = f" + std::to_string(fn - 1) + "(a, " + locals.back() + ");\n";
+        out += "    return r;\n";
+    } else {
+        out += "    return " + locals.back() + ";\n";
+    }
+    out += "}\n\n";
+}
+
+std::string source_generate(const SourceShape &shape) {
+    std::string out;
+    for (uint32_t fn = 0; fn < shape.fn_count; fn++) {
+        function(shape, fn, out);
+    }
+
+    out += "fn main() i32 {\n";
+    out += "    let a: i32 = 1;\n";
+    out += "    let b: i32 = 2;\n";
+    out += "    let r: i32 = f" + std::to_string(shape.fn_count - 1) + "(a, b);\n";
+    out += "    return r;\n";
+    out += "}\n";
+    return out;
+}
+
+uint32_t source_decl_count(const SourceShape &shape) {
+    return shape.fn_count + 1;
+}
@@ -0,0 +1,38 @@
+#ifndef ACORN_BENCH_SOURCE_GEN_H
+#define ACORN_BENCH_SOURCE_GEN_H
+
+#include <cstdint>
+#include <string>
+
+// Shape of a generated program. Every generated program is valid Acorn which lowers all the way to LLVM IR:
+// `fn main` calls the last function, which calls the one before it and so on, so every function is reachable.
+struct SourceShape {
+    uint32_t fn_count;
+    // `let` statements per function, not counting the call and return
+    uint32_t stmts_per_fn;
+    // Parenthesized binary operators in each initializer
+    uint32_t expr_depth;
+    // Earlier locals referenced by each initializer, and the length of every local name
+    uint32_t refs_per_expr;
+    uint32_t ident_len;
+    // Length of a string literal declared after every integer `let`, zero for none
+    uint32_t string_len;
+};
+
+enum SourcePreset {
+    SOURCE_MANY_FUNCTIONS,
+    SOURCE_DEEP_NESTING,
+    SOURCE_LONG_BLOCKS,
+    SOURCE_MANY_IDENTIFIERS,
+    SOURCE_LONG_STRINGS,
+};
+
+// The shape of `preset` with its scaled dimension set to `scale`.
+SourceShape source_preset_shape(SourcePreset preset, uint32_t scale);
+
+std::string source_generate(const SourceShape &shape);
+
+// Top level declarations in a program of the given shape, including `main`.
+uint32_t source_decl_count(const SourceShape &shape);
+
+#endif //ACORN_BENCH_SOURCE_GEN_H
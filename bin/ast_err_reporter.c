@@ -2,60 +2,6 @@
 
 #include "color.h"
 #include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-
-static uint64_t get_line_col(uint8_t *str, uint32_t pos) {
-    uint32_t row = 1, col = 0;
-    for (uint32_t i = 0; i < pos; i++) {
-        uint8_t c = str[i];
-        if (c == '\0') assert(false);
-
-        if (c == '\n') {
-            row++;
-            col = 0;
-        } else {
-            col++;
-        }
-    }
-    return (uint64_t) row << 32 | col;
-}
-
-static char *get_line(uint8_t *str, uint32_t line) {
-    // Copilot wrote this, not me :|
-    uint32_t start = 0, end = 0;
-
-    // Find the start of the line
-    for (uint32_t i = 0; i < strlen((char *) str); i++) {
-        uint8_t c = str[i];
-        if (c == '\0') assert(false);
-
-        if (c == '\n') {
-            if (line == 1) {
-                start = i + 1;
-                break;
-            }
-            line--;
-        }
-    }
-
-    // Find the end of the line
-    for (uint32_t i = start; i < strlen((char *) str); i++) {
-        uint8_t c = str[i];
-        if (c == '\0') assert(false);
-
-        if (c == '\n') {
-            end = i;
-            break;
-        }
-    }
-
-    // Copy the line
-    char *line_str = (char *) malloc(end - start + 1);
-    memcpy(line_str, str + start, end - start);
-    line_str[end - start] = '\0';
-    return line_str;
-}
 
 static void print_ast_error(char *file_name, Ast *ast, CompileError *error) {
     if (error->location.start == UINT32_MAX) {
@@ -63,15 +9,12 @@ static void print_ast_error(char *file_name, Ast *ast, CompileError *error) {
         return;
     }
 
-    uint64_t row_col = get_line_col(ast->source, error->location.start);
-    uint32_t row = row_col >> 32;
-    uint32_t col = row_col & 0xFFFFFFFF;
-
-    char *line = get_line(ast->source, row - 1);
+    SourceLoc loc = line_index_lookup(&ast->lines, error->location.start);
+    TokenLoc line = line_index_line(&ast->lines, ast->source, loc.line);
 
-    printf("%s:%d:%d: " RED "error" reset ": %s\n", file_name, row, col, error->message);
-    printf("%s\n", line);
-    printf("%*s" GRN "^" reset "\n", col, "");
+    printf("%s:%d:%d: " RED "error" reset ": %s\n", file_name, loc.line, loc.col, error->message);
+    printf("%.*s\n", (int) (line.end - line.start), ast->source + line.start);
+    printf("%*s" GRN "^" reset "\n", loc.col, "");
 
 }
 
@@ -0,0 +1,167 @@
+#include "build.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "time_report.h"
+
+typedef struct build_file_s {
+    int32_t exit_code;
+    // Outputs of a successful compile, see `module_output_paths`
+    char **outputs;
+    uint32_t output_count;
+    // Only set if the file defines `main`
+    char *exe_path;
+} BuildFile;
+
+typedef struct build_pool_s {
+    Invocation *invocation;
+    BuildFile *files;
+    atomic_uint next_file;
+} BuildPool;
+
+static void build_file(Invocation *invocation, uint32_t index, BuildFile *result) {
+    Invocation file = *invocation;
+    file.path = invocation->paths[index];
+    file.paths = &file.path;
+    file.path_count = 1;
+    file.build = true;
+    // Files are compiled concurrently instead of units, and linked once every file is compiled
+    file.options.jobs = 1;
+    if (file.options.emit & EMIT_EXE)
+        file.options.emit = (file.options.emit & ~EMIT_EXE) | EMIT_OBJ;
+
+    // Each file has its own default declaration cache, an explicit one is shared
+    char *decl_dir = NULL;
+    file.default_decl_dir = NULL;
+    if (invocation->default_decl_dir != NULL) {
+        decl_dir = malloc(strlen(file.path) + strlen(".cache") + 1);
+        strcpy(decl_dir, file.path);
+        strcat(decl_dir, ".cache");
+        file.caches.decl_dir = decl_dir;
+    }
+
+    Module module;
+    if (invocation_open_module(&file, &module)) {
+        result->exit_code = invocation_build(&file, &module, &result->outputs, &result->output_count);
+    } else {
+        result->exit_code = 64;
+    }
+
+    if (result->exit_code == 0 && module_find_decl(&module, "main") != NULL)
+        result->exe_path = module_exe_path(&module);
+    if (file.caches.print_stats && module.decl_cache != NULL)
+        decl_cache_print_stats(module.decl_cache, stderr);
+    module_free(&module);
+    free(decl_dir);
+}
+
+static void *build_worker(void *arg) {
+    BuildPool *pool = arg;
+    while (true) {
+        uint32_t index = atomic_fetch_add(&pool->next_file, 1);
+        if (index >= pool->invocation->path_count)
+            break;
+
+        build_file(pool->invocation, index, &pool->files[index]);
+    }
+    return NULL;
+}
+
+static bool is_object(const char *path) {
+    size_t len = strlen(path);
+    return len > 2 && strcmp(path + len - 2, ".o") == 0;
+}
+
+// Links the objects of every file into the executable of the file defining `main`.
+static int32_t link_files(Invocation *invocation, BuildFile *files) {
+    uint32_t output_count = 0;
+    for (uint32_t i = 0; i < invocation->path_count; i++)
+        output_count += files[i].output_count;
+
+    char *exe_path = NULL;
+    char **obj_paths = malloc(sizeof(char *) * (output_count + 1));
+    uint32_t obj_count = 0;
+    for (uint32_t i = 0; i < invocation->path_count; i++) {
+        BuildFile *file = &files[i];
+        if (file->exe_path != NULL) {
+            if (exe_path != NULL) {
+                fprintf(stderr, "More than one file defines main: %s\n", invocation->paths[i]);
+                free(obj_paths);
+                return 64;
+            }
+            exe_path = file->exe_path;
+        }
+
+        for (uint32_t j = 0; j < file->output_count; j++) {
+            if (is_object(file->outputs[j]))
+                obj_paths[obj_count++] = file->outputs[j];
+        }
+    }
+
+    if (exe_path == NULL) {
+        fprintf(stderr, "None of the files defines main\n");
+        free(obj_paths);
+        return 64;
+    }
+
+    TimeSpan span = time_phase_begin(TIME_PHASE_LINK);
+    bool linked = link_objects(obj_paths, obj_count, exe_path);
+    time_phase_end(&span, obj_count);
+    free(obj_paths);
+    return linked ? 0 : 64;
+}
+
+int32_t build_run(Invocation *invocation) {
+    // Initializes LLVM targets before starting any workers, and checks the target once
+    if (codegen_target_machine(&invocation->options) == NULL)
+        return 64;
+
+    BuildPool pool = {.invocation = invocation, .files = calloc(invocation->path_count, sizeof(BuildFile))};
+    atomic_init(&pool.next_file, 0);
+
+    uint32_t jobs = invocation->options.jobs;
+    uint32_t thread_count = jobs < invocation->path_count ? jobs : invocation->path_count;
+    pthread_t *threads = NULL;
+    uint32_t started = 0;
+    if (thread_count > 1) {
+        threads = malloc(sizeof(pthread_t) * (thread_count - 1));
+        for (; started < thread_count - 1; started++) {
+            if (pthread_create(&threads[started], NULL, build_worker, &pool) != 0)
+                break;
+        }
+    }
+
+    build_worker(&pool);
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    // Every file is compiled even if one fails, so that all errors are reported
+    int32_t exit_code = 0;
+    for (uint32_t i = 0; i < invocation->path_count && exit_code == 0; i++)
+        exit_code = pool.files[i].exit_code;
+    if (exit_code == 0 && (invocation->options.emit & EMIT_EXE))
+        exit_code = link_files(invocation, pool.files);
+
+    // Objects only written for the link are removed whether or not it happened, as for a single file
+    bool remove_objects = !(invocation->options.emit & EMIT_OBJ);
+    for (uint32_t i = 0; i < invocation->path_count; i++) {
+        BuildFile *file = &pool.files[i];
+        for (uint32_t j = 0; j < file->output_count; j++) {
+            if (remove_objects && is_object(file->outputs[j]))
+                unlink(file->outputs[j]);
+            free(file->outputs[j]);
+        }
+        free(file->outputs);
+        free(file->exe_path);
+    }
+    free(pool.files);
+    return exit_code;
+}
@@ -0,0 +1,19 @@
+#ifndef ACORN_BUILD_H
+#define ACORN_BUILD_H
+
+#include "driver.h"
+
+// SECTION: Build
+// `acorn build <file>... -j <jobs>` compiles many files in one process. Each file is its own module, compiled start to
+// finish by one of `jobs` worker threads, so that independent files compile concurrently. A module generates code in
+// LLVM contexts created by the worker which compiles it, and nothing but LLVM initialization (see
+// `codegen_target_machine`) is shared between workers. Each worker also keeps its target machine between files.
+//
+// Every decl with a body is compiled, whether or not the file has a `main`, so files call each other through
+// `foreign` declarations. With `--emit=exe` the objects of every file are linked in a single step, into an executable
+// named after the one file which defines `main`.
+
+// Compiles every file of the invocation, printing errors to stderr, and returns the process exit code.
+int32_t build_run(Invocation *invocation);
+
+#endif //ACORN_BUILD_H
@@ -0,0 +1,579 @@
+#include "daemon.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "driver.h"
+#include "cache_util.h"
+#include "writer.h"
+
+// SECTION: Resident builds
+// The source, flags and outputs of each compile the daemon ran, used to answer unchanged requests without compiling.
+
+typedef struct resident_output_s {
+    char *path;
+    off_t size;
+    struct timespec modified;
+} ResidentOutput;
+
+typedef struct resident_build_s {
+    // The absolute source path and the flags
+    char *key;
+    char *source;
+    size_t source_len;
+    ResidentOutput *outputs;
+    uint32_t output_count;
+} ResidentBuild;
+
+typedef struct resident_build_list_s {
+    uint32_t size;
+    uint32_t capacity;
+    ResidentBuild *data;
+} ResidentBuildList;
+
+#define self_t ResidentBuild *self
+
+static void resident_build_free(self_t) {
+    free(self->key);
+    free(self->source);
+    for (uint32_t i = 0; i < self->output_count; i++)
+        free(self->outputs[i].path);
+    free(self->outputs);
+}
+
+static bool resident_build_up_to_date(self_t, const char *source, size_t source_len) {
+    if (self->source_len != source_len || memcmp(self->source, source, source_len) != 0)
+        return false;
+
+    for (uint32_t i = 0; i < self->output_count; i++) {
+        ResidentOutput *output = &self->outputs[i];
+        struct stat current;
+        if (stat(output->path, &current) != 0 || current.st_size != output->size ||
+            current.st_mtim.tv_sec != output->modified.tv_sec || current.st_mtim.tv_nsec != output->modified.tv_nsec)
+            return false;
+    }
+    return true;
+}
+
+#undef self_t
+
+#define self_t ResidentBuildList *self
+
+static ResidentBuild *resident_build_find(self_t, const char *key) {
+    for (uint32_t i = 0; i < self->size; i++) {
+        if (strcmp(self->data[i].key, key) == 0)
+            return &self->data[i];
+    }
+    return NULL;
+}
+
+static void resident_build_remove(self_t, ResidentBuild *build) {
+    resident_build_free(build);
+    *build = self->data[--self->size];
+}
+
+// Records a successful compile, replacing any earlier one with the same key. Takes ownership of the key and source.
+static void resident_build_record(self_t, char *key, char *source, size_t source_len, char **outputs,
+                                  uint32_t output_count) {
+    ResidentBuild *build = resident_build_find(self, key);
+    if (build != NULL)
+        resident_build_remove(self, build);
+
+    ResidentBuild record = {.key = key, .source = source, .source_len = source_len, .outputs = NULL,
+            .output_count = 0};
+    record.outputs = malloc(sizeof(ResidentOutput) * (output_count + 1));
+    for (uint32_t i = 0; i < output_count; i++) {
+        struct stat info;
+        char *path = realpath(outputs[i], NULL);
+        if (path == NULL || stat(path, &info) != 0) {
+            // An output which cannot be checked means the build is never up to date
+            free(path);
+            resident_build_free(&record);
+            return;
+        }
+        record.outputs[record.output_count++] = (ResidentOutput) {
+            .path = path, .size = info.st_size, .modified = info.st_mtim,
+        };
+    }
+
+    if (self->capacity < self->size + 1) {
+        self->capacity = self->capacity < 8 ? 8 : self->capacity * 2;
+        self->data = realloc(self->data, sizeof(ResidentBuild) * self->capacity);
+    }
+    self->data[self->size++] = record;
+}
+
+#undef self_t
+
+// SECTION: Resident modules
+// The module of each source path, as of the last source which compiled. Each compile brings the copy of its child up
+// to date (see `module_reload_buffer`), so that unchanged decls keep their MIR. The daemon catches up once the client
+// has its reply, loading the MIR the child lowered from the declaration cache instead of lowering it again.
+
+typedef struct resident_module_s {
+    // The absolute source path, which the module borrows
+    char *path;
+    // The flags and declaration cache directory the module was opened with
+    char *options;
+    Module *module;
+} ResidentModule;
+
+typedef struct resident_module_list_s {
+    uint32_t size;
+    uint32_t capacity;
+    ResidentModule *data;
+} ResidentModuleList;
+
+// A successful compile, which the resident module of its source catches up with after the reply.
+typedef struct catch_up_s {
+    // NULL if there is nothing to catch up with
+    char *source;
+    size_t source_len;
+    char *path;
+    char *options;
+} CatchUp;
+
+#define self_t ResidentModuleList *self
+
+static void resident_module_free(ResidentModule *module) {
+    module_free(module->module);
+    free(module->module);
+    free(module->path);
+    free(module->options);
+}
+
+static ResidentModule *resident_module_find(self_t, const char *path) {
+    for (uint32_t i = 0; i < self->size; i++) {
+        if (strcmp(self->data[i].path, path) == 0)
+            return &self->data[i];
+    }
+    return NULL;
+}
+
+static void resident_module_remove(self_t, ResidentModule *module) {
+    resident_module_free(module);
+    *module = self->data[--self->size];
+}
+
+// Opens the module of a path without one, from a source which is known to compile. Returns NULL if it could not be
+// opened. Takes ownership of the path and options.
+static ResidentModule *resident_module_open(self_t, Invocation *invocation, char *path, char *options,
+                                            const char *source, size_t source_len) {
+    // The module borrows the absolute path, which stays valid whatever the working directory of later requests
+    Invocation resident_invocation = *invocation;
+    resident_invocation.path = path;
+    Module *module = malloc(sizeof(Module));
+    ModuleReload reload;
+    if (!invocation_load_source(&resident_invocation, module, false, source, source_len, &reload)) {
+        module_free(module);
+        free(module);
+        free(path);
+        free(options);
+        return NULL;
+    }
+
+    if (self->capacity < self->size + 1) {
+        self->capacity = self->capacity < 8 ? 8 : self->capacity * 2;
+        self->data = realloc(self->data, sizeof(ResidentModule) * self->capacity);
+    }
+    self->data[self->size] = (ResidentModule) {.path = path, .options = options, .module = module};
+    return &self->data[self->size++];
+}
+
+static void resident_module_catch_up(self_t, Invocation *invocation, CatchUp *catch_up) {
+    if (catch_up->source == NULL)
+        return;
+
+    ResidentModule *resident = resident_module_find(self, catch_up->path);
+    if (resident != NULL) {
+        ModuleReload reload;
+        module_reload_buffer(resident->module, catch_up->source, catch_up->source_len, &reload);
+        free(catch_up->path);
+        free(catch_up->options);
+    } else {
+        resident = resident_module_open(self, invocation, catch_up->path, catch_up->options, catch_up->source,
+                                        catch_up->source_len);
+    }
+
+    if (resident != NULL)
+        module_load_cached_mir(resident->module);
+    free(catch_up->source);
+    *catch_up = (CatchUp) {.source = NULL, .source_len = 0, .path = NULL, .options = NULL};
+}
+
+#undef self_t
+
+
+// SECTION: Compiles
+
+typedef struct daemon_state_s {
+    ResidentBuildList builds;
+    ResidentModuleList modules;
+} DaemonState;
+
+// Every compile uses the declaration cache, by default next to the source as for `--incremental`. The directory is
+// made absolute, since the resident module which keeps it outlives the working directory of the request.
+static void use_decl_cache(Invocation *invocation, const char *source_path) {
+    const char *dir = invocation->caches.decl_dir;
+    char *absolute;
+    if (dir == NULL || dir == invocation->default_decl_dir) {
+        absolute = malloc(strlen(source_path) + strlen(".cache") + 1);
+        strcpy(absolute, source_path);
+        strcat(absolute, ".cache");
+    } else if (dir[0] == '/') {
+        return;
+    } else {
+        char *cwd = getcwd(NULL, 0);
+        if (cwd == NULL)
+            return;
+        size_t len = strlen(cwd) + strlen(dir) + 2;
+        absolute = malloc(len);
+        snprintf(absolute, len, "%s/%s", cwd, dir);
+        free(cwd);
+    }
+
+    free(invocation->default_decl_dir);
+    invocation->default_decl_dir = absolute;
+    invocation->caches.decl_dir = absolute;
+}
+
+// Compiles in a child process, so that a crashing compile does not take the daemon down with it. The child inherits
+// the initialized LLVM and cached target machines, and sends the paths of its outputs back over a pipe.
+// With a `source`, the child brings its copy of `module` up to it, opening it if `module` is NULL.
+static int32_t run_isolated(Invocation *invocation, Module *module, const char *source, size_t source_len,
+                            char ***outputs, uint32_t *output_count) {
+    *outputs = NULL;
+    *output_count = 0;
+
+    int output_pipe[2];
+    if (pipe(output_pipe) != 0) {
+        fprintf(stderr, "Could not create a pipe: %s\n", strerror(errno));
+        return 64;
+    }
+
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+        fprintf(stderr, "Could not start a compile: %s\n", strerror(errno));
+        close(output_pipe[0]);
+        close(output_pipe[1]);
+        return 64;
+    }
+
+    if (child == 0) {
+        close(output_pipe[0]);
+        char **paths;
+        uint32_t count;
+        Module opened;
+        int32_t exit_code = source == NULL
+                ? invocation_run(invocation, &paths, &count)
+                : invocation_run_source(invocation, module != NULL ? module : &opened, module != NULL, source,
+                                        source_len, &paths, &count);
+        for (uint32_t i = 0; i < count; i++)
+            write(output_pipe[1], paths[i], strlen(paths[i]) + 1);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(exit_code);
+    }
+
+    close(output_pipe[1]);
+    Writer paths;
+    writer_init_buffer(&paths);
+    char buffer[4096];
+    ssize_t read_len;
+    while ((read_len = read(output_pipe[0], buffer, sizeof(buffer))) != 0) {
+        if (read_len < 0 && errno == EINTR)
+            continue;
+        if (read_len < 0)
+            break;
+        writer_write(&paths, buffer, read_len);
+    }
+    close(output_pipe[0]);
+
+    int status;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR);
+    if (!WIFEXITED(status)) {
+        fprintf(stderr, "The compiler crashed with signal %d\n", WTERMSIG(status));
+        writer_free(&paths);
+        return 128 + WTERMSIG(status);
+    }
+
+    int32_t exit_code = WEXITSTATUS(status);
+    if (exit_code == 0) {
+        for (size_t i = 0; i < paths.size; i += strlen(paths.data + i) + 1)
+            (*output_count)++;
+        *outputs = malloc(sizeof(char *) * (*output_count + 1));
+        uint32_t index = 0;
+        for (size_t i = 0; i < paths.size; i += strlen(paths.data + i) + 1)
+            (*outputs)[index++] = strdup(paths.data + i);
+
+        // Later children inherit a target machine for these options for each of their worker threads
+        if (invocation->backend == BACKEND_LLVM)
+            codegen_prepare_target_machines(&invocation->options, invocation->options.jobs);
+    }
+    writer_free(&paths);
+    return exit_code;
+}
+
+// Compiles `invocation` unless the daemon already produced its current outputs. A successful compile of a source is
+// left in `catch_up` for its resident module.
+static int32_t run_resident(DaemonState *daemon, Invocation *invocation, CatchUp *catch_up) {
+    *catch_up = (CatchUp) {.source = NULL, .source_len = 0, .path = NULL, .options = NULL};
+
+    char *source_path = realpath(invocation->path, NULL);
+    size_t source_len = 0;
+    char *source = source_path != NULL ? cache_read_file(source_path, &source_len) : NULL;
+    char **outputs;
+    uint32_t output_count;
+    int32_t exit_code;
+    if (source == NULL) {
+        free(source_path);
+        exit_code = run_isolated(invocation, NULL, NULL, 0, &outputs, &output_count);
+        for (uint32_t i = 0; i < output_count; i++)
+            free(outputs[i]);
+        free(outputs);
+        return exit_code;
+    }
+
+    use_decl_cache(invocation, source_path);
+    char flags[512];
+    invocation_write_flags(invocation, flags, sizeof(flags));
+    size_t key_len = strlen(source_path) + strlen(flags) + 2;
+    char *key = malloc(key_len);
+    snprintf(key, key_len, "%s\n%s", source_path, flags);
+    size_t options_len = strlen(flags) + strlen(invocation->caches.decl_dir) + 2;
+    char *options = malloc(options_len);
+    snprintf(options, options_len, "%s\n%s", flags, invocation->caches.decl_dir);
+
+    // MIR is not among the tracked outputs
+    bool tracked = !(invocation->options.emit & EMIT_MIR);
+    ResidentBuild *build = resident_build_find(&daemon->builds, key);
+    if (tracked && build != NULL && resident_build_up_to_date(build, source, source_len)) {
+        if (invocation->caches.print_stats)
+            fprintf(stderr, "daemon: outputs are up to date\n");
+        free(source_path);
+        free(key);
+        free(options);
+        free(source);
+        return 0;
+    }
+
+    // A module opened with other flags is opened again
+    ResidentModule *resident = resident_module_find(&daemon->modules, source_path);
+    if (resident != NULL && strcmp(resident->options, options) != 0) {
+        resident_module_remove(&daemon->modules, resident);
+        resident = NULL;
+    }
+    exit_code = run_isolated(invocation, resident != NULL ? resident->module : NULL, source, source_len, &outputs,
+                             &output_count);
+
+    if (exit_code == 0) {
+        char *copy = malloc(source_len + 1);
+        memcpy(copy, source, source_len + 1);
+        *catch_up = (CatchUp) {.source = copy, .source_len = source_len, .path = source_path, .options = options};
+    } else {
+        free(source_path);
+        free(options);
+    }
+
+    // An artifact cache hit does not report its outputs, so it is not recorded
+    if (exit_code == 0 && tracked && output_count > 0) {
+        resident_build_record(&daemon->builds, key, source, source_len, outputs, output_count);
+    } else {
+        build = resident_build_find(&daemon->builds, key);
+        if (build != NULL)
+            resident_build_remove(&daemon->builds, build);
+        free(key);
+        free(source);
+    }
+
+    for (uint32_t i = 0; i < output_count; i++)
+        free(outputs[i]);
+    free(outputs);
+    return exit_code;
+}
+
+
+// SECTION: Server
+
+static volatile sig_atomic_t daemon_stopping = 0;
+
+static void stop_daemon(int signal) {
+    (void) signal;
+    daemon_stopping = 1;
+}
+
+// Receives the request header and the client stdout and stderr.
+static bool receive_header(int connection, uint32_t *payload_len, int fds[2]) {
+    struct iovec iov = {.iov_base = payload_len, .iov_len = sizeof(*payload_len)};
+    char control[CMSG_SPACE(sizeof(int) * 2)];
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    if (recvmsg(connection, &message, MSG_CMSG_CLOEXEC) != sizeof(*payload_len))
+        return false;
+
+    struct cmsghdr *fds_message = CMSG_FIRSTHDR(&message);
+    if (fds_message == NULL || fds_message->cmsg_type != SCM_RIGHTS ||
+        fds_message->cmsg_len != CMSG_LEN(sizeof(int) * 2))
+        return false;
+    memcpy(fds, CMSG_DATA(fds_message), sizeof(int) * 2);
+    return true;
+}
+
+static void handle_request(int connection, DaemonState *daemon) {
+    uint32_t payload_len;
+    int client_fds[2];
+    if (!receive_header(connection, &payload_len, client_fds))
+        return;
+
+    char *payload = malloc(payload_len + 1);
+    int32_t exit_code = 64;
+    if (payload_len == 0 || !daemon_read_all(connection, payload, payload_len)) {
+        free(payload);
+        close(client_fds[0]);
+        close(client_fds[1]);
+        return;
+    }
+    payload[payload_len] = '\0';
+
+    // The working directory is followed by the arguments
+    int32_t argc = 0;
+    char **argv = malloc(sizeof(char *) * payload_len);
+    const char *cwd = payload;
+    for (char *cursor = payload + strlen(payload) + 1; cursor < payload + payload_len; cursor += strlen(cursor) + 1)
+        argv[argc++] = cursor;
+
+    // Requests run with the client working directory and output, which are put back afterwards
+    int saved_cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int saved_stderr = dup(STDERR_FILENO);
+    fflush(stdout);
+    dup2(client_fds[0], STDOUT_FILENO);
+    dup2(client_fds[1], STDERR_FILENO);
+
+    Invocation invocation;
+    bool parsed = false;
+    CatchUp catch_up = {.source = NULL, .source_len = 0, .path = NULL, .options = NULL};
+    if (chdir(cwd) != 0) {
+        fprintf(stderr, "The daemon could not enter %s: %s\n", cwd, strerror(errno));
+    } else {
+        parsed = invocation_parse(&invocation, "acorn", argc, argv);
+        if (parsed) {
+            if (invocation_needs_process(&invocation)) {
+                exit_code = DAEMON_DECLINED;
+            } else {
+                exit_code = run_resident(daemon, &invocation, &catch_up);
+            }
+        }
+    }
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    dup2(saved_stderr, STDERR_FILENO);
+    fchdir(saved_cwd);
+    close(saved_stdout);
+    close(saved_stderr);
+    close(saved_cwd);
+    close(client_fds[0]);
+    close(client_fds[1]);
+
+    // The client does not wait for the resident module
+    daemon_write_all(connection, &exit_code, sizeof(exit_code));
+    if (parsed) {
+        resident_module_catch_up(&daemon->modules, &invocation, &catch_up);
+        invocation_free(&invocation);
+    }
+    free(argv);
+    free(payload);
+}
+
+// Binds the socket, replacing a stale socket file left by a daemon which did not exit cleanly.
+static int listen_on(const char *socket_path) {
+    struct sockaddr_un address;
+    if (!daemon_socket_address(socket_path, &address))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Could not create a socket: %s\n", strerror(errno));
+        return -1;
+    }
+
+    bool bound = bind(fd, (struct sockaddr *) &address, sizeof(address)) == 0;
+    if (!bound && errno == EADDRINUSE) {
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool running = connect(probe, (struct sockaddr *) &address, sizeof(address)) == 0;
+        close(probe);
+        if (running) {
+            fprintf(stderr, "A daemon is already listening on %s\n", socket_path);
+            close(fd);
+            return -1;
+        }
+        unlink(socket_path);
+        bound = bind(fd, (struct sockaddr *) &address, sizeof(address)) == 0;
+    }
+
+    if (!bound || listen(fd, 16) != 0) {
+        fprintf(stderr, "Could not listen on %s: %s\n", socket_path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int32_t daemon_serve(const char *socket_path) {
+    int fd = listen_on(socket_path);
+    if (fd < 0)
+        return 1;
+
+    // Interrupting `accept` stops the daemon, a client going away only fails its writes
+    struct sigaction stop = {.sa_handler = stop_daemon};
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    fprintf(stderr, "Listening on %s\n", socket_path);
+    DaemonState daemon = {
+        .builds = {.size = 0, .capacity = 0, .data = NULL},
+        .modules = {.size = 0, .capacity = 0, .data = NULL},
+    };
+    while (!daemon_stopping) {
+        int connection = accept(fd, NULL, NULL);
+        if (connection < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Could not accept a connection: %s\n", strerror(errno));
+            break;
+        }
+
+        if (daemon_peer_is_user(connection)) {
+            handle_request(connection, &daemon);
+        } else {
+            fprintf(stderr, "Rejected a connection from another user\n");
+        }
+        close(connection);
+    }
+
+    for (uint32_t i = 0; i < daemon.builds.size; i++)
+        resident_build_free(&daemon.builds.data[i]);
+    free(daemon.builds.data);
+    for (uint32_t i = 0; i < daemon.modules.size; i++)
+        resident_module_free(&daemon.modules.data[i]);
+    free(daemon.modules.data);
+    close(fd);
+    unlink(socket_path);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef ACORN_DAEMON_H
+#define ACORN_DAEMON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// SECTION: Daemon
+// `acorn --daemon` keeps a compiler process running on a local Unix socket, so that repeated compiles do not pay for
+// process startup, LLVM initialization or target machine creation (see `codegen_target_machine`).
+// `acorn --client <arguments>`, or the smaller `acorn-client <arguments>` which does not load LLVM at all, forwards a
+// command line to it.
+//
+// Both sides only talk to a process of the same user, since the default socket path is predictable.
+//
+// The daemon runs each request in the client working directory and writes to the client stdout and stderr. Requests
+// run one at a time, each compile in a forked child so that a crash only fails that request. Children inherit the
+// initialized LLVM, and the daemon creates target machines for each set of options it has compiled with, one for
+// every job, so that the worker threads of later children do not create their own.
+//
+// The daemon remembers the source, flags and outputs of every compile it ran. A request whose source and flags are
+// unchanged, and whose outputs are still as they were written, is answered without compiling.
+// It also keeps the parsed and lowered module of every source path, as of the last source which compiled. The child
+// of a later request reloads it (see `module_reload`), so only changed decls are lowered to MIR again, and every
+// compile uses the declaration cache (next to the source unless `--incremental=<dir>` is given, see `decl_cache.h`)
+// so only their objects are generated. After replying, the daemon reloads its own module and loads the MIR the child
+// lowered from the declaration cache.
+// Invocations which run the program or report on the process (see `invocation_needs_process`) are declined, and the
+// client runs them itself.
+
+// Reply to a request the client has to run itself. Exit codes are never negative.
+#define DAEMON_DECLINED (-1)
+
+// `$XDG_RUNTIME_DIR/acorn.sock`, or `/tmp/acorn-<uid>.sock` without a runtime directory. The caller frees the path.
+char *daemon_default_socket(void);
+
+// Serves requests until interrupted. Returns the process exit code.
+int32_t daemon_serve(const char *socket_path);
+
+// Forwards the arguments (without the program name) to the daemon at `socket_path`. Returns false if no daemon is
+// listening, it runs as another user or it declined the request, in which case nothing ran.
+bool daemon_forward(const char *socket_path, int32_t argc, char **argv, int32_t *exit_code);
+
+// Used by both sides of the socket.
+struct sockaddr_un;
+bool daemon_socket_address(const char *socket_path, struct sockaddr_un *address);
+// Whether the process on the other end of a connected socket runs as the same user.
+bool daemon_peer_is_user(int fd);
+bool daemon_write_all(int fd, const void *data, size_t len);
+bool daemon_read_all(int fd, void *data, size_t len);
+
+#endif //ACORN_DAEMON_H
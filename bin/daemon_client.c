@@ -0,0 +1,151 @@
+// For `struct ucred`
+#define _GNU_SOURCE
+
+#include "daemon.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// The client side of the daemon, which does not depend on the compiler so that `acorn-client` starts quickly.
+
+// SECTION: Protocol
+// A request is a 32-bit payload length sent with the client stdout and stderr attached, then the payload: the
+// working directory and each argument, all null terminated. The reply is a 32-bit exit code, or `DAEMON_DECLINED`.
+
+char *daemon_default_socket(void) {
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    char path[sizeof(((struct sockaddr_un *) NULL)->sun_path)];
+    if (runtime_dir != NULL && runtime_dir[0] != '\0') {
+        snprintf(path, sizeof(path), "%s/acorn.sock", runtime_dir);
+    } else {
+        snprintf(path, sizeof(path), "/tmp/acorn-%u.sock", (unsigned) getuid());
+    }
+    return strdup(path);
+}
+
+bool daemon_socket_address(const char *socket_path, struct sockaddr_un *address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "Socket path is too long: %s\n", socket_path);
+        return false;
+    }
+    strcpy(address->sun_path, socket_path);
+    return true;
+}
+
+bool daemon_peer_is_user(int fd) {
+    struct ucred peer;
+    socklen_t len = sizeof(peer);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &len) == 0 && peer.uid == getuid();
+}
+
+bool daemon_write_all(int fd, const void *data, size_t len) {
+    const char *bytes = data;
+    while (len > 0) {
+        ssize_t written = send(fd, bytes, len, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        len -= written;
+    }
+    return true;
+}
+
+bool daemon_read_all(int fd, void *data, size_t len) {
+    char *bytes = data;
+    while (len > 0) {
+        ssize_t read = recv(fd, bytes, len, 0);
+        if (read < 0 && errno == EINTR)
+            continue;
+        if (read <= 0)
+            return false;
+        bytes += read;
+        len -= read;
+    }
+    return true;
+}
+
+
+// SECTION: Client
+
+bool daemon_forward(const char *socket_path, int32_t argc, char **argv, int32_t *exit_code) {
+    struct sockaddr_un address;
+    if (!daemon_socket_address(socket_path, &address))
+        return false;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    if (connect(fd, (struct sockaddr *) &address, sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Anyone can bind a socket in /tmp first, they must not get our arguments, output or exit code
+    if (!daemon_peer_is_user(fd)) {
+        fprintf(stderr, "Not forwarding to %s, which is not served by this user\n", socket_path);
+        close(fd);
+        return false;
+    }
+
+    char *cwd = getcwd(NULL, 0);
+    if (cwd == NULL) {
+        close(fd);
+        return false;
+    }
+    size_t payload_len = strlen(cwd) + 1;
+    for (int32_t i = 0; i < argc; i++)
+        payload_len += strlen(argv[i]) + 1;
+    char *payload = malloc(payload_len);
+    char *cursor = stpcpy(payload, cwd) + 1;
+    for (int32_t i = 0; i < argc; i++)
+        cursor = stpcpy(cursor, argv[i]) + 1;
+    free(cwd);
+
+    // The daemon writes straight to our stdout and stderr
+    uint32_t header = (uint32_t) payload_len;
+    struct iovec iov = {.iov_base = &header, .iov_len = sizeof(header)};
+    int fds[2] = {STDOUT_FILENO, STDERR_FILENO};
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+    struct msghdr message = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control,
+        .msg_controllen = sizeof(control),
+    };
+    struct cmsghdr *fds_message = CMSG_FIRSTHDR(&message);
+    fds_message->cmsg_level = SOL_SOCKET;
+    fds_message->cmsg_type = SCM_RIGHTS;
+    fds_message->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(fds_message), fds, sizeof(fds));
+
+    bool sent = sendmsg(fd, &message, MSG_NOSIGNAL) == sizeof(header) && daemon_write_all(fd, payload, payload_len);
+    free(payload);
+
+    // Nothing has run unless the request was sent in full
+    if (!sent) {
+        close(fd);
+        return false;
+    }
+
+    int32_t reply;
+    bool ran = true;
+    if (!daemon_read_all(fd, &reply, sizeof(reply))) {
+        fprintf(stderr, "Lost the connection to the daemon at %s\n", socket_path);
+        reply = 64;
+    } else if (reply == DAEMON_DECLINED) {
+        ran = false;
+    }
+    *exit_code = reply;
+    close(fd);
+    return ran;
+}
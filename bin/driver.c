@@ -0,0 +1,429 @@
+#include "driver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "artifact_cache.h"
+#include "ast_err_reporter.h"
+
+#define self_t Invocation *self
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--jit[=lazy]] [--backend=llvm|native] [-O0|-O1|-O2|-O3|-Os] [--emit=obj,asm,bc,ll,exe,mir] [-j <jobs>] [--codegen-units=<n>] [--target=<triple>] [--cpu=<name>|native] [--time-report[=json]] [--trace=<out.json>] [--perf-counters] [--incremental[=<dir>]] [--cache-dir=<dir>] [--cache-size=<MiB>] [--cache-stats] [--watch] <file>\n"
+                    "       %s build [<options>] [-j <jobs>] <file>...\n"
+                    "       %s --daemon[=<socket>]\n"
+                    "       %s --client[=<socket>] <arguments>\n", program, program, program, program);
+}
+
+bool invocation_parse(self_t, const char *program, int32_t argc, char **argv) {
+    self->path = NULL;
+    self->paths = malloc(sizeof(char *) * (argc > 0 ? argc : 1));
+    self->path_count = 0;
+    self->build = argc > 0 && strcmp(argv[0], "build") == 0;
+    self->mode = RUN_MODE_EMIT;
+    self->backend = BACKEND_LLVM;
+    self->options = CODEGEN_OPTIONS_DEFAULT;
+    self->caches = (Caches) {.decl_dir = NULL, .artifact_dir = NULL, .artifact_max_size = 1024ULL << 20,
+            .print_stats = false};
+    self->reports = 0;
+    self->trace_path = NULL;
+    self->default_decl_dir = NULL;
+    self->watch = false;
+    bool incremental_default_dir = false;
+
+    CodegenOptions *options = &self->options;
+    for (int32_t i = self->build ? 1 : 0; i < argc; i++) {
+        if (strcmp(argv[i], "--jit") == 0) {
+            self->mode = RUN_MODE_JIT;
+        } else if (strcmp(argv[i], "--jit=lazy") == 0) {
+            self->mode = RUN_MODE_JIT_LAZY;
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            options->opt_level = CODEGEN_OPT_O0;
+        } else if (strcmp(argv[i], "-O1") == 0) {
+            options->opt_level = CODEGEN_OPT_O1;
+        } else if (strcmp(argv[i], "-O2") == 0) {
+            options->opt_level = CODEGEN_OPT_O2;
+        } else if (strcmp(argv[i], "-O3") == 0) {
+            options->opt_level = CODEGEN_OPT_O3;
+        } else if (strcmp(argv[i], "-Os") == 0) {
+            options->opt_level = CODEGEN_OPT_OS;
+        } else if (strncmp(argv[i], "--emit=", 7) == 0) {
+            if (!codegen_parse_emit_kinds(argv[i] + 7, &options->emit)) {
+                fprintf(stderr, "Unknown emit kind in: %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options->jobs = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            options->jobs = (uint32_t) strtoul(argv[i] + 2, NULL, 10);
+        } else if (strncmp(argv[i], "--codegen-units=", 16) == 0) {
+            options->codegen_units = (uint32_t) strtoul(argv[i] + 16, NULL, 10);
+        } else if (strncmp(argv[i], "--target=", 9) == 0) {
+            options->target = argv[i] + 9;
+        } else if (strncmp(argv[i], "--cpu=", 6) == 0) {
+            options->cpu = argv[i] + 6;
+        } else if (strcmp(argv[i], "--time-report") == 0) {
+            self->reports |= REPORT_TIME;
+        } else if (strcmp(argv[i], "--time-report=json") == 0) {
+            self->reports |= REPORT_TIME_JSON;
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            self->reports |= REPORT_PERF;
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            self->reports |= REPORT_TRACE;
+            self->trace_path = argv[i] + 8;
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            incremental_default_dir = true;
+        } else if (strncmp(argv[i], "--incremental=", 14) == 0) {
+            self->caches.decl_dir = argv[i] + 14;
+        } else if (strncmp(argv[i], "--cache-dir=", 12) == 0) {
+            self->caches.artifact_dir = argv[i] + 12;
+        } else if (strncmp(argv[i], "--cache-size=", 13) == 0) {
+            self->caches.artifact_max_size = (uint64_t) strtoull(argv[i] + 13, NULL, 10) << 20;
+        } else if (strcmp(argv[i], "--cache-stats") == 0) {
+            self->caches.print_stats = true;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            self->watch = true;
+        } else if (strcmp(argv[i], "--backend=llvm") == 0) {
+            self->backend = BACKEND_LLVM;
+        } else if (strcmp(argv[i], "--backend=native") == 0) {
+            self->backend = BACKEND_NATIVE;
+        } else if ((self->build || self->path_count == 0) && argv[i][0] != '-') {
+            self->paths[self->path_count++] = argv[i];
+        } else {
+            self->path_count = 0;
+            break;
+        }
+    }
+
+    if (self->path_count == 0) {
+        print_usage(program);
+        return false;
+    }
+    self->path = self->paths[0];
+
+    if (self->build && (self->mode != RUN_MODE_EMIT || self->backend != BACKEND_LLVM || self->watch ||
+                        self->caches.artifact_dir != NULL)) {
+        fprintf(stderr, "build only supports emitting files with the llvm backend, without --watch or --cache-dir\n");
+        return false;
+    }
+
+    if (self->backend == BACKEND_NATIVE && self->mode != RUN_MODE_EMIT) {
+        fprintf(stderr, "The JIT requires the llvm backend\n");
+        return false;
+    }
+
+    if (self->watch && self->mode != RUN_MODE_EMIT) {
+        fprintf(stderr, "--watch can not be used with the JIT\n");
+        return false;
+    }
+
+    if (options->jobs == 0)
+        options->jobs = 1;
+    // The JIT takes a single LLVM module
+    if (self->mode != RUN_MODE_EMIT)
+        options->codegen_units = 1;
+
+    // Watching keeps the objects of unchanged decls, which needs the declaration cache.
+    // The default cache is placed next to the source, like every other output
+    if ((incremental_default_dir || self->watch) && self->caches.decl_dir == NULL) {
+        self->default_decl_dir = malloc(strlen(self->path) + strlen(".cache") + 1);
+        strcpy(self->default_decl_dir, self->path);
+        strcat(self->default_decl_dir, ".cache");
+        self->caches.decl_dir = self->default_decl_dir;
+    }
+    return true;
+}
+
+void invocation_free(self_t) {
+    free(self->paths);
+    self->paths = NULL;
+    self->path_count = 0;
+    free(self->default_decl_dir);
+    self->default_decl_dir = NULL;
+}
+
+bool invocation_needs_process(self_t) {
+    return self->mode != RUN_MODE_EMIT || self->reports != 0 || self->watch || self->build;
+}
+
+void invocation_write_flags(self_t, char *buffer, size_t size) {
+    CodegenOptions *options = &self->options;
+    snprintf(buffer, size, "--backend=%s -O%d --emit=%u --target=%s --cpu=%s -j%u --codegen-units=%u%s",
+             self->backend == BACKEND_NATIVE ? "native" : "llvm", (int) options->opt_level, options->emit,
+             options->target != NULL ? options->target : "host", options->cpu != NULL ? options->cpu : "generic",
+             options->jobs, options->codegen_units, self->caches.decl_dir != NULL ? " --incremental" : "");
+}
+
+
+// SECTION: Running
+
+// Opens the artifact cache for compiles it can hold, which are those emitting files other than MIR.
+static bool open_artifact_cache(self_t, ArtifactCache *cache) {
+    Caches *caches = &self->caches;
+    if (caches->artifact_dir == NULL || self->mode != RUN_MODE_EMIT || (self->options.emit & EMIT_MIR))
+        return false;
+    if (!artifact_cache_init(cache, caches->artifact_dir, caches->artifact_max_size))
+        return false;
+
+    // Everything which changes the outputs, other than the compiler and source
+    char flags[512];
+    invocation_write_flags(self, flags, sizeof(flags));
+    if (!artifact_cache_begin(cache, self->path, flags)) {
+        artifact_cache_free(cache);
+        return false;
+    }
+    return true;
+}
+
+// Stores the outputs of a successful compile in the artifact cache, if one is open.
+static void finish_module(self_t, Module *module, ArtifactCache *artifacts, char **paths, uint32_t count) {
+    if (artifacts != NULL) {
+        artifact_cache_store(artifacts, paths, count);
+        if (self->caches.print_stats)
+            artifact_cache_print_stats(artifacts, stderr);
+        artifact_cache_free(artifacts);
+    }
+    if (self->caches.print_stats && module->decl_cache != NULL)
+        decl_cache_print_stats(module->decl_cache, stderr);
+}
+
+// Releases everything after a failed compile, returning `exit_code`.
+static int32_t fail_module(Module *module, ArtifactCache *artifacts, int32_t exit_code) {
+    if (artifacts != NULL)
+        artifact_cache_free(artifacts);
+    module_free(module);
+    return exit_code;
+}
+
+// Reads the file unless `source` is given.
+static bool open_module(self_t, Module *module, const char *source, size_t source_len) {
+    module_init(module, self->path);
+    module->options = self->options;
+
+    if (self->caches.decl_dir != NULL && !module_enable_decl_cache(module, self->caches.decl_dir)) {
+        fprintf(stderr, "Could not open the declaration cache for file: %s\n", self->path);
+        return false;
+    }
+
+    if (source != NULL) {
+        module_parse_buffer(module, source, source_len);
+        return true;
+    }
+
+    bool parsed = module_parse(module);
+    if (!parsed) {
+        fprintf(stderr, "Could not parse file: %s\n", self->path);
+        return false;
+    }
+    return true;
+}
+
+bool invocation_open_module(self_t, Module *module) {
+    return open_module(self, module, NULL, 0);
+}
+
+bool invocation_open_source(self_t, Module *module, const char *source, size_t source_len) {
+    return open_module(self, module, source, source_len);
+}
+
+bool invocation_load_source(self_t, Module *module, bool opened, const char *source, size_t source_len,
+                            ModuleReload *reload) {
+    if (opened) {
+        module_reload_buffer(module, source, source_len, reload);
+        return true;
+    }
+
+    if (!invocation_open_source(self, module, source, source_len))
+        return false;
+    if (module->ast->errors.size == 0)
+        module_lower_ast(module);
+    return true;
+}
+
+// Opens the artifact cache, returning true if it restored the outputs, which skips the whole compile.
+static bool restore_outputs(self_t, ArtifactCache *cache, ArtifactCache **artifacts) {
+    *artifacts = NULL;
+    if (!open_artifact_cache(self, cache))
+        return false;
+
+    *artifacts = cache;
+    if (!artifact_cache_restore(cache))
+        return false;
+
+    if (self->caches.print_stats)
+        artifact_cache_print_stats(cache, stderr);
+    artifact_cache_free(cache);
+    *artifacts = NULL;
+    return true;
+}
+
+// Builds an opened module and stores its outputs in the artifact cache, if one is open. The module is not freed.
+static int32_t run_module(self_t, Module *module, ArtifactCache *artifacts, char ***outputs, uint32_t *output_count) {
+    char **paths = NULL;
+    uint32_t count = 0;
+    bool want_paths = artifacts != NULL || outputs != NULL;
+    int32_t exit_code = invocation_build(self, module, want_paths ? &paths : NULL, &count);
+    // The JIT returns the exit code of the program, and has no outputs
+    if (exit_code != 0 || self->mode != RUN_MODE_EMIT) {
+        if (artifacts != NULL)
+            artifact_cache_free(artifacts);
+        return exit_code;
+    }
+
+    finish_module(self, module, artifacts, paths, count);
+    if (outputs != NULL) {
+        *outputs = paths;
+        *output_count = count;
+    } else {
+        for (uint32_t i = 0; i < count; i++)
+            free(paths[i]);
+        free(paths);
+    }
+    return 0;
+}
+
+int32_t invocation_run(self_t, char ***outputs, uint32_t *output_count) {
+    if (outputs != NULL) {
+        *outputs = NULL;
+        *output_count = 0;
+    }
+
+    ArtifactCache artifact_cache;
+    ArtifactCache *artifacts;
+    if (restore_outputs(self, &artifact_cache, &artifacts))
+        return 0;
+
+    Module module;
+    if (!invocation_open_module(self, &module))
+        return fail_module(&module, artifacts, 64);
+
+    int32_t exit_code = run_module(self, &module, artifacts, outputs, output_count);
+    module_free(&module);
+    return exit_code;
+}
+
+int32_t invocation_run_source(self_t, Module *module, bool opened, const char *source, size_t source_len,
+                              char ***outputs, uint32_t *output_count) {
+    if (outputs != NULL) {
+        *outputs = NULL;
+        *output_count = 0;
+    }
+
+    ArtifactCache artifact_cache;
+    ArtifactCache *artifacts;
+    if (restore_outputs(self, &artifact_cache, &artifacts))
+        return 0;
+
+    // The counters of a module kept between builds start again for every build
+    if (opened && module->decl_cache != NULL)
+        decl_cache_reset_stats(module->decl_cache);
+
+    ModuleReload reload;
+    if (!invocation_load_source(self, module, opened, source, source_len, &reload)) {
+        if (artifacts != NULL)
+            artifact_cache_free(artifacts);
+        return 64;
+    }
+    return run_module(self, module, artifacts, outputs, output_count);
+}
+
+// Builds a parsed module, returning the exit code.
+static int32_t build_module(self_t, Module *module) {
+    char *path = self->path;
+
+    // Check for any ast errors
+    ErrorList *ast_errors = &module->ast->errors;
+    if (ast_errors->size > 0) {
+        // Files which are built concurrently print their errors one after another
+        flockfile(stdout);
+        print_ast_errors(path, module->ast);
+        funlockfile(stdout);
+        return 1;
+    }
+
+    if (module->hir == NULL) {
+        bool lowered_ast = module_lower_ast(module);
+        if (!lowered_ast) {
+            fprintf(stderr, "Could not lower ast\n");
+        }
+    }
+
+    // MIR is written before codegen, which is skipped if nothing else was requested
+    if (module->options.emit & EMIT_MIR) {
+        if (!module_emit_mir(module)) {
+            fprintf(stderr, "Could not emit MIR for file: %s\n", path);
+            return 64;
+        }
+
+        module->options.emit &= ~EMIT_MIR;
+        if (module->options.emit == 0 && self->mode == RUN_MODE_EMIT)
+            return 0;
+    }
+
+    if (self->backend == BACKEND_NATIVE) {
+        bool emitted = module_emit_native(module);
+        if (!emitted) {
+            fprintf(stderr, "Could not emit native code for file: %s\n", path);
+            return 64;
+        }
+
+        return 0;
+    }
+
+    // A file built with others may be a library without `main`, whose decls the others declare as foreign
+    bool lowered = self->build ? module_lower_all(module) : module_lower_main(module);
+    if (!lowered) {
+        fprintf(stderr, "Could not lower main for file: %s\n", path);
+        return 64;
+    }
+
+//    Decl *main_decl = module_find_decl(module, "main");
+//    char *main_str = mir_debug_print(main_decl->mir);
+//    printf("// begin fn main\n");
+//    printf("%s", main_str);
+//    free(main_str);
+
+//    Decl *add_decl = module_find_decl(module, "add");
+//    char *add_str = mir_debug_print(add_decl->mir);
+//    printf("// begin fn add\n");
+//    printf("%s", add_str);
+//    free(add_str);
+
+    if (self->mode != RUN_MODE_EMIT) {
+        int32_t exit_code = 0;
+        bool ran = module_run_jit(module, self->mode == RUN_MODE_JIT_LAZY, &exit_code);
+        if (!ran) {
+            fprintf(stderr, "Could not run JIT for file: %s\n", path);
+            return 64;
+        }
+
+        return exit_code;
+    }
+
+    bool emitted = module_emit_llvm(module);
+    if (!emitted) {
+        fprintf(stderr, "Could not emit LLVM for file: %s\n", path);
+        return 64;
+    }
+
+    return 0;
+}
+
+int32_t invocation_build(self_t, Module *module, char ***outputs, uint32_t *output_count) {
+    if (outputs != NULL) {
+        *outputs = NULL;
+        *output_count = 0;
+    }
+
+    // The MIR emit kind is cleared while building, and restored since the module may be built again
+    uint32_t emit = module->options.emit;
+    int32_t exit_code = build_module(self, module);
+    module->options.emit = emit;
+
+    if (exit_code == 0 && self->mode == RUN_MODE_EMIT && outputs != NULL)
+        *outputs = module_output_paths(module, output_count);
+    return exit_code;
+}
+
+#undef self_t
@@ -0,0 +1,104 @@
+#ifndef ACORN_DRIVER_H
+#define ACORN_DRIVER_H
+
+#include "module.h"
+
+// SECTION: Driver
+// Command line handling shared by a normal invocation and the compiler daemon (see `daemon.h`), which runs forwarded
+// command lines in its own process. Nothing here exits the process.
+
+typedef enum run_mode_s {
+    RUN_MODE_EMIT,
+    RUN_MODE_JIT,
+    RUN_MODE_JIT_LAZY,
+} RunMode;
+
+typedef enum backend_s {
+    BACKEND_LLVM,
+    BACKEND_NATIVE,
+} Backend;
+
+// Cache settings, see `module_enable_decl_cache` and `artifact_cache.h`.
+typedef struct caches_s {
+    // NULL unless incremental builds were requested
+    char *decl_dir;
+    // NULL unless whole compiles should be cached
+    char *artifact_dir;
+    uint64_t artifact_max_size;
+    bool print_stats;
+} Caches;
+
+// Reports which are printed or written when the process exits.
+typedef enum report_s {
+    REPORT_TIME = 1 << 0,
+    REPORT_TIME_JSON = 1 << 1,
+    REPORT_PERF = 1 << 2,
+    REPORT_TRACE = 1 << 3,
+} Report;
+
+typedef struct invocation_s {
+    // The first of `paths`
+    char *path;
+    // Every file given, more than one only for `build`
+    char **paths;
+    uint32_t path_count;
+    // `acorn build`, see `build.h`
+    bool build;
+    RunMode mode;
+    Backend backend;
+    CodegenOptions options;
+    Caches caches;
+    uint32_t reports;
+    // Only set for `REPORT_TRACE`
+    char *trace_path;
+    // Build again on every save, see `watch.h`
+    bool watch;
+
+    // Owned copy of the default `--incremental` directory
+    char *default_decl_dir;
+} Invocation;
+
+#define self_t Invocation *self
+
+// Parses the arguments after the program name, which are borrowed. A first argument of `build` accepts any number of
+// files. Prints the usage and returns false if they are
+// invalid.
+bool invocation_parse(self_t, const char *program, int32_t argc, char **argv);
+void invocation_free(self_t);
+
+// Whether the invocation must run in the calling process, since it runs the program, reports on the process,
+// watches the file or builds several files.
+bool invocation_needs_process(self_t);
+
+// Writes every option which changes the outputs of the invocation, other than the compiler and source.
+void invocation_write_flags(self_t, char *buffer, size_t size);
+
+// Initializes `module` for the file, enables the declaration cache if requested and parses it. The module is
+// initialized even if this fails, and freed by the caller.
+bool invocation_open_module(self_t, Module *module);
+// Like `invocation_open_module`, but parses a copy of `source` instead of reading the file.
+bool invocation_open_source(self_t, Module *module, const char *source, size_t source_len);
+
+// Brings `module` up to `source`: opens it if `opened` is false and lowers the AST, otherwise reloads it (see
+// `module_reload_buffer`, which fills `reload`). Returns false if the module could not be opened.
+bool invocation_load_source(self_t, Module *module, bool opened, const char *source, size_t source_len,
+                            ModuleReload *reload);
+
+// Builds (or runs) a module opened by `invocation_open_module`, lowering the AST if that has not happened yet.
+// Prints errors to stderr and returns the process exit code. The module is not freed and can be reloaded and built
+// again. `outputs` is as for `invocation_run`.
+int32_t invocation_build(self_t, Module *module, char ***outputs, uint32_t *output_count);
+
+// Compiles (or runs) the file, printing errors to stderr, and returns the process exit code.
+// `outputs` may be NULL, otherwise it is set to the paths written by a successful compile (see
+// `module_output_paths`), which the caller frees.
+int32_t invocation_run(self_t, char ***outputs, uint32_t *output_count);
+// Like `invocation_run`, but compiles `source` in `module`, which is first brought up to it with
+// `invocation_load_source`. The module is not freed. A hit in the artifact cache leaves it as it was, unopened if
+// `opened` is false.
+int32_t invocation_run_source(self_t, Module *module, bool opened, const char *source, size_t source_len,
+                              char ***outputs, uint32_t *output_count);
+
+#undef self_t
+
+#endif //ACORN_DRIVER_H
@@ -1,114 +1,112 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "driver.h"
+#include "daemon.h"
+#include "watch.h"
+#include "build.h"
+#include "time_report.h"
+#include "perf_counters.h"
+#include "alloc_tracker.h"
+
+// The reports are printed at exit, after everything else the process wrote.
+static void print_time_report(void) {
+    time_report_print(stderr);
+}
 
-#include "module.h"
-#include "ast_err_reporter.h"
-
-static void run_file(char *path);
-
-int main(int32_t argc, char *argv[]) {
+static void print_time_report_json(void) {
+    time_report_print_json(stderr);
+}
 
-    if (argc == 2) {
-        run_file(argv[1]);
-    } else {
-        fprintf(stderr, "Usage: %s <file>\n", argv[0]);
-        exit(64);
-    }
+static void print_perf_report(void) {
+    time_report_print_perf(stderr);
+}
 
-    return 0;
+static void write_trace(void) {
+    trace_write();
 }
 
-static void run_file(char *path) {
-    Module module;
-    module_init(&module, path);
+#ifdef ACORN_ALLOC_TRACKING
+static void print_alloc_report(void) {
+    alloc_tracker_report(stderr);
+}
+#endif
 
-    bool parsed = module_parse(&module);
-    if (!parsed) {
-        fprintf(stderr, "Could not parse file: %s\n", path);
-        exit(64);
+static void enable_reports(Invocation *invocation) {
+    if (invocation->reports & REPORT_TIME) {
+        time_report_enable();
+        atexit(print_time_report);
     }
-
-    // Check for any ast errors
-    ErrorList *ast_errors = &module.ast->errors;
-    if (ast_errors->size > 0) {
-        print_ast_errors(path, module.ast);
-        exit(1);
+    if (invocation->reports & REPORT_TIME_JSON) {
+        time_report_enable();
+        atexit(print_time_report_json);
     }
-
-    bool lowered_ast = module_lower_ast(&module);
-    if (!lowered_ast) {
-        fprintf(stderr, "Could not lower ast\n");
+    // Compiling continues without counters if they are unavailable
+    if ((invocation->reports & REPORT_PERF) && perf_counters_enable()) {
+        time_report_enable();
+        atexit(print_perf_report);
     }
-
-    bool lowered = module_lower_main(&module);
-    if (!lowered) {
-        fprintf(stderr, "Could not lower main for file: %s\n", path);
-        exit(64);
+    if (invocation->reports & REPORT_TRACE) {
+        trace_enable(invocation->trace_path);
+        atexit(write_trace);
     }
+}
 
-//    Decl *main_decl = module_find_decl(&module, "main");
-//    char *main_str = mir_debug_print(main_decl->mir);
-//    printf("// begin fn main\n");
-//    printf("%s", main_str);
-//    free(main_str);
+// Matches `--<name>` or `--<name>=<value>`, setting `value` to NULL or the value.
+static bool match_socket_flag(const char *arg, const char *flag, const char **value) {
+    size_t len = strlen(flag);
+    if (strncmp(arg, flag, len) != 0 || (arg[len] != '\0' && arg[len] != '='))
+        return false;
+    *value = arg[len] == '=' ? arg + len + 1 : NULL;
+    return true;
+}
 
-//    Decl *add_decl = module_find_decl(&module, "add");
-//    char *add_str = mir_debug_print(add_decl->mir);
-//    printf("// begin fn add\n");
-//    printf("%s", add_str);
-//    free(add_str);
+int main(int32_t argc, char *argv[]) {
+#ifdef ACORN_ALLOC_TRACKING
+    atexit(print_alloc_report);
+#endif
+
+    const char *socket_path = NULL;
+    bool daemon = argc > 1 && match_socket_flag(argv[1], "--daemon", &socket_path);
+    bool client = argc > 1 && !daemon && match_socket_flag(argv[1], "--client", &socket_path);
+    char *default_socket = (daemon || client) && socket_path == NULL ? daemon_default_socket() : NULL;
+    if (default_socket != NULL)
+        socket_path = default_socket;
+
+    if (daemon) {
+        int32_t exit_code = argc == 2 ? daemon_serve(socket_path) : 64;
+        if (argc != 2)
+            fprintf(stderr, "Usage: %s --daemon[=<socket>]\n", argv[0]);
+        free(default_socket);
+        return exit_code;
+    }
 
-    bool emitted = module_emit_llvm(&module);
-    if (!emitted) {
-        fprintf(stderr, "Could not emit LLVM for file: %s\n", path);
+    int32_t arg_start = client ? 2 : 1;
+    Invocation invocation;
+    if (!invocation_parse(&invocation, argv[0], argc - arg_start, argv + arg_start)) {
+        free(default_socket);
         exit(64);
     }
 
-    module_free(&module);
-    exit(0);
+    // Compiles in this process if there is no daemon to forward to
+    int32_t exit_code;
+    if (client && !invocation_needs_process(&invocation) &&
+        daemon_forward(socket_path, argc - arg_start, argv + arg_start, &exit_code)) {
+        invocation_free(&invocation);
+        free(default_socket);
+        return exit_code;
+    }
 
-//    uint8_t *source = read_file(path);
-//
-//    Parser parser;
-//    parser_init(&parser, source);
-//
-//    Ast ast = parser_parse(&parser);
-//    printf("Done parsing\n");
-//
-//    char *str = ast_debug_print(&ast);
-//    printf("%s\n", str);
-//    free(str);
-//
-//    printf("Generating LLVM IR\n");
-//
-//    compile_ast_to_file(&ast, "/Users/matt/dev/c/acornc/samples/test.ll");
+    enable_reports(&invocation);
+    if (invocation.build) {
+        exit_code = build_run(&invocation);
+    } else if (invocation.watch) {
+        exit_code = watch_run(&invocation);
+    } else {
+        exit_code = invocation_run(&invocation, NULL, NULL);
+    }
+    invocation_free(&invocation);
+    free(default_socket);
+    exit(exit_code);
 }
-
-//static uint8_t *read_file(const char *path) {
-//    FILE *file = fopen(path, "rb");
-//    if (file == NULL) {
-//        fprintf(stderr, "Could not open file: %s\n", path);
-//        exit(74);
-//    }
-//
-//    fseek(file, 0, SEEK_END);
-//    size_t file_size = ftell(file);
-//    rewind(file);
-//
-//    uint8_t *buffer = malloc(file_size + 1);
-//    if (buffer == NULL) {
-//        fprintf(stderr, "Could not allocate memory for file: %s\n", path);
-//        exit(74);
-//    }
-//
-//    size_t bytes_read = fread(buffer, sizeof(uint8_t), file_size, file);
-//    if (bytes_read < file_size) {
-//        fprintf(stderr, "Could not read file: %s\n", path);
-//        exit(74);
-//    }
-//
-//    buffer[bytes_read] = '\0';
-//
-//    fclose(file);
-//    return buffer;
-//}
@@ -0,0 +1,192 @@
+#include "watch.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+
+#include "cache_util.h"
+
+// Editors often save in several steps (truncate and write, or write a copy and rename it), events arriving within
+// this many milliseconds of each other are taken as one save.
+#define WATCH_SETTLE_MS 20
+
+static volatile sig_atomic_t watch_stopping = 0;
+
+static void stop_watching(int signal) {
+    (void) signal;
+    watch_stopping = 1;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+// Reads pending events, returning whether any of them is about `name`. Returns false with `errno` set on failure.
+static bool read_events(int fd, const char *name, bool *matched) {
+    // Aligned as the events it holds
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(fd, buffer, sizeof(buffer));
+    if (len <= 0)
+        return false;
+
+    for (char *cursor = buffer; cursor < buffer + len;) {
+        struct inotify_event *event = (struct inotify_event *) cursor;
+        if (event->len > 0 && strcmp(event->name, name) == 0)
+            *matched = true;
+        cursor += sizeof(struct inotify_event) + event->len;
+    }
+    return true;
+}
+
+// Blocks until `name` is saved. Returns false when interrupted.
+static bool wait_for_save(int fd, const char *name) {
+    if (watch_stopping)
+        return false;
+
+    bool matched = false;
+    while (!matched) {
+        if (!read_events(fd, name, &matched)) {
+            if (errno != EINTR)
+                fprintf(stderr, "Could not watch for changes: %s\n", strerror(errno));
+            return false;
+        }
+    }
+
+    // Drain the rest of the save
+    struct pollfd poll_fd = {.fd = fd, .events = POLLIN};
+    while (poll(&poll_fd, 1, WATCH_SETTLE_MS) > 0) {
+        if (!read_events(fd, name, &matched))
+            return false;
+    }
+    return !watch_stopping;
+}
+
+// `caught_up` is when the watcher finished reloading its own module, which is part of the time to the next build.
+static void report(Invocation *invocation, int32_t exit_code, uint64_t start, uint64_t built, uint64_t caught_up,
+                   const ModuleReload *reload) {
+    double ms = (double) (caught_up - start) / 1e6;
+    double catch_up_ms = (double) (caught_up - built) / 1e6;
+
+    if (exit_code != 0) {
+        fprintf(stderr, "watch: %s failed after %.1f ms, waiting for changes\n", invocation->path, ms);
+    } else if (reload != NULL) {
+        fprintf(stderr, "watch: rebuilt %s in %.1f ms (%u of %u decls reused, %.1f ms reloading the watcher)\n",
+                invocation->path, ms, reload->reused, reload->decl_count, catch_up_ms);
+    } else {
+        fprintf(stderr, "watch: built %s in %.1f ms (%.1f ms loading the watcher), waiting for changes\n",
+                invocation->path, ms, catch_up_ms);
+    }
+}
+
+// Builds `source` in a child process, like the daemon does, so that a compile which crashes (eg on an assert in the
+// frontend) only fails this build. The child reloads its copy of the module and builds it, and only if it succeeds
+// does the watcher reload its own module from the same source, which is then known not to crash. The MIR the child
+// lowered comes back through the declaration cache. The frontend runs twice, so the time printed runs until the
+// watcher has caught up.
+static int32_t build_isolated(Invocation *invocation, Module *module, bool *opened, const char *source, size_t len) {
+    uint64_t start = now_ns();
+    fflush(stdout);
+    fflush(stderr);
+    pid_t child = fork();
+    if (child < 0) {
+        fprintf(stderr, "Could not start a build: %s\n", strerror(errno));
+        return 64;
+    }
+
+    if (child == 0) {
+        ModuleReload reload;
+        int32_t exit_code = 64;
+        if (invocation_load_source(invocation, module, *opened, source, len, &reload))
+            exit_code = invocation_build(invocation, module, NULL, NULL);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(exit_code);
+    }
+
+    int status;
+    while (waitpid(child, &status, 0) < 0 && errno == EINTR);
+    if (!WIFEXITED(status)) {
+        fprintf(stderr, "watch: the compiler crashed with signal %d, waiting for changes\n", WTERMSIG(status));
+        return 128 + WTERMSIG(status);
+    }
+
+    int32_t exit_code = WEXITSTATUS(status);
+    uint64_t built = now_ns();
+    if (exit_code != 0) {
+        report(invocation, exit_code, start, built, built, NULL);
+        return exit_code;
+    }
+
+    ModuleReload reload;
+    bool reloaded = *opened;
+    if (!invocation_load_source(invocation, module, *opened, source, len, &reload)) {
+        module_free(module);
+        return 64;
+    }
+    *opened = true;
+    module_load_cached_mir(module);
+    report(invocation, exit_code, start, built, now_ns(), reloaded ? &reload : NULL);
+    return exit_code;
+}
+
+int32_t watch_run(Invocation *invocation) {
+    // The directory is watched rather than the file, which editors may replace on every save
+    char *dir = strdup(invocation->path);
+    char *slash = strrchr(dir, '/');
+    const char *name = slash != NULL ? invocation->path + (slash - dir) + 1 : invocation->path;
+    if (slash == dir)
+        slash[1] = '\0';
+    else if (slash != NULL)
+        *slash = '\0';
+    else
+        strcpy(dir, ".");
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        fprintf(stderr, "Could not watch directory: %s: %s\n", dir, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        free(dir);
+        return 64;
+    }
+    free(dir);
+
+    // Interrupting the wait stops watching
+    struct sigaction stop = {.sa_handler = stop_watching};
+    sigemptyset(&stop.sa_mask);
+    sigaction(SIGINT, &stop, NULL);
+    sigaction(SIGTERM, &stop, NULL);
+
+    // The module holds the last source which built, and stays unopened until one does
+    Module module;
+    bool opened = false;
+    int32_t exit_code = 0;
+    do {
+        size_t len;
+        char *source = cache_read_file(invocation->path, &len);
+        if (source == NULL) {
+            fprintf(stderr, "watch: could not read %s, waiting for changes\n", invocation->path);
+            exit_code = 64;
+            continue;
+        }
+
+        // Saving without changes does not build again
+        if (!opened || strlen((char *) module.ast->source) != len || memcmp(module.ast->source, source, len) != 0)
+            exit_code = build_isolated(invocation, &module, &opened, source, len);
+        free(source);
+    } while (wait_for_save(fd, name));
+
+    if (opened)
+        module_free(&module);
+    close(fd);
+    return exit_code;
+}
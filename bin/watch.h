@@ -0,0 +1,20 @@
+#ifndef ACORN_WATCH_H
+#define ACORN_WATCH_H
+
+#include "driver.h"
+
+// SECTION: Watch
+// `acorn --watch <file>` builds the file, then builds it again every time it is saved until interrupted. The module
+// stays loaded between builds: a save is diffed against the previous source per decl (see `module_reload`), only
+// changed decls are lowered to MIR again, and with the declaration cache (always on while watching, see
+// `decl_cache.h`) only their objects are generated again before linking.
+//
+// Each build runs in a forked child, as the daemon does, so that a compile which crashes fails only that build. The
+// watcher keeps the module of the last source which built, and catches up with each successful build afterwards by
+// reloading it too. The time printed after every build runs from the save being noticed until the watcher has caught
+// up, and says how much of it the reload took.
+
+// Watches and builds until interrupted. Returns the process exit code.
+int32_t watch_run(Invocation *invocation);
+
+#endif //ACORN_WATCH_H
@@ -0,0 +1,24 @@
+#include "fuzz_input.h"
+
+extern "C" {
+#include "parser.h"
+#include "ast_lowering.h"
+}
+
+// Lowers every input which parses without errors, HIR lowering assumes a well formed AST.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    uint8_t *source = fuzz_source(data, size);
+
+    Parser parser;
+    parser_init(&parser, source);
+    Ast ast = parser_parse(&parser);
+
+    if (ast.errors.size == 0) {
+        Hir hir = ast_lower(&ast);
+        hir_free(&hir);
+    }
+
+    fuzz_ast_free(&ast);
+    free(source);
+    return 0;
+}
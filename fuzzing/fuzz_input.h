@@ -0,0 +1,28 @@
+#ifndef ACORN_FUZZ_INPUT_H
+#define ACORN_FUZZ_INPUT_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include "ast.h"
+}
+
+// Fuzzer inputs are not null terminated, while every source the compiler reads is.
+static inline uint8_t *fuzz_source(const uint8_t *data, size_t size) {
+    auto source = static_cast<uint8_t *>(malloc(size + 1));
+    memcpy(source, data, size);
+    source[size] = '\0';
+    return source;
+}
+
+static inline void fuzz_ast_free(Ast *ast) {
+    token_list_free(&ast->tokens);
+    ast_node_list_free(&ast->nodes);
+    index_list_free(&ast->extra_data);
+    error_list_free(&ast->errors);
+    line_index_free(&ast->lines);
+}
+
+#endif //ACORN_FUZZ_INPUT_H
@@ -0,0 +1,17 @@
+#include "fuzz_input.h"
+
+extern "C" {
+#include "lexer.h"
+}
+
+// Lexes the input to the end, the same loop as `parser_init`.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    uint8_t *source = fuzz_source(data, size);
+
+    Lexer lexer;
+    lexer_init(&lexer, source);
+    while (lexer_next(&lexer).type != TOK_EOF);
+
+    free(source);
+    return 0;
+}
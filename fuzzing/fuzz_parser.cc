@@ -0,0 +1,17 @@
+#include "fuzz_input.h"
+
+extern "C" {
+#include "parser.h"
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    uint8_t *source = fuzz_source(data, size);
+
+    Parser parser;
+    parser_init(&parser, source);
+    Ast ast = parser_parse(&parser);
+
+    fuzz_ast_free(&ast);
+    free(source);
+    return 0;
+}
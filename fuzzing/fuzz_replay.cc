@@ -0,0 +1,92 @@
+// Stand in for the libFuzzer driver on compilers without `-fsanitize=fuzzer`. Runs each input file (or every file
+// in each directory) through the target once and prints how long it took, so the regression corpus can be replayed
+// with any toolchain using the same command line as a libFuzzer binary:
+//
+//     acorn_fuzz_hir -timeout=1 regressions/hir
+//
+// Other `-flag=value` arguments are accepted and ignored. Exits with 70 (the libFuzzer timeout exit code) if any
+// input ran longer than `-timeout` seconds.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static void collect_inputs(const std::string &path, std::vector<std::string> &inputs) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        fprintf(stderr, "Could not open input: %s\n", path.c_str());
+        exit(1);
+    }
+
+    if (!S_ISDIR(info.st_mode)) {
+        inputs.push_back(path);
+        return;
+    }
+
+    DIR *dir = opendir(path.c_str());
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.')
+            continue;
+        collect_inputs(path + "/" + entry->d_name, inputs);
+    }
+    closedir(dir);
+}
+
+static bool read_input(const std::string &path, std::vector<uint8_t> &data) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    data.resize(ftell(file));
+    rewind(file);
+    bool result = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    double timeout = 0;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "-timeout=", 9) == 0) {
+            timeout = atof(argv[i] + 9);
+        } else if (argv[i][0] != '-') {
+            collect_inputs(argv[i], inputs);
+        }
+    }
+
+    int slow = 0;
+    for (const std::string &path : inputs) {
+        std::vector<uint8_t> data;
+        if (!read_input(path, data)) {
+            fprintf(stderr, "Could not read input: %s\n", path.c_str());
+            return 1;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        bool timed_out = timeout > 0 && elapsed.count() > timeout;
+        printf("%s: %zu bytes in %.3f ms%s\n", path.c_str(), data.size(), elapsed.count() * 1000.0,
+               timed_out ? " TIMEOUT" : "");
+        if (timed_out) slow++;
+    }
+
+    if (slow != 0) {
+        fprintf(stderr, "%d of %zu inputs exceeded the %g second timeout\n", slow, inputs.size(), timeout);
+        return 70;
+    }
+    return 0;
+}
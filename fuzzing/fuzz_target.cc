@@ -1,11 +0,0 @@
-#include <stddef.h>
-#include <stdint.h>
-#include <cassert>
-
-extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
-    if (size > 0 && data[0] == 'H')
-        if (size > 1 && data[1] == 'I')
-            if (size > 2 && data[2] == '!')
-                assert(false);
-    return 0;
-}
\ No newline at end of file
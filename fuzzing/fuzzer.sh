@@ -1,20 +1,58 @@
 #!/bin/bash
+# Usage: ./fuzzer.sh [crash|slow|regress] [lexer|parser|hir]
+#
+#   crash    Fuzz for crashes for an hour (default).
+#   slow     Fuzz for superlinear behaviour. Grows `-max_len` in steps while every input must finish within
+#            SLOW_TIMEOUT seconds. Crashes are ignored (the compiler asserts on much unimplemented behaviour), timeouts
+#            are minimized into `regressions/<target>`.
+#   regress  Replays `regressions/<target>` with the same timeout, failing if any input got slower than it.
+
+MODE=${1:-crash}
+TARGET=${2:-parser}
+SLOW_TIMEOUT=${SLOW_TIMEOUT:-1}
+SLOW_STEP_TIME=${SLOW_STEP_TIME:-300}
 
 # Switch to current directory
 cd "$(dirname "$0")"
 
-# Build the fuzzer executable
-mkdir -p build
-cd build
+# Build the fuzzer executables, with clang so libFuzzer is available
+cmake -S .. -B build -DCMAKE_C_COMPILER=clang -DCMAKE_CXX_COMPILER=clang++ -Dfuzz=ON || exit 1
+cmake --build build --target "acorn_fuzz_$TARGET" || exit 1
+FUZZER=./build/fuzzing/acorn_fuzz_$TARGET
 
-cmake ..
-make
+# The compiler does not free everything yet
+COMMON_FLAGS="-detect_leaks=0 -artifact_prefix=./artifacts/${TARGET}_ -create_missing_dirs=1"
 
-cd ..
+# Copy samples and known slow inputs to corpus
+mkdir -p "corpus/$TARGET"
+cp ./samples/* "./regressions/$TARGET"/* "./corpus/$TARGET"
 
-# Copy samples to corpus
-mkdir -p corpus
-cp ./samples/* ./corpus
+case "$MODE" in
+crash)
+    $FUZZER "corpus/$TARGET" -max_total_time=3600 -print_corpus_stats=1 $COMMON_FLAGS
+    ;;
+slow)
+    for MAX_LEN in 64 256 1024 4096 16384 65536 262144 1048576; do
+        echo "Fuzzing for slow inputs up to $MAX_LEN bytes"
+        $FUZZER "corpus/$TARGET" -fork=1 -ignore_crashes=1 -ignore_ooms=1 -ignore_timeouts=0 \
+            -max_len=$MAX_LEN -len_control=0 -timeout="$SLOW_TIMEOUT" -report_slow_units="$SLOW_TIMEOUT" \
+            -max_total_time="$SLOW_STEP_TIME" $COMMON_FLAGS
 
-# Run the fuzzer
-./build/acorn_fuzzing corpus -max_total_time=3600 -print_corpus_stats=1 -artifact_prefix=./artifacts/acorn_fuzzing_ -create_missing_dirs=1
+        for SLOW in ./artifacts/"${TARGET}"_timeout-*; do
+            [ -e "$SLOW" ] || continue
+            $FUZZER "$SLOW" -minimize_crash=1 -timeout="$SLOW_TIMEOUT" -max_total_time=600 -detect_leaks=0 \
+                -exact_artifact_path="./regressions/$TARGET/slow_$(basename "$SLOW" | cut -d- -f2 | cut -c1-12)"
+            rm "$SLOW"
+            echo "Minimized slow input into regressions/$TARGET, check it in once the slowdown is understood"
+            exit 77
+        done
+    done
+    ;;
+regress)
+    $FUZZER -timeout="$SLOW_TIMEOUT" -detect_leaks=0 "./regressions/$TARGET"/*
+    ;;
+*)
+    echo "Unknown mode: $MODE"
+    exit 1
+    ;;
+esac
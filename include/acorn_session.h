@@ -0,0 +1,90 @@
+#ifndef ACORN_SESSION_H
+#define ACORN_SESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// SECTION: Sessions
+// The embedding API: compiles sources held in memory into objects held in memory, without touching the file system
+// or printing diagnostics. A session is created once and compiles any number of sources with the same options. It
+// initializes LLVM and creates its target machine once, and generates every compile in one LLVM context.
+// Interned strings and MIR type pools stay per compile: their keys are only meaningful within one module.
+//
+// Each source is compiled like a file of `acorn build`: every function with a body is compiled and exported, with
+// or without a `main`. A session must only be used by one thread at a time, separate sessions may be used
+// concurrently.
+//
+// Errors never abort the embedding process, they are returned as diagnostics. Sources are checked before they are
+// lowered, and anything the compiler does not support yet is reported rather than lowered: only top level functions,
+// whose statements are `let` with a type and an initializer, `return` and calls, with integer arithmetic on literals
+// of up to 32 bits. Functions must be declared before they are used. Comparisons and control flow are reported as
+// unsupported (see `ast_check.h`).
+
+typedef struct acorn_session_s AcornSession;
+
+typedef enum acorn_opt_level_s {
+    ACORN_OPT_O0,
+    ACORN_OPT_O1,
+    ACORN_OPT_O2,
+    ACORN_OPT_O3,
+    ACORN_OPT_OS,
+} AcornOptLevel;
+
+typedef struct acorn_session_options_s {
+    AcornOptLevel opt_level;
+    // Target triple, NULL for the host. Copied by the session.
+    const char *target;
+    // CPU name, NULL for "generic", "native" for the host CPU. Copied by the session.
+    const char *cpu;
+} AcornSessionOptions;
+
+#define ACORN_SESSION_OPTIONS_DEFAULT ((AcornSessionOptions) {.opt_level = ACORN_OPT_O0, .target = NULL, .cpu = NULL})
+
+typedef enum acorn_diagnostic_kind_s {
+    // The source has a syntax error, the location is set
+    ACORN_DIAGNOSTIC_SYNTAX,
+    // The source uses an undefined name, mismatched types or something the compiler does not support yet, the
+    // location is set
+    ACORN_DIAGNOSTIC_SEMANTIC,
+    // A later stage failed, the location is not set
+    ACORN_DIAGNOSTIC_CODEGEN,
+} AcornDiagnosticKind;
+
+typedef struct acorn_diagnostic_s {
+    AcornDiagnosticKind kind;
+    // Byte offset into the source, and the line and column of that byte starting at 1. All zero without a location.
+    uint32_t offset;
+    uint32_t line;
+    uint32_t column;
+    // Owned by the result
+    char *message;
+} AcornDiagnostic;
+
+typedef struct acorn_result_s {
+    // A relocatable object for the session target, NULL if the compile failed. Owned by the result.
+    char *object;
+    size_t object_size;
+    AcornDiagnostic *diagnostics;
+    uint32_t diagnostic_count;
+} AcornResult;
+
+// Returns NULL if the target or CPU is unknown.
+AcornSession *acorn_session_create(const AcornSessionOptions *options);
+void acorn_session_destroy(AcornSession *session);
+
+// Compiles `source`, which need not be terminated. `name` appears in the object, like a file name. Returns whether
+// an object was produced. Either way, the result must be released with `acorn_result_free`.
+bool acorn_session_compile(AcornSession *session, const char *name, const char *source, size_t source_len,
+                           AcornResult *result);
+void acorn_result_free(AcornResult *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //ACORN_SESSION_H
@@ -0,0 +1,54 @@
+#ifndef ACORN_ALLOC_TRACKER_H
+#define ACORN_ALLOC_TRACKER_H
+
+#include "common.h"
+
+#include <stdlib.h>
+
+// SECTION: Allocation tracker
+// Optional accounting of heap memory by owner, enabled by building with `ACORN_ALLOC_TRACKING` defined.
+// Tracked allocations carry a small header, so they must only be resized and freed through the tracker, either
+// with `ARRAY_GROW`/`ARRAY_FREE` or `TRACKED_MALLOC`/`TRACKED_FREE`. Without the define these are plain libc calls.
+
+typedef enum alloc_tag_s {
+    // Containers which do not have their own tag
+    ALLOC_TAG_OTHER,
+
+    ALLOC_TAG_TOKEN_LIST,
+    ALLOC_TAG_AST_NODE_LIST,
+    ALLOC_TAG_INDEX_LIST,
+    ALLOC_TAG_HIR_INST_LIST,
+    ALLOC_TAG_MIR_INST_LIST,
+    ALLOC_TAG_STRING_SET,
+    ALLOC_TAG_SCOPE,
+    ALLOC_TAG_EXTENDED_TYPE,
+    ALLOC_TAG_COMPILE_ERROR,
+
+    __ALLOC_TAG_LAST,
+} AllocTag;
+
+char *alloc_tag_to_string(AllocTag tag);
+
+#ifdef ACORN_ALLOC_TRACKING
+
+// Same as `realloc`, except that a `new_size` of zero frees the allocation. `tag` is ignored for existing allocations.
+void *tracked_realloc(AllocTag tag, void *pointer, size_t new_size);
+// Records how many bytes of a container allocation are in use, the rest is reported as wasted capacity.
+void tracked_set_used(void *pointer, size_t used);
+
+// Prints live, peak and wasted bytes for each tag. Anything still live at exit is reported as leaked.
+void alloc_tracker_report(FILE *out);
+
+#define TRACKED_MALLOC(tag, size) tracked_realloc(tag, NULL, size)
+#define TRACKED_FREE(pointer) ((void) tracked_realloc(ALLOC_TAG_OTHER, pointer, 0))
+#define TRACK_USED(pointer, used) tracked_set_used(pointer, used)
+
+#else
+
+#define TRACKED_MALLOC(tag, size) malloc(size)
+#define TRACKED_FREE(pointer) free(pointer)
+#define TRACK_USED(pointer, used) ((void) 0)
+
+#endif
+
+#endif //ACORN_ALLOC_TRACKER_H
@@ -2,13 +2,18 @@
 #define ACORNC_ARRAY_UTIL_H
 
 #include "common.h"
+#include "alloc_tracker.h"
 
 
 #define ARRAY_GROW_CAPCITY(capacity) \
     ((capacity) < 8 ? 8 : (capacity) * 2)
 
 #define ARRAY_GROW(type, pointer, new_count) \
-    (type *)reallocate(pointer, sizeof(type) * (new_count))
+    ARRAY_GROW_TAGGED(ALLOC_TAG_OTHER, type, pointer, new_count)
+
+// Attributes the memory to `tag` in the allocation tracker
+#define ARRAY_GROW_TAGGED(tag, type, pointer, new_count) \
+    (type *)reallocate_tagged(tag, pointer, sizeof(type) * (new_count))
 
 #define ARRAY_GROW2(type, pointer, old_count, new_count) \
     (type *)reallocate2(pointer, sizeof(type) * (old_count), sizeof(type) * (new_count))
@@ -17,6 +22,8 @@
     reallocate(pointer, 0)
 
 void *reallocate(void *pointer, size_t new_size);
+void *reallocate_tagged(AllocTag tag, void *pointer, size_t new_size);
+void *reallocate2(void *pointer, size_t old_size, size_t new_size);
 
 // SECTION: Index List
 // Stores a list of indices in order.
@@ -75,4 +82,22 @@ size_t *index_ptr_map_get(self_t, uint32_t key);
 
 #undef self_t
 
+// SECTION: Bit Set
+// A fixed size set of indices, eg instructions which have already been visited.
+
+typedef struct bit_set_s {
+    uint32_t size;
+    uint64_t *data;
+} BitSet;
+
+#define self_t BitSet *self
+
+// All `size` bits start cleared
+void bit_set_init(self_t, uint32_t size);
+void bit_set_free(self_t);
+bool bit_set_get(self_t, uint32_t index);
+void bit_set_set(self_t, uint32_t index);
+
+#undef self_t
+
 #endif //ACORNC_ARRAY_UTIL_H
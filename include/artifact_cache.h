@@ -0,0 +1,52 @@
+#ifndef CONFIG_ARTIFACT_CACHE_H
+#define CONFIG_ARTIFACT_CACHE_H
+
+#include "common.h"
+
+// SECTION: Artifact cache
+// A content addressed cache of whole compiles, so that compiling the same source with the same compiler and flags
+// restores the previous outputs without parsing anything. This is separate from the declaration cache (see
+// `decl_cache.h`), which only helps once a source has changed.
+//
+// The inputs are the compiler binary (its size and modification time, which covers the version and the host target),
+// the flags given by the driver, the source path and the source bytes. An entry is a directory named by a hash of the
+// inputs, holding a `manifest` with the inputs in full followed by one `<mode> <name>` line per output, and the outputs
+// themselves named by their line index. Entries are built in a temporary directory and renamed into place.
+//
+// Once an entry is stored, the least recently used entries are removed until the cache fits in `max_size`. A restore
+// marks its entry as used by touching the manifest.
+
+typedef struct artifact_cache_s {
+    char *dir;
+    uint64_t max_size;
+
+    // Set by `artifact_cache_begin`
+    char *source_path;
+    char *inputs;
+    size_t inputs_len;
+    char *entry_path;
+
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evicted;
+} ArtifactCache;
+
+#define self_t ArtifactCache *self
+
+// Creates `dir` if it does not exist yet.
+bool artifact_cache_init(self_t, const char *dir, uint64_t max_size);
+void artifact_cache_free(self_t);
+
+// Reads the inputs of compiling `source_path` with `flags`, which must describe every option that changes the outputs.
+// Returns false if the source or compiler cannot be read, in which case the compile should not be cached.
+bool artifact_cache_begin(self_t, const char *source_path, const char *flags);
+// Copies the outputs of an earlier compile with the same inputs back next to the source.
+bool artifact_cache_restore(self_t);
+// Stores the outputs of the compile, which must all be next to the source, then evicts old entries.
+void artifact_cache_store(self_t, char **paths, uint32_t count);
+
+void artifact_cache_print_stats(self_t, FILE *out);
+
+#undef self_t
+
+#endif //CONFIG_ARTIFACT_CACHE_H
@@ -188,6 +188,7 @@ void ast_node_list_add(self_t, AstNode node);
 typedef struct ast_s {
     uint8_t *source;
     TokenList tokens;
+    LineIndex lines;
 
     // Index zero contains the root node (which is present no matter what)
     AstNodeList nodes;
@@ -197,12 +198,18 @@ typedef struct ast_s {
 
 #define self_t Ast *self
 
+// Frees the source and every list, but not the AST itself.
+void ast_free(self_t);
+
 AstNode *ast_get_node(self_t, AstIndex index);
 AstNode *ast_get_node_tagged(self_t, AstIndex index, AstTag tag);
 
 // Returns a string containing the content of the token at the given index.
 // The caller owns the string memory.
 char *ast_get_token_content(self_t, TokenIndex token);
+// Returns the value of the string literal token at the given index, without quotes and with escapes decoded.
+// The caller owns the string memory.
+char *ast_get_string_literal(self_t, TokenIndex token);
 
 #undef self_t
 
@@ -211,6 +218,8 @@ typedef enum ast_error_s {
     AST_ERR_UNEXPECTED_EOF,
     AST_ERR_EXPECTED_EXPRESSION,
     AST_ERR_MISSING_SEMICOLON,
+    AST_ERR_UNEXPECTED_TOKEN,
+    AST_ERR_INVALID_TOKEN,
 } AstError;
 
 char *ast_error_to_string(AstError error);
@@ -0,0 +1,49 @@
+#ifndef ACORN_AST_CHECK_H
+#define ACORN_AST_CHECK_H
+
+#include "common.h"
+#include "ast.h"
+#include "error.h"
+
+// SECTION: Checking
+// Checks that an AST without syntax errors only uses what lowering and code generation support, and that its types
+// agree. Those stages assert on anything else, so input which is not trusted (see `acorn_session.h`) is checked
+// before it is lowered. An AST which passes is lowered and generated without errors.
+//
+// The supported language is small for now: top level functions, whose statements are `let` with a type and an
+// initializer, `return` and calls. Expressions are literals, names, calls and integer arithmetic. Integer literals
+// must fit their type, and 32 bits for now. Functions must be declared before they are used, like in HIR lowering.
+// Comparisons, control flow and implicit block results are rejected, since the code generator does not support them
+// yet.
+
+typedef enum ast_check_error_s {
+    CHECK_ERR_UNSUPPORTED,
+    CHECK_ERR_NOT_A_FUNCTION_DECL,
+    CHECK_ERR_DUPLICATE_FUNCTION,
+    CHECK_ERR_DUPLICATE_PARAM,
+    CHECK_ERR_UNKNOWN_TYPE,
+    CHECK_ERR_MISSING_PARAM_TYPE,
+    CHECK_ERR_MISSING_LET_TYPE,
+    CHECK_ERR_MISSING_LET_INIT,
+    CHECK_ERR_UNDEFINED_NAME,
+    CHECK_ERR_USED_BEFORE_DECL,
+    CHECK_ERR_MISMATCHED_TYPES,
+    CHECK_ERR_INTEGER_TOO_LARGE,
+    CHECK_ERR_NOT_CALLABLE,
+    CHECK_ERR_FUNCTION_VALUE,
+    CHECK_ERR_VOID_VALUE,
+    CHECK_ERR_ARGUMENT_COUNT,
+    CHECK_ERR_UNEXPECTED_RETURN_VALUE,
+    CHECK_ERR_MISSING_RETURN_VALUE,
+    CHECK_ERR_MISSING_RETURN,
+    CHECK_ERR_UNREACHABLE,
+    CHECK_ERR_UNSUPPORTED_STMT,
+    CHECK_ERR_IMPLICIT_RESULT,
+} AstCheckError;
+
+char *ast_check_error_to_string(AstCheckError error);
+
+// Adds an error for each problem to `errors`, located at the offending token. Returns whether there were none.
+bool ast_check(Ast *ast, ErrorList *errors);
+
+#endif //ACORN_AST_CHECK_H
@@ -37,6 +37,7 @@ typedef struct ast_lowering_s {
     HirInstList instructions;
     IndexList extra;
     StringSet strings;
+    IndexMap string_literals;
     //todo errors
 
     // Intermediate state
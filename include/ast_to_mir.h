@@ -3,6 +3,7 @@
 
 #include "ast.h"
 #include "mir.h"
+#include "interner.h"
 
 // SECTION: Scope (AtmScope = ast-to-mir scope)
 // A basic map tree from string name to MirIndex
@@ -38,10 +39,15 @@ AtmScopeItemType *atm_scope_get_type(self_t, const char *name);
 typedef struct ast_to_mir_s {
     // Inputs
     Ast *ast;
+    // String literals are interned here, shared by every function in the module
+    StringSet *strings;
+    // The literals already interned when lowering to HIR, or NULL if the AST is lowered to MIR directly
+    IndexMap *string_literals;
 
     // Outputs
     MirInstList instructions;
     IndexList extra;
+    MirTypePool types;
 
     // Intermediate state
     AtmScope *scope;        // Starts as global scope
@@ -51,25 +57,28 @@ typedef struct ast_to_mir_s {
 
 #define self_t AstToMir *self
 
-void ast_to_mir_init(self_t, Ast *ast);
+void ast_to_mir_init(self_t, Ast *ast, StringSet *strings);
 void ast_to_mir_free(self_t);
 
 Mir lower_ast_fn(self_t, AstIndex fn_index);
 
-MirIndex mir_lower_stmt(self_t, AstIndex stmt_index);
-MirIndex mir_lower_let(self_t, AstIndex stmt_index);
+// Statements and expressions lower to a ref, which is a well known ref (see `ir_common.h`) for common constants
+// and an instruction otherwise.
+Ref mir_lower_stmt(self_t, AstIndex stmt_index);
+Ref mir_lower_let(self_t, AstIndex stmt_index);
 
 Type mir_lower_type_expr(self_t, AstIndex index);
 
-MirIndex mir_lower_expr(self_t, AstIndex expr_index);
-MirIndex mir_lower_int_const(self_t, AstIndex expr_index);
-MirIndex mir_lower_string_const(self_t, AstIndex expr_index);
-MirIndex mir_lower_ref(self_t, AstIndex expr_index);
-MirIndex mir_lower_bin_op(self_t, AstIndex expr_index);
-MirIndex mir_lower_call(self_t, AstIndex expr_index);
+Ref mir_lower_expr(self_t, AstIndex expr_index);
+Ref mir_lower_int_const(self_t, AstIndex expr_index);
+Ref mir_lower_bool_const(self_t, AstIndex expr_index);
+Ref mir_lower_string_const(self_t, AstIndex expr_index);
+Ref mir_lower_ref(self_t, AstIndex expr_index);
+Ref mir_lower_bin_op(self_t, AstIndex expr_index);
+Ref mir_lower_call(self_t, AstIndex expr_index);
 // If proto_data is not null, its args will be inserted into the function body
 MirIndex mir_lower_block(self_t, AstIndex block_index, AstFnProto *proto_data);
-MirIndex mir_lower_return(self_t, AstIndex ret_index);
+Ref mir_lower_return(self_t, AstIndex ret_index);
 
 // SECTION: Type checking
 // Cached type checking for expressions and statements
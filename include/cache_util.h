@@ -0,0 +1,21 @@
+#ifndef CONFIG_CACHE_UTIL_H
+#define CONFIG_CACHE_UTIL_H
+
+#include "common.h"
+
+// SECTION: Cache files
+// Helpers shared by the on-disk caches (see `decl_cache.h` and `artifact_cache.h`).
+
+// 64-bit FNV-1a. Keys only select a file, cache entries are compared in full before they are used.
+#define CACHE_HASH_INIT 0xcbf29ce484222325ULL
+uint64_t cache_hash(uint64_t hash, const void *data, size_t len);
+
+// Reads the whole file, which is null terminated for convenience. Returns NULL if it cannot be read.
+char *cache_read_file(const char *path, size_t *len);
+// Writes to a temporary file next to `path` and renames it into place, so readers never see a partial file. The
+// temporary file is unique to the call, so threads and processes may write the same path at once.
+bool cache_write_file(const char *path, const char *data, size_t len);
+// Copies `from` with `cache_write_file`. Fails quietly if `from` cannot be read.
+bool cache_copy_file(const char *from, const char *to);
+
+#endif //CONFIG_CACHE_UTIL_H
@@ -4,20 +4,95 @@
 #include "common.h"
 #include "mir.h"
 #include "llvm-c/Core.h"
-
-// SECTION: Codegen
-// LLVM IR generation for a single module and its declarations
+#include "llvm-c/Orc.h"
+#include "llvm-c/TargetMachine.h"
 
 typedef struct module_s Module;
 typedef struct decl_s Decl;
 
+// SECTION: Codegen options
+// Process wide target and optimization settings, shared by every module.
+
+typedef enum codegen_opt_level_s {
+    CODEGEN_OPT_O0,
+    CODEGEN_OPT_O1,
+    CODEGEN_OPT_O2,
+    CODEGEN_OPT_O3,
+    CODEGEN_OPT_OS,
+} CodegenOptLevel;
+
+// Bit flags for the outputs written by the driver
+typedef enum emit_kind_s {
+    EMIT_OBJ = 1 << 0,
+    EMIT_ASM = 1 << 1,
+    EMIT_BC = 1 << 2,
+    EMIT_LL = 1 << 3,
+    EMIT_EXE = 1 << 4,
+    // Textual MIR, written by the driver before codegen. See `module_emit_mir`.
+    EMIT_MIR = 1 << 5,
+} EmitKind;
+
+typedef struct codegen_options_s {
+    CodegenOptLevel opt_level;
+    // Combination of `EmitKind` flags
+    uint32_t emit;
+    // Target triple, NULL for the host.
+    char *target;
+    // CPU name, NULL for "generic". "native" tunes for the host CPU (and enables its features).
+    char *cpu;
+    // Number of threads used to generate and emit codegen units.
+    uint32_t jobs;
+    // Number of codegen units a module is split into, 0 for one per job.
+    uint32_t codegen_units;
+} CodegenOptions;
+
+#define CODEGEN_OPTIONS_DEFAULT ((CodegenOptions) { \
+    .opt_level = CODEGEN_OPT_O0, .emit = EMIT_EXE, .target = NULL, .cpu = NULL, .jobs = 1, .codegen_units = 0})
+
+// Parses a comma separated list of emit kinds, eg `obj,ll`, as accepted by `--emit=`.
+bool codegen_parse_emit_kinds(const char *list, uint32_t *emit);
+
+// Returns the target machine for the given options. Each thread gets one on first use for each distinct target, cpu
+// and optimization level, and reuses it afterwards, so a long running process (see `acorn --daemon`) may compile with
+// different options. Target machines are not safe to share between threads emitting concurrently, so a thread takes an
+// idle machine or creates one, and hands its machines back to the idle ones when it exits.
+// Only the native target is initialized unless another target is requested.
+LLVMTargetMachineRef codegen_target_machine(const CodegenOptions *options);
+
+// Creates machines for the options until the calling thread and `count - 1` other threads can each take one without
+// creating it, eg before forking compiles with `count` jobs.
+bool codegen_prepare_target_machines(const CodegenOptions *options, uint32_t count);
+
+// SECTION: Codegen
+// LLVM IR generation for a codegen unit, which is some subset of the declarations in a module.
+// Each unit has its own context, so separate units may be generated and emitted on separate threads.
+
 typedef struct codegen_s {
     Module *module;
+    const CodegenOptions *options;
 
+    // The context is owned by an ORC thread safe context so that the module may be handed to the JIT.
+    LLVMOrcThreadSafeContextRef ll_ts_context;
+    // False if the context is the module's shared context, see `Module.shared_context`
+    bool owns_context;
     LLVMContextRef ll_context;
+    // May be NULL once ownership has been transferred to the JIT.
     LLVMModuleRef ll_module;
     LLVMBuilderRef ll_builder;
 
+    // Indices of the declarations defined in this unit. References to any other declaration become external.
+    IndexList decls;
+    // Set when the object of the unit is reused from the declaration cache, in which case no IR is generated.
+    bool cached;
+    // A mapping between interned string literals and pointers to their globals
+    IndexPtrMap string_pool;
+    // Function types indexed by decl, built from `DeclFnData` the first time a decl is referenced.
+    // LLVM types belong to a context, so they are cached per unit rather than on the decl.
+    LLVMTypeRef *fn_types;
+    // Memoized LLVM types of each non extended type tag, and of pointers to them.
+    LLVMTypeRef types[__TYPE_LAST];
+    LLVMTypeRef ptr_types[__TYPE_LAST];
+
     // Current MIR being generated
     Mir *mir;
     // A mapping between MIR instructions and LLVM instructions
@@ -28,11 +103,26 @@ typedef struct codegen_s {
 
 #define self_t Codegen *self
 
-void codegen_init(self_t, Module *module);
+void codegen_init(self_t, Module *module, const CodegenOptions *options);
 void codegen_free(self_t);
 
+// Sets the target layout on the module and runs the optimization pipeline for the configured level.
+// Must be called once all decls have been lowered and before anything is emitted.
+bool codegen_optimize(self_t);
+
+// Textual IR
 bool codegen_write_to_file(self_t, char *path);
+bool codegen_write_to_bc_file(self_t, char *path);
+bool codegen_write_to_asm_file(self_t, char *path);
 bool codegen_write_to_obj_file(self_t, char *path);
+// Emits an object into a buffer, which the caller frees.
+bool codegen_write_to_obj_memory(self_t, char **data, size_t *size);
+
+// Compiles the module in process and runs its `main` function, writing the result to `exit_code`.
+// Foreign symbols are resolved from the host process. If `lazy` is set, each function is only
+// compiled the first time it is called.
+// Eager mode consumes the LLVM module, so nothing else may be emitted from this codegen afterwards.
+bool codegen_run_jit(self_t, bool lazy, int32_t *exit_code);
 
 void codegen_lower_decl(self_t, Decl *decl);
 LLVMTypeRef codegen_fn_proto(self_t, Decl *decl);
@@ -40,6 +130,9 @@ LLVMTypeRef codegen_fn_proto(self_t, Decl *decl);
 LLVMTypeRef codegen_type_to_llvm(self_t, Type type);
 
 LLVMValueRef codegen_inst(self_t, MirIndex index, LLVMBasicBlockRef ll_block);
+// Well known refs are built as constants directly, everything else goes through `codegen_inst`.
+// `ll_type` is the type of the use, which is required for the untyped `RefZero` and `RefOne`.
+LLVMValueRef codegen_ref(self_t, Ref ref, LLVMTypeRef ll_type, LLVMBasicBlockRef ll_block);
 LLVMValueRef codegen_constant(self_t, MirIndex index, LLVMBasicBlockRef ll_block);
 LLVMValueRef codegen_binary_op(self_t, MirIndex index, LLVMBasicBlockRef ll_block);
 LLVMValueRef codegen_alloc(self_t, MirIndex index, LLVMBasicBlockRef ll_block);
@@ -3,7 +3,10 @@
 
 #include "common.h"
 #include "ast.h"
+#include "writer.h"
 
+void ast_debug_tree_write(Ast *ast, AstIndex root, bool print_locs, Writer *out);
+// Caller owns the returned string
 char *ast_debug_tree_print(Ast *ast, AstIndex root, bool print_locs);
 
 #endif //ACORN_AST_DEBUG_TREE_H
@@ -3,8 +3,10 @@
 
 #include "common.h"
 #include "hir.h"
+#include "writer.h"
 
-// Unsafe as usual
+void hir_debug_write(Hir *hir, HirIndex root, Writer *out);
+// Caller owns the returned string
 char *hir_debug_print(Hir *hir, HirIndex root);
 
 #endif //CONFIG_MIR_DEBUG_H
@@ -3,8 +3,21 @@
 
 #include "common.h"
 #include "mir.h"
+#include "writer.h"
+#include "interner.h"
 
-// Unsafe as usual
+// Optional names used to print MIR in its readable form, which is also the form `mir_parser` reads.
+typedef struct mir_debug_names_s {
+    // Pointer constants are printed as the string literal they refer to when present.
+    StringSet *strings;
+    // Function refs are printed by name when present, indexed by decl. Otherwise as their index, eg `fn_ptr(#2)`.
+    char **decl_names;
+    uint32_t decl_count;
+} MirDebugNames;
+
+void mir_debug_write(Mir *mir, Writer *out);
+void mir_debug_write_named(Mir *mir, const MirDebugNames *names, Writer *out);
+// Caller owns the returned string
 char *mir_debug_print(Mir *mir);
 
 #endif //CONFIG_MIR_DEBUG_H
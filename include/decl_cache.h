@@ -0,0 +1,70 @@
+#ifndef CONFIG_DECL_CACHE_H
+#define CONFIG_DECL_CACHE_H
+
+#include "common.h"
+#include "codegen.h"
+
+typedef struct module_s Module;
+typedef struct decl_s Decl;
+
+// SECTION: Declaration cache
+// An on-disk cache of the MIR and object of each declaration, so that a rebuild only lowers and generates the
+// declarations which changed.
+//
+// An entry is keyed by a hash of the compiler flags and the source of the declaration (from `fn` to its closing
+// brace). The entry holds the MIR as text (see `mir_parser.h`) and the signatures of every function it references.
+// It is only used if the flags, source and signatures are all unchanged.
+// Objects are keyed by the entry key and the signatures, since the code for a call depends on the callee signature.
+//
+// Entries are written to a temporary file and renamed, so a concurrent or interrupted build never sees half an entry.
+
+typedef struct decl_cache_key_s {
+    // Zero if the decl cannot be cached (eg it has no source)
+    uint64_t entry;
+    // Zero until the MIR has been loaded or stored
+    uint64_t object;
+} DeclCacheKey;
+
+typedef struct decl_cache_s {
+    char *dir;
+    // Everything other than the source and signatures which changes the MIR or object of a decl
+    char *flags;
+
+    // Keys of each decl in the module, indexed by decl
+    DeclCacheKey *keys;
+    uint32_t key_count;
+
+    // Hit and miss counters, which may be updated from any thread
+    struct decl_cache_stats_s *stats;
+} DeclCache;
+
+#define self_t DeclCache *self
+
+// Creates `dir` if it does not exist yet.
+bool decl_cache_init(self_t, const char *dir, const CodegenOptions *options);
+void decl_cache_free(self_t);
+
+// Reads the MIR of `decl` into `decl->mir` if its entry is present and still valid.
+bool decl_cache_load_mir(self_t, Module *module, Decl *decl);
+// Writes the entry for the (just lowered) MIR of `decl`.
+void decl_cache_store_mir(self_t, Module *module, Decl *decl);
+
+// Computes the object key for MIR which was neither loaded nor lowered, eg MIR kept by `module_reload`.
+void decl_cache_track_mir(self_t, Module *module, Decl *decl);
+// Drops the keys of every decl. Must be called when the decls of the module are replaced.
+void decl_cache_forget_decls(self_t);
+
+// Returns whether an object is present for the MIR of `decl`. Must be called after its MIR was loaded or stored.
+bool decl_cache_has_object(self_t, Module *module, Decl *decl);
+// Copies the cached object of `decl` to `obj_path`.
+bool decl_cache_load_object(self_t, Module *module, Decl *decl, const char *obj_path);
+// Copies the object at `obj_path`, which contains only `decl`, into the cache.
+void decl_cache_store_object(self_t, Module *module, Decl *decl, const char *obj_path);
+
+// Zeroes the counters, eg before each build of a module which is kept between builds.
+void decl_cache_reset_stats(self_t);
+void decl_cache_print_stats(self_t, FILE *out);
+
+#undef self_t
+
+#endif //CONFIG_DECL_CACHE_H
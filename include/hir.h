@@ -172,10 +172,15 @@ typedef struct hir_s {
     HirInstList instructions;
     IndexList extra;
     StringSet strings;
+    // The interned content of each string literal, by the token of the literal, so escapes are only decoded once
+    IndexMap string_literals;
 } Hir;
 
 #define self_t Hir *self
 
+// Frees every list and the strings, but not the HIR itself.
+void hir_free(self_t);
+
 HirInst *hir_get_inst(self_t, HirIndex index);
 HirInst *hir_get_inst_tagged(self_t, HirIndex index, HirInstTag tag);
 
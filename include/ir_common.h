@@ -4,14 +4,42 @@
 #include "common.h"
 #include "type.h"
 
+// Number of small integer constants (starting at zero) with a well known ref, for each of `REF_SMALL_INT_TYPES`.
+#define REF_SMALL_INT_COUNT 16
+#define REF_SMALL_INT_TYPE_COUNT 4
+
 // Incomplete enum representing the known ref values, or any index into an instruction list
 // Conversion can be done using the appropriate methods below
+//
+// The known refs are constants which are used often enough that they should not cost an instruction. They are never
+// present in the instruction list, so users can materialize them directly from the ref.
 typedef enum {
     RefNone,
 
+    // Untyped, these take the type of the value they are used with.
     RefZero,
     RefOne,
 
+    // Builtin types, in the same order as the simple `TypeTag`s from `TY_VOID` to `TypeBool`.
+    RefTypeVoid,
+    RefTypeI8,
+    RefTypeI16,
+    RefTypeI32,
+    RefTypeI64,
+    RefTypeI128,
+    RefTypeISize,
+    RefTypeF32,
+    RefTypeF64,
+    RefTypeBool,
+
+    RefVoidValue,
+    RefBoolFalse,
+    RefBoolTrue,
+
+    // `0..REF_SMALL_INT_COUNT` as an i8, i16, i32 and then i64.
+    RefSmallIntFirst,
+    RefSmallIntLast = RefSmallIntFirst + REF_SMALL_INT_TYPE_COUNT * REF_SMALL_INT_COUNT - 1,
+
     __REF_LAST,
 } Ref;
 
@@ -19,5 +47,19 @@ Ref index_to_ref(uint32_t index);
 uint32_t ref_to_index(Ref ref);
 
 char *ref_to_string(Ref ref); //todo safety test
+// Inverse of `ref_to_string` for the well known refs. Returns `__REF_LAST` if the name is not known.
+Ref ref_from_string(const char *name, size_t len);
+
+// Returns the well known ref for a builtin type, or `__REF_LAST` if there is none (eg for extended types).
+Ref ref_from_type(Type type);
+bool ref_is_type(Ref ref);
+Type ref_to_type(Ref ref);
+
+// Returns the well known ref for an integer constant, or `__REF_LAST` if it must be an instruction.
+Ref ref_from_int(Type type, uint64_t value);
+// Type of a well known value. `RefZero` and `RefOne` are `TypeUnknown` since they take the type of their use.
+TypeTag ref_value_type(Ref ref);
+// Integer value of a well known value, booleans are zero or one.
+uint64_t ref_int_value(Ref ref);
 
 #endif //CONFIG_IR_COMMON_H
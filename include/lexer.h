@@ -61,10 +61,42 @@ void token_list_insert(self_t, Token token);
 
 #undef self_t
 
+// SECTION: Line index
+// Byte offset of the start of every line in a source, recorded while lexing so that locations can be turned into
+// line and column with a binary search instead of rescanning the source.
+
+typedef struct source_loc_s {
+    // One based
+    uint32_t line;
+    // Zero based, in bytes
+    uint32_t col;
+} SourceLoc;
+
+typedef struct line_index_s {
+    uint32_t size;
+    uint32_t capacity;
+    // data[i] is the offset of line i + 1, so data[0] is always 0 once lexing has started
+    uint32_t *data;
+} LineIndex;
+
+#define self_t LineIndex *self
+
+void line_index_init(self_t);
+void line_index_free(self_t);
+void line_index_add(self_t, uint32_t line_start);
+
+SourceLoc line_index_lookup(self_t, uint32_t offset);
+// Byte range of the given (one based) line, not including the line break.
+TokenLoc line_index_line(self_t, const uint8_t *source, uint32_t line);
+
+#undef self_t
+
 typedef struct lexer_s {
     size_t origin;
     const uint8_t *start;
     const uint8_t *current;
+    // Line starts are recorded here if set, see `LineIndex`. NULL after `lexer_init`.
+    LineIndex *lines;
 } Lexer;
 
 #define self_t Lexer *self
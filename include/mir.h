@@ -67,27 +67,49 @@ typedef enum mir_inst_tag_s {
 } MirInstTag;
 
 char *mir_tag_to_string(MirInstTag tag);
+// Inverse of `mir_tag_to_string`. Returns `MirReserved` if the name is not a tag.
+MirInstTag mir_tag_from_string(const char *name, size_t len);
 
-// 8 bytes max
-//todo 12? ty_pl must be a ptr + u32
+// Types are 32 bit so that they fit in instruction data. A type without an `ExtendedType` is its own `TypeTag`, and an
+// extended type is stored in the type pool of its MIR at `index - __TYPE_LAST`.
+typedef uint32_t MirTypeIndex;
+
+typedef struct mir_type_pool_s {
+    uint32_t size;
+    uint32_t capacity;
+    Type *data;
+} MirTypePool;
+
+#define self_t MirTypePool *self
+
+void mir_type_pool_init(self_t);
+void mir_type_pool_free(self_t);
+// Equal extended types share an index, so comparing indices compares types.
+MirTypeIndex mir_type_pool_add(self_t, Type type);
+Type mir_type_pool_get(self_t, MirTypeIndex index);
+
+#undef self_t
+
+// 8 bytes, anything larger goes in extra
 typedef union mir_inst_data_s {
     uint8_t noop;
-    Type ty;
+    MirTypeIndex ty;
     Ref un_op;
     struct {
-        Ref lhs; // Note: This is represented as an int in c, so this is actually 8 bytes violating the rule above.
-        Ref rhs; // Note: This is represented as an int in c, so this is actually 8 bytes violating the rule above.
+        Ref lhs;
+        Ref rhs;
     } bin_op;
     struct {
-        Type ty;
+        MirTypeIndex ty;
         //Index in instructions, extra, or values
         uint32_t payload;
     } ty_pl;
     struct {
         uint32_t payload;
-        Ref operand; // Note: This is represented as an int in c, so this is actually 8 bytes violating the rule above.
+        Ref operand;
     } pl_op;
-    char *fn_ptr;
+    // Index of the function in the decls of its module (a `DeclIndex`)
+    uint32_t fn_decl;
 } MirInstData;
 
 // Data payloads
@@ -102,35 +124,52 @@ typedef struct {
     uint32_t arg_count;
 } MirCallData;
 
+// An instruction as read from a `MirInstList`. It is not stored like this, see below.
 typedef struct mir_inst_s {
     MirInstTag tag;
     MirInstData data;
 } MirInst;
 
+// Instructions are stored as two columns, a one byte tag and 8 bytes of data, so 9 bytes per instruction with no
+// padding. Passes which only look at tags touch a single byte per instruction.
 typedef struct mir_inst_list_s {
     uint32_t size;
     uint32_t capacity;
-    MirInst *data;
+    uint8_t *tags;
+    MirInstData *data;
 } MirInstList;
 
 #define self_t MirInstList *self
 
 void mir_inst_list_init(self_t);
 void mir_inst_list_free(self_t);
-void mir_inst_list_add(self_t, MirInst inst);
-MirInst *mir_inst_list_get(self_t, uint32_t index);
+void mir_inst_list_add(self_t, MirInstTag tag, MirInstData data);
+void mir_inst_list_set(self_t, uint32_t index, MirInstTag tag, MirInstData data);
+// The index must be in bounds
+MirInst mir_inst_list_get(self_t, uint32_t index);
+
+static inline MirInstTag mir_inst_list_tag(self_t, uint32_t index) {
+    assert(index < self->size);
+    return (MirInstTag) self->tags[index];
+}
 
 #undef self_t
 
 typedef struct mir_s {
     MirInstList instructions;
     IndexList extra;
+    MirTypePool types;
     // values value list todo value union
 } Mir;
 
 #define self_t Mir *self
 
 void mir_add_inst(self_t, MirInstTag tag, MirInstData data);
+void mir_free(self_t);
+
+static inline Type mir_get_type(self_t, MirTypeIndex index) {
+    return mir_type_pool_get(&self->types, index);
+}
 
 #undef self_t
 
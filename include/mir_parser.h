@@ -0,0 +1,62 @@
+#ifndef CONFIG_MIR_PARSER_H
+#define CONFIG_MIR_PARSER_H
+
+#include "common.h"
+#include "mir.h"
+#include "interner.h"
+
+typedef struct module_s Module;
+typedef struct decl_s Decl;
+
+// SECTION: MIR parser
+// Reads the textual format written by `mir_debug_write` back into a `Mir`, so that the backends can be tested and
+// benchmarked without going through the frontend.
+//
+// A function body is one instruction per line, eg `%3 = add(%1, @ref.one)`. Instructions keep the index they are
+// written with, and operands must be defined before they are used. Any instruction which is not an operand of a
+// later instruction is a statement of the root block, which is the same rule the printer follows.
+// Pointer constants may be written as a string literal, eg `constant(*i8, "hello")`, which is interned.
+//
+// A module is a list of functions in the same shape as the source language, with blank lines and `//` comments
+// ignored:
+//
+//     foreign fn puts(*i8) i32
+//     fn main() i32 {
+//     %1 = constant(i32, 0)
+//     %2 = ret(%1)
+//     }
+
+typedef struct mir_parser_s {
+    // Only used for error messages, may be NULL
+    const char *path;
+    const char *cursor;
+    uint32_t line;
+
+    // String literals are interned here
+    StringSet *strings;
+    // Names of referenced functions. Outside of a module `fn_ptr` refers to its name's key here, so these are the decl
+    // names to print the MIR with.
+    StringSet fn_names;
+} MirParser;
+
+#define self_t MirParser *self
+
+void mir_parser_init(self_t, const char *path, const char *source, StringSet *strings);
+void mir_parser_free(self_t);
+
+// Parses a function body until a line containing only `}` (which is consumed) or the end of the input.
+// `param_count` is the number of arguments that may be referenced with `arg`, or UINT32_MAX for any.
+// Errors are reported to stderr, in which case nothing is written to `mir`.
+bool mir_parse_fn(self_t, uint32_t param_count, Mir *mir);
+
+// Parses a function body into the MIR of `decl`, which must already be in `module` and not have MIR yet.
+// Function refs are resolved against the decls of `module`.
+bool mir_parse_decl(self_t, Module *module, Decl *decl);
+
+// Parses every function in the input into decls of `module`, which must not have been parsed yet.
+// Every decl has its MIR present, and foreign decls are marked as generated.
+bool mir_parse_module(self_t, Module *module);
+
+#undef self_t
+
+#endif //CONFIG_MIR_PARSER_H
@@ -7,6 +7,8 @@
 #include "hir.h"
 #include "interner.h"
 #include "codegen.h"
+#include "writer.h"
+#include "decl_cache.h"
 
 // SECTION: Declaration
 
@@ -31,6 +33,8 @@ typedef union decl_data_s {
 typedef struct decl_s {
     StringKey name;
     DeclState state;
+    // The AST node the MIR is lowered from. Must stay in sync with the HIR module decl order.
+    AstIndex ast_index;
 
     DeclData data;
     Mir *mir; // Only present after lowering
@@ -42,29 +46,12 @@ typedef struct decl_fn_data_s {
     Type *param_types;
 } DeclFnData;
 
+#define self_t Decl *self
 
+// Lowers the decl to MIR the first time it is requested.
+Mir *decl_get_mir_in_module(self_t, Module *module);
 
-//typedef struct decl_s {
-//    char *name;
-//    DeclState state;
-//
-//    AstIndex ast_index;
-//
-//    // Only present after lowering
-//    Mir *mir;
-//    // May be present before lowering
-//    //todo not good to bring llvm into this struct, will eventually have a Map<decl index, LLVMValueRef>
-//    LLVMValueRef llvm_value;
-//} Decl;
-
-//#define self_t Decl *self
-//
-//void decl_init_from_ast(self_t, Ast *ast, AstIndex ast_index);
-//void decl_free(self_t);
-//
-//Mir *decl_get_mir_in_module(self_t, Module *module);
-//
-//#undef self_t
+#undef self_t
 
 typedef struct decl_list_s {
     uint32_t size;
@@ -95,8 +82,16 @@ typedef struct module_s {
     Ast *ast;
     // Not always present
     Hir *hir;
-    // Only present once codegen has started
-    Codegen *codegen;
+    // Only present once codegen has started, see `CodegenOptions.codegen_units`
+    Codegen *units;
+    uint32_t unit_count;
+    // Set by the driver before lowering, defaults to `CODEGEN_OPTIONS_DEFAULT`.
+    CodegenOptions options;
+    // Only present for incremental builds, see `module_enable_decl_cache`.
+    DeclCache *decl_cache;
+    // A context used by every unit instead of one each, which outlives the module (see `acorn_session.h`).
+    // Units then have to be generated on one thread. NULL by default.
+    LLVMOrcThreadSafeContextRef shared_context;
 } Module;
 
 #define self_t Module *self
@@ -104,16 +99,77 @@ typedef struct module_s {
 void module_init(self_t, char *path);
 void module_free(self_t);
 
+// Reuses the MIR and objects of unchanged decls from `dir` (see `decl_cache.h`). Must be called after setting
+// `options` and before lowering. Each reachable decl is generated in its own codegen unit so that its object can be
+// reused, unless `options.codegen_units` is set or outputs other than objects and executables are requested.
+bool module_enable_decl_cache(self_t, const char *dir);
+
 bool module_parse(self_t);
+// Like `module_parse`, but parses a copy of `source` instead of reading the file. The path is only used as a name.
+void module_parse_buffer(self_t, const char *source, size_t len);
+
+// Result of `module_reload`.
+typedef struct module_reload_s {
+    // False if the file is unchanged, in which case the module was left alone
+    bool changed;
+    // Decls in the new source, zero if it has AST errors
+    uint32_t decl_count;
+    // Decls whose MIR was kept
+    uint32_t reused;
+} ModuleReload;
+
+// Reads the file again after `module_parse`, replacing the AST, HIR and decls of the module. Unchanged decls keep
+// their MIR (and so their objects, with the declaration cache), everything else is lowered again on request. If the
+// new source has AST errors the module is left without decls, and nothing is reused by the next reload.
+// Codegen units are freed, so `module_lower_main` can run again.
+bool module_reload(self_t, ModuleReload *result);
+// Like `module_reload`, but compares and parses a copy of `source` instead of reading the file.
+void module_reload_buffer(self_t, const char *source, size_t len, ModuleReload *result);
+// Loads the MIR of every decl without MIR which the declaration cache holds, without lowering any. Lets a module catch
+// up with a build of the same source made by another process, eg a watch child.
+void module_load_cached_mir(self_t);
+// Reads a textual MIR module (see `mir_parser.h`) instead of source, after which the module is ready for
+// `module_lower_main` or `module_emit_native`.
+bool module_parse_mir(self_t);
 bool module_lower_ast(self_t);
 bool module_lower_main(self_t);
+// Like `module_lower_main`, but lowers every decl with a body whether or not it is reachable from a `main`, so that
+// the objects can be linked with other modules which declare them `foreign`.
+bool module_lower_all(self_t);
+// Writes every output requested by `options.emit`.
 bool module_emit_llvm(self_t);
-
-Decl *module_find_decl(self_t, char *name);
+// Writes every decl as textual MIR which `module_parse_mir` can read. Must be called before `module_lower_main`.
+void module_write_mir(self_t, Writer *out);
+// Writes the header of a decl in the format of `module_write_mir`, eg `foreign fn puts(*i8) i32`.
+void module_write_decl_signature(self_t, Decl *decl, Writer *out);
+// Emits the object of a module lowered into a single unit into a buffer, which the caller frees.
+bool module_emit_object_to_memory(self_t, char **data, size_t *size);
+// Writes `module_write_mir` output next to the source, eg `main.acorn.mir`.
+bool module_emit_mir(self_t);
+// Generates machine code for `main` and everything it references with the native x86-64 backend, then links it.
+// Does not require `module_lower_main`.
+bool module_emit_native(self_t);
+// The executable is placed next to the source file, with `.acorn` or a trailing `.mir` stripped from the name.
+// The caller frees the path.
+char *module_exe_path(self_t);
+// Paths of the outputs written by `module_emit_llvm` or `module_emit_native`, excluding MIR. The caller frees each
+// path and the array.
+char **module_output_paths(self_t, uint32_t *count);
+// Runs the module `main` in process instead of emitting it. See `codegen_run_jit`.
+// Requires the module to have been lowered into a single codegen unit.
+bool module_run_jit(self_t, bool lazy, int32_t *exit_code);
+
+Decl *module_find_decl(self_t, const char *name);
+// Name memory is borrowed from the HIR string set.
+char *module_decl_name(self_t, Decl *decl);
+// The source of a decl runs from its `fn` token to the brace closing its body. False if it has no source.
+bool module_decl_source(self_t, Decl *decl, const char **start, size_t *len);
 
 #undef self_t
 
+// SECTION: Linking
 
-// Decl
+// Links all objects into a single executable with one invocation of the system C compiler driver.
+bool link_objects(char **obj_paths, uint32_t obj_count, char *exe_path);
 
 #endif //CONFIG_MODULE_H
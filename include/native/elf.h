@@ -0,0 +1,90 @@
+#ifndef ACORN_NATIVE_ELF_H
+#define ACORN_NATIVE_ELF_H
+
+#include "common.h"
+
+// SECTION: Byte list
+// A growable list of raw bytes, used for section contents.
+
+typedef struct byte_list_s {
+    uint32_t size;
+    uint32_t capacity;
+    uint8_t *data;
+} ByteList;
+
+#define self_t ByteList *self
+
+void byte_list_init(self_t);
+void byte_list_free(self_t);
+void byte_list_add(self_t, uint8_t byte);
+void byte_list_add_multi(self_t, const void *data, size_t size);
+
+#undef self_t
+
+// SECTION: ELF object
+// A minimal x86-64 ELF relocatable object writer. Only supports the sections emitted by the native backend.
+
+typedef uint32_t ElfSymbolIndex;
+
+typedef enum elf_section_s {
+    ELF_SECTION_UNDEF,
+    ELF_SECTION_TEXT,
+    ELF_SECTION_RODATA,
+} ElfSection;
+
+// Subset of the x86-64 relocation types
+typedef enum elf_reloc_type_s {
+    ELF_R_X86_64_PC32 = 2,
+    ELF_R_X86_64_PLT32 = 4,
+    ELF_R_X86_64_GOTPCREL = 9,
+} ElfRelocType;
+
+typedef struct elf_symbol_s {
+    // Owned by the symbol. NULL for section symbols.
+    char *name;
+    ElfSection section;
+    uint64_t value;
+    uint64_t size;
+} ElfSymbol;
+
+typedef struct elf_reloc_s {
+    // Offset into .text
+    uint64_t offset;
+    ElfSymbolIndex symbol;
+    ElfRelocType type;
+    int64_t addend;
+} ElfReloc;
+
+typedef struct elf_object_s {
+    ByteList text;
+    ByteList rodata;
+
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;
+    ElfSymbol *symbols;
+
+    uint32_t reloc_count;
+    uint32_t reloc_capacity;
+    ElfReloc *relocs;
+
+    // Local symbol representing the start of .rodata, used for string relocations.
+    ElfSymbolIndex rodata_symbol;
+} ElfObject;
+
+#define self_t ElfObject *self
+
+void elf_object_init(self_t);
+void elf_object_free(self_t);
+
+// Returns the symbol with the given name, adding it as undefined if it is not present yet.
+ElfSymbolIndex elf_object_symbol(self_t, const char *name);
+void elf_object_define(self_t, ElfSymbolIndex symbol, uint64_t value, uint64_t size);
+// Appends null terminated data to .rodata and returns its offset.
+uint64_t elf_object_add_string(self_t, const char *str, size_t len);
+void elf_object_add_reloc(self_t, uint64_t offset, ElfSymbolIndex symbol, ElfRelocType type, int64_t addend);
+
+bool elf_object_write_to_file(self_t, const char *path);
+
+#undef self_t
+
+#endif //ACORN_NATIVE_ELF_H
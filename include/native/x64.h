@@ -0,0 +1,77 @@
+#ifndef ACORN_NATIVE_X64_H
+#define ACORN_NATIVE_X64_H
+
+#include "common.h"
+#include "mir.h"
+#include "native/elf.h"
+
+// SECTION: x86-64 native backend
+// Generates System V x86-64 machine code directly from MIR and writes it as an ELF relocatable object.
+// Intended for fast debug builds, so it favours compile speed over code quality.
+
+typedef struct module_s Module;
+typedef struct decl_s Decl;
+
+typedef enum x64_loc_kind_s {
+    // The value is never read, so it does not need a home.
+    X64_LOC_NONE,
+    // Lives in a callee saved register for its entire lifetime.
+    X64_LOC_REG,
+    // Spilled to a stack slot (offset from rbp).
+    X64_LOC_STACK,
+    // Integer constant, rematerialized as an immediate at each use.
+    X64_LOC_IMM,
+    // The address of a stack allocation (offset from rbp).
+    X64_LOC_FRAME,
+    // The address of a string in .rodata.
+    X64_LOC_STRING,
+    // The address of a function symbol.
+    X64_LOC_SYMBOL,
+} X64LocKind;
+
+typedef struct x64_loc_s {
+    X64LocKind kind;
+    union {
+        uint8_t reg;
+        int32_t offset;
+        int64_t imm;
+        uint64_t rodata_offset;
+        ElfSymbolIndex symbol;
+    } data;
+} X64Loc;
+
+typedef struct x64_gen_s {
+    Module *module;
+    ElfObject obj;
+    // A mapping between interned string literals and their .rodata offset (plus one)
+    IndexPtrMap string_offsets;
+
+    // Current MIR being generated
+    Mir *mir;
+    // Instruction indices in evaluation order
+    IndexList schedule;
+    // Indexed by instruction, only valid during `x64_gen_lower_decl`
+    X64Loc *locs;
+    Type *types;
+    uint32_t *last_use;
+
+    // Bitmask of the callee saved registers used by the current function
+    uint16_t used_regs;
+    uint32_t saved_reg_count;
+    uint32_t slot_count;
+    // Offsets into .text of jumps to the epilogue of the current function
+    IndexList ret_patches;
+} X64Gen;
+
+#define self_t X64Gen *self
+
+void x64_gen_init(self_t, Module *module);
+void x64_gen_free(self_t);
+
+bool x64_gen_write_to_obj_file(self_t, char *path);
+
+void x64_gen_lower_decl(self_t, Decl *decl);
+
+#undef self_t
+
+#endif //ACORN_NATIVE_X64_H
@@ -11,11 +11,14 @@ typedef struct parser_s {
     uint8_t *source;
 
     TokenList tokens;
+    LineIndex lines;
     uint32_t tok_index;
 
     AstNodeList nodes;
     IndexList extra_data;
     ErrorList errors;
+    // Set by an error the parser cannot recover from, the remaining tokens are skipped without further errors
+    bool abandoned;
 } Parser;
 
 #define self_t Parser *self
@@ -20,8 +20,9 @@ bool parse_match(self_t, TokenType type);
 // Otherwise returns false and does not advance
 bool parse_match_advance(self_t, TokenType type);
 
-// Assert that the next token is of the given type, or panic
-//todo very unsafe mechanic, should enter recovery mode or at least skip until it finds that token
+// Consume the next token, which must be of the given type. Otherwise an error is recorded and the rest of the source
+// is abandoned, see `Parser.abandoned`.
+//todo should enter recovery mode or at least skip until it finds that token
 TokenIndex parse_assert(self_t, TokenType type);
 
 
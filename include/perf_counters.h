@@ -0,0 +1,35 @@
+#ifndef ACORN_PERF_COUNTERS_H
+#define ACORN_PERF_COUNTERS_H
+
+#include "common.h"
+
+// SECTION: Hardware performance counters
+// Per thread hardware counters (Linux `perf_event_open`), read around each time report phase.
+// Counters which cannot be opened (no kernel support, `perf_event_paranoid`, virtual machines, other platforms) are
+// reported as unavailable rather than failing the compile.
+
+typedef enum perf_counter_s {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_BRANCH_MISSES,
+
+    __PERF_COUNTER_LAST,
+} PerfCounter;
+
+char *perf_counter_to_string(PerfCounter counter);
+
+typedef struct perf_sample_s {
+    uint64_t values[__PERF_COUNTER_LAST];
+    // Bit per counter, set if the value was read
+    uint32_t valid;
+} PerfSample;
+
+// Returns false (after printing why) if no counter is available on the calling thread.
+bool perf_counters_enable(void);
+bool perf_counters_enabled(void);
+
+// Reads the counters of the calling thread, opening them the first time the thread reads.
+PerfSample perf_counters_read(void);
+
+#endif //ACORN_PERF_COUNTERS_H
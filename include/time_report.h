@@ -0,0 +1,56 @@
+#ifndef ACORN_TIME_REPORT_H
+#define ACORN_TIME_REPORT_H
+
+#include "common.h"
+#include "trace.h"
+#include "perf_counters.h"
+
+// SECTION: Time report
+// Process wide wall time, CPU time, peak RSS and item counts for each compiler phase.
+// Spans may be recorded from any thread. Recording is a no-op until `time_report_enable` is called.
+// Every span is also recorded as a trace event when tracing is enabled, see `trace.h`, and samples the hardware
+// counters when they are enabled, see `perf_counters.h`.
+
+typedef enum time_phase_s {
+    TIME_PHASE_FILE_LOAD,
+    TIME_PHASE_LEX,
+    TIME_PHASE_PARSE,
+    TIME_PHASE_HIR,
+    TIME_PHASE_MIR,
+    TIME_PHASE_LLVM_IR,
+    TIME_PHASE_LLVM_OPT,
+    TIME_PHASE_NATIVE,
+    TIME_PHASE_EMIT,
+    TIME_PHASE_LINK,
+
+    __TIME_PHASE_LAST,
+} TimePhase;
+
+char *time_phase_to_string(TimePhase phase);
+
+typedef struct time_span_s {
+    TimePhase phase;
+    // Zero if recording was disabled when the span began
+    uint64_t wall_start;
+    uint64_t cpu_start;
+    int64_t max_rss_start;
+    PerfSample perf_start;
+    TraceSpan trace;
+} TimeSpan;
+
+void time_report_enable(void);
+bool time_report_enabled(void);
+
+TimeSpan time_phase_begin(TimePhase phase);
+// `count` is the number of items the span produced, eg tokens for `TIME_PHASE_LEX`.
+void time_phase_end(TimeSpan *span, uint64_t count);
+// Same as `time_phase_end`, but tags the trace event with `detail` (eg the declaration name).
+void time_phase_end_detail(TimeSpan *span, const char *detail, uint64_t count);
+
+// Concurrent spans (eg codegen units on separate threads) are summed, so phase times may exceed the total.
+void time_report_print(FILE *out);
+void time_report_print_json(FILE *out);
+// Hardware counters for each phase, with IPC and misses normalized by the number of tokens and AST nodes.
+void time_report_print_perf(FILE *out);
+
+#endif //ACORN_TIME_REPORT_H
@@ -0,0 +1,35 @@
+#ifndef ACORN_TRACE_H
+#define ACORN_TRACE_H
+
+#include "common.h"
+
+// SECTION: Trace
+// Chrome trace event (and Perfetto) output of compiler spans.
+// Each thread records into its own fixed size ring buffer without locking, so tracing is cheap enough to leave
+// compiled in. When a buffer is full the oldest events are overwritten. Buffers are written out by `trace_write`,
+// which must only be called once every other recording thread has finished.
+// A thread which exits leaves its buffer to the next thread which starts recording, so memory is bounded by the
+// threads recording at once rather than every worker ever created. The threads sharing a buffer appear as one.
+
+#define TRACE_DETAIL_LEN 48
+
+typedef struct trace_span_s {
+    const char *name;
+    // Zero if tracing was disabled when the span began
+    uint64_t start_ns;
+} TraceSpan;
+
+// Starts recording, events are written to `path` by `trace_write`.
+void trace_enable(const char *path);
+bool trace_enabled(void);
+
+uint64_t trace_now_ns(void);
+
+// `name` must be a static string. Spans on the same thread must end in the reverse order they began.
+TraceSpan trace_begin(const char *name);
+// `detail` (may be NULL) is copied and truncated to `TRACE_DETAIL_LEN`. `count_name` must be a static string or NULL.
+void trace_end(TraceSpan *span, const char *detail, const char *count_name, uint64_t count);
+
+bool trace_write(void);
+
+#endif //ACORN_TRACE_H
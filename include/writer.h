@@ -0,0 +1,54 @@
+#ifndef ACORN_WRITER_H
+#define ACORN_WRITER_H
+
+#include "common.h"
+
+#include <stdarg.h>
+
+// SECTION: Writer
+// Buffered text output shared by the debug printers. Output goes to a `FILE *`, a growable buffer or a callback.
+// File and callback writers stage output in a fixed buffer which is handed to the sink whenever it fills up, so
+// output of any size takes constant memory and every write is amortized constant time.
+
+typedef void (*WriterCallback)(void *context, const char *data, size_t len);
+
+typedef enum writer_sink_s {
+    WRITER_SINK_FILE,
+    WRITER_SINK_BUFFER,
+    WRITER_SINK_CALLBACK,
+} WriterSink;
+
+typedef struct writer_s {
+    WriterSink sink;
+    FILE *file;
+    WriterCallback callback;
+    void *context;
+
+    // Staged output. For buffer writers this is all output so far, always null terminated.
+    char *data;
+    size_t size;
+    size_t capacity;
+} Writer;
+
+#define self_t Writer *self
+
+void writer_init_file(self_t, FILE *file);
+void writer_init_buffer(self_t);
+void writer_init_callback(self_t, WriterCallback callback, void *context);
+// Flushes any staged output and releases the writer. The buffer of a buffer writer is freed unless taken first.
+void writer_free(self_t);
+
+void writer_write(self_t, const char *data, size_t len);
+void writer_puts(self_t, const char *string);
+void writer_printf(self_t, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void writer_vprintf(self_t, const char *format, va_list args);
+
+// Hands staged output to the file or callback. Does nothing for buffer writers.
+void writer_flush(self_t);
+
+// Returns the output of a buffer writer, which the caller must `free`, and resets the writer.
+char *writer_take_buffer(self_t);
+
+#undef self_t
+
+#endif //ACORN_WRITER_H
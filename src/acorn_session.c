@@ -0,0 +1,126 @@
+#include "acorn_session.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast_check.h"
+#include "module.h"
+
+struct acorn_session_s {
+    CodegenOptions options;
+    LLVMOrcThreadSafeContextRef context;
+};
+
+// SECTION: Sessions
+
+AcornSession *acorn_session_create(const AcornSessionOptions *options) {
+    static const CodegenOptLevel opt_levels[] = {
+            [ACORN_OPT_O0] = CODEGEN_OPT_O0,
+            [ACORN_OPT_O1] = CODEGEN_OPT_O1,
+            [ACORN_OPT_O2] = CODEGEN_OPT_O2,
+            [ACORN_OPT_O3] = CODEGEN_OPT_O3,
+            [ACORN_OPT_OS] = CODEGEN_OPT_OS,
+    };
+
+    AcornSession *session = malloc(sizeof(AcornSession));
+    session->options = CODEGEN_OPTIONS_DEFAULT;
+    session->options.opt_level = opt_levels[options->opt_level];
+    session->options.target = options->target != NULL ? strdup(options->target) : NULL;
+    session->options.cpu = options->cpu != NULL ? strdup(options->cpu) : NULL;
+    // One unit per compile, generated on the calling thread in the shared context
+    session->options.emit = EMIT_OBJ;
+    session->options.jobs = 1;
+    session->options.codegen_units = 1;
+
+    // Initializes LLVM and checks the target, the machine is then reused by every compile
+    if (codegen_target_machine(&session->options) == NULL) {
+        free(session->options.target);
+        free(session->options.cpu);
+        free(session);
+        return NULL;
+    }
+
+    session->context = LLVMOrcCreateNewThreadSafeContext();
+    return session;
+}
+
+void acorn_session_destroy(AcornSession *session) {
+    if (session == NULL)
+        return;
+
+    LLVMOrcDisposeThreadSafeContext(session->context);
+    free(session->options.target);
+    free(session->options.cpu);
+    free(session);
+}
+
+
+// SECTION: Compiling
+
+static void add_diagnostic(AcornResult *result, AcornDiagnostic diagnostic) {
+    // The result is released by the embedder, so it is allocated without the tracker. It has no capacity, instead
+    // the array doubles each time the count reaches a power of two.
+    uint32_t count = result->diagnostic_count;
+    if ((count & (count - 1)) == 0)
+        result->diagnostics = realloc(result->diagnostics, sizeof(AcornDiagnostic) * (count == 0 ? 1 : count * 2));
+    result->diagnostics[result->diagnostic_count++] = diagnostic;
+}
+
+static void add_errors(AcornResult *result, AcornDiagnosticKind kind, Ast *ast, ErrorList *errors) {
+    for (uint32_t i = 0; i < errors->size; i++) {
+        CompileError *error = error_list_get(errors, i);
+        AcornDiagnostic diagnostic = {.kind = kind, .offset = 0, .line = 0, .column = 0,
+                .message = strdup(error->message != NULL ? error->message : "Syntax error")};
+
+        // Columns are counted from zero by the line index
+        if (error->location.start != UINT32_MAX) {
+            SourceLoc loc = line_index_lookup(&ast->lines, error->location.start);
+            diagnostic.offset = error->location.start;
+            diagnostic.line = loc.line;
+            diagnostic.column = loc.col + 1;
+        }
+        add_diagnostic(result, diagnostic);
+    }
+}
+
+static void add_codegen_error(AcornResult *result, const char *message) {
+    add_diagnostic(result, (AcornDiagnostic) {.kind = ACORN_DIAGNOSTIC_CODEGEN, .offset = 0, .line = 0, .column = 0,
+            .message = strdup(message)});
+}
+
+bool acorn_session_compile(AcornSession *session, const char *name, const char *source, size_t source_len,
+                           AcornResult *result) {
+    *result = (AcornResult) {.object = NULL, .object_size = 0, .diagnostics = NULL, .diagnostic_count = 0};
+
+    Module module;
+    module_init(&module, (char *) name);
+    module.options = session->options;
+    module.shared_context = session->context;
+
+    // Lowering and code generation assert on anything they do not support, so the source is checked first
+    ErrorList check_errors;
+    error_list_init(&check_errors);
+
+    module_parse_buffer(&module, source, source_len);
+    if (module.ast->errors.size > 0) {
+        add_errors(result, ACORN_DIAGNOSTIC_SYNTAX, module.ast, &module.ast->errors);
+    } else if (!ast_check(module.ast, &check_errors)) {
+        add_errors(result, ACORN_DIAGNOSTIC_SEMANTIC, module.ast, &check_errors);
+    } else if (!module_lower_ast(&module) || !module_lower_all(&module)) {
+        add_codegen_error(result, "Could not lower the source");
+    } else if (!module_emit_object_to_memory(&module, &result->object, &result->object_size)) {
+        add_codegen_error(result, "Could not emit an object");
+    }
+
+    error_list_free(&check_errors);
+    module_free(&module);
+    return result->object != NULL;
+}
+
+void acorn_result_free(AcornResult *result) {
+    free(result->object);
+    for (uint32_t i = 0; i < result->diagnostic_count; i++)
+        free(result->diagnostics[i].message);
+    free(result->diagnostics);
+    *result = (AcornResult) {.object = NULL, .object_size = 0, .diagnostics = NULL, .diagnostic_count = 0};
+}
@@ -0,0 +1,157 @@
+#include "alloc_tracker.h"
+
+char *alloc_tag_to_string(AllocTag tag) {
+    switch (tag) {
+        case ALLOC_TAG_OTHER:           return "other";
+        case ALLOC_TAG_TOKEN_LIST:      return "TokenList";
+        case ALLOC_TAG_AST_NODE_LIST:   return "AstNodeList";
+        case ALLOC_TAG_INDEX_LIST:      return "IndexList";
+        case ALLOC_TAG_HIR_INST_LIST:   return "HirInstList";
+        case ALLOC_TAG_MIR_INST_LIST:   return "MirInstList";
+        case ALLOC_TAG_STRING_SET:      return "StringSet";
+        case ALLOC_TAG_SCOPE:           return "scope";
+        case ALLOC_TAG_EXTENDED_TYPE:   return "ExtendedType";
+        case ALLOC_TAG_COMPILE_ERROR:   return "CompileError";
+        default:                        return "<?>";
+    }
+}
+
+#ifdef ACORN_ALLOC_TRACKING
+
+#include <pthread.h>
+#include <stdalign.h>
+
+// Placed in front of every tracked allocation. Live allocations form a list so leaks can be found at exit.
+typedef struct alloc_header_s {
+    struct alloc_header_s *prev;
+    struct alloc_header_s *next;
+    size_t size;
+    // SIZE_MAX until the owner reports its usage, allocations without usage never count as wasted.
+    size_t used;
+    AllocTag tag;
+} AllocHeader;
+
+// Keeps the user data aligned as malloc would
+#define HEADER_SIZE ((sizeof(AllocHeader) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t))
+
+#define header_of(pointer) ((AllocHeader *) ((char *) (pointer) - HEADER_SIZE))
+#define data_of(header) ((void *) ((char *) (header) + HEADER_SIZE))
+
+typedef struct alloc_stats_s {
+    uint64_t allocs;
+    uint64_t frees;
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t wasted_bytes;
+    uint64_t peak_wasted_bytes;
+} AllocStats;
+
+static pthread_mutex_t tracker_lock = PTHREAD_MUTEX_INITIALIZER;
+static AllocHeader *live = NULL;
+static AllocStats stats[__ALLOC_TAG_LAST];
+
+static size_t wasted(AllocHeader *header) {
+    return header->used == SIZE_MAX ? 0 : header->size - header->used;
+}
+
+// The following all require `tracker_lock`
+
+static void unlink_header(AllocHeader *header) {
+    if (header->prev != NULL) header->prev->next = header->next;
+    else live = header->next;
+    if (header->next != NULL) header->next->prev = header->prev;
+
+    AllocStats *tag = &stats[header->tag];
+    tag->live_bytes -= header->size;
+    tag->wasted_bytes -= wasted(header);
+}
+
+static void link_header(AllocHeader *header) {
+    header->prev = NULL;
+    header->next = live;
+    if (live != NULL) live->prev = header;
+    live = header;
+
+    AllocStats *tag = &stats[header->tag];
+    tag->live_bytes += header->size;
+    if (tag->live_bytes > tag->peak_bytes) tag->peak_bytes = tag->live_bytes;
+    tag->wasted_bytes += wasted(header);
+    if (tag->wasted_bytes > tag->peak_wasted_bytes) tag->peak_wasted_bytes = tag->wasted_bytes;
+}
+
+void *tracked_realloc(AllocTag tag, void *pointer, size_t new_size) {
+    pthread_mutex_lock(&tracker_lock);
+
+    AllocHeader *header = NULL;
+    if (pointer != NULL) {
+        header = header_of(pointer);
+        unlink_header(header);
+    }
+
+    if (new_size == 0) {
+        if (header != NULL) stats[header->tag].frees++;
+        pthread_mutex_unlock(&tracker_lock);
+        free(header);
+        return NULL;
+    }
+
+    AllocHeader *result = realloc(header, HEADER_SIZE + new_size);
+    if (result == NULL) exit(1); // oom. handle better later
+
+    if (header == NULL) {
+        result->tag = tag;
+        result->used = SIZE_MAX;
+        stats[tag].allocs++;
+    }
+    result->size = new_size;
+    if (result->used != SIZE_MAX && result->used > new_size)
+        result->used = new_size;
+    link_header(result);
+
+    pthread_mutex_unlock(&tracker_lock);
+    return data_of(result);
+}
+
+void tracked_set_used(void *pointer, size_t used) {
+    AllocHeader *header = header_of(pointer);
+    assert(used <= header->size);
+
+    pthread_mutex_lock(&tracker_lock);
+    AllocStats *tag = &stats[header->tag];
+    tag->wasted_bytes -= wasted(header);
+    header->used = used;
+    tag->wasted_bytes += wasted(header);
+    if (tag->wasted_bytes > tag->peak_wasted_bytes) tag->peak_wasted_bytes = tag->wasted_bytes;
+    pthread_mutex_unlock(&tracker_lock);
+}
+
+void alloc_tracker_report(FILE *out) {
+    pthread_mutex_lock(&tracker_lock);
+
+    // Everything still live is a leak
+    uint64_t leaked_count[__ALLOC_TAG_LAST] = {0};
+    for (AllocHeader *header = live; header != NULL; header = header->next) {
+        leaked_count[header->tag]++;
+    }
+
+    fprintf(out, "%-14s %10s %10s %12s %12s %12s %14s\n",
+            "tag", "allocs", "frees", "peak bytes", "peak wasted", "leaks", "leaked bytes");
+    for (AllocTag i = 0; i < __ALLOC_TAG_LAST; i++) {
+        AllocStats *tag = &stats[i];
+        if (tag->allocs == 0)
+            continue;
+
+        fprintf(out, "%-14s %10llu %10llu %12llu %12llu %12llu %14llu\n",
+                alloc_tag_to_string(i),
+                (unsigned long long) tag->allocs,
+                (unsigned long long) tag->frees,
+                (unsigned long long) tag->peak_bytes,
+                (unsigned long long) tag->peak_wasted_bytes,
+                (unsigned long long) leaked_count[i],
+                (unsigned long long) tag->live_bytes);
+    }
+
+    pthread_mutex_unlock(&tracker_lock);
+}
+
+#endif
@@ -5,6 +5,14 @@
 #include <string.h>
 
 void *reallocate(void *pointer, size_t new_size) {
+    return reallocate_tagged(ALLOC_TAG_OTHER, pointer, new_size);
+}
+
+void *reallocate_tagged(AllocTag tag, void *pointer, size_t new_size) {
+#ifdef ACORN_ALLOC_TRACKING
+    return tracked_realloc(tag, pointer, new_size);
+#else
+    (void) tag;
     if (new_size == 0) {
         free(pointer);
         return NULL;
@@ -13,16 +21,13 @@ void *reallocate(void *pointer, size_t new_size) {
     void *result = realloc(pointer, new_size);
     if (result == NULL) exit(1); // oom. handle better later
     return result;
+#endif
 }
 
 void *reallocate2(void *pointer, size_t old_size, size_t new_size) {
-    if (new_size == 0) {
-        free(pointer);
+    void *result = reallocate(pointer, new_size);
+    if (result == NULL)
         return NULL;
-    }
-
-    void *result = realloc(pointer, new_size);
-    if (result == NULL) exit(1); // oom. handle better later
 
     // Zero the new memory
     if (new_size > old_size) {
@@ -50,11 +55,12 @@ void index_list_free(self_t) {
 void index_list_add(self_t, uint32_t index) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->data = ARRAY_GROW(uint32_t, self->data, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_INDEX_LIST, uint32_t, self->data, self->capacity);
     }
 
     self->data[self->size] = index;
     self->size++;
+    TRACK_USED(self->data, self->size * sizeof(uint32_t));
 }
 
 uint32_t index_list_add_multi(self_t, void *data, size_t size) {
@@ -64,12 +70,13 @@ uint32_t index_list_add_multi(self_t, void *data, size_t size) {
 
     if (self->capacity < self->size + size) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->data = ARRAY_GROW(uint32_t, self->data, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_INDEX_LIST, uint32_t, self->data, self->capacity);
     }
 
     memcpy(self->data + self->size, data, size * sizeof(uint32_t));
     uint32_t start_index = self->size;
     self->size += size;
+    TRACK_USED(self->data, self->size * sizeof(uint32_t));
     return start_index;
 }
 
@@ -148,3 +155,30 @@ size_t *index_ptr_map_get(self_t, uint32_t key) {
 }
 
 #undef self_t
+
+#define self_t BitSet *self
+
+void bit_set_init(self_t, uint32_t size) {
+    size_t words = (size + 63) / 64;
+    self->size = size;
+    self->data = ARRAY_GROW(uint64_t, NULL, words);
+    memset(self->data, 0, words * sizeof(uint64_t));
+}
+
+void bit_set_free(self_t) {
+    ARRAY_FREE(uint64_t, self->data);
+    self->size = 0;
+    self->data = NULL;
+}
+
+bool bit_set_get(self_t, uint32_t index) {
+    assert(index < self->size);
+    return (self->data[index / 64] >> (index % 64)) & 1;
+}
+
+void bit_set_set(self_t, uint32_t index) {
+    assert(index < self->size);
+    self->data[index / 64] |= (uint64_t) 1 << (index % 64);
+}
+
+#undef self_t
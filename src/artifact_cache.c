@@ -0,0 +1,327 @@
+#include "artifact_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "array_util.h"
+#include "cache_util.h"
+#include "writer.h"
+
+// Bumped whenever the entry layout changes.
+#define ARTIFACT_CACHE_VERSION 1
+#define ENTRY_NAME_LEN 16
+
+#define self_t ArtifactCache *self
+
+bool artifact_cache_init(self_t, const char *dir, uint64_t max_size) {
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create cache directory %s: %s\n", dir, strerror(errno));
+        return false;
+    }
+
+    self->dir = strdup(dir);
+    self->max_size = max_size;
+    self->source_path = NULL;
+    self->inputs = NULL;
+    self->inputs_len = 0;
+    self->entry_path = NULL;
+    self->hits = 0;
+    self->misses = 0;
+    self->evicted = 0;
+    return true;
+}
+
+void artifact_cache_free(self_t) {
+    free(self->dir);
+    free(self->source_path);
+    free(self->inputs);
+    free(self->entry_path);
+    self->dir = NULL;
+    self->source_path = NULL;
+    self->inputs = NULL;
+    self->entry_path = NULL;
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t len = strlen(dir) + strlen(name) + 2;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%s", dir, name);
+    return path;
+}
+
+// Outputs are written next to the source, so only their names are stored.
+static char *source_dir(self_t) {
+    const char *slash = strrchr(self->source_path, '/');
+    return slash != NULL ? strndup(self->source_path, slash - self->source_path) : strdup(".");
+}
+
+
+// SECTION: Inputs
+
+bool artifact_cache_begin(self_t, const char *source_path, const char *flags) {
+    // Rebuilding or updating the compiler changes its size or modification time
+    struct stat compiler;
+    if (stat("/proc/self/exe", &compiler) != 0)
+        return false;
+
+    size_t source_len;
+    char *source = cache_read_file(source_path, &source_len);
+    if (source == NULL)
+        return false;
+
+    Writer inputs;
+    writer_init_buffer(&inputs);
+    writer_printf(&inputs, "acorn artifact cache %d\n", ARTIFACT_CACHE_VERSION);
+    writer_printf(&inputs, "%lld %lld.%09ld\n", (long long) compiler.st_size, (long long) compiler.st_mtim.tv_sec,
+                  compiler.st_mtim.tv_nsec);
+    writer_printf(&inputs, "%s\n%s\n%zu\n", flags, source_path, source_len);
+    writer_write(&inputs, source, source_len);
+    writer_puts(&inputs, "\n");
+    free(source);
+
+    char name[ENTRY_NAME_LEN + 1];
+    snprintf(name, sizeof(name), "%016llx",
+             (unsigned long long) cache_hash(CACHE_HASH_INIT, inputs.data, inputs.size));
+
+    free(self->source_path);
+    free(self->inputs);
+    free(self->entry_path);
+    self->source_path = strdup(source_path);
+    self->inputs_len = inputs.size;
+    self->inputs = malloc(inputs.size);
+    memcpy(self->inputs, inputs.data, inputs.size);
+    self->entry_path = join_path(self->dir, name);
+    writer_free(&inputs);
+    return true;
+}
+
+
+// SECTION: Entries
+// <inputs>
+// <mode> <name>, for each output
+
+bool artifact_cache_restore(self_t) {
+    assert(self->entry_path != NULL);
+
+    char *manifest_path = join_path(self->entry_path, "manifest");
+    size_t len;
+    char *manifest = cache_read_file(manifest_path, &len);
+
+    // Compare the inputs in full, the entry name is only a hash
+    bool result = manifest != NULL && len >= self->inputs_len &&
+                  memcmp(manifest, self->inputs, self->inputs_len) == 0;
+    char *dir = source_dir(self);
+    const char *cursor = result ? manifest + self->inputs_len : NULL;
+    for (uint32_t index = 0; result && *cursor != '\0'; index++) {
+        char *end;
+        mode_t mode = (mode_t) strtoul(cursor, &end, 8);
+        char *newline = strchr(end, '\n');
+        if (*end != ' ' || newline == NULL) {
+            result = false;
+            break;
+        }
+
+        char *name = strndup(end + 1, newline - end - 1);
+        char *output_path = join_path(dir, name);
+        char stored_name[16];
+        snprintf(stored_name, sizeof(stored_name), "%u", index);
+        char *stored_path = join_path(self->entry_path, stored_name);
+
+        result = cache_copy_file(stored_path, output_path) && chmod(output_path, mode) == 0;
+
+        free(stored_path);
+        free(output_path);
+        free(name);
+        cursor = newline + 1;
+    }
+
+    // Mark the entry as recently used
+    if (result)
+        utimensat(AT_FDCWD, manifest_path, NULL, 0);
+
+    if (result) {
+        self->hits++;
+    } else {
+        self->misses++;
+    }
+    free(dir);
+    free(manifest);
+    free(manifest_path);
+    return result;
+}
+
+static void remove_entry(const char *path) {
+    DIR *dir = opendir(path);
+    if (dir != NULL) {
+        struct dirent *file;
+        while ((file = readdir(dir)) != NULL) {
+            if (strcmp(file->d_name, ".") == 0 || strcmp(file->d_name, "..") == 0)
+                continue;
+            char *file_path = join_path(path, file->d_name);
+            unlink(file_path);
+            free(file_path);
+        }
+        closedir(dir);
+    }
+    rmdir(path);
+}
+
+static void artifact_cache_evict(self_t);
+
+void artifact_cache_store(self_t, char **paths, uint32_t count) {
+    assert(self->entry_path != NULL);
+
+    // Build the entry next to its final path, so that the rename cannot cross file systems
+    size_t tmp_len = strlen(self->entry_path) + 32;
+    char *tmp_path = malloc(tmp_len);
+    snprintf(tmp_path, tmp_len, "%s.%d.tmp", self->entry_path, (int) getpid());
+    if (mkdir(tmp_path, 0777) != 0) {
+        fprintf(stderr, "Could not create cache entry %s: %s\n", tmp_path, strerror(errno));
+        free(tmp_path);
+        return;
+    }
+
+    Writer manifest;
+    writer_init_buffer(&manifest);
+    writer_write(&manifest, self->inputs, self->inputs_len);
+
+    bool result = true;
+    for (uint32_t i = 0; i < count && result; i++) {
+        struct stat output;
+        char stored_name[16];
+        snprintf(stored_name, sizeof(stored_name), "%u", i);
+        char *stored_path = join_path(tmp_path, stored_name);
+
+        result = stat(paths[i], &output) == 0 && cache_copy_file(paths[i], stored_path);
+        if (result) {
+            const char *slash = strrchr(paths[i], '/');
+            writer_printf(&manifest, "%o %s\n", (unsigned) (output.st_mode & 07777),
+                          slash != NULL ? slash + 1 : paths[i]);
+        }
+        free(stored_path);
+    }
+
+    if (result) {
+        char *manifest_path = join_path(tmp_path, "manifest");
+        result = cache_write_file(manifest_path, manifest.data, manifest.size);
+        free(manifest_path);
+    }
+    // Another compile may have stored the same entry first, in which case ours is dropped
+    if (!result || rename(tmp_path, self->entry_path) != 0)
+        remove_entry(tmp_path);
+
+    writer_free(&manifest);
+    free(tmp_path);
+    artifact_cache_evict(self);
+}
+
+
+// SECTION: Eviction
+
+typedef struct cache_entry_s {
+    char *path;
+    uint64_t size;
+    struct timespec used;
+} CacheEntry;
+
+static int compare_entries_by_use(const void *a, const void *b) {
+    const struct timespec *lhs = &((const CacheEntry *) a)->used;
+    const struct timespec *rhs = &((const CacheEntry *) b)->used;
+    if (lhs->tv_sec != rhs->tv_sec)
+        return lhs->tv_sec < rhs->tv_sec ? -1 : 1;
+    if (lhs->tv_nsec != rhs->tv_nsec)
+        return lhs->tv_nsec < rhs->tv_nsec ? -1 : 1;
+    return 0;
+}
+
+static bool is_entry_name(const char *name) {
+    if (strlen(name) != ENTRY_NAME_LEN)
+        return false;
+    for (const char *c = name; *c != '\0'; c++) {
+        if (!((*c >= '0' && *c <= '9') || (*c >= 'a' && *c <= 'f')))
+            return false;
+    }
+    return true;
+}
+
+static uint64_t entry_size(const char *path) {
+    uint64_t size = 0;
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+        return 0;
+
+    struct dirent *file;
+    while ((file = readdir(dir)) != NULL) {
+        struct stat info;
+        char *file_path = join_path(path, file->d_name);
+        if (stat(file_path, &info) == 0 && S_ISREG(info.st_mode))
+            size += (uint64_t) info.st_size;
+        free(file_path);
+    }
+    closedir(dir);
+    return size;
+}
+
+// Removes the least recently used entries until the cache fits in `max_size`. Other files in the directory, such as
+// declaration cache entries or entries still being built, are left alone.
+static void artifact_cache_evict(self_t) {
+    DIR *dir = opendir(self->dir);
+    if (dir == NULL)
+        return;
+
+    CacheEntry *entries = NULL;
+    uint32_t entry_count = 0;
+    uint32_t entry_capacity = 0;
+    uint64_t total = 0;
+
+    struct dirent *file;
+    while ((file = readdir(dir)) != NULL) {
+        if (!is_entry_name(file->d_name))
+            continue;
+
+        char *path = join_path(self->dir, file->d_name);
+        char *manifest_path = join_path(path, "manifest");
+        struct stat manifest;
+        if (stat(manifest_path, &manifest) != 0) {
+            free(manifest_path);
+            free(path);
+            continue;
+        }
+        free(manifest_path);
+
+        if (entry_count == entry_capacity) {
+            entry_capacity = ARRAY_GROW_CAPCITY(entry_capacity);
+            entries = ARRAY_GROW(CacheEntry, entries, entry_capacity);
+        }
+        CacheEntry *entry = &entries[entry_count++];
+        entry->path = path;
+        entry->size = entry_size(path);
+        entry->used = manifest.st_mtim;
+        total += entry->size;
+    }
+    closedir(dir);
+
+    if (total > self->max_size) {
+        qsort(entries, entry_count, sizeof(CacheEntry), compare_entries_by_use);
+        for (uint32_t i = 0; i < entry_count && total > self->max_size; i++) {
+            remove_entry(entries[i].path);
+            total -= entries[i].size;
+            self->evicted++;
+        }
+    }
+
+    for (uint32_t i = 0; i < entry_count; i++)
+        free(entries[i].path);
+    ARRAY_FREE(CacheEntry, entries);
+}
+
+void artifact_cache_print_stats(self_t, FILE *out) {
+    fprintf(out, "artifact cache: %u hits, %u misses, %u evicted\n", self->hits, self->misses, self->evicted);
+}
+
+#undef self_t
@@ -86,17 +86,28 @@ void ast_node_list_free(self_t) {
 void ast_node_list_add(self_t, AstNode node) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->data = ARRAY_GROW(AstNode, self->data, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_AST_NODE_LIST, AstNode, self->data, self->capacity);
     }
 
     self->data[self->size] = node;
     self->size++;
+    TRACK_USED(self->data, self->size * sizeof(AstNode));
 }
 
 #undef self_t
 
 #define self_t Ast *self
 
+void ast_free(self_t) {
+    free(self->source);
+    self->source = NULL;
+    token_list_free(&self->tokens);
+    line_index_free(&self->lines);
+    ast_node_list_free(&self->nodes);
+    index_list_free(&self->extra_data);
+    error_list_free(&self->errors);
+}
+
 AstNode *ast_get_node(self_t, AstIndex index) {
     return &self->nodes.data[index];
 }
@@ -116,6 +127,41 @@ char *ast_get_token_content(self_t, TokenIndex token) {
     return str;
 }
 
+char *ast_get_string_literal(self_t, TokenIndex token) {
+    Token str_token = self->tokens.data[token];
+    const char *content = (const char *) self->source + str_token.loc.start + 1;
+    size_t content_len = str_token.loc.end - str_token.loc.start - 2;
+
+    // The decoded string is never longer than the literal
+    char *str = malloc(content_len + 1);
+    size_t len = 0;
+    for (size_t i = 0; i < content_len; i++) {
+        char c = content[i];
+        if (c != '\\' || i + 1 == content_len) {
+            str[len++] = c;
+            continue;
+        }
+
+        //todo \0 cannot be represented until interned strings carry a length
+        switch (content[++i]) {
+            case 'n': str[len++] = '\n'; break;
+            case 't': str[len++] = '\t'; break;
+            case 'r': str[len++] = '\r'; break;
+            case '\\': str[len++] = '\\'; break;
+            case '"': str[len++] = '"'; break;
+            case '\'': str[len++] = '\''; break;
+            default:
+                // Unknown escapes are kept as written
+                str[len++] = '\\';
+                str[len++] = content[i];
+                break;
+        }
+    }
+
+    str[len] = '\0';
+    return str;
+}
+
 #undef self_t
 
 char *ast_error_to_string(AstError error) {
@@ -126,6 +172,10 @@ char *ast_error_to_string(AstError error) {
             return "expected expression, found ...";
         case AST_ERR_MISSING_SEMICOLON:
             return "missing semicolon";
+        case AST_ERR_UNEXPECTED_TOKEN:
+            return "unexpected token";
+        case AST_ERR_INVALID_TOKEN:
+            return "invalid token";
         default:
             return "unknown error";
     }
@@ -0,0 +1,536 @@
+#include "ast_check.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_util.h"
+#include "type.h"
+
+// A simple type behind `pointers` levels of `*`, which unlike `Type` needs no allocation for pointers.
+// `TypeUnknown` stands for a type which was already reported, it matches anything so that errors do not cascade.
+typedef struct check_type_s {
+    TypeTag tag;
+    uint32_t pointers;
+} CheckType;
+
+#define CHECK_TYPE(type_tag, pointer_count) ((CheckType) {.tag = (type_tag), .pointers = (pointer_count)})
+
+// A name in scope: a function and its declaration, or a variable or parameter and its type
+typedef struct check_name_s {
+    char *name;
+    AstIndex fn_decl;   // ast_index_empty for variables and parameters
+    CheckType type;
+} CheckName;
+
+typedef struct ast_check_s {
+    Ast *ast;
+    ErrorList *errors;
+
+    // Names in scope, innermost last. Leaving a scope truncates back to the size when it was entered.
+    uint32_t size;
+    uint32_t capacity;
+    CheckName *names;
+
+    // Return type of the function being checked
+    CheckType ret_type;
+} AstCheck;
+
+#define self_t AstCheck *self
+
+// SECTION: Utilities
+
+static void check_error(self_t, TokenIndex token, AstCheckError code) {
+    Token tok = self->ast->tokens.data[token];
+    error_list_add(self->errors, (CompileError) {
+        .location = {tok.loc.start, tok.loc.end},
+        .node = token,
+        .error_code = code,
+        .message = ast_check_error_to_string(code),
+    });
+}
+
+// The token to report a node at. Calls are reported at the callee rather than the paren.
+static TokenIndex node_token(self_t, AstIndex index) {
+    AstNode *node = ast_get_node(self->ast, index);
+    if (node->tag == AST_CALL || node->tag == AST_I_RETURN)
+        return node_token(self, node->data.lhs);
+    return node->main_token;
+}
+
+static void scope_add(self_t, char *owned_name, AstIndex fn_decl, CheckType type) {
+    if (self->capacity < self->size + 1) {
+        self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
+        self->names = ARRAY_GROW_TAGGED(ALLOC_TAG_SCOPE, CheckName, self->names, self->capacity);
+    }
+
+    self->names[self->size++] = (CheckName) {.name = owned_name, .fn_decl = fn_decl, .type = type};
+    TRACK_USED(self->names, self->size * sizeof(CheckName));
+}
+
+static void scope_truncate(self_t, uint32_t size) {
+    for (uint32_t i = size; i < self->size; i++)
+        free(self->names[i].name);
+    self->size = size;
+}
+
+static CheckName *scope_find(self_t, const char *name) {
+    for (uint32_t i = self->size; i > 0; i--) {
+        if (strcmp(self->names[i - 1].name, name) == 0)
+            return &self->names[i - 1];
+    }
+    return NULL;
+}
+
+static bool is_void(CheckType type) {
+    return type.tag == TY_VOID && type.pointers == 0;
+}
+
+static bool is_integer(CheckType type) {
+    return type.pointers == 0 && type.tag >= TypeI8 && type.tag <= TypeISize;
+}
+
+// The largest literal of an integer type. MIR constants hold 32 bits for now, which also bounds the wider types.
+static uint64_t integer_max(TypeTag tag) {
+    switch (tag) {
+        case TypeI8:
+            return INT8_MAX;
+        case TypeI16:
+            return INT16_MAX;
+        case TypeI32:
+            return INT32_MAX;
+        default:
+            return UINT32_MAX;
+    }
+}
+
+static bool accepts(CheckType expected, CheckType actual) {
+    if (expected.tag == TypeUnknown || actual.tag == TypeUnknown)
+        return true;
+    return expected.tag == actual.tag && expected.pointers == actual.pointers;
+}
+
+// Returns false if the type expression names a type which `type_from_name` does not know
+static bool resolve_type(self_t, AstIndex index, CheckType *type) {
+    AstNode *node = ast_get_node_tagged(self->ast, index, AST_TYPE);
+    char *name = ast_get_token_content(self->ast, node->main_token);
+
+    bool known = false;
+    if (strcmp(name, "*") == 0) {
+        known = resolve_type(self, node->data.lhs, type);
+        type->pointers++;
+    } else {
+        for (TypeTag tag = TypeI8; tag <= TypeBool && !known; tag++) {
+            known = strcmp(name, type_tag_to_string(tag)) == 0;
+            *type = CHECK_TYPE(known ? tag : TypeUnknown, 0);
+        }
+    }
+
+    free(name);
+    return known;
+}
+
+static CheckType check_type_expr(self_t, AstIndex index) {
+    CheckType type;
+    if (!resolve_type(self, index, &type)) {
+        check_error(self, ast_get_node(self->ast, index)->main_token, CHECK_ERR_UNKNOWN_TYPE);
+        return CHECK_TYPE(TypeUnknown, 0);
+    }
+    return type;
+}
+
+static AstFnProto *fn_proto(self_t, AstIndex fn_decl, AstNode **proto_node) {
+    AstNode *node = ast_get_node_tagged(self->ast, fn_decl, AST_NAMED_FN);
+    *proto_node = ast_get_node_tagged(self->ast, node->data.lhs, AST_FN_PROTO);
+    return index_list_get_sized(&self->ast->extra_data, AstFnProto, (*proto_node)->data.lhs);
+}
+
+static void report_undefined(self_t, TokenIndex token, const char *name) {
+    // HIR lowering only knows the functions declared so far
+    AstNode *module = ast_get_node_tagged(self->ast, ast_index_root, AST_MODULE);
+    for (AstIndex i = module->data.lhs; i <= module->data.rhs; i++) {
+        AstNode *decl = ast_get_node(self->ast, self->ast->extra_data.data[i]);
+        if (decl->tag != AST_NAMED_FN)
+            continue;
+
+        char *fn_name = ast_get_token_content(self->ast, decl->main_token + 1);
+        bool same = strcmp(fn_name, name) == 0;
+        free(fn_name);
+
+        if (same) {
+            check_error(self, token, CHECK_ERR_USED_BEFORE_DECL);
+            return;
+        }
+    }
+
+    check_error(self, token, CHECK_ERR_UNDEFINED_NAME);
+}
+
+
+// SECTION: Expressions
+
+static void check_expr(self_t, AstIndex index, CheckType expected);
+
+// Number literals take the expected type, which must be an integer type wide enough for them. The lexer also accepts
+// fractions, which are never an integer.
+static void check_number(self_t, TokenIndex token, CheckType expected) {
+    if (expected.tag == TypeUnknown)
+        return;
+    if (!is_integer(expected)) {
+        check_error(self, token, CHECK_ERR_MISMATCHED_TYPES);
+        return;
+    }
+
+    // Stops as soon as the value is too large, so it cannot overflow
+    char *digits = ast_get_token_content(self->ast, token);
+    uint64_t max = integer_max(expected.tag);
+    uint64_t value = 0;
+    bool fraction = false;
+    bool too_large = false;
+    for (char *c = digits; *c != '\0' && !fraction && !too_large; c++) {
+        if (*c == '.') {
+            fraction = true;
+        } else {
+            value = value * 10 + (uint64_t) (*c - '0');
+            too_large = value > max;
+        }
+    }
+    free(digits);
+
+    if (fraction)
+        check_error(self, token, CHECK_ERR_MISMATCHED_TYPES);
+    else if (too_large)
+        check_error(self, token, CHECK_ERR_INTEGER_TOO_LARGE);
+}
+
+static void check_ref(self_t, AstIndex index, CheckType expected) {
+    AstNode *node = ast_get_node_tagged(self->ast, index, AST_REF);
+    char *name = ast_get_token_content(self->ast, node->main_token);
+
+    CheckName *found = scope_find(self, name);
+    if (found == NULL) {
+        report_undefined(self, node->main_token, name);
+    } else if (found->fn_decl != ast_index_empty) {
+        check_error(self, node->main_token, CHECK_ERR_FUNCTION_VALUE);
+    } else if (!accepts(expected, found->type)) {
+        check_error(self, node->main_token, CHECK_ERR_MISMATCHED_TYPES);
+    }
+
+    free(name);
+}
+
+static void check_binary(self_t, AstIndex index, CheckType expected) {
+    AstNode *node = ast_get_node_tagged(self->ast, index, AST_BINARY);
+
+    // Only arithmetic is generated for now
+    char *op = ast_get_token_content(self->ast, node->main_token);
+    bool arithmetic = strcmp(op, "+") == 0 || strcmp(op, "-") == 0 || strcmp(op, "*") == 0 || strcmp(op, "/") == 0;
+    free(op);
+    if (!arithmetic) {
+        check_error(self, node->main_token, CHECK_ERR_UNSUPPORTED);
+        return;
+    }
+
+    // The operands have the type of the result
+    if (expected.tag != TypeUnknown && !is_integer(expected)) {
+        check_error(self, node->main_token, CHECK_ERR_MISMATCHED_TYPES);
+        expected = CHECK_TYPE(TypeUnknown, 0);
+    }
+    check_expr(self, node->data.lhs, expected);
+    check_expr(self, node->data.rhs, expected);
+}
+
+// `expected` is NULL if the result is unused
+static void check_call(self_t, AstIndex index, const CheckType *expected) {
+    AstNode *node = ast_get_node_tagged(self->ast, index, AST_CALL);
+    AstCallData call = *((AstCallData *) &self->ast->extra_data.data[node->data.rhs]);
+    uint32_t arg_count = call.arg_start == ast_index_empty ? 0 : call.arg_end - call.arg_start + 1;
+
+    // Only functions can be called, by their name
+    AstIndex fn_decl = ast_index_empty;
+    AstNode *callee = ast_get_node(self->ast, node->data.lhs);
+    if (callee->tag == AST_REF) {
+        char *name = ast_get_token_content(self->ast, callee->main_token);
+        CheckName *found = scope_find(self, name);
+        if (found == NULL)
+            report_undefined(self, callee->main_token, name);
+        else if (found->fn_decl == ast_index_empty)
+            check_error(self, callee->main_token, CHECK_ERR_NOT_CALLABLE);
+        else
+            fn_decl = found->fn_decl;
+        free(name);
+    } else {
+        check_error(self, node_token(self, node->data.lhs), CHECK_ERR_NOT_CALLABLE);
+    }
+
+    AstNode *proto_node = NULL;
+    AstFnProto *proto = fn_decl != ast_index_empty ? fn_proto(self, fn_decl, &proto_node) : NULL;
+    uint32_t param_count = 0;
+    if (proto != NULL && proto->param_start != ast_index_empty)
+        param_count = proto->param_end - proto->param_start + 1;
+    if (proto != NULL && param_count != arg_count) {
+        check_error(self, node_token(self, index), CHECK_ERR_ARGUMENT_COUNT);
+        proto = NULL;
+    }
+
+    // Arguments have the types of the parameters. Their names are checked even if the callee is not known.
+    for (uint32_t i = 0; i < arg_count; i++) {
+        CheckType param_type = CHECK_TYPE(TypeUnknown, 0);
+        if (proto != NULL) {
+            AstIndex param_index = self->ast->extra_data.data[proto->param_start + i];
+            AstNode *param = ast_get_node_tagged(self->ast, param_index, AST_FN_PARAM);
+            // The declaration already reported a missing or unknown type
+            if (param->data.rhs == ast_index_empty || !resolve_type(self, param->data.rhs, &param_type))
+                param_type = CHECK_TYPE(TypeUnknown, 0);
+        }
+        check_expr(self, self->ast->extra_data.data[call.arg_start + i], param_type);
+    }
+
+    if (proto == NULL || expected == NULL)
+        return;
+
+    CheckType ret_type = CHECK_TYPE(TY_VOID, 0);
+    if (proto_node->data.rhs != ast_index_empty && !resolve_type(self, proto_node->data.rhs, &ret_type))
+        ret_type = CHECK_TYPE(TypeUnknown, 0);
+
+    if (is_void(ret_type)) {
+        check_error(self, node_token(self, index), CHECK_ERR_VOID_VALUE);
+    } else if (!accepts(*expected, ret_type)) {
+        check_error(self, node_token(self, index), CHECK_ERR_MISMATCHED_TYPES);
+    }
+}
+
+// Literals take the expected type, so they only need to be able to have it
+static void check_expr(self_t, AstIndex index, CheckType expected) {
+    AstNode *node = ast_get_node(self->ast, index);
+    switch (node->tag) {
+        case AST_INTEGER:
+            check_number(self, node->main_token, expected);
+            break;
+        case AST_BOOL: {
+            if (!accepts(expected, CHECK_TYPE(TypeBool, 0)))
+                check_error(self, node->main_token, CHECK_ERR_MISMATCHED_TYPES);
+            break;
+        }
+        case AST_STRING: {
+            if (!accepts(expected, CHECK_TYPE(TypeI8, 1)))
+                check_error(self, node->main_token, CHECK_ERR_MISMATCHED_TYPES);
+            break;
+        }
+        case AST_REF:
+            check_ref(self, index, expected);
+            break;
+        case AST_BINARY:
+            check_binary(self, index, expected);
+            break;
+        case AST_CALL:
+            check_call(self, index, &expected);
+            break;
+        default:
+            check_error(self, node_token(self, index), CHECK_ERR_UNSUPPORTED);
+            break;
+    }
+}
+
+
+// SECTION: Statements
+
+static void check_let(self_t, AstIndex index) {
+    AstNode *node = ast_get_node_tagged(self->ast, index, AST_LET);
+
+    CheckType type = CHECK_TYPE(TypeUnknown, 0);
+    if (node->data.lhs == ast_index_empty)
+        check_error(self, node->main_token + 1, CHECK_ERR_MISSING_LET_TYPE);
+    else
+        type = check_type_expr(self, node->data.lhs);
+
+    if (node->data.rhs == ast_index_empty)
+        check_error(self, node->main_token + 1, CHECK_ERR_MISSING_LET_INIT);
+    else
+        check_expr(self, node->data.rhs, type);
+
+    // The variable is in scope after its initializer, like in MIR lowering
+    scope_add(self, ast_get_token_content(self->ast, node->main_token + 1), ast_index_empty, type);
+}
+
+static void check_return(self_t, AstIndex index) {
+    AstNode *node = ast_get_node_tagged(self->ast, index, AST_RETURN);
+
+    if (node->data.lhs == ast_index_empty) {
+        if (!is_void(self->ret_type) && self->ret_type.tag != TypeUnknown)
+            check_error(self, node->main_token, CHECK_ERR_MISSING_RETURN_VALUE);
+    } else if (is_void(self->ret_type)) {
+        check_error(self, node->main_token, CHECK_ERR_UNEXPECTED_RETURN_VALUE);
+    } else {
+        check_expr(self, node->data.lhs, self->ret_type);
+    }
+}
+
+// Returns whether the statement ends the block
+static bool check_stmt(self_t, AstIndex index) {
+    AstNode *node = ast_get_node(self->ast, index);
+    switch (node->tag) {
+        case AST_LET:
+            check_let(self, index);
+            return false;
+        case AST_RETURN:
+            check_return(self, index);
+            return true;
+        case AST_CALL:
+            check_call(self, index, NULL);
+            return false;
+        case AST_I_RETURN:
+            check_error(self, node_token(self, index), CHECK_ERR_IMPLICIT_RESULT);
+            return true;
+        case AST_BLOCK:
+        case AST_IF:
+        case AST_WHILE:
+            check_error(self, node->main_token, CHECK_ERR_UNSUPPORTED);
+            return false;
+        default:
+            check_error(self, node_token(self, index), CHECK_ERR_UNSUPPORTED_STMT);
+            return false;
+    }
+}
+
+static void check_body(self_t, AstIndex block_index, TokenIndex name_token) {
+    AstNode *block = ast_get_node_tagged(self->ast, block_index, AST_BLOCK);
+
+    bool returned = false;
+    if (block->data.lhs != ast_index_empty) {
+        for (AstIndex i = block->data.lhs; i <= block->data.rhs; i++) {
+            AstIndex stmt_index = self->ast->extra_data.data[i];
+
+            // The code generator would append to a block which already ended
+            if (returned) {
+                check_error(self, node_token(self, stmt_index), CHECK_ERR_UNREACHABLE);
+                break;
+            }
+            returned = check_stmt(self, stmt_index);
+        }
+    }
+
+    // Only a function without a return type may run off its end
+    if (!returned && !is_void(self->ret_type) && self->ret_type.tag != TypeUnknown)
+        check_error(self, name_token, CHECK_ERR_MISSING_RETURN);
+}
+
+
+// SECTION: Declarations
+
+static void check_fn(self_t, AstIndex decl_index) {
+    AstNode *node = ast_get_node_tagged(self->ast, decl_index, AST_NAMED_FN);
+    AstNode *proto_node;
+    AstFnProto *proto = fn_proto(self, decl_index, &proto_node);
+    TokenIndex name_token = node->main_token + 1;
+
+    // Every function is exported under its name
+    char *name = ast_get_token_content(self->ast, name_token);
+    if (scope_find(self, name) != NULL)
+        check_error(self, name_token, CHECK_ERR_DUPLICATE_FUNCTION);
+
+    self->ret_type = CHECK_TYPE(TY_VOID, 0);
+    if (proto_node->data.rhs != ast_index_empty)
+        self->ret_type = check_type_expr(self, proto_node->data.rhs);
+
+    // A function is in scope from its own body on
+    scope_add(self, name, decl_index, CHECK_TYPE(TypeUnknown, 0));
+
+    uint32_t scope_start = self->size;
+    if (proto->param_start != ast_index_empty) {
+        for (AstIndex i = proto->param_start; i <= proto->param_end; i++) {
+            AstNode *param = ast_get_node_tagged(self->ast, self->ast->extra_data.data[i], AST_FN_PARAM);
+
+            // Parameters share one scope, so unlike locals they cannot shadow each other
+            char *param_name = ast_get_token_content(self->ast, param->main_token);
+            CheckName *found = scope_find(self, param_name);
+            if (found != NULL && found - self->names >= scope_start)
+                check_error(self, param->main_token, CHECK_ERR_DUPLICATE_PARAM);
+
+            CheckType type = CHECK_TYPE(TypeUnknown, 0);
+            if (param->data.rhs == ast_index_empty)
+                check_error(self, param->main_token, CHECK_ERR_MISSING_PARAM_TYPE);
+            else
+                type = check_type_expr(self, param->data.rhs);
+            scope_add(self, param_name, ast_index_empty, type);
+        }
+    }
+
+    if (!(proto->flags & FN_PROTO_FOREIGN))
+        check_body(self, node->data.rhs, name_token);
+
+    scope_truncate(self, scope_start);
+}
+
+bool ast_check(Ast *ast, ErrorList *errors) {
+    AstCheck check = {.ast = ast, .errors = errors, .size = 0, .capacity = 0, .names = NULL};
+    uint32_t error_count = errors->size;
+
+    AstNode *module = ast_get_node_tagged(ast, ast_index_root, AST_MODULE);
+    if (module->data.lhs != ast_index_empty) {
+        for (AstIndex i = module->data.lhs; i <= module->data.rhs; i++) {
+            AstIndex decl_index = ast->extra_data.data[i];
+            AstNode *decl = ast_get_node(ast, decl_index);
+            if (decl->tag == AST_NAMED_FN)
+                check_fn(&check, decl_index);
+            else
+                check_error(&check, decl->main_token, CHECK_ERR_NOT_A_FUNCTION_DECL);
+        }
+    }
+
+    scope_truncate(&check, 0);
+    ARRAY_FREE(CheckName, check.names);
+    return errors->size == error_count;
+}
+
+#undef self_t
+
+char *ast_check_error_to_string(AstCheckError error) {
+    switch (error) {
+        case CHECK_ERR_UNSUPPORTED:
+            return "Not supported by the code generator yet";
+        case CHECK_ERR_NOT_A_FUNCTION_DECL:
+            return "Only functions can be declared at the top level for now";
+        case CHECK_ERR_DUPLICATE_FUNCTION:
+            return "A function with this name is already declared";
+        case CHECK_ERR_DUPLICATE_PARAM:
+            return "A parameter with this name is already declared";
+        case CHECK_ERR_UNKNOWN_TYPE:
+            return "Unknown type";
+        case CHECK_ERR_MISSING_PARAM_TYPE:
+            return "A parameter requires a type";
+        case CHECK_ERR_MISSING_LET_TYPE:
+            return "A `let` requires a type for now";
+        case CHECK_ERR_MISSING_LET_INIT:
+            return "A `let` requires an initializer for now";
+        case CHECK_ERR_UNDEFINED_NAME:
+            return "Undefined name";
+        case CHECK_ERR_USED_BEFORE_DECL:
+            return "A function must be declared before it is used";
+        case CHECK_ERR_MISMATCHED_TYPES:
+            return "Mismatched types";
+        case CHECK_ERR_INTEGER_TOO_LARGE:
+            return "The integer does not fit its type";
+        case CHECK_ERR_NOT_CALLABLE:
+            return "Only functions can be called";
+        case CHECK_ERR_FUNCTION_VALUE:
+            return "A function can only be called";
+        case CHECK_ERR_VOID_VALUE:
+            return "The function does not return a value";
+        case CHECK_ERR_ARGUMENT_COUNT:
+            return "Wrong number of arguments";
+        case CHECK_ERR_UNEXPECTED_RETURN_VALUE:
+            return "A function without a return type cannot return a value";
+        case CHECK_ERR_MISSING_RETURN_VALUE:
+            return "Missing return value";
+        case CHECK_ERR_MISSING_RETURN:
+            return "Missing return at the end of the function";
+        case CHECK_ERR_UNREACHABLE:
+            return "Unreachable statement after a return";
+        case CHECK_ERR_UNSUPPORTED_STMT:
+            return "Only `let`, `return` and calls are supported as statements";
+        case CHECK_ERR_IMPLICIT_RESULT:
+            return "A block cannot end in an expression yet, add a semicolon";
+        default:
+            return "unknown error";
+    }
+}
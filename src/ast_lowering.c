@@ -16,6 +16,8 @@ Hir ast_lower(Ast *ast) {
     return (Hir) {
         .instructions = lowering.instructions,
         .extra = lowering.extra,
+        .strings = lowering.strings,
+        .string_literals = lowering.string_literals,
         //todo errors
     };
 }
\ No newline at end of file
@@ -27,8 +27,8 @@ void ast_scope_free(self_t) {
 void ast_scope_set(self_t, StringKey name, HirIndex value) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->names = ARRAY_GROW(StringKey, self->names, self->capacity);
-        self->data = ARRAY_GROW(HirIndex, self->data, self->capacity);
+        self->names = ARRAY_GROW_TAGGED(ALLOC_TAG_SCOPE, StringKey, self->names, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_SCOPE, HirIndex, self->data, self->capacity);
     }
 
     // Replace existing
@@ -43,6 +43,8 @@ void ast_scope_set(self_t, StringKey name, HirIndex value) {
     self->names[self->size] = name;
     self->data[self->size] = value;
     self->size++;
+    TRACK_USED(self->names, self->size * sizeof(StringKey));
+    TRACK_USED(self->data, self->size * sizeof(HirIndex));
 }
 
 HirIndex *ast_scope_get(self_t, StringKey name) {
@@ -91,7 +93,7 @@ static HirIndex fill_inst(self_t, HirIndex reserved, HirInstTag tag, HirInstData
 }
 
 static void scope_push(self_t) {
-    AstScope *scope = malloc(sizeof(AstScope));
+    AstScope *scope = TRACKED_MALLOC(ALLOC_TAG_SCOPE, sizeof(AstScope));
     ast_scope_init(scope, self->scope);
     self->scope = scope;
 }
@@ -100,7 +102,7 @@ static void scope_pop(self_t) {
     AstScope *scope = self->scope;
     self->scope = scope->parent;
     ast_scope_free(scope);
-    free(scope);
+    TRACKED_FREE(scope);
 }
 
 
@@ -112,9 +114,10 @@ void ast_lowering_init(self_t, Ast *ast) {
     hir_inst_list_init(&self->instructions);
     index_list_init(&self->extra);
     string_set_init(&self->strings);
+    index_map_init(&self->string_literals);
     //todo errors
 
-    self->scope = malloc(sizeof(AstScope));
+    self->scope = TRACKED_MALLOC(ALLOC_TAG_SCOPE, sizeof(AstScope));
     ast_scope_init(self->scope, NULL);
     self->fn_ret_ty = UINT32_MAX;
 }
@@ -122,7 +125,8 @@ void ast_lowering_init(self_t, Ast *ast) {
 void ast_lowering_free(self_t) {
     assert(self->fn_ret_ty == UINT32_MAX);
     assert(self->scope->parent == NULL);
-    free(self->scope);
+    ast_scope_free(self->scope);
+    TRACKED_FREE(self->scope);
 }
 
 HirIndex ast_lower_block(self_t, AstNode *node);
@@ -132,7 +136,33 @@ HirIndex ast_lower_block(self_t, AstNode *node);
 // The implementation of lowering each ast node.
 
 HirIndex ast_lower_module(self_t, AstIndex module_index) {
-    return 0;
+    AstNode *node = ast_get_node_tagged(self->ast, module_index, AST_MODULE);
+    HirIndex result = reserve_inst(self);
+
+    // Lower each top level declaration, in source order
+    IndexList decl_indices;
+    index_list_init(&decl_indices);
+    if (node->data.lhs != ast_index_empty) {
+        for (AstIndex index = node->data.lhs; index <= node->data.rhs; index++) {
+            HirIndex decl = ast_lower_tl_decl(self, self->ast->extra_data.data[index]);
+            index_list_add(&decl_indices, decl);
+        }
+    }
+
+    // Create the module details
+    HirModule module = (HirModule) {
+        .decl_count = decl_indices.size,
+    };
+    HirIndex extra_index = index_list_add_sized(&self->extra, module);
+
+    // Add the decls to extra as required by module
+    for (size_t i = 0; i < decl_indices.size; i++)
+        add_extra(self, decl_indices.data[i]);
+    index_list_free(&decl_indices);
+
+    return fill_inst(self, result, HIR_MODULE, (HirInstData) {
+        .extra = extra_index,
+    });
 }
 
 
@@ -382,11 +412,11 @@ HirIndex ast_lower_integer(self_t, AstNode *node) {
 HirIndex ast_lower_string(self_t, AstNode *node) {
     assert(node->tag == AST_STRING);
 
-    // Intern the string without the quotes
-    char *str_bytes = ast_get_token_content(self->ast, node->main_token);
-    str_bytes[strlen(str_bytes) - 1] = '\0';
-    StringKey str = string_set_add(&self->strings, str_bytes + 1);
+    // Intern the decoded string
+    char *str_bytes = ast_get_string_literal(self->ast, node->main_token);
+    StringKey str = string_set_add(&self->strings, str_bytes);
     free(str_bytes);
+    index_map_put(&self->string_literals, node->main_token, str);
 
     return add_inst(self, HIR_STRING, (HirInstData) {
         .str_value = str
@@ -504,6 +534,7 @@ HirIndex ast_lower_block(self_t, AstNode *node) {
     for (size_t i = 0; i < stmts.size; i++) {
         add_extra(self, stmts.data[i]);
     }
+    index_list_free(&stmts);
 
     return fill_inst(self, result, HIR_BLOCK, (HirInstData) {
         .extra = data_index,
@@ -720,6 +751,7 @@ HirIndex ast_lower_type(self_t, AstIndex type_index) {
     }
 
     // Type must be a pointer, parse inner
+    free(bytes);
     HirIndex result = reserve_inst(self);
 
     HirIndex inner_type = ast_lower_type(self, node->data.lhs);
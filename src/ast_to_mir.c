@@ -18,7 +18,8 @@ void atm_scope_init(self_t, AtmScope *parent) {
 }
 
 void atm_scope_free(self_t) {
-    //todo this does free the names array, but it leaves the allocations of each string.
+    for (uint32_t i = 0; i < self->size; i++)
+        TRACKED_FREE(self->names[i]);
     ARRAY_FREE(char *, self->names);
     ARRAY_FREE(MirIndex, self->data);
     ARRAY_FREE(AtmScopeItemType, self->types);
@@ -28,9 +29,9 @@ void atm_scope_free(self_t) {
 void atm_scope_set(self_t, const char *name, MirIndex value, AtmScopeItemType type) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->names = ARRAY_GROW(char *, self->names, self->capacity);
-        self->data = ARRAY_GROW(MirIndex, self->data, self->capacity);
-        self->types = ARRAY_GROW(AtmScopeItemType, self->types, self->capacity);
+        self->names = ARRAY_GROW_TAGGED(ALLOC_TAG_SCOPE, char *, self->names, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_SCOPE, MirIndex, self->data, self->capacity);
+        self->types = ARRAY_GROW_TAGGED(ALLOC_TAG_SCOPE, AtmScopeItemType, self->types, self->capacity);
     }
 
     for (uint32_t i = 0; i < self->size; i++) {
@@ -41,10 +42,17 @@ void atm_scope_set(self_t, const char *name, MirIndex value, AtmScopeItemType ty
         }
     }
 
-    self->names[self->size] = strdup(name);
+    size_t name_len = strlen(name);
+    char *owned_name = TRACKED_MALLOC(ALLOC_TAG_SCOPE, name_len + 1);
+    memcpy(owned_name, name, name_len + 1);
+
+    self->names[self->size] = owned_name;
     self->data[self->size] = value;
     self->types[self->size] = type;
     self->size++;
+    TRACK_USED(self->names, self->size * sizeof(char *));
+    TRACK_USED(self->data, self->size * sizeof(MirIndex));
+    TRACK_USED(self->types, self->size * sizeof(AtmScopeItemType));
 }
 
 MirIndex *atm_scope_get(self_t, const char *name) {
@@ -84,7 +92,7 @@ AtmScopeItemType *atm_scope_get_type(self_t, const char *name) {
 
 // Utilities
 static inline MirIndex add_inst(self_t, MirInstTag tag, MirInstData data) {
-    mir_inst_list_add(&self->instructions, (MirInst) {tag, data});
+    mir_inst_list_add(&self->instructions, tag, data);
     return self->instructions.size - 1;
 }
 
@@ -98,15 +106,13 @@ static MirIndex reserve_inst(self_t) {
 }
 
 static MirIndex fill_inst(self_t, MirIndex reserved, MirInstTag tag, MirInstData data) {
-    MirInst *inst = mir_inst_list_get(&self->instructions, reserved);
-    assert(inst->tag == MirReserved);
-    inst->tag = tag;
-    inst->data = data;
+    assert(mir_inst_list_tag(&self->instructions, reserved) == MirReserved);
+    mir_inst_list_set(&self->instructions, reserved, tag, data);
     return reserved;
 }
 
 static void push_scope(self_t) {
-    AtmScope *scope = malloc(sizeof(AtmScope));
+    AtmScope *scope = TRACKED_MALLOC(ALLOC_TAG_SCOPE, sizeof(AtmScope));
     atm_scope_init(scope, self->scope);
     self->scope = scope;
 }
@@ -115,7 +121,7 @@ static void pop_scope(self_t) {
     AtmScope *scope = self->scope;
     self->scope = scope->parent;
     atm_scope_free(scope);
-    free(scope);
+    TRACKED_FREE(scope);
 }
 
 static AstIndex find_named_fn(self_t, const char *name) {
@@ -136,15 +142,37 @@ static AstIndex find_named_fn(self_t, const char *name) {
     return ast_index_empty;
 }
 
+// Returns the prototype of the function a call operand names, or NULL if it is not a named function in the module
+static AstFnProto *callee_proto(self_t, AstIndex operand_index) {
+    AstNode *operand = ast_get_node(self->ast, operand_index);
+    if (operand->tag != AST_REF)
+        return NULL;
+
+    // Names in scope take precedence over functions, like in `mir_lower_ref`
+    char *name = ast_get_token_content(self->ast, operand->main_token);
+    AstIndex fn_index = atm_scope_get(self->scope, name) == NULL ? find_named_fn(self, name) : ast_index_empty;
+    free(name);
+    if (fn_index == ast_index_empty)
+        return NULL;
+
+    AstNode *fn = ast_get_node_tagged(self->ast, self->ast->extra_data.data[fn_index], AST_NAMED_FN);
+    AstNode *proto = ast_get_node_tagged(self->ast, fn->data.lhs, AST_FN_PROTO);
+    AstFnProto *proto_data = index_list_get_sized(&self->ast->extra_data, AstFnProto, proto->data.lhs);
+    return proto_data->param_start != ast_index_empty ? proto_data : NULL;
+}
+
 // Public API
-void ast_to_mir_init(self_t, Ast *ast) {
+void ast_to_mir_init(self_t, Ast *ast, StringSet *strings) {
     self->ast = ast;
+    self->strings = strings;
+    self->string_literals = NULL;
 
     mir_inst_list_init(&self->instructions);
+    mir_type_pool_init(&self->types);
     index_list_init(&self->extra);
 
     // Create global scope
-    self->scope = malloc(sizeof(AtmScope));
+    self->scope = TRACKED_MALLOC(ALLOC_TAG_SCOPE, sizeof(AtmScope));
     atm_scope_init(self->scope, NULL);
 
     // Create type cache
@@ -156,7 +184,7 @@ void ast_to_mir_free(self_t) {
     index_ptr_map_free(&self->type_cache);
 
     atm_scope_free(self->scope);
-    free(self->scope);
+    TRACKED_FREE(self->scope);
 
     //todo other stuff
 }
@@ -189,13 +217,14 @@ Mir lower_ast_fn(self_t, AstIndex fn_index) {
 
     return (Mir) {
         .instructions = self->instructions,
+        .types = self->types,
         .extra = self->extra,
     };
 }
 
 // Implementation
 
-MirIndex mir_lower_stmt(self_t, AstIndex stmt_index) {
+Ref mir_lower_stmt(self_t, AstIndex stmt_index) {
     AstNode *node = ast_get_node(self->ast, stmt_index);
     assert(node != NULL);
 
@@ -207,7 +236,7 @@ MirIndex mir_lower_stmt(self_t, AstIndex stmt_index) {
     }
 }
 
-MirIndex mir_lower_let(self_t, AstIndex stmt_index) {
+Ref mir_lower_let(self_t, AstIndex stmt_index) {
     AstNode *node = ast_get_node_tagged(self->ast, stmt_index, AST_LET);
 
     // Type annotation
@@ -225,11 +254,13 @@ MirIndex mir_lower_let(self_t, AstIndex stmt_index) {
     // Placeholder for alloc instruction
     MirIndex alloc_index = reserve_inst(self);
 
-    // Initializer (must be present for now)
+    // Initializer (must be present for now). The expected type is restored afterwards, since the statements after
+    // still expect the return type.
     assert(node->data.rhs != ast_index_empty);
+    Type *old_exp_type = self->exp_type;
     self->exp_type = &type_annotation;
-    MirIndex init_index = mir_lower_expr(self, node->data.rhs);
-    self->exp_type = NULL;
+    Ref init = mir_lower_expr(self, node->data.rhs);
+    self->exp_type = old_exp_type;
 
     // Type rule as follows for now:
     // Annotation takes precedence and must be able to coerce init_type to annotated type.
@@ -249,7 +280,7 @@ MirIndex mir_lower_let(self_t, AstIndex stmt_index) {
 
     // Fill the alloc instruction now that type is determined.
     fill_inst(self, alloc_index, MirAlloc, (MirInstData) {
-        .ty = var_type
+        .ty = mir_type_pool_add(&self->types, var_type)
     });
 
     // Insert the pointer to the scope
@@ -261,11 +292,11 @@ MirIndex mir_lower_let(self_t, AstIndex stmt_index) {
     MirIndex store_index = add_inst(self, MirStore, (MirInstData) {
         .bin_op = {
             .lhs = index_to_ref(alloc_index),
-            .rhs = index_to_ref(init_index),
+            .rhs = init,
         }
     });
 
-    return store_index;
+    return index_to_ref(store_index);
 }
 
 Type mir_lower_type_expr(self_t, AstIndex index) {
@@ -279,7 +310,7 @@ Type mir_lower_type_expr(self_t, AstIndex index) {
         Type ptr_type = mir_lower_type_expr(self, node->data.lhs);
 
         //todo memory leak, this is never freed. Need to allocate these in an arena probably
-        ExtendedType *extended = malloc(sizeof(ExtendedType));
+        ExtendedType *extended = TRACKED_MALLOC(ALLOC_TAG_EXTENDED_TYPE, sizeof(ExtendedType));
         extended->tag = TY_PTR;
         extended->data.inner_type = ptr_type;
 
@@ -292,13 +323,15 @@ Type mir_lower_type_expr(self_t, AstIndex index) {
 }
 
 
-MirIndex mir_lower_expr(self_t, AstIndex expr_index) {
+Ref mir_lower_expr(self_t, AstIndex expr_index) {
     AstNode *node = ast_get_node(self->ast, expr_index);
     assert(node != NULL);
 
     switch (node->tag) {
         case AST_INTEGER:
             return mir_lower_int_const(self, expr_index);
+        case AST_BOOL:
+            return mir_lower_bool_const(self, expr_index);
         case AST_STRING:
             return mir_lower_string_const(self, expr_index);
         case AST_REF:
@@ -318,7 +351,7 @@ MirIndex mir_lower_expr(self_t, AstIndex expr_index) {
     }
 }
 
-MirIndex mir_lower_int_const(self_t, AstIndex expr_index) {
+Ref mir_lower_int_const(self_t, AstIndex expr_index) {
     AstNode *node = ast_get_node_tagged(self->ast, expr_index, AST_INTEGER);
 
     // Parse u32
@@ -335,15 +368,30 @@ MirIndex mir_lower_int_const(self_t, AstIndex expr_index) {
     if (type_tag(type) == TY_PTR)
         type = (Type) {.tag = TypeI64};
 
-    return add_inst(self, MirConstant, (MirInstData) {
+    // Small constants do not need an instruction
+    Ref known = ref_from_int(type, value);
+    if (known != __REF_LAST)
+        return known;
+
+    return index_to_ref(add_inst(self, MirConstant, (MirInstData) {
         .ty_pl = {
-            .ty = type,
+            .ty = mir_type_pool_add(&self->types, type),
             .payload = value, //todo this needs to point into values list
         }
-    });
+    }));
 }
 
-MirIndex mir_lower_string_const(self_t, AstIndex expr_index) {
+Ref mir_lower_bool_const(self_t, AstIndex expr_index) {
+    AstNode *node = ast_get_node_tagged(self->ast, expr_index, AST_BOOL);
+
+    char *str = ast_get_token_content(self->ast, node->main_token);
+    bool value = strcmp(str, "true") == 0;
+    free(str);
+
+    return value ? RefBoolTrue : RefBoolFalse;
+}
+
+Ref mir_lower_string_const(self_t, AstIndex expr_index) {
     AstNode *node = ast_get_node_tagged(self->ast, expr_index, AST_STRING);
 
     // Ensure the type is *i8
@@ -352,17 +400,27 @@ MirIndex mir_lower_string_const(self_t, AstIndex expr_index) {
     assert(type_tag(type) == TY_PTR);
     assert(type.extended->data.inner_type.tag == TypeI8);
 
-    return add_inst(self, MirConstant, (MirInstData) {
+    StringKey key;
+    if (self->string_literals != NULL) {
+        uint32_t *interned = index_map_get(self->string_literals, node->main_token);
+        assert(interned != NULL);
+        key = *interned;
+    } else {
+        char *content = ast_get_string_literal(self->ast, node->main_token);
+        key = string_set_add(self->strings, content);
+        free(content);
+    }
+
+    return index_to_ref(add_inst(self, MirConstant, (MirInstData) {
         .ty_pl = {
-            .ty = type,
-            // Payload is an index into the token list for the string literal
-            //todo add values array
-            .payload = node->main_token,
+            .ty = mir_type_pool_add(&self->types, type),
+            // Payload is the interned content of the string literal
+            .payload = key,
         }
-    });
+    }));
 }
 
-MirIndex mir_lower_ref(self_t, AstIndex expr_index) {
+Ref mir_lower_ref(self_t, AstIndex expr_index) {
     AstNode *node = ast_get_node_tagged(self->ast, expr_index, AST_REF);
 
     // Lookup name in scope
@@ -373,11 +431,13 @@ MirIndex mir_lower_ref(self_t, AstIndex expr_index) {
         // Not found in scope, check if it is a named function
         AstIndex fn_index = find_named_fn(self, name);
         if (fn_index != ast_index_empty) {
-            //todo adding the name here is really hacky and a memory leak currently.
-            // Should reference the decl index in the module or something.
-            return add_inst(self, MirFnPtr, (MirInstData) {
-                .fn_ptr = name,
-            });
+            free(name);
+
+            // Module decls are extracted in source order, so the position in the module is the decl index.
+            AstNode *module = ast_get_node_tagged(self->ast, ast_index_root, AST_MODULE);
+            return index_to_ref(add_inst(self, MirFnPtr, (MirInstData) {
+                .fn_decl = fn_index - module->data.lhs,
+            }));
         }
 
         // Not a named function, not sure what it is
@@ -391,13 +451,13 @@ MirIndex mir_lower_ref(self_t, AstIndex expr_index) {
     switch (type) {
         case AtmScopeItemTypeVar: {
             free(name);
-            return add_inst(self, MirLoad, (MirInstData) {
+            return index_to_ref(add_inst(self, MirLoad, (MirInstData) {
                 .un_op = index_to_ref(*index)
-            });
+            }));
         }
         case AtmScopeItemTypeArg: {
             free(name);
-            return *index;
+            return index_to_ref(*index);
 //            return index_to_ref(*index);
 //            return add_inst(self, MirLoad, (MirInstData) {
 //                .un_op = index_to_ref(*index)
@@ -411,7 +471,7 @@ MirIndex mir_lower_ref(self_t, AstIndex expr_index) {
     }
 }
 
-MirIndex mir_lower_bin_op(self_t, AstIndex expr_index) {
+Ref mir_lower_bin_op(self_t, AstIndex expr_index) {
     AstNode *node = ast_get_node_tagged(self->ast, expr_index, AST_BINARY);
 
     // Determine the operation
@@ -470,36 +530,49 @@ MirIndex mir_lower_bin_op(self_t, AstIndex expr_index) {
     self->exp_type = &operand_type;
 
     // Lower lhs/rhs
-    Ref lhs = index_to_ref(mir_lower_expr(self, node->data.lhs));
-    Ref rhs = index_to_ref(mir_lower_expr(self, node->data.rhs));
+    Ref lhs = mir_lower_expr(self, node->data.lhs);
+    Ref rhs = mir_lower_expr(self, node->data.rhs);
 
     // Cleanup
     self->exp_type = old_exp_type;
 
-    return add_inst(self, op_tag, (MirInstData) {
+    return index_to_ref(add_inst(self, op_tag, (MirInstData) {
         .bin_op = {lhs, rhs}
-    });
+    }));
 }
 
-MirIndex mir_lower_call(self_t, AstIndex expr_index) {
+Ref mir_lower_call(self_t, AstIndex expr_index) {
     AstNode *node = ast_get_node_tagged(self->ast, expr_index, AST_CALL);
 
     // Lower the operand
-    Ref operand = index_to_ref(mir_lower_expr(self, node->data.lhs));
+    Ref operand = mir_lower_expr(self, node->data.lhs);
     //todo type checking here. How to ensure ref resolves to a function pointer?
 
     // Lower params
     AstCallData call_data = *((AstCallData *) &self->ast->extra_data.data[node->data.rhs]);
 
+    // A named function gives its parameter types as the expected types of the args
+    AstFnProto *callee = callee_proto(self, node->data.lhs);
+
     IndexList arg_indices;
     index_list_init(&arg_indices);
 
+    Type *old_exp_type = self->exp_type;
     if (call_data.arg_start != ast_index_empty) {
         for (AstIndex arg_index = call_data.arg_start; arg_index <= call_data.arg_end; arg_index++) {
-            //todo setup expected types here
-            //todo cannot easily do that in this pass, as we do not yet know types.
-            Ref lowered_arg = index_to_ref(mir_lower_expr(self, self->ast->extra_data.data[arg_index]));
+            //todo other callees cannot set up expected types in this pass, as we do not yet know types.
+            Type param_ty;
+            uint32_t param = arg_index - call_data.arg_start;
+            if (callee != NULL && callee->param_start + param <= callee->param_end) {
+                AstIndex param_index = self->ast->extra_data.data[callee->param_start + param];
+                AstNode *param_node = ast_get_node_tagged(self->ast, param_index, AST_FN_PARAM);
+                param_ty = mir_lower_type_expr(self, param_node->data.rhs);
+                self->exp_type = &param_ty;
+            }
+
+            Ref lowered_arg = mir_lower_expr(self, self->ast->extra_data.data[arg_index]);
             index_list_add(&arg_indices, lowered_arg);
+            self->exp_type = old_exp_type;
         }
     }
 
@@ -510,12 +583,12 @@ MirIndex mir_lower_call(self_t, AstIndex expr_index) {
     }
 
     // Insert call
-    return add_inst(self, MirCall, (MirInstData) {
+    return index_to_ref(add_inst(self, MirCall, (MirInstData) {
         .pl_op = {
             .payload = data_index,
             .operand = operand,
         }
-    });
+    }));
 }
 
 MirIndex mir_lower_block(self_t, AstIndex block_index, AstFnProto *proto_data) {
@@ -549,7 +622,7 @@ MirIndex mir_lower_block(self_t, AstIndex block_index, AstFnProto *proto_data) {
                 // Create the `arg` node.
                 AstIndex arg_index = add_inst(self, MirArg, (MirInstData) {
                     .ty_pl = {
-                        .ty = param_ty,
+                        .ty = mir_type_pool_add(&self->types, param_ty),
                         .payload = i - proto_data->param_start,
                     }
                 });
@@ -565,9 +638,11 @@ MirIndex mir_lower_block(self_t, AstIndex block_index, AstFnProto *proto_data) {
     // Append block instructions
     for (uint32_t index = block->data.lhs; index <= block->data.rhs; index++) {
         AstIndex ast_index = self->ast->extra_data.data[index];
-        MirIndex inst_index = mir_lower_stmt(self, ast_index);
+        Ref stmt = mir_lower_stmt(self, ast_index);
 
-        index_list_add(&insts, inst_index);
+        // A well known ref has no effect as a statement
+        if (stmt > __REF_LAST)
+            index_list_add(&insts, ref_to_index(stmt));
     }
 
     // Copy instructions to extra data
@@ -575,6 +650,7 @@ MirIndex mir_lower_block(self_t, AstIndex block_index, AstFnProto *proto_data) {
     for (uint32_t i = 0; i < insts.size; i++) {
         add_extra(self, *index_list_get(&insts, i));
     }
+    index_list_free(&insts);
 
     // Cleanup
     pop_scope(self);
@@ -586,20 +662,20 @@ MirIndex mir_lower_block(self_t, AstIndex block_index, AstFnProto *proto_data) {
     });
 }
 
-MirIndex mir_lower_return(self_t, AstIndex ret_index) {
+Ref mir_lower_return(self_t, AstIndex ret_index) {
     AstNode *ret = ast_get_node_tagged(self->ast, ret_index, AST_RETURN);
 
     if (ret->data.lhs == ast_index_empty) {
-        return add_inst(self, MirRet, (MirInstData) {
-            .un_op = RefZero,
-        });
+        return index_to_ref(add_inst(self, MirRet, (MirInstData) {
+            .un_op = RefVoidValue,
+        }));
     }
 
-    MirIndex expr_index = mir_lower_expr(self, ret->data.lhs);
+    Ref value = mir_lower_expr(self, ret->data.lhs);
 
-    return add_inst(self, MirRet, (MirInstData) {
-        .un_op = index_to_ref(expr_index),
-    });
+    return index_to_ref(add_inst(self, MirRet, (MirInstData) {
+        .un_op = value,
+    }));
 }
 
 
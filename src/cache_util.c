@@ -0,0 +1,81 @@
+#include "cache_util.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FNV_PRIME 0x100000001b3ULL
+
+uint64_t cache_hash(uint64_t hash, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+char *cache_read_file(const char *path, size_t *len) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    size_t capacity = 4096;
+    char *data = malloc(capacity);
+    *len = 0;
+    size_t read;
+    while ((read = fread(data + *len, 1, capacity - *len - 1, file)) > 0) {
+        *len += read;
+        if (capacity - *len == 1) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    data[*len] = '\0';
+
+    bool failed = ferror(file);
+    fclose(file);
+    if (failed) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// Numbers the temporary files of a process, whose threads may write the same path at once (eg `acorn build`)
+static atomic_uint cache_write_count = 0;
+
+bool cache_write_file(const char *path, const char *data, size_t len) {
+    size_t tmp_len = strlen(path) + 48;
+    char *tmp_path = malloc(tmp_len);
+    snprintf(tmp_path, tmp_len, "%s.%d.%u.tmp", path, (int) getpid(), atomic_fetch_add(&cache_write_count, 1));
+
+    FILE *file = fopen(tmp_path, "wb");
+    bool result = file != NULL;
+    if (result) {
+        result = fwrite(data, 1, len, file) == len;
+        result = fclose(file) == 0 && result;
+    }
+    if (result)
+        result = rename(tmp_path, path) == 0;
+    if (!result) {
+        fprintf(stderr, "Could not write cache file %s: %s\n", path, strerror(errno));
+        unlink(tmp_path);
+    }
+
+    free(tmp_path);
+    return result;
+}
+
+bool cache_copy_file(const char *from, const char *to) {
+    size_t len;
+    char *data = cache_read_file(from, &len);
+    if (data == NULL)
+        return false;
+
+    bool result = cache_write_file(to, data, len);
+    free(data);
+    return result;
+}
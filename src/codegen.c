@@ -1,19 +1,18 @@
 #include <stdlib.h>
 #include "codegen.h"
-#include <llvm-c/Target.h>
-#include <llvm-c/TargetMachine.h>
+#include <llvm-c/BitWriter.h>
 #include <string.h>
-#include <unistd.h>
 
 #include "module.h"
+#include "time_report.h"
 
 //todo put me a better place, it is duplicated from mir_debug.c
 #define mir_get_inst(mir, index) mir_inst_list_get(&(mir)->instructions, (index))
 #define mir_get_extra(mir, index) *index_list_get(&(mir)->extra, (index))
 
-static inline MirInst *mir_get_inst_tagged(Mir *mir, MirIndex index, MirInstTag tag) {
-    MirInst *inst = mir_get_inst(mir, index);
-    assert(inst->tag == tag);
+static inline MirInst mir_get_inst_tagged(Mir *mir, MirIndex index, MirInstTag tag) {
+    MirInst inst = mir_get_inst(mir, index);
+    assert(inst.tag == tag);
     return inst;
 }
 
@@ -21,14 +20,24 @@ static inline MirInst *mir_get_inst_tagged(Mir *mir, MirIndex index, MirInstTag
 
 #define llvm_int LLVMInt64TypeInContext(self->ll_context)
 
-void codegen_init(self_t, Module *module) {
+void codegen_init(self_t, Module *module, const CodegenOptions *options) {
     assert(module != NULL);
     self->module = module;
+    self->options = options;
 
-    self->ll_context = LLVMContextCreate();
+    self->owns_context = module->shared_context == NULL;
+    self->ll_ts_context = self->owns_context ? LLVMOrcCreateNewThreadSafeContext() : module->shared_context;
+    self->ll_context = LLVMOrcThreadSafeContextGetContext(self->ll_ts_context);
     self->ll_module = LLVMModuleCreateWithNameInContext(module->name, self->ll_context);
     self->ll_builder = LLVMCreateBuilderInContext(self->ll_context);
 
+    index_list_init(&self->decls);
+    self->cached = false;
+    index_ptr_map_init(&self->string_pool);
+    self->fn_types = calloc(module->decls.size, sizeof(LLVMTypeRef));
+    memset(self->types, 0, sizeof(self->types));
+    memset(self->ptr_types, 0, sizeof(self->ptr_types));
+
     self->curr_fn = NULL;
     index_ptr_map_init(&self->inst_map);
 }
@@ -37,11 +46,19 @@ void codegen_free(self_t) {
 
     LLVMDisposeBuilder(self->ll_builder);
     self->ll_builder = NULL;
-    LLVMDisposeModule(self->ll_module);
+    if (self->ll_module != NULL)
+        LLVMDisposeModule(self->ll_module);
     self->ll_module = NULL;
-    LLVMContextDispose(self->ll_context);
+    // The context itself is reference counted by ORC, any module still held by a JIT keeps it alive.
+    if (self->owns_context)
+        LLVMOrcDisposeThreadSafeContext(self->ll_ts_context);
+    self->ll_ts_context = NULL;
     self->ll_context = NULL;
 
+    index_list_free(&self->decls);
+    index_ptr_map_free(&self->string_pool);
+    free(self->fn_types);
+    self->fn_types = NULL;
     self->module = NULL;
 }
 
@@ -56,156 +73,150 @@ bool codegen_write_to_file(self_t, char *path) {
     return !has_error;
 }
 
-bool codegen_write_to_obj_file(self_t, char *path) {
+bool codegen_write_to_bc_file(self_t, char *path) {
+    if (LLVMWriteBitcodeToFile(self->ll_module, path) != 0) {
+        fprintf(stderr, "Error writing bitcode file: %s\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+// Emits machine code to a buffer, which the caller disposes.
+static LLVMMemoryBufferRef codegen_emit_machine_code(self_t, const char *name, LLVMCodeGenFileType type) {
+    LLVMTargetMachineRef machine = codegen_target_machine(self->options);
+    if (machine == NULL)
+        return NULL;
+
     char *errors = NULL;
+    LLVMMemoryBufferRef buffer = NULL;
+    if (LLVMTargetMachineEmitToMemoryBuffer(machine, self->ll_module, type, &errors, &buffer)) {
+        fprintf(stderr, "Error emitting %s: %s\n", name, errors);
+        LLVMDisposeMessage(errors);
+        return NULL;
+    }
+    return buffer;
+}
+
+// Emits machine code to memory, then writes the whole buffer with a single write.
+static bool codegen_write_machine_file(self_t, char *path, LLVMCodeGenFileType type) {
+    LLVMMemoryBufferRef buffer = codegen_emit_machine_code(self, path, type);
+    if (buffer == NULL)
+        return false;
+
+    const char *data = LLVMGetBufferStart(buffer);
+    size_t size = LLVMGetBufferSize(buffer);
 
-    LLVMInitializeAllTargetInfos();
-    LLVMInitializeAllTargets();
-    LLVMInitializeAllTargetMCs();
-    LLVMInitializeAllAsmParsers();
-    LLVMInitializeAllAsmPrinters();
-
-    LLVMTargetRef target;
-    bool has_error = LLVMGetTargetFromTriple(LLVMGetDefaultTargetTriple(), &target, &errors);
-    if (has_error) printf("error: %s\n", errors);
-    LLVMDisposeMessage(errors);
-    LLVMTargetMachineRef machine = LLVMCreateTargetMachine(target, LLVMGetDefaultTargetTriple(), "generic", LLVMGetHostCPUFeatures(), LLVMCodeGenLevelDefault, LLVMRelocDefault, LLVMCodeModelDefault);
-
-    LLVMSetTarget(self->ll_module, LLVMGetDefaultTargetTriple());
-    LLVMTargetDataRef datalayout = LLVMCreateTargetDataLayout(machine);
-    char* datalayout_str = LLVMCopyStringRepOfTargetData(datalayout);
-    LLVMSetDataLayout(self->ll_module, datalayout_str);
-    LLVMDisposeMessage(datalayout_str);
-
-    has_error = LLVMTargetMachineEmitToFile(machine, self->ll_module, path, LLVMObjectFile, &errors);
-    if (has_error) printf("error: %s\n", errors);
-    LLVMDisposeMessage(errors);
-
-    // Strip .acorn.o from path
-    char *path2 = strdup(path);
-    char *dot_acorn = strstr(path2, ".acorn");
-    if (dot_acorn) {
-        *dot_acorn = '\0';
+    bool result = false;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file: %s\n", path);
+    } else {
+        result = fwrite(data, 1, size, file) == size;
+        result = fclose(file) == 0 && result;
+        if (!result)
+            fprintf(stderr, "Could not write file: %s\n", path);
     }
 
-    int exit_code = execl("/usr/bin/cc", "cc", path, "-lc", "-o", path2, NULL);
-    free(path2);
+    LLVMDisposeMemoryBuffer(buffer);
+    return result;
+}
+
+bool codegen_write_to_asm_file(self_t, char *path) {
+    return codegen_write_machine_file(self, path, LLVMAssemblyFile);
+}
 
-    if (exit_code != 0) {
-        printf("cc finished with non-zero exit code: %d\n", exit_code);
+bool codegen_write_to_obj_file(self_t, char *path) {
+    return codegen_write_machine_file(self, path, LLVMObjectFile);
+}
+
+bool codegen_write_to_obj_memory(self_t, char **data, size_t *size) {
+    LLVMMemoryBufferRef buffer = codegen_emit_machine_code(self, self->module->name, LLVMObjectFile);
+    if (buffer == NULL)
         return false;
-    }
 
+    *size = LLVMGetBufferSize(buffer);
+    *data = malloc(*size);
+    memcpy(*data, LLVMGetBufferStart(buffer), *size);
+    LLVMDisposeMemoryBuffer(buffer);
     return true;
 }
 
+// Looked up by name rather than cached on the decl, since each unit has its own copy of the function.
+// Decls defined in another unit are left as external declarations.
 static LLVMValueRef codegen_get_decl_ll_value(self_t, Decl *decl) {
-    if (decl->llvm_value == NULL) {
+    char *name = module_decl_name(self->module, decl);
+    LLVMValueRef fn = LLVMGetNamedFunction(self->ll_module, name);
+    if (fn == NULL) {
         LLVMTypeRef fn_type = codegen_fn_proto(self, decl);
-        decl->llvm_value = LLVMAddFunction(self->ll_module, decl->name, fn_type);
-        decl->state = DeclStateReferenced;
+        fn = LLVMAddFunction(self->ll_module, name, fn_type);
     }
 
-    return decl->llvm_value;
+    return fn;
 }
 
 void codegen_lower_decl(self_t, Decl *decl) {
     assert(decl != NULL);
+    TimeSpan span = time_phase_begin(TIME_PHASE_LLVM_IR);
 
     LLVMValueRef fn = codegen_get_decl_ll_value(self, decl);
     self->curr_fn = &fn;
 
-    if (strcmp(decl->name, "puts") != 0) {
-        Mir *mir = decl_get_mir_in_module(decl, self->module);
-        self->mir = mir;
-        index_ptr_map_init(&self->inst_map);
+    // Foreign decls are already generated, so only decls with a body are ever lowered.
+    Mir *mir = decl_get_mir_in_module(decl, self->module);
+    self->mir = mir;
+    index_ptr_map_init(&self->inst_map);
 
-        LLVMBasicBlockRef entry_block = LLVMAppendBasicBlock(fn, "entry");
-        LLVMPositionBuilderAtEnd(self->ll_builder, entry_block);
+    LLVMBasicBlockRef entry_block = LLVMAppendBasicBlockInContext(self->ll_context, fn, "entry");
+    LLVMPositionBuilderAtEnd(self->ll_builder, entry_block);
 
-        codegen_block_direct(self, 0, entry_block);
-    }
+    codegen_block_direct(self, 0, entry_block);
+
+    // A function without a return type may end without a `return`
+    if (LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(self->ll_builder)) == NULL &&
+        LLVMGetTypeKind(LLVMGetReturnType(LLVMGlobalGetValueType(fn))) == LLVMVoidTypeKind)
+        LLVMBuildRetVoid(self->ll_builder);
 
     decl->state = DeclStateGenerated;
+    time_phase_end_detail(&span, module_decl_name(self->module, decl), mir->instructions.size);
 
     index_ptr_map_free(&self->inst_map);
     self->mir = NULL;
     self->curr_fn = NULL;
 }
 
-// Returns a string containing the content of the token at the given index.
-// The caller owns the string memory.
-static char *codegen_get_ast_token_content(self_t, TokenIndex token) {
-    Token main_token = self->module->ast->tokens.data[token];
-    size_t str_len = main_token.loc.end - main_token.loc.start;
-    char *str = malloc(str_len + 1);
-    memcpy(str, (const void *) main_token.loc.start, str_len);
-    str[str_len] = '\0';
-    return str;
-}
-
-static Type codegen_get_type_from_ast(self_t, AstIndex index) {
-    AstNode *node = ast_get_node_tagged(self->module->ast, index, AST_TYPE);
-
-    char *name = codegen_get_ast_token_content(self, node->main_token);
-    if (strcmp(name, "*") == 0) {
-        free(name);
-
-        // Pointer type
-        Type ptr_type = codegen_get_type_from_ast(self, node->data.lhs);
-
-        //todo memory leak, this is never freed. Need to allocate these in an arena probably
-        ExtendedType *extended = malloc(sizeof(ExtendedType));
-        extended->tag = TY_PTR;
-        extended->data.inner_type = ptr_type;
-
-        return (Type) {.extended = extended};
-    }
-
-    Type ty = type_from_name(name);
-    free(name);
-    return ty;
-}
-
 LLVMTypeRef codegen_fn_proto(self_t, Decl *decl) {
-    AstNode *fn_ast = ast_get_node_tagged(self->module->ast, decl->ast_index, AST_NAMED_FN);
-    AstNode *proto_ast = ast_get_node_tagged(self->module->ast, fn_ast->data.lhs, AST_FN_PROTO);
-    AstFnProto proto = *((AstFnProto *) &self->module->ast->extra_data.data[proto_ast->data.lhs]);
+    DeclIndex decl_index = (DeclIndex) (decl - self->module->decls.data);
+    if (self->fn_types[decl_index] != NULL)
+        return self->fn_types[decl_index];
+
+    DeclFnData *fn_data = decl->data.fn_data;
 
-    size_t param_count = 0;
     LLVMTypeRef *params = NULL;
-    if (proto.param_start != ast_index_empty) {
-        param_count = proto.param_end - proto.param_start + 1;
-        params = malloc(sizeof(LLVMTypeRef) * param_count);
-        for (int32_t i = 0; i < param_count; i++) {
-            AstNode *param_node = ast_get_node_tagged(self->module->ast, self->module->ast->extra_data.data[proto.param_start + i], AST_FN_PARAM);
-            Type ty = codegen_get_type_from_ast(self, param_node->data.rhs);
-            LLVMTypeRef param_type = codegen_type_to_llvm(self, ty);
-
-            params[i] = param_type;
+    if (fn_data->param_count != 0) {
+        params = malloc(sizeof(LLVMTypeRef) * fn_data->param_count);
+        for (uint32_t i = 0; i < fn_data->param_count; i++) {
+            params[i] = codegen_type_to_llvm(self, fn_data->param_types[i]);
         }
     }
 
-    // Get return type
-    AstNode *ret_ast = ast_get_node_tagged(self->module->ast, proto_ast->data.rhs, AST_TYPE);
-    char *type_str = codegen_get_ast_token_content(self, ret_ast->main_token);
-    LLVMTypeRef ret_type = codegen_type_to_llvm(self, type_from_name(type_str));
-    free(type_str);
-
-    // Create LLVM type
-    LLVMTypeRef fn_type = LLVMFunctionType(ret_type, params, param_count, false);
+    LLVMTypeRef ret_type = codegen_type_to_llvm(self, fn_data->ret_type);
+    LLVMTypeRef fn_type = LLVMFunctionType(ret_type, params, fn_data->param_count, false);
 
-    // Cleanup
     if (params != NULL) {
         free(params);
     }
 
+    self->fn_types[decl_index] = fn_type;
     return fn_type;
 }
 
-
-LLVMTypeRef codegen_type_to_llvm(self_t, Type type) {
-    switch (type_tag(type)) {
+static LLVMTypeRef codegen_simple_type_to_llvm(self_t, TypeTag tag) {
+    switch (tag) {
+        case TY_VOID:
+            return LLVMVoidTypeInContext(self->ll_context);
+        case TypeBool:
+            return LLVMInt1TypeInContext(self->ll_context);
         case TypeI8:
             return LLVMInt8TypeInContext(self->ll_context);
         case TypeI16:
@@ -213,16 +224,38 @@ LLVMTypeRef codegen_type_to_llvm(self_t, Type type) {
         case TypeI32:
             return LLVMInt32TypeInContext(self->ll_context);
         case TypeI64:
+        case TypeISize:
             return LLVMInt64TypeInContext(self->ll_context);
         case TypeI128:
             return LLVMInt128TypeInContext(self->ll_context);
-        case TY_PTR:
-            return LLVMPointerType(codegen_type_to_llvm(self, type.extended->data.inner_type), 0);
+        case TypeF32:
+            return LLVMFloatTypeInContext(self->ll_context);
+        case TypeF64:
+            return LLVMDoubleTypeInContext(self->ll_context);
         default:
             assert(false);
     }
 }
 
+LLVMTypeRef codegen_type_to_llvm(self_t, Type type) {
+    if (!type_is_extended(type)) {
+        if (self->types[type.tag] == NULL)
+            self->types[type.tag] = codegen_simple_type_to_llvm(self, type.tag);
+        return self->types[type.tag];
+    }
+
+    assert(type.extended->tag == TY_PTR);
+    Type inner = type.extended->data.inner_type;
+    if (type_is_extended(inner)) {
+        // Pointers to pointers are rare enough that they are not worth memoizing
+        return LLVMPointerType(codegen_type_to_llvm(self, inner), 0);
+    }
+
+    if (self->ptr_types[inner.tag] == NULL)
+        self->ptr_types[inner.tag] = LLVMPointerType(codegen_type_to_llvm(self, inner), 0);
+    return self->ptr_types[inner.tag];
+}
+
 
 LLVMValueRef codegen_inst(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
     LLVMValueRef *ll_inst = (LLVMValueRef *) index_ptr_map_get(&self->inst_map, index);
@@ -230,9 +263,9 @@ LLVMValueRef codegen_inst(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
         return *ll_inst;
     }
 
-    MirInst *inst = mir_get_inst(self->mir, index);
+    MirInst inst = mir_get_inst(self->mir, index);
     LLVMValueRef ll_value;
-    switch (inst->tag) {
+    switch (inst.tag) {
         case MirConstant: {
             ll_value = codegen_constant(self, index, ll_block);
             break;
@@ -273,7 +306,7 @@ LLVMValueRef codegen_inst(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
             break;
         }
         case MirRet: {
-            codegen_return(self, inst, ll_block);
+            codegen_return(self, &inst, ll_block);
             return NULL;
         }
         case MirReserved: {
@@ -281,7 +314,7 @@ LLVMValueRef codegen_inst(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
             assert(false);
         }
         default: {
-            printf("Unhandled tag for codegen: %s\n", mir_tag_to_string(inst->tag));
+            printf("Unhandled tag for codegen: %s\n", mir_tag_to_string(inst.tag));
             assert(false);
         }
     }
@@ -291,119 +324,125 @@ LLVMValueRef codegen_inst(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
     return ll_value;
 }
 
+LLVMValueRef codegen_ref(self_t, Ref ref, LLVMTypeRef ll_type, LLVMBasicBlockRef ll_block) {
+    if (ref > __REF_LAST)
+        return codegen_inst(self, ref_to_index(ref), ll_block);
+
+    TypeTag tag = ref_value_type(ref);
+    if (tag != TypeUnknown)
+        ll_type = codegen_type_to_llvm(self, (Type) {.tag = tag});
+    if (ll_type == NULL || tag == TY_VOID || ref_is_type(ref) || ref == RefNone) {
+        fprintf(stderr, "Cannot use @ref.%s as a value here\n", ref_to_string(ref));
+        assert(false);
+    }
+
+    return LLVMConstInt(ll_type, ref_int_value(ref), false);
+}
+
+// Returns a pointer to the string, creating the global the first time the content is used in this unit.
+// Globals are private, null terminated and unnamed_addr, so LLVM places them in a mergeable string section and
+// the linker can deduplicate them across units.
+static LLVMValueRef codegen_string_literal(self_t, StringKey key) {
+    LLVMValueRef *cached = (LLVMValueRef *) index_ptr_map_get(&self->string_pool, key);
+    if (cached != NULL && *cached != NULL)
+        return *cached;
+
+    char *content = string_set_get(&self->module->hir->strings, key);
+    uint32_t len = (uint32_t) strlen(content);
+
+    LLVMTypeRef str_type = LLVMArrayType(LLVMInt8TypeInContext(self->ll_context), len + 1);
+    LLVMValueRef str_global = LLVMAddGlobal(self->ll_module, str_type, ".str");
+    LLVMSetInitializer(str_global, LLVMConstStringInContext(self->ll_context, content, len, false));
+    LLVMSetGlobalConstant(str_global, true);
+    LLVMSetLinkage(str_global, LLVMPrivateLinkage);
+    LLVMSetUnnamedAddress(str_global, LLVMGlobalUnnamedAddr);
+    LLVMSetAlignment(str_global, 1);
+
+    // Pointer to the first character, as a constant so it can be shared by every use
+    LLVMValueRef zero = LLVMConstInt(LLVMInt64TypeInContext(self->ll_context), 0, false);
+    LLVMValueRef indices[2] = {zero, zero};
+    LLVMValueRef str_ptr = LLVMConstInBoundsGEP2(str_type, str_global, indices, 2);
+
+    index_ptr_map_put(&self->string_pool, key, (size_t) str_ptr);
+    return str_ptr;
+}
+
 LLVMValueRef codegen_constant(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
-    MirInst *inst = mir_get_inst(self->mir, index);
-    Type const_ty = inst->data.ty_pl.ty;
+    MirInst inst = mir_get_inst(self->mir, index);
+    Type const_ty = mir_get_type(self->mir, inst.data.ty_pl.ty);
 
     // Cannot codegen non int/ptr constants
     assert(type_is_integer(const_ty));
 
     // If it not a pointer, its an int.
     if (type_tag(const_ty) != TY_PTR) {
-        LLVMTypeRef ll_type = codegen_type_to_llvm(self, inst->data.ty_pl.ty);
-        return LLVMConstInt(ll_type, inst->data.ty_pl.payload, false);
+        LLVMTypeRef ll_type = codegen_type_to_llvm(self, const_ty);
+        return LLVMConstInt(ll_type, inst.data.ty_pl.payload, false);
     }
 
     // It's a pointer, we only support *i8, which means its a const string. for now
-    //todo lots of bad assumptions
     assert(type_tag(const_ty.extended->data.inner_type) == TypeI8);
 
-    // Add the string and related instructions
-    char *str_content_raw = codegen_get_ast_token_content(self, inst->data.ty_pl.payload);
-    char *str_content = malloc(strlen(str_content_raw) - 1);
-    strncpy(str_content, str_content_raw + 1, strlen(str_content_raw) - 2);
-    str_content[strlen(str_content_raw) - 2] = '\0';
-    free(str_content_raw);
-    LLVMTypeRef str_type = LLVMArrayType(LLVMInt8Type(), strlen(str_content));
-    LLVMValueRef str_global = LLVMAddGlobal(self->ll_module, str_type, "const_string");
-    LLVMSetInitializer(str_global, LLVMConstString(str_content, strlen(str_content), false));
-    LLVMSetGlobalConstant(str_global, true);
-    LLVMSetLinkage(str_global, LLVMPrivateLinkage);
-    LLVMSetUnnamedAddress(str_global, LLVMGlobalUnnamedAddr);
-    LLVMSetAlignment(str_global, 1);
-    free(str_content);
-
-    //todo not sure what below does
-    LLVMValueRef zeroIndex = LLVMConstInt( LLVMInt64Type(), 0, true );
-    LLVMValueRef indexes[2] = { zeroIndex, zeroIndex };
-    LLVMValueRef gep = LLVMBuildInBoundsGEP2(self->ll_builder, str_type, str_global, indexes, 2, "gep");
-
-    return gep;
-
-
-//todo some yoinked stack overflow code for string literals
-//LLVMValueRef defineStringLiteral( const char *sourceString, size_t size ) {
-//    LLVMTypeRef strType = LLVMArrayType( LLVMInt8Type(), size );
-//    LLVMValueRef str = LLVMAddGlobal(module->getLLVMModule(), strType, "");
-//    LLVMSetInitializer(str, LLVMConstString( sourceString, size, true ));
-//    LLVMSetGlobalConstant(str, true);
-//    LLVMSetLinkage(str, LLVMPrivateLinkage);
-//    LLVMSetUnnamedAddress(str, LLVMGlobalUnnamedAddr);
-//    LLVMSetAlignment(str, 1);
-//
-//
-//    LLVMValueRef zeroIndex = LLVMConstInt( LLVMInt64Type(), 0, true );
-//    LLVMValueRef indexes[2] = { zeroIndex, zeroIndex };
-//
-//    LLVMValueRef gep = LLVMBuildInBoundsGEP2(builder, strType, str, indexes, 2, "");
-//
-//    return gep;
-//}
-
-
-    assert(false);
+    return codegen_string_literal(self, inst.data.ty_pl.payload);
 }
 
 LLVMValueRef codegen_binary_op(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
-    MirInst *inst = mir_get_inst(self->mir, index);
+    MirInst inst = mir_get_inst(self->mir, index);
 
-    LLVMValueRef lhs = codegen_inst(self, ref_to_index(inst->data.bin_op.lhs), ll_block);
-    LLVMValueRef rhs = codegen_inst(self, ref_to_index(inst->data.bin_op.rhs), ll_block);
+    // An untyped lhs takes the type of rhs. Constants emit no code, so evaluating rhs first keeps the order.
+    LLVMValueRef lhs, rhs;
+    if (inst.data.bin_op.lhs == RefZero || inst.data.bin_op.lhs == RefOne) {
+        rhs = codegen_ref(self, inst.data.bin_op.rhs, NULL, ll_block);
+        lhs = codegen_ref(self, inst.data.bin_op.lhs, LLVMTypeOf(rhs), ll_block);
+    } else {
+        lhs = codegen_ref(self, inst.data.bin_op.lhs, NULL, ll_block);
+        rhs = codegen_ref(self, inst.data.bin_op.rhs, LLVMTypeOf(lhs), ll_block);
+    }
 
-    if (inst->tag == MirAdd) {
+    if (inst.tag == MirAdd) {
         return LLVMBuildAdd(self->ll_builder, lhs, rhs, "add");
-    } else if (inst->tag == MirSub) {
+    } else if (inst.tag == MirSub) {
         return LLVMBuildSub(self->ll_builder, lhs, rhs, "sub");
-    } else if (inst->tag == MirMul) {
+    } else if (inst.tag == MirMul) {
         return LLVMBuildMul(self->ll_builder, lhs, rhs, "mul");
-    } else if (inst->tag == MirDiv) {
+    } else if (inst.tag == MirDiv) {
         return LLVMBuildSDiv(self->ll_builder, lhs, rhs, "div");
     } else {
-        fprintf(stderr, "Unhandled binary op: %s\n", mir_tag_to_string(inst->tag));
+        fprintf(stderr, "Unhandled binary op: %s\n", mir_tag_to_string(inst.tag));
         assert(false);
     }
 }
 
 LLVMValueRef codegen_alloc(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
-    MirInst *inst = mir_get_inst_tagged(self->mir, index, MirAlloc);
+    MirInst inst = mir_get_inst_tagged(self->mir, index, MirAlloc);
 
-    LLVMTypeRef type = codegen_type_to_llvm(self, inst->data.ty);
+    LLVMTypeRef type = codegen_type_to_llvm(self, mir_get_type(self->mir, inst.data.ty));
 
     return LLVMBuildAlloca(self->ll_builder, type, "alloc"); //todo preserve name somehow
 }
 
 void codegen_store(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
-    MirInst *inst = mir_get_inst_tagged(self->mir, index, MirStore);
+    MirInst inst = mir_get_inst_tagged(self->mir, index, MirStore);
 
-    LLVMValueRef ptr = codegen_inst(self, ref_to_index(inst->data.bin_op.lhs), ll_block);
-    LLVMValueRef value = codegen_inst(self, ref_to_index(inst->data.bin_op.rhs), ll_block);
+    LLVMValueRef ptr = codegen_inst(self, ref_to_index(inst.data.bin_op.lhs), ll_block);
+    LLVMValueRef value = codegen_ref(self, inst.data.bin_op.rhs, LLVMGetElementType(LLVMTypeOf(ptr)), ll_block);
 
     LLVMBuildStore(self->ll_builder, value, ptr);
 }
 
 LLVMValueRef codegen_load(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
-    MirInst *inst = mir_get_inst_tagged(self->mir, index, MirLoad);
+    MirInst inst = mir_get_inst_tagged(self->mir, index, MirLoad);
 
-    LLVMValueRef ptr = codegen_inst(self, ref_to_index(inst->data.un_op), ll_block);
+    LLVMValueRef ptr = codegen_inst(self, ref_to_index(inst.data.un_op), ll_block);
 
     return LLVMBuildLoad(self->ll_builder, ptr, "load");
 }
 
 LLVMValueRef codegen_call(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
-    MirInst *inst = mir_get_inst_tagged(self->mir, index, MirCall);
+    MirInst inst = mir_get_inst_tagged(self->mir, index, MirCall);
 
     // Get operand ir value
-    LLVMValueRef fn_ptr = codegen_inst(self, ref_to_index(inst->data.pl_op.operand), ll_block);
+    LLVMValueRef fn_ptr = codegen_inst(self, ref_to_index(inst.data.pl_op.operand), ll_block);
     bool is_a_fn = LLVMIsAFunction(fn_ptr);
     if (!is_a_fn) {
         char *value_str = LLVMPrintValueToString(fn_ptr);
@@ -413,14 +452,15 @@ LLVMValueRef codegen_call(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
     }
 
     // Construct arg list
-    MirIndex extra_index = inst->data.pl_op.payload;
+    MirIndex extra_index = inst.data.pl_op.payload;
 
     uint32_t arg_count = mir_get_extra(self->mir, extra_index);
     LLVMValueRef *args = NULL;
     if (arg_count != 0) {
         args = malloc(sizeof(LLVMValueRef) * arg_count);
         for (uint32_t i = 0; i < arg_count; i++) {
-            args[i] = codegen_inst(self, ref_to_index(mir_get_extra(self->mir, extra_index + i + 1)), ll_block);
+            Ref arg = mir_get_extra(self->mir, extra_index + i + 1);
+            args[i] = codegen_ref(self, arg, LLVMTypeOf(LLVMGetParam(fn_ptr, i)), ll_block);
         }
     }
 
@@ -433,18 +473,17 @@ LLVMValueRef codegen_call(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
 }
 
 LLVMValueRef codegen_arg(self_t, MirIndex index, LLVMBasicBlockRef ll_block) {
-    MirInst *inst = mir_get_inst_tagged(self->mir, index, MirArg);
+    MirInst inst = mir_get_inst_tagged(self->mir, index, MirArg);
 
-    return LLVMGetParam(*self->curr_fn, inst->data.ty_pl.payload);
+    return LLVMGetParam(*self->curr_fn, inst.data.ty_pl.payload);
 }
 
 LLVMValueRef codegen_fn_ptr(self_t, MirIndex index) {
-    MirInst *inst = mir_get_inst_tagged(self->mir, index, MirFnPtr);
+    MirInst inst = mir_get_inst_tagged(self->mir, index, MirFnPtr);
 
-    char *fn_name = inst->data.fn_ptr;
-    Decl *decl = module_find_decl(self->module, fn_name);
+    Decl *decl = decl_list_get(&self->module->decls, inst.data.fn_decl);
     if (decl == NULL) {
-        fprintf(stderr, "Could not find function %s\n", fn_name);
+        fprintf(stderr, "Could not find function #%u\n", inst.data.fn_decl);
         assert(false);
     }
 
@@ -452,19 +491,26 @@ LLVMValueRef codegen_fn_ptr(self_t, MirIndex index) {
 }
 
 void codegen_return(self_t, MirInst *inst, LLVMBasicBlockRef ll_block) {
-    //todo codegen for refs
-    LLVMValueRef ret_val = codegen_inst(self, ref_to_index(inst->data.un_op), ll_block);
+    if (inst->data.un_op == RefVoidValue) {
+        LLVMBuildRetVoid(self->ll_builder);
+        return;
+    }
+
+    LLVMTypeRef ret_type = LLVMGetReturnType(LLVMGlobalGetValueType(*self->curr_fn));
+    LLVMValueRef ret_val = codegen_ref(self, inst->data.un_op, ret_type, ll_block);
     LLVMBuildRet(self->ll_builder, ret_val);
 }
 
 void codegen_block_direct(self_t, MirIndex block_index, LLVMBasicBlockRef ll_block) {
-    MirInst *inst = mir_get_inst_tagged(self->mir, block_index, MirBlock);
-    MirIndex data_index = inst->data.ty_pl.payload;
+    MirInst inst = mir_get_inst_tagged(self->mir, block_index, MirBlock);
+    MirIndex data_index = inst.data.ty_pl.payload;
 
     uint32_t stmt_count = mir_get_extra(self->mir, data_index);
     for (uint32_t i = data_index + 1; i <= data_index + stmt_count; i++) {
-        LLVMValueRef result = codegen_inst(self, mir_get_extra(self->mir, i), ll_block);
-        if (result != NULL) {
+        MirIndex stmt = mir_get_extra(self->mir, i);
+        LLVMValueRef result = codegen_inst(self, stmt, ll_block);
+        // The result of a call may be unused
+        if (result != NULL && mir_get_inst(self->mir, stmt).tag != MirCall) {
             char *value_str = LLVMPrintValueToString(result);
             fprintf(stderr, "Illegal result, expected void but got: %s\n", value_str);
             LLVMDisposeMessage(value_str);
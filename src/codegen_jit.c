@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <string.h>
+#include "codegen.h"
+
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Target.h>
+
+#define LAZY_BODY_SUFFIX "$body"
+
+#define self_t Codegen *self
+
+static bool report_error(LLVMErrorRef error, const char *context) {
+    if (error == NULL)
+        return false;
+
+    char *message = LLVMGetErrorMessage(error);
+    fprintf(stderr, "JIT error (%s): %s\n", context, message);
+    LLVMDisposeErrorMessage(message);
+    return true;
+}
+
+static bool jit_add_eager(self_t, LLVMOrcLLJITRef jit, LLVMOrcJITDylibRef dylib) {
+    // Ownership of the module is transferred to the JIT
+    LLVMOrcThreadSafeModuleRef ts_module = LLVMOrcCreateNewThreadSafeModule(self->ll_module, self->ll_ts_context);
+    self->ll_module = NULL;
+
+    return !report_error(LLVMOrcLLJITAddLLVMIRModule(jit, dylib, ts_module), "add module");
+}
+
+// Creates a copy of the module where only `fn_name` has a body, and renames it to `<fn_name>$body`.
+// All other functions are left as declarations, so they resolve to the lazy stubs in the dylib.
+static LLVMModuleRef clone_single_fn(self_t, const char *fn_name) {
+    LLVMModuleRef clone = LLVMCloneModule(self->ll_module);
+
+    LLVMValueRef fn = LLVMGetFirstFunction(clone);
+    while (fn != NULL) {
+        LLVMValueRef next = LLVMGetNextFunction(fn);
+
+        size_t name_len;
+        const char *name = LLVMGetValueName2(fn, &name_len);
+        if (strcmp(name, fn_name) == 0) {
+            char *body_name = malloc(name_len + sizeof(LAZY_BODY_SUFFIX));
+            sprintf(body_name, "%s" LAZY_BODY_SUFFIX, name);
+            LLVMSetValueName2(fn, body_name, strlen(body_name));
+            free(body_name);
+        } else if (!LLVMIsDeclaration(fn)) {
+            // Replace the definition with an external declaration of the same name.
+            char *decl_name = strndup(name, name_len);
+            LLVMValueRef decl = LLVMAddFunction(clone, "", LLVMGlobalGetValueType(fn));
+            LLVMReplaceAllUsesWith(fn, decl);
+            LLVMDeleteFunction(fn);
+            LLVMSetValueName2(decl, decl_name, name_len);
+            free(decl_name);
+        }
+
+        fn = next;
+    }
+
+    return clone;
+}
+
+static bool jit_add_lazy(self_t, LLVMOrcLLJITRef jit, LLVMOrcJITDylibRef dylib,
+                         LLVMOrcLazyCallThroughManagerRef call_through, LLVMOrcIndirectStubsManagerRef stubs) {
+    uint32_t fn_count = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(self->ll_module); fn != NULL; fn = LLVMGetNextFunction(fn)) {
+        if (!LLVMIsDeclaration(fn)) fn_count++;
+    }
+    if (fn_count == 0)
+        return true;
+
+    LLVMOrcCSymbolAliasMapPair *aliases = malloc(sizeof(LLVMOrcCSymbolAliasMapPair) * fn_count);
+    uint32_t alias_index = 0;
+
+    for (LLVMValueRef fn = LLVMGetFirstFunction(self->ll_module); fn != NULL; fn = LLVMGetNextFunction(fn)) {
+        if (LLVMIsDeclaration(fn))
+            continue;
+
+        size_t name_len;
+        const char *name = LLVMGetValueName2(fn, &name_len);
+
+        // Each function gets its own module so that it is only compiled when its stub is first called
+        LLVMModuleRef fn_module = clone_single_fn(self, name);
+        LLVMOrcThreadSafeModuleRef ts_module = LLVMOrcCreateNewThreadSafeModule(fn_module, self->ll_ts_context);
+        if (report_error(LLVMOrcLLJITAddLLVMIRModule(jit, dylib, ts_module), "add function module")) {
+            free(aliases);
+            return false;
+        }
+
+        char *body_name = malloc(name_len + sizeof(LAZY_BODY_SUFFIX));
+        sprintf(body_name, "%s" LAZY_BODY_SUFFIX, name);
+        aliases[alias_index++] = (LLVMOrcCSymbolAliasMapPair) {
+            .Name = LLVMOrcLLJITMangleAndIntern(jit, name),
+            .Entry = {
+                .Name = LLVMOrcLLJITMangleAndIntern(jit, body_name),
+                .Flags = {
+                    .GenericFlags = LLVMJITSymbolGenericFlagsExported | LLVMJITSymbolGenericFlagsCallable,
+                    .TargetFlags = 0,
+                },
+            },
+        };
+        free(body_name);
+    }
+
+    // The alias names are owned by the materialization unit from here on.
+    LLVMOrcMaterializationUnitRef reexports = LLVMOrcLazyReexports(call_through, stubs, dylib, aliases, fn_count);
+    free(aliases);
+
+    return !report_error(LLVMOrcJITDylibDefine(dylib, reexports), "define lazy reexports");
+}
+
+bool codegen_run_jit(self_t, bool lazy, int32_t *exit_code) {
+    assert(self->ll_module != NULL);
+
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+
+    LLVMOrcLLJITRef jit;
+    if (report_error(LLVMOrcCreateLLJIT(&jit, LLVMOrcCreateLLJITBuilder()), "create"))
+        return false;
+
+    // Resolve foreign declarations (eg `puts`) against the symbols already present in this process
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(jit);
+    LLVMOrcDefinitionGeneratorRef process_symbols;
+    if (report_error(LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(
+            &process_symbols, LLVMOrcLLJITGetGlobalPrefix(jit), NULL, NULL), "process symbols")) {
+        LLVMOrcDisposeLLJIT(jit);
+        return false;
+    }
+    LLVMOrcJITDylibAddGenerator(dylib, process_symbols);
+
+    LLVMOrcLazyCallThroughManagerRef call_through = NULL;
+    LLVMOrcIndirectStubsManagerRef stubs = NULL;
+
+    bool added;
+    if (lazy) {
+        const char *triple = LLVMOrcLLJITGetTripleString(jit);
+        stubs = LLVMOrcCreateLocalIndirectStubsManager(triple);
+        added = !report_error(LLVMOrcCreateLocalLazyCallThroughManager(
+            triple, LLVMOrcLLJITGetExecutionSession(jit), 0, &call_through), "lazy call through");
+        if (added)
+            added = jit_add_lazy(self, jit, dylib, call_through, stubs);
+    } else {
+        added = jit_add_eager(self, jit, dylib);
+    }
+
+    LLVMOrcJITTargetAddress main_addr = 0;
+    if (added)
+        added = !report_error(LLVMOrcLLJITLookup(jit, &main_addr, "main"), "lookup main");
+
+    if (added) {
+        int32_t (*main_fn)(void) = (int32_t (*)(void)) main_addr;
+        *exit_code = main_fn();
+    }
+
+    // The session may still reference the stubs and trampolines, so it is torn down first.
+    LLVMOrcDisposeLLJIT(jit);
+    if (call_through != NULL)
+        LLVMOrcDisposeLazyCallThroughManager(call_through);
+    if (stubs != NULL)
+        LLVMOrcDisposeIndirectStubsManager(stubs);
+
+    return added;
+}
+
+#undef self_t
@@ -0,0 +1,283 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "codegen.h"
+
+#include <llvm-c/Target.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+// Used by `codegen_target_machine` on each thread, one for each distinct set of options.
+#define TARGET_MACHINE_CACHE_SIZE 8
+// Machines no thread is using, which any thread may take.
+#define IDLE_TARGET_MACHINE_COUNT 64
+
+typedef struct target_machine_entry_s {
+    CodegenOptLevel opt_level;
+    char *target;
+    char *cpu;
+    LLVMTargetMachineRef machine;
+} TargetMachineEntry;
+
+static _Thread_local TargetMachineEntry target_machines[TARGET_MACHINE_CACHE_SIZE];
+static _Thread_local uint32_t target_machine_next = 0;
+
+// A thread which exits hands its machines to the idle pool, so that the workers of the next compile take them
+// instead of creating their own.
+static pthread_mutex_t idle_lock = PTHREAD_MUTEX_INITIALIZER;
+static TargetMachineEntry idle_machines[IDLE_TARGET_MACHINE_COUNT];
+static uint32_t idle_count = 0;
+
+static pthread_once_t release_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t release_key;
+
+static pthread_once_t native_target_once = PTHREAD_ONCE_INIT;
+static pthread_once_t all_targets_once = PTHREAD_ONCE_INIT;
+
+static void initialize_native_target(void) {
+    LLVMInitializeNativeTarget();
+    LLVMInitializeNativeAsmPrinter();
+}
+
+// The requested target may be any of the ones LLVM was built with
+static void initialize_all_targets(void) {
+    LLVMInitializeAllTargetInfos();
+    LLVMInitializeAllTargets();
+    LLVMInitializeAllTargetMCs();
+    LLVMInitializeAllAsmPrinters();
+}
+
+static bool same_option(const char *a, const char *b) {
+    return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+static bool entry_matches(TargetMachineEntry *entry, const CodegenOptions *options) {
+    return entry->machine != NULL && entry->opt_level == options->opt_level &&
+           same_option(entry->target, options->target) && same_option(entry->cpu, options->cpu);
+}
+
+static void entry_dispose(TargetMachineEntry *entry) {
+    LLVMDisposeTargetMachine(entry->machine);
+    free(entry->target);
+    free(entry->cpu);
+    *entry = (TargetMachineEntry) {0};
+}
+
+// Moves the machine into the idle pool, or disposes it if the pool is full.
+static void idle_put(TargetMachineEntry *entry) {
+    pthread_mutex_lock(&idle_lock);
+    if (idle_count < IDLE_TARGET_MACHINE_COUNT) {
+        idle_machines[idle_count++] = *entry;
+        *entry = (TargetMachineEntry) {0};
+    }
+    pthread_mutex_unlock(&idle_lock);
+
+    if (entry->machine != NULL)
+        entry_dispose(entry);
+}
+
+static bool idle_take(const CodegenOptions *options, TargetMachineEntry *entry) {
+    bool found = false;
+    pthread_mutex_lock(&idle_lock);
+    for (uint32_t i = 0; i < idle_count; i++) {
+        if (entry_matches(&idle_machines[i], options)) {
+            *entry = idle_machines[i];
+            idle_machines[i] = idle_machines[--idle_count];
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&idle_lock);
+    return found;
+}
+
+static void release_thread_machines(void *unused) {
+    (void) unused;
+    for (uint32_t i = 0; i < TARGET_MACHINE_CACHE_SIZE; i++) {
+        if (target_machines[i].machine != NULL)
+            idle_put(&target_machines[i]);
+    }
+}
+
+static void create_release_key(void) {
+    pthread_key_create(&release_key, release_thread_machines);
+}
+
+bool codegen_parse_emit_kinds(const char *list, uint32_t *emit) {
+    *emit = 0;
+
+    const char *start = list;
+    while (*start != '\0') {
+        size_t len = strcspn(start, ",");
+        if (len == 3 && strncmp(start, "obj", len) == 0) *emit |= EMIT_OBJ;
+        else if (len == 3 && strncmp(start, "asm", len) == 0) *emit |= EMIT_ASM;
+        else if (len == 2 && strncmp(start, "bc", len) == 0) *emit |= EMIT_BC;
+        else if (len == 2 && strncmp(start, "ll", len) == 0) *emit |= EMIT_LL;
+        else if (len == 3 && strncmp(start, "exe", len) == 0) *emit |= EMIT_EXE;
+        else if (len == 3 && strncmp(start, "mir", len) == 0) *emit |= EMIT_MIR;
+        else return false;
+
+        start += len;
+        if (*start == ',') start++;
+    }
+
+    return *emit != 0;
+}
+
+static LLVMCodeGenOptLevel codegen_level(CodegenOptLevel level) {
+    switch (level) {
+        case CODEGEN_OPT_O0:
+            return LLVMCodeGenLevelNone;
+        case CODEGEN_OPT_O1:
+            return LLVMCodeGenLevelLess;
+        case CODEGEN_OPT_O2:
+        case CODEGEN_OPT_OS:
+            return LLVMCodeGenLevelDefault;
+        case CODEGEN_OPT_O3:
+            return LLVMCodeGenLevelAggressive;
+    }
+    assert(false);
+}
+
+static bool create_target_machine(const CodegenOptions *options, TargetMachineEntry *entry) {
+    pthread_once(&native_target_once, initialize_native_target);
+    if (options->target != NULL)
+        pthread_once(&all_targets_once, initialize_all_targets);
+
+    char *triple = options->target == NULL
+                   ? LLVMGetDefaultTargetTriple()
+                   : LLVMNormalizeTargetTriple(options->target);
+
+    char *errors = NULL;
+    LLVMTargetRef target;
+    if (LLVMGetTargetFromTriple(triple, &target, &errors)) {
+        fprintf(stderr, "Unknown target '%s': %s\n", triple, errors);
+        LLVMDisposeMessage(errors);
+        LLVMDisposeMessage(triple);
+        return false;
+    }
+
+    char *cpu = NULL;
+    char *features = NULL;
+    if (options->cpu != NULL && strcmp(options->cpu, "native") == 0) {
+        cpu = LLVMGetHostCPUName();
+        features = LLVMGetHostCPUFeatures();
+    }
+
+    // Objects are position independent, since the system compiler driver links PIE executables by default.
+    LLVMTargetMachineRef machine = LLVMCreateTargetMachine(
+        target, triple,
+        cpu != NULL ? cpu : (options->cpu != NULL ? options->cpu : "generic"),
+        features != NULL ? features : "",
+        codegen_level(options->opt_level), LLVMRelocPIC, LLVMCodeModelDefault);
+
+    if (cpu != NULL) LLVMDisposeMessage(cpu);
+    if (features != NULL) LLVMDisposeMessage(features);
+    LLVMDisposeMessage(triple);
+
+    *entry = (TargetMachineEntry) {
+        .opt_level = options->opt_level,
+        .target = options->target != NULL ? strdup(options->target) : NULL,
+        .cpu = options->cpu != NULL ? strdup(options->cpu) : NULL,
+        .machine = machine,
+    };
+    return true;
+}
+
+LLVMTargetMachineRef codegen_target_machine(const CodegenOptions *options) {
+    for (uint32_t i = 0; i < TARGET_MACHINE_CACHE_SIZE; i++) {
+        if (entry_matches(&target_machines[i], options))
+            return target_machines[i].machine;
+    }
+
+    TargetMachineEntry created;
+    if (!idle_take(options, &created) && !create_target_machine(options, &created))
+        return NULL;
+
+    // Hand the machines back when the thread exits
+    pthread_once(&release_key_once, create_release_key);
+    pthread_setspecific(release_key, target_machines);
+
+    // Past the limit the oldest machine is replaced, which is safe since a thread only uses the machine of the options
+    // it is currently compiling with
+    TargetMachineEntry *entry = &target_machines[target_machine_next++ % TARGET_MACHINE_CACHE_SIZE];
+    if (entry->machine != NULL)
+        idle_put(entry);
+    *entry = created;
+    return created.machine;
+}
+
+bool codegen_prepare_target_machines(const CodegenOptions *options, uint32_t count) {
+    if (codegen_target_machine(options) == NULL)
+        return false;
+
+    uint32_t idle = 0;
+    pthread_mutex_lock(&idle_lock);
+    for (uint32_t i = 0; i < idle_count; i++) {
+        if (entry_matches(&idle_machines[i], options))
+            idle++;
+    }
+    pthread_mutex_unlock(&idle_lock);
+
+    for (uint32_t i = idle + 1; i < count; i++) {
+        TargetMachineEntry created;
+        if (!create_target_machine(options, &created))
+            return false;
+        idle_put(&created);
+    }
+    return true;
+}
+
+#define self_t Codegen *self
+
+static const char *pass_pipeline(CodegenOptLevel level) {
+    switch (level) {
+        case CODEGEN_OPT_O0:
+            return NULL;
+        case CODEGEN_OPT_O1:
+            return "default<O1>";
+        case CODEGEN_OPT_O2:
+            return "default<O2>";
+        case CODEGEN_OPT_O3:
+            return "default<O3>";
+        case CODEGEN_OPT_OS:
+            return "default<Os>";
+    }
+    assert(false);
+}
+
+bool codegen_optimize(self_t) {
+    assert(self->ll_module != NULL);
+
+    LLVMTargetMachineRef machine = codegen_target_machine(self->options);
+    if (machine == NULL)
+        return false;
+
+    char *triple = LLVMGetTargetMachineTriple(machine);
+    LLVMSetTarget(self->ll_module, triple);
+    LLVMDisposeMessage(triple);
+
+    LLVMTargetDataRef data_layout = LLVMCreateTargetDataLayout(machine);
+    char *data_layout_str = LLVMCopyStringRepOfTargetData(data_layout);
+    LLVMSetDataLayout(self->ll_module, data_layout_str);
+    LLVMDisposeMessage(data_layout_str);
+    LLVMDisposeTargetData(data_layout);
+
+    const char *pipeline = pass_pipeline(self->options->opt_level);
+    if (pipeline == NULL)
+        return true;
+
+    LLVMPassBuilderOptionsRef pass_options = LLVMCreatePassBuilderOptions();
+    LLVMErrorRef error = LLVMRunPasses(self->ll_module, pipeline, machine, pass_options);
+    LLVMDisposePassBuilderOptions(pass_options);
+
+    if (error != NULL) {
+        char *message = LLVMGetErrorMessage(error);
+        fprintf(stderr, "Error running optimization passes: %s\n", message);
+        LLVMDisposeErrorMessage(message);
+        return false;
+    }
+
+    return true;
+}
+
+#undef self_t
@@ -1,7 +1,6 @@
 #include "debug/ast_debug_tree.h"
 
 #include <stdlib.h>
-#include <string.h>
 
 typedef struct {
     // Options
@@ -9,27 +8,22 @@ typedef struct {
 
     Ast *ast;
 
-    char *buffer;
-    size_t buffer_index;
+    Writer *out;
 } AstDebug;
 
-#define AST_DEBUG_BUFFER_SIZE (sizeof(char) * 4096)
-
 #define self_t AstDebug *self
 
 // SECTION: Utilities
 // Utility macros and functions for retrieving or emitting information.
 
-#define print(self, ...) { \
-    sprintf(self->buffer + self->buffer_index, __VA_ARGS__); \
-    self->buffer_index += strlen(self->buffer + self->buffer_index); \
-}
+#define print(self, ...) { writer_printf((self)->out, __VA_ARGS__); }
 
 #define get_extra(self, index) *index_list_get(&(self)->ast->extra_data, (index))
 
+// Separated from the node name by a space
 void print_token(self_t, TokenIndex token_idx) {
     char *str = ast_get_token_content(self->ast, token_idx);
-    print(self, "\"%s\"", str);
+    print(self, " \"%s\"", str);
     free(str);
 }
 
@@ -55,15 +49,11 @@ static void print_main_token_generic(self_t, AstNode *node) {
 }
 
 static void print_nothing_generic(self_t, AstNode *node) {
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
 }
 
 static void print_dot(self_t, AstNode *node, int indent) {
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     // Print LHS/RHS
@@ -81,8 +71,6 @@ static void print_binary(self_t, AstNode *node, int indent) {
 }
 
 static void print_return(self_t, AstNode *node, int indent) {
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     // Print LHS
@@ -90,8 +78,6 @@ static void print_return(self_t, AstNode *node, int indent) {
 }
 
 static void print_i_return(self_t, AstNode *node, int indent) {
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     // Print LHS
@@ -99,8 +85,6 @@ static void print_i_return(self_t, AstNode *node, int indent) {
 }
 
 static void print_block(self_t, AstNode *node, int indent) {
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     if (node->data.lhs == ast_index_empty)
@@ -113,8 +97,6 @@ static void print_block(self_t, AstNode *node, int indent) {
 
 static void print_call(self_t, AstNode *node, int indent) {
     AstCallData call_data = *((AstCallData*) &get_extra(self, node->data.rhs));
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     // Operand
@@ -131,8 +113,6 @@ static void print_call(self_t, AstNode *node, int indent) {
 
 static void print_if(self_t, AstNode *node, int indent) {
     AstIfData if_data = *((AstIfData*) &get_extra(self, node->data.rhs));
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     // Condition
@@ -146,8 +126,6 @@ static void print_if(self_t, AstNode *node, int indent) {
 }
 
 static void print_while(self_t, AstNode *node, int indent) {
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     // Condition
@@ -189,8 +167,6 @@ static void print_named_fn(self_t, AstNode *node, int indent) {
 }
 
 static void print_fn_proto(self_t, AstNode *node, int indent) {
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     AstFnProto proto = *((AstFnProto*) &get_extra(self, node->data.lhs));
@@ -236,8 +212,6 @@ static void print_container_generic(self_t, AstNode *node, int indent) {
 }
 
 static void print_module(self_t, AstNode *node, int indent) {
-    // This index subtraction removes the space added by print_node.
-    self->buffer_index--;
     print(self, "\n");
 
     if (node->data.lhs == ast_index_empty)
@@ -256,14 +230,13 @@ static void print_node(self_t, AstIndex index, int indent) {
     // Print the indentation & node name
     print(self, "%*s%s", indent, "", ast_tag_to_string(node->tag));
 
-    if (self->print_locs) {
-        //todo cannot really implement this atm. AST does not have locational information.
-//        Token main_token = self->ast->tokens.data
-//        print(self, "@%d..%d", 0, 1);
+    // Location of the main token, only available for ASTs with a line index
+    if (self->print_locs && self->ast->lines.size != 0) {
+        Token main_token = self->ast->tokens.data[node->main_token];
+        SourceLoc loc = line_index_lookup(&self->ast->lines, (uint32_t) main_token.loc.start);
+        print(self, "@%d:%d", loc.line, loc.col);
     }
 
-    print(self, " ");
-
     switch (node->tag) {
         // Expressions
         case AST_INTEGER:
@@ -346,17 +319,22 @@ static void print_node(self_t, AstIndex index, int indent) {
 
 // SECTION: Public API
 
-char *ast_debug_tree_print(Ast *ast, AstIndex root, bool print_locs) {
+void ast_debug_tree_write(Ast *ast, AstIndex root, bool print_locs, Writer *out) {
     AstDebug self = {
         .print_locs = print_locs,
         .ast = ast,
-        .buffer = malloc(AST_DEBUG_BUFFER_SIZE),
-        .buffer_index = 0,
+        .out = out,
     };
 
     print_node(&self, root, 0);
+}
 
-//    ast_debug_print_node_raw(&self, root, 0);
+char *ast_debug_tree_print(Ast *ast, AstIndex root, bool print_locs) {
+    Writer out;
+    writer_init_buffer(&out);
+    ast_debug_tree_write(ast, root, print_locs, &out);
 
-    return self.buffer;
+    char *result = writer_take_buffer(&out);
+    writer_free(&out);
+    return result;
 }
@@ -1,26 +1,19 @@
 #include <stdlib.h>
-#include <string.h>
 #include "debug/hir_debug.h"
 
 typedef struct {
     Hir *hir;
 
-    char *buffer;
-    size_t buffer_index;
+    Writer *out;
 } HirDebug;
 
-#define HIR_DEBUG_BUFFER_SIZE (sizeof(char) * 4096)
-
 #define self_t HirDebug *self
 
 
 // SECTION: Utilities
 // Utility macros and functions for retrieving or emitting information.
 
-#define print(self, ...) { \
-    sprintf(self->buffer + self->buffer_index, __VA_ARGS__); \
-    self->buffer_index += strlen(self->buffer + self->buffer_index); \
-}
+#define print(self, ...) { writer_printf((self)->out, __VA_ARGS__); }
 
 #define get_extra(self, index) *index_list_get(&(self)->hir->extra, (index))
 
@@ -45,6 +38,7 @@ void print_default_header(self_t, HirIndex index, int indent) {
 // Any elements which need forward declarations are done here
 
 static void print_inst(self_t, HirIndex index, int indent);
+static void print_block_unterminated(self_t, HirIndex index, HirInst *inst, int indent);
 
 static void print_inst_if_present(self_t, HirIndex index, int indent) {
     if (index == hir_index_empty)
@@ -96,8 +90,8 @@ static void print_fn_decl(self_t, HirIndex index, HirInst *inst, int indent) {
         print(self, ", ");
 
         // Body
-        print_inst(self, decl->body, 0);
-        self->buffer_index -= 1; // Remove the newline added by the body print
+        HirInst *body = hir_get_inst_tagged(self->hir, decl->body, HIR_BLOCK);
+        print_block_unterminated(self, decl->body, body, 0);
     }
 
     print(self, ")\n");
@@ -165,7 +159,8 @@ static void print_break_inline(self_t, HirIndex index, HirInst *inst, int indent
     print(self, "break_inline(%%%d)\n", inst->data.un_op);
 }
 
-static void print_block(self_t, HirIndex index, HirInst *inst, int indent) {
+// Without the trailing newline, so it can be followed by more of the parent instruction.
+static void print_block_unterminated(self_t, HirIndex index, HirInst *inst, int indent) {
     print_default_header(self, index, indent);
     print(self, "block(");
 
@@ -174,7 +169,7 @@ static void print_block(self_t, HirIndex index, HirInst *inst, int indent) {
 
     // Exit early if block is empty
     if (block_data->len == 0) {
-        print(self, ")\n");
+        print(self, ")");
         return;
     }
 
@@ -189,7 +184,12 @@ static void print_block(self_t, HirIndex index, HirInst *inst, int indent) {
     }
 
     print_indent(self, indent);
-    print(self, "})\n");
+    print(self, "})");
+}
+
+static void print_block(self_t, HirIndex index, HirInst *inst, int indent) {
+    print_block_unterminated(self, index, inst, indent);
+    print(self, "\n");
 }
 
 static void print_return(self_t, HirIndex index, HirInst *inst, int indent) {
@@ -331,15 +331,21 @@ static void print_inst(self_t, HirIndex index, int indent) {
 
 #undef self_t
 
-char *hir_debug_print(Hir *hir, HirIndex root) {
+void hir_debug_write(Hir *hir, HirIndex root, Writer *out) {
     HirDebug self = {
         .hir = hir,
-        .buffer = malloc(HIR_DEBUG_BUFFER_SIZE),
-        .buffer_index = 0,
+        .out = out,
     };
-    memset(self.buffer, 0, HIR_DEBUG_BUFFER_SIZE);
 
     print_inst(&self, root, 0);
+}
+
+char *hir_debug_print(Hir *hir, HirIndex root) {
+    Writer out;
+    writer_init_buffer(&out);
+    hir_debug_write(hir, root, &out);
 
-    return self.buffer;
+    char *result = writer_take_buffer(&out);
+    writer_free(&out);
+    return result;
 }
@@ -1,30 +1,28 @@
 #include "debug/mir_debug.h"
 
 #include <stdlib.h>
-#include <string.h>
 #include "array_util.h"
 
 typedef struct {
     Mir *mir;
-    IndexList visited;
+    // Optional names, see `MirDebugNames`
+    const MirDebugNames *names;
+    // Instructions already printed as an operand, one bit per instruction
+    BitSet visited;
 
-    char *buffer;
-    size_t buffer_index;
+    Writer *out;
 } MirDebug;
 
 #define self_t MirDebug *self
 
-#define print(self, ...) { \
-    sprintf(self->buffer + self->buffer_index, __VA_ARGS__); \
-    self->buffer_index += strlen(self->buffer + self->buffer_index); \
-}
+#define print(self, ...) { writer_printf((self)->out, __VA_ARGS__); }
 
 #define get_inst(self, index) mir_inst_list_get(&(self)->mir->instructions, (index))
 #define get_extra(self, index) *index_list_get(&(self)->mir->extra, (index))
 
-static inline MirInst *get_inst_tagged(self_t, MirIndex index, MirInstTag tag) {
-    MirInst *inst = get_inst(self, index);
-    assert(inst->tag == tag);
+static inline MirInst get_inst_tagged(self_t, MirIndex index, MirInstTag tag) {
+    MirInst inst = get_inst(self, index);
+    assert(inst.tag == tag);
     return inst;
 }
 
@@ -48,47 +46,73 @@ static void print_block_inst_ref(self_t, Ref ref, int indent) {
     if (ref > __REF_LAST) {
         MirIndex index = ref_to_index(ref);
 
-        bool visited = index_list_contains(&self->visited, index);
-        if (visited) return;
+        if (bit_set_get(&self->visited, index)) return;
 
         print_block_inst(self, index, indent);
-        index_list_add(&self->visited, index);
+        bit_set_set(&self->visited, index);
     }
 }
 
-static void print_type(self_t, Type ty) {
-    char *type_str = type_to_string(ty);
+static void print_type(self_t, MirTypeIndex ty) {
+    char *type_str = type_to_string(mir_get_type(self->mir, ty));
     print(self, "%s", type_str);
     free(type_str);
 }
 
 
+// Escaped so that `mir_parser` reads back the same bytes
+static void print_string_literal(self_t, const char *string) {
+    print(self, "\"");
+    for (const unsigned char *c = (const unsigned char *) string; *c != '\0'; c++) {
+        switch (*c) {
+            case '"': print(self, "\\\"") break;
+            case '\\': print(self, "\\\\") break;
+            case '\n': print(self, "\\n") break;
+            case '\r': print(self, "\\r") break;
+            case '\t': print(self, "\\t") break;
+            default:
+                if (*c < 0x20 || *c == 0x7f) {
+                    print(self, "\\x%02x", *c)
+                } else {
+                    writer_write(self->out, (const char *) c, 1);
+                }
+        }
+    }
+    print(self, "\"");
+}
+
 static void print_constant(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, MirConstant);
+    MirInst inst = get_inst_tagged(self, index, MirConstant);
     append_default_header(self, index, indent);
 
     print(self, "constant(");
-    print_type(self, inst->data.ty_pl.ty);
-    print(self, ", %d)", inst->data.ty_pl.payload);
+    print_type(self, inst.data.ty_pl.ty);
+    if (self->names->strings != NULL && type_tag(mir_get_type(self->mir, inst.data.ty_pl.ty)) == TY_PTR) {
+        print(self, ", ");
+        print_string_literal(self, string_set_get(self->names->strings, inst.data.ty_pl.payload));
+        print(self, ")");
+    } else {
+        print(self, ", %d)", inst.data.ty_pl.payload);
+    }
 }
 
 static void print_binary_generic(self_t, MirIndex index, MirInstTag tag, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, tag);
+    MirInst inst = get_inst_tagged(self, index, tag);
 
-    print_block_inst_ref(self, inst->data.bin_op.lhs, indent);
-    print_block_inst_ref(self, inst->data.bin_op.rhs, indent);
+    print_block_inst_ref(self, inst.data.bin_op.lhs, indent);
+    print_block_inst_ref(self, inst.data.bin_op.rhs, indent);
 
     append_default_header(self, index, indent);
     print(self, "%s(", mir_tag_to_string(tag))
-    print_ref(self, inst->data.bin_op.lhs);
+    print_ref(self, inst.data.bin_op.lhs);
     print(self, ", ")
-    print_ref(self, inst->data.bin_op.rhs);
+    print_ref(self, inst.data.bin_op.rhs);
     print(self, ")")
 }
 
 static void print_alloc(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, MirAlloc);
-    Type ty = inst->data.ty;
+    MirInst inst = get_inst_tagged(self, index, MirAlloc);
+    MirTypeIndex ty = inst.data.ty;
 
     append_default_header(self, index, indent);
     print(self, "alloc(")
@@ -97,57 +121,57 @@ static void print_alloc(self_t, MirIndex index, int indent) {
 }
 
 static void print_store(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, MirStore);
+    MirInst inst = get_inst_tagged(self, index, MirStore);
 
-    print_block_inst_ref(self, inst->data.bin_op.lhs, indent);
-    print_block_inst_ref(self, inst->data.bin_op.rhs, indent);
+    print_block_inst_ref(self, inst.data.bin_op.lhs, indent);
+    print_block_inst_ref(self, inst.data.bin_op.rhs, indent);
 
     append_default_header(self, index, indent);
     print(self, "store(")
-    print_ref(self, inst->data.bin_op.lhs);
+    print_ref(self, inst.data.bin_op.lhs);
     print(self, ", ")
-    print_ref(self, inst->data.bin_op.rhs);
+    print_ref(self, inst.data.bin_op.rhs);
     print(self, ")")
 }
 
 static void print_load(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, MirLoad);
+    MirInst inst = get_inst_tagged(self, index, MirLoad);
 
-    print_block_inst_ref(self, inst->data.un_op, indent);
+    print_block_inst_ref(self, inst.data.un_op, indent);
 
     append_default_header(self, index, indent);
     print(self, "load(")
-    print_ref(self, inst->data.un_op);
+    print_ref(self, inst.data.un_op);
     print(self, ")")
 }
 
 static void print_ret(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, MirRet);
-    print_block_inst_ref(self, inst->data.un_op, indent);
+    MirInst inst = get_inst_tagged(self, index, MirRet);
+    print_block_inst_ref(self, inst.data.un_op, indent);
 
     append_default_header(self, index, indent);
     print(self, "ret(")
-    print_ref(self, inst->data.un_op);
+    print_ref(self, inst.data.un_op);
     print(self, ")");
 }
 
 static void print_arg(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, MirArg);
+    MirInst inst = get_inst_tagged(self, index, MirArg);
 
     append_default_header(self, index, indent);
     print(self, "arg(");
-    print_type(self, inst->data.ty_pl.ty);
-    print(self, ", %d)", inst->data.ty_pl.payload);
+    print_type(self, inst.data.ty_pl.ty);
+    print(self, ", %d)", inst.data.ty_pl.payload);
 }
 
 static void print_call(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, MirCall);
+    MirInst inst = get_inst_tagged(self, index, MirCall);
 
     // Print operand
-    print_block_inst_ref(self, inst->data.pl_op.operand, indent);
+    print_block_inst_ref(self, inst.data.pl_op.operand, indent);
 
     // Print arguments above
-    MirIndex extra_index = inst->data.pl_op.payload;
+    MirIndex extra_index = inst.data.pl_op.payload;
     uint32_t arg_count = get_extra(self, extra_index);
     for (MirIndex i = extra_index + 1; i <= extra_index + arg_count; i++) {
         print_block_inst_ref(self, get_extra(self, i), indent);
@@ -156,7 +180,7 @@ static void print_call(self_t, MirIndex index, int indent) {
     // Print call line
     append_default_header(self, index, indent);
     print(self, "call(")
-    print_ref(self, inst->data.pl_op.operand);
+    print_ref(self, inst.data.pl_op.operand);
     print(self, ", args=")
     if (arg_count == 0) {
         print(self, "_")
@@ -171,16 +195,21 @@ static void print_call(self_t, MirIndex index, int indent) {
 }
 
 static void print_fn_ptr(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst_tagged(self, index, MirFnPtr);
+    MirInst inst = get_inst_tagged(self, index, MirFnPtr);
 
     append_default_header(self, index, indent);
-    print(self, "fn_ptr(%s)", inst->data.fn_ptr)
+    uint32_t decl = inst.data.fn_decl;
+    if (decl < self->names->decl_count) {
+        print(self, "fn_ptr(%s)", self->names->decl_names[decl])
+    } else {
+        print(self, "fn_ptr(#%u)", decl)
+    }
 }
 
 static void print_block_inst(self_t, MirIndex index, int indent) {
-    MirInst *inst = get_inst(self, index);
+    MirInst inst = get_inst(self, index);
 
-    switch (inst->tag) {
+    switch (inst.tag) {
         case MirAdd:
         case MirSub:
         case MirMul:
@@ -191,7 +220,7 @@ static void print_block_inst(self_t, MirIndex index, int indent) {
         case MirGtEq:
         case MirLt:
         case MirLtEq:
-            print_binary_generic(self, index, inst->tag, indent);
+            print_binary_generic(self, index, inst.tag, indent);
             break;
         case MirConstant:
             print_constant(self, index, indent);
@@ -221,7 +250,7 @@ static void print_block_inst(self_t, MirIndex index, int indent) {
             printf("Illegal reserved tag present in MIR\n");
             assert(false);
         default:
-            printf("Unhandled tag: %s\n", mir_tag_to_string(inst->tag));
+            printf("Unhandled tag: %s\n", mir_tag_to_string(inst.tag));
             assert(false);
     }
     print(self, "\n")
@@ -229,10 +258,10 @@ static void print_block_inst(self_t, MirIndex index, int indent) {
 
 
 static void print_root_block(self_t) {
-    MirInst *inst = get_inst(self, 0);
-    assert(inst->tag == MirBlock);
+    MirInst inst = get_inst(self, 0);
+    assert(inst.tag == MirBlock);
 
-    MirIndex data_index = inst->data.ty_pl.payload;
+    MirIndex data_index = inst.data.ty_pl.payload;
     uint32_t expr_count = get_extra(self, data_index);
 
     for (uint32_t i = data_index + 1; i <= data_index + expr_count; i++) {
@@ -244,20 +273,30 @@ static void print_root_block(self_t) {
 
 #undef self_t
 
-char *mir_debug_print(Mir *mir) {
-    char *buffer = malloc(4096);
-    memset(buffer, 0, 4096);
+void mir_debug_write(Mir *mir, Writer *out) {
+    MirDebugNames names = {0};
+    mir_debug_write_named(mir, &names, out);
+}
 
+void mir_debug_write_named(Mir *mir, const MirDebugNames *names, Writer *out) {
     MirDebug self = {
         .mir = mir,
-        .buffer = buffer,
-        .buffer_index = 0,
+        .names = names,
+        .out = out,
     };
-    index_list_init(&self.visited);
+    bit_set_init(&self.visited, mir->instructions.size);
 
     print_root_block(&self);
 
-    index_list_free(&self.visited);
+    bit_set_free(&self.visited);
+}
+
+char *mir_debug_print(Mir *mir) {
+    Writer out;
+    writer_init_buffer(&out);
+    mir_debug_write(mir, &out);
 
-    return buffer;
+    char *result = writer_take_buffer(&out);
+    writer_free(&out);
+    return result;
 }
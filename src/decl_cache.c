@@ -0,0 +1,317 @@
+#include "decl_cache.h"
+
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "module.h"
+#include "mir_parser.h"
+#include "writer.h"
+#include "cache_util.h"
+#include "debug/mir_debug.h"
+
+// Bumped whenever the MIR text or code generation changes, so entries written by an older compiler are never used.
+#define DECL_CACHE_VERSION 2
+
+// SECTION: Keys
+
+typedef struct decl_cache_stats_s {
+    atomic_uint mir_hits;
+    atomic_uint mir_misses;
+    atomic_uint object_hits;
+    atomic_uint object_misses;
+} DeclCacheStats;
+
+#define self_t DeclCache *self
+
+bool decl_cache_init(self_t, const char *dir, const CodegenOptions *options) {
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Could not create cache directory %s: %s\n", dir, strerror(errno));
+        return false;
+    }
+
+    // Outputs and the number of jobs do not change the code of a decl
+    char flags[256];
+    snprintf(flags, sizeof(flags), "acorn decl cache %d -O%d --target=%s --cpu=%s", DECL_CACHE_VERSION,
+             (int) options->opt_level,
+             options->target != NULL ? options->target : "host",
+             options->cpu != NULL ? options->cpu : "generic");
+
+    self->dir = strdup(dir);
+    self->flags = strdup(flags);
+    self->keys = NULL;
+    self->key_count = 0;
+    self->stats = malloc(sizeof(DeclCacheStats));
+    atomic_init(&self->stats->mir_hits, 0);
+    atomic_init(&self->stats->mir_misses, 0);
+    atomic_init(&self->stats->object_hits, 0);
+    atomic_init(&self->stats->object_misses, 0);
+    return true;
+}
+
+void decl_cache_free(self_t) {
+    free(self->dir);
+    free(self->flags);
+    free(self->keys);
+    free(self->stats);
+    self->dir = NULL;
+    self->stats = NULL;
+    self->flags = NULL;
+    self->keys = NULL;
+    self->key_count = 0;
+}
+
+static DeclCacheKey *decl_key(self_t, Module *module, Decl *decl) {
+    // Keys are only created while lowering, which happens before any unit is processed on a worker thread.
+    if (self->keys == NULL) {
+        self->key_count = module->decls.size;
+        self->keys = calloc(self->key_count, sizeof(DeclCacheKey));
+    }
+
+    DeclIndex index = (DeclIndex) (decl - module->decls.data);
+    assert(index < self->key_count);
+    DeclCacheKey *key = &self->keys[index];
+    if (key->entry == 0) {
+        const char *source;
+        size_t len;
+        if (!module_decl_source(module, decl, &source, &len))
+            return key;
+
+        uint64_t hash = cache_hash(CACHE_HASH_INIT, self->flags, strlen(self->flags) + 1);
+        key->entry = cache_hash(hash, source, len) | 1;
+    }
+    return key;
+}
+
+static char *cache_path(self_t, uint64_t key, const char *extension) {
+    size_t len = strlen(self->dir) + strlen(extension) + 18;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/%016llx%s", self->dir, (unsigned long long) key, extension);
+    return path;
+}
+
+
+// SECTION: MIR entries
+// <flags>
+// <source length>
+// <source>
+// <name> <signature>, for each referenced function
+// <blank line>
+// <MIR>
+
+// Writes a line for every function referenced by the MIR of `decl`, in order of first reference.
+static void write_signatures(Module *module, Mir *mir, Writer *out) {
+    IndexList seen;
+    index_list_init(&seen);
+
+    for (MirIndex i = 0; i < mir->instructions.size; i++) {
+        if (mir_inst_list_tag(&mir->instructions, i) != MirFnPtr)
+            continue;
+
+        DeclIndex target = mir->instructions.data[i].fn_decl;
+        bool duplicate = false;
+        for (uint32_t j = 0; j < seen.size && !duplicate; j++)
+            duplicate = seen.data[j] == target;
+        if (duplicate)
+            continue;
+        index_list_add(&seen, target);
+
+        Decl *decl = decl_list_get(&module->decls, target);
+        writer_printf(out, "%s ", module_decl_name(module, decl));
+        module_write_decl_signature(module, decl, out);
+        writer_puts(out, "\n");
+    }
+
+    index_list_free(&seen);
+}
+
+static void set_object_key(DeclCacheKey *key, const char *signatures, size_t len) {
+    key->object = cache_hash(key->entry, signatures, len) | 1;
+}
+
+// Checks each `<name> <signature>` line against the current module, returning the end of the lines.
+static const char *check_signatures(Module *module, const char *cursor) {
+    while (cursor != NULL && *cursor != '\n') {
+        const char *space = strchr(cursor, ' ');
+        const char *end = strchr(cursor, '\n');
+        if (space == NULL || end == NULL || space > end) {
+            cursor = NULL;
+            break;
+        }
+
+        char *name = strndup(cursor, space - cursor);
+        Decl *decl = module_find_decl(module, name);
+        free(name);
+        if (decl == NULL) {
+            cursor = NULL;
+            break;
+        }
+
+        Writer expected;
+        writer_init_buffer(&expected);
+        module_write_decl_signature(module, decl, &expected);
+        bool same = (size_t) (end - space - 1) == expected.size && memcmp(space + 1, expected.data, expected.size) == 0;
+        writer_free(&expected);
+        if (!same) {
+            cursor = NULL;
+            break;
+        }
+        cursor = end + 1;
+    }
+
+    return cursor;
+}
+
+bool decl_cache_load_mir(self_t, Module *module, Decl *decl) {
+    DeclCacheKey *key = decl_key(self, module, decl);
+    if (key->entry == 0)
+        return false;
+
+    char *path = cache_path(self, key->entry, ".mir");
+    size_t len;
+    char *data = cache_read_file(path, &len);
+
+    // Compare the flags and source in full, the key is only a hash
+    const char *source;
+    size_t source_len;
+    module_decl_source(module, decl, &source, &source_len);
+    const char *signatures = NULL;
+    const char *cursor = data;
+    size_t flags_len = strlen(self->flags);
+    if (cursor != NULL && strncmp(cursor, self->flags, flags_len) == 0 && cursor[flags_len] == '\n') {
+        char *source_end;
+        cursor += flags_len + 1;
+        if (strtoull(cursor, &source_end, 10) == source_len && *source_end == '\n' &&
+            (size_t) (data + len - source_end) > source_len + 1 &&
+            memcmp(source_end + 1, source, source_len) == 0 && source_end[source_len + 1] == '\n') {
+            signatures = source_end + source_len + 2;
+        }
+    }
+    cursor = signatures != NULL ? check_signatures(module, signatures) : NULL;
+
+    bool result = false;
+    if (cursor != NULL) {
+        MirParser parser;
+        mir_parser_init(&parser, path, cursor + 1, &module->hir->strings);
+        result = mir_parse_decl(&parser, module, decl);
+        mir_parser_free(&parser);
+    }
+    if (result)
+        set_object_key(key, signatures, cursor - signatures);
+
+    atomic_fetch_add(result ? &self->stats->mir_hits : &self->stats->mir_misses, 1);
+    free(data);
+    free(path);
+    return result;
+}
+
+void decl_cache_track_mir(self_t, Module *module, Decl *decl) {
+    DeclCacheKey *key = decl_key(self, module, decl);
+    if (key->entry == 0)
+        return;
+
+    Writer signatures;
+    writer_init_buffer(&signatures);
+    write_signatures(module, decl->mir, &signatures);
+    set_object_key(key, signatures.data, signatures.size);
+    writer_free(&signatures);
+}
+
+void decl_cache_forget_decls(self_t) {
+    free(self->keys);
+    self->keys = NULL;
+    self->key_count = 0;
+}
+
+void decl_cache_store_mir(self_t, Module *module, Decl *decl) {
+    DeclCacheKey *key = decl_key(self, module, decl);
+    if (key->entry == 0)
+        return;
+
+    const char *source;
+    size_t source_len;
+    module_decl_source(module, decl, &source, &source_len);
+
+    Writer out;
+    writer_init_buffer(&out);
+    writer_printf(&out, "%s\n%zu\n", self->flags, source_len);
+    writer_write(&out, source, source_len);
+    writer_puts(&out, "\n");
+
+    size_t signatures_start = out.size;
+    write_signatures(module, decl->mir, &out);
+    set_object_key(key, out.data + signatures_start, out.size - signatures_start);
+    writer_puts(&out, "\n");
+
+    MirDebugNames names = {
+        .strings = &module->hir->strings,
+        .decl_names = malloc(sizeof(char *) * module->decls.size),
+        .decl_count = module->decls.size,
+    };
+    for (DeclIndex i = 0; i < module->decls.size; i++) {
+        names.decl_names[i] = module_decl_name(module, decl_list_get(&module->decls, i));
+    }
+    mir_debug_write_named(decl->mir, &names, &out);
+    free(names.decl_names);
+
+    char *path = cache_path(self, key->entry, ".mir");
+    cache_write_file(path, out.data, out.size);
+    free(path);
+    writer_free(&out);
+}
+
+
+// SECTION: Objects
+
+bool decl_cache_has_object(self_t, Module *module, Decl *decl) {
+    DeclCacheKey *key = decl_key(self, module, decl);
+    bool result = false;
+    if (key->object != 0) {
+        char *path = cache_path(self, key->object, ".o");
+        result = access(path, R_OK) == 0;
+        free(path);
+    }
+
+    atomic_fetch_add(result ? &self->stats->object_hits : &self->stats->object_misses, 1);
+    return result;
+}
+
+bool decl_cache_load_object(self_t, Module *module, Decl *decl, const char *obj_path) {
+    DeclCacheKey *key = decl_key(self, module, decl);
+    assert(key->object != 0);
+
+    char *path = cache_path(self, key->object, ".o");
+    bool result = cache_copy_file(path, obj_path);
+    if (!result)
+        fprintf(stderr, "Could not read cached object %s\n", path);
+    free(path);
+    return result;
+}
+
+void decl_cache_store_object(self_t, Module *module, Decl *decl, const char *obj_path) {
+    DeclCacheKey *key = decl_key(self, module, decl);
+    if (key->object == 0)
+        return;
+
+    char *path = cache_path(self, key->object, ".o");
+    cache_copy_file(obj_path, path);
+    free(path);
+}
+
+void decl_cache_reset_stats(self_t) {
+    atomic_store(&self->stats->mir_hits, 0);
+    atomic_store(&self->stats->mir_misses, 0);
+    atomic_store(&self->stats->object_hits, 0);
+    atomic_store(&self->stats->object_misses, 0);
+}
+
+void decl_cache_print_stats(self_t, FILE *out) {
+    fprintf(out, "decl cache: mir %u hits, %u misses; objects %u hits, %u misses\n",
+            atomic_load(&self->stats->mir_hits), atomic_load(&self->stats->mir_misses),
+            atomic_load(&self->stats->object_hits), atomic_load(&self->stats->object_misses));
+}
+
+#undef self_t
@@ -13,8 +13,9 @@ void error_list_init(self_t) {
 }
 
 void error_list_free(self_t) {
-    //todo free all errors
-
+    // Messages are static strings for now, only the errors themselves are owned
+    for (uint32_t i = 0; i < self->size; i++)
+        TRACKED_FREE(self->data[i]);
     ARRAY_FREE(uint32_t, self->data);
     error_list_init(self);
 }
@@ -22,14 +23,15 @@ void error_list_free(self_t) {
 void error_list_add(self_t, CompileError error) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->data = ARRAY_GROW(CompileError *, self->data, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_COMPILE_ERROR, CompileError *, self->data, self->capacity);
     }
 
-    CompileError *owned = malloc(sizeof(CompileError));
+    CompileError *owned = TRACKED_MALLOC(ALLOC_TAG_COMPILE_ERROR, sizeof(CompileError));
     *owned = error;
 
     self->data[self->size] = owned;
     self->size++;
+    TRACK_USED(self->data, self->size * sizeof(CompileError *));
 }
 
 CompileError *error_list_get(self_t, uint32_t index) {
@@ -61,11 +61,12 @@ void hir_inst_list_free(self_t) {
 void hir_inst_list_add(self_t, HirInst inst) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->data = ARRAY_GROW(HirInst, self->data, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_HIR_INST_LIST, HirInst, self->data, self->capacity);
     }
 
     self->data[self->size] = inst;
     self->size++;
+    TRACK_USED(self->data, self->size * sizeof(HirInst));
 }
 
 HirInst *hir_inst_list_get(self_t, uint32_t index) {
@@ -78,6 +79,13 @@ HirInst *hir_inst_list_get(self_t, uint32_t index) {
 
 #define self_t Hir *self
 
+void hir_free(self_t) {
+    hir_inst_list_free(&self->instructions);
+    index_list_free(&self->extra);
+    string_set_free(&self->strings);
+    index_map_free(&self->string_literals);
+}
+
 HirInst *hir_get_inst(self_t, HirIndex index) {
     return &self->instructions.data[index];
 }
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stdlib.h>
 #include "interner.h"
 #include "array_util.h"
 
@@ -11,6 +12,8 @@ void string_set_init(self_t) {
 }
 
 void string_set_free(self_t) {
+    for (uint32_t i = 0; i < self->size; i++)
+        TRACKED_FREE(self->data[i]);
     ARRAY_FREE(uint32_t, self->data);
     string_set_init(self);
 }
@@ -18,11 +21,16 @@ void string_set_free(self_t) {
 static StringKey string_set_add_new(self_t, char *string) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->data = ARRAY_GROW(char *, self->data, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_STRING_SET, char *, self->data, self->capacity);
     }
 
-    self->data[self->size] = strdup(string);
+    size_t len = strlen(string);
+    char *owned = TRACKED_MALLOC(ALLOC_TAG_STRING_SET, len + 1);
+    memcpy(owned, string, len + 1);
+
+    self->data[self->size] = owned;
     self->size++;
+    TRACK_USED(self->data, self->size * sizeof(char *));
     return self->size - 1;
 }
 
@@ -1,5 +1,7 @@
 #include "ir_common.h"
 
+#include <string.h>
+
 Ref index_to_ref(uint32_t index) {
     return index + __REF_LAST;
 }
@@ -13,15 +15,107 @@ uint32_t ref_to_index(Ref ref) {
     }
 }
 
+#define SMALL_INT_NAMES(ty) \
+    #ty "_0", #ty "_1", #ty "_2", #ty "_3", #ty "_4", #ty "_5", #ty "_6", #ty "_7", \
+    #ty "_8", #ty "_9", #ty "_10", #ty "_11", #ty "_12", #ty "_13", #ty "_14", #ty "_15"
+
+static const char *ref_names[] = {
+        [RefNone] = "none",
+        [RefZero] = "zero",
+        [RefOne] = "one",
+        [RefTypeVoid] = "void_type",
+        [RefTypeI8] = "i8_type",
+        [RefTypeI16] = "i16_type",
+        [RefTypeI32] = "i32_type",
+        [RefTypeI64] = "i64_type",
+        [RefTypeI128] = "i128_type",
+        [RefTypeISize] = "isize_type",
+        [RefTypeF32] = "f32_type",
+        [RefTypeF64] = "f64_type",
+        [RefTypeBool] = "bool_type",
+        [RefVoidValue] = "void_value",
+        [RefBoolFalse] = "bool_false",
+        [RefBoolTrue] = "bool_true",
+        SMALL_INT_NAMES(i8), SMALL_INT_NAMES(i16), SMALL_INT_NAMES(i32), SMALL_INT_NAMES(i64),
+};
+
+#undef SMALL_INT_NAMES
+
+// Must be in the same order as the small int refs
+static const TypeTag small_int_types[REF_SMALL_INT_TYPE_COUNT] = {TypeI8, TypeI16, TypeI32, TypeI64};
+
+_Static_assert(sizeof(ref_names) / sizeof(ref_names[0]) == __REF_LAST, "Every known ref must have a name");
+_Static_assert(REF_SMALL_INT_COUNT == 16, "SMALL_INT_NAMES must match REF_SMALL_INT_COUNT");
+_Static_assert(RefTypeBool - RefTypeVoid == TypeBool - TY_VOID, "Type refs must match the simple type tags");
+
 char *ref_to_string(Ref ref) {
+    if (ref >= __REF_LAST)
+        return "unknown";
+    return (char *) ref_names[ref];
+}
+
+Ref ref_from_string(const char *name, size_t len) {
+    for (Ref ref = RefNone; ref < __REF_LAST; ref++) {
+        const char *ref_name = ref_names[ref];
+        if (strlen(ref_name) == len && strncmp(ref_name, name, len) == 0)
+            return ref;
+    }
+    return __REF_LAST;
+}
+
+Ref ref_from_type(Type type) {
+    TypeTag tag = type_tag(type);
+    if (type_is_extended(type) || tag < TY_VOID || tag > TypeBool)
+        return __REF_LAST;
+    return RefTypeVoid + (tag - TY_VOID);
+}
+
+bool ref_is_type(Ref ref) {
+    return ref >= RefTypeVoid && ref <= RefTypeBool;
+}
+
+Type ref_to_type(Ref ref) {
+    assert(ref_is_type(ref));
+    return (Type) {.tag = TY_VOID + (ref - RefTypeVoid)};
+}
+
+Ref ref_from_int(Type type, uint64_t value) {
+    if (type_is_extended(type) || value >= REF_SMALL_INT_COUNT)
+        return __REF_LAST;
+
+    if (type.tag == TypeBool)
+        return value == 0 ? RefBoolFalse : RefBoolTrue;
+    for (uint32_t i = 0; i < REF_SMALL_INT_TYPE_COUNT; i++) {
+        if (small_int_types[i] == type.tag)
+            return RefSmallIntFirst + i * REF_SMALL_INT_COUNT + value;
+    }
+    return __REF_LAST;
+}
+
+TypeTag ref_value_type(Ref ref) {
+    if (ref >= RefSmallIntFirst && ref <= RefSmallIntLast)
+        return small_int_types[(ref - RefSmallIntFirst) / REF_SMALL_INT_COUNT];
+
+    switch (ref) {
+        case RefVoidValue:
+            return TY_VOID;
+        case RefBoolFalse:
+        case RefBoolTrue:
+            return TypeBool;
+        default:
+            return TypeUnknown;
+    }
+}
+
+uint64_t ref_int_value(Ref ref) {
+    if (ref >= RefSmallIntFirst && ref <= RefSmallIntLast)
+        return (ref - RefSmallIntFirst) % REF_SMALL_INT_COUNT;
+
     switch (ref) {
-        case RefNone:
-            return "none";
-        case RefZero:
-            return "zero";
         case RefOne:
-            return "one";
+        case RefBoolTrue:
+            return 1;
         default:
-            return "unknown";
+            return 0;
     }
 }
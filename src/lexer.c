@@ -2,6 +2,8 @@
 #include "lexer_internal.h"
 #include "array_util.h"
 
+#include <string.h>
+
 #define self_t TokenList *self
 
 void token_list_init(self_t) {
@@ -18,11 +20,67 @@ void token_list_free(self_t) {
 void token_list_insert(self_t, Token token) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->data = ARRAY_GROW(Token, self->data, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_TOKEN_LIST, Token, self->data, self->capacity);
     }
 
     self->data[self->size] = token;
     self->size++;
+    TRACK_USED(self->data, self->size * sizeof(Token));
+}
+
+#undef self_t
+
+#define self_t LineIndex *self
+
+void line_index_init(self_t) {
+    self->size = 0;
+    self->capacity = 0;
+    self->data = NULL;
+}
+
+void line_index_free(self_t) {
+    ARRAY_FREE(uint32_t, self->data);
+    line_index_init(self);
+}
+
+void line_index_add(self_t, uint32_t line_start) {
+    if (self->capacity < self->size + 1) {
+        self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
+        self->data = ARRAY_GROW(uint32_t, self->data, self->capacity);
+    }
+
+    self->data[self->size] = line_start;
+    self->size++;
+    TRACK_USED(self->data, self->size * sizeof(uint32_t));
+}
+
+SourceLoc line_index_lookup(self_t, uint32_t offset) {
+    assert(self->size > 0);
+
+    // Last line starting at or before offset
+    uint32_t low = 0, high = self->size;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (self->data[mid] <= offset) low = mid;
+        else high = mid;
+    }
+
+    return (SourceLoc) {.line = low + 1, .col = offset - self->data[low]};
+}
+
+TokenLoc line_index_line(self_t, const uint8_t *source, uint32_t line) {
+    assert(line > 0 && line <= self->size);
+
+    size_t start = self->data[line - 1];
+    size_t end;
+    if (line < self->size) {
+        end = self->data[line] - 1;
+    } else {
+        end = start + strcspn((const char *) source + start, "\n");
+    }
+    if (end > start && source[end - 1] == '\r') end--;
+
+    return (TokenLoc) {.start = start, .end = end};
 }
 
 #undef self_t
@@ -33,6 +91,7 @@ void lexer_init(self_t, const uint8_t *source) {
     self->origin = (size_t) source;
     self->start = source;
     self->current = source;
+    self->lines = NULL;
 }
 
 Token lexer_next(self_t) {
@@ -38,6 +38,12 @@ uint8_t lex_advance(self_t) {
     return self->current[-1];
 }
 
+// Called after advancing past a line break
+static void lex_record_line(self_t) {
+    if (self->lines != NULL)
+        line_index_add(self->lines, (uint32_t) ((size_t) self->current - self->origin));
+}
+
 bool lex_match(self_t, uint8_t c) {
     if (lex_at_end(self)) return false;
     if (*self->current != c) return false;
@@ -78,8 +84,11 @@ void lex_skip_trivia(self_t) {
             case ' ':
             case '\t':
             case '\r':
+                lex_advance(self);
+                break;
             case '\n':
                 lex_advance(self);
+                lex_record_line(self);
                 break;
             case '/':
                 // If there are two slashes, its a comment. Ignore until end of line.
@@ -122,11 +131,18 @@ Token lex_number(self_t) {
 Token lex_string(self_t) {
     uint8_t next;
     while ((next = lex_peek0(self)) != '"' && !lex_at_end(self)) {
-        if (next == '\n') assert(false);
+        // Strings end on their line, the newline is left for the next token
+        if (next == '\n')
+            return new_token_error(self, "Unterminated string");
         lex_advance(self);
+
+        // Skip the escaped character so that \" does not end the string. Escapes are decoded during lowering.
+        if (next == '\\' && !lex_at_end(self) && lex_advance(self) == '\n')
+            lex_record_line(self);
     }
 
-    if (lex_at_end(self)) assert(false); // Unterminated string
+    if (lex_at_end(self))
+        return new_token_error(self, "Unterminated string");
 
     lex_advance(self); // Eat the closing quote
     return new_token(self, TOK_STRING);
@@ -2,6 +2,8 @@
 
 #include "array_util.h"
 
+#include <string.h>
+
 
 char *mir_tag_to_string(MirInstTag tag) {
     switch (tag) {
@@ -51,42 +53,129 @@ char *mir_tag_to_string(MirInstTag tag) {
     }
 }
 
+MirInstTag mir_tag_from_string(const char *name, size_t len) {
+    for (MirInstTag tag = MirReserved + 1; tag < __MIR_LAST; tag++) {
+        char *tag_name = mir_tag_to_string(tag);
+        if (strlen(tag_name) == len && strncmp(tag_name, name, len) == 0)
+            return tag;
+    }
+    return MirReserved;
+}
+
+// SECTION: Type pool
+
+#define self_t MirTypePool *self
+
+void mir_type_pool_init(self_t) {
+    self->size = 0;
+    self->capacity = 0;
+    self->data = NULL;
+}
+
+void mir_type_pool_free(self_t) {
+    ARRAY_FREE(Type, self->data);
+    mir_type_pool_init(self);
+}
+
+static bool type_same(Type lhs, Type rhs) {
+    if (!type_is_extended(lhs) || !type_is_extended(rhs))
+        return lhs.tag == rhs.tag;
+    if (lhs.extended->tag != rhs.extended->tag)
+        return false;
+
+    assert(lhs.extended->tag == TY_PTR);
+    return type_same(lhs.extended->data.inner_type, rhs.extended->data.inner_type);
+}
+
+MirTypeIndex mir_type_pool_add(self_t, Type type) {
+    if (!type_is_extended(type))
+        return type.tag;
+
+    // Functions only use a handful of extended types, so a linear search is fine
+    for (uint32_t i = 0; i < self->size; i++) {
+        if (type_same(self->data[i], type))
+            return __TYPE_LAST + i;
+    }
+
+    if (self->capacity < self->size + 1) {
+        self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
+        self->data = ARRAY_GROW(Type, self->data, self->capacity);
+    }
+    self->data[self->size] = type;
+    self->size++;
+    return __TYPE_LAST + self->size - 1;
+}
+
+Type mir_type_pool_get(self_t, MirTypeIndex index) {
+    if (index < __TYPE_LAST)
+        return (Type) {.tag = (TypeTag) index};
+
+    assert(index - __TYPE_LAST < self->size);
+    return self->data[index - __TYPE_LAST];
+}
+
+#undef self_t
+
+// SECTION: Instructions
+
+_Static_assert(__MIR_LAST <= UINT8_MAX, "MIR tags are stored in a byte");
+_Static_assert(sizeof(MirInstData) == 8, "MIR instruction data must stay 8 bytes");
+
 #define self_t MirInstList *self
 
 void mir_inst_list_init(self_t) {
     self->size = 0;
     self->capacity = 0;
+    self->tags = NULL;
     self->data = NULL;
 }
 
 void mir_inst_list_free(self_t) {
-    ARRAY_FREE(MirInst, self->data);
+    ARRAY_FREE(uint8_t, self->tags);
+    ARRAY_FREE(MirInstData, self->data);
     mir_inst_list_init(self);
 }
 
-void mir_inst_list_add(self_t, MirInst inst) {
+void mir_inst_list_add(self_t, MirInstTag tag, MirInstData data) {
     if (self->capacity < self->size + 1) {
         self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
-        self->data = ARRAY_GROW(MirInst, self->data, self->capacity);
+        self->tags = ARRAY_GROW_TAGGED(ALLOC_TAG_MIR_INST_LIST, uint8_t, self->tags, self->capacity);
+        self->data = ARRAY_GROW_TAGGED(ALLOC_TAG_MIR_INST_LIST, MirInstData, self->data, self->capacity);
     }
 
-    self->data[self->size] = inst;
+    self->tags[self->size] = (uint8_t) tag;
+    self->data[self->size] = data;
     self->size++;
+    TRACK_USED(self->tags, self->size * sizeof(uint8_t));
+    TRACK_USED(self->data, self->size * sizeof(MirInstData));
+}
+
+void mir_inst_list_set(self_t, uint32_t index, MirInstTag tag, MirInstData data) {
+    assert(index < self->size);
+    self->tags[index] = (uint8_t) tag;
+    self->data[index] = data;
 }
 
-MirInst *mir_inst_list_get(self_t, uint32_t index) {
-    if (index < self->size)
-        return &self->data[index];
-    return NULL;
+MirInst mir_inst_list_get(self_t, uint32_t index) {
+    assert(index < self->size);
+    return (MirInst) {(MirInstTag) self->tags[index], self->data[index]};
 }
 
 #undef self_t
 
 
+// SECTION: MIR
+
 #define self_t Mir *self
 
 void mir_add_inst(self_t, MirInstTag tag, MirInstData data) {
-    mir_inst_list_add(&self->instructions, (MirInst) {tag, data});
+    mir_inst_list_add(&self->instructions, tag, data);
+}
+
+void mir_free(self_t) {
+    mir_inst_list_free(&self->instructions);
+    index_list_free(&self->extra);
+    mir_type_pool_free(&self->types);
 }
 
-#undef self_t
\ No newline at end of file
+#undef self_t
@@ -0,0 +1,665 @@
+#include "mir_parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_util.h"
+#include "alloc_tracker.h"
+#include "module.h"
+
+#define self_t MirParser *self
+
+void mir_parser_init(self_t, const char *path, const char *source, StringSet *strings) {
+    self->path = path;
+    self->cursor = source;
+    self->line = 1;
+    self->strings = strings;
+    string_set_init(&self->fn_names);
+}
+
+void mir_parser_free(self_t) {
+    string_set_free(&self->fn_names);
+}
+
+static bool error(self_t, const char *message) {
+    fprintf(stderr, "%s:%u: %s\n", self->path != NULL ? self->path : "<mir>", self->line, message);
+    return false;
+}
+
+// SECTION: Lexing helpers
+
+static inline bool is_ident_start(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static void skip_spaces(self_t) {
+    while (*self->cursor == ' ' || *self->cursor == '\t' || *self->cursor == '\r')
+        self->cursor++;
+}
+
+// Skips spaces and a trailing comment, then expects the end of the line (or input).
+static bool expect_line_end(self_t) {
+    skip_spaces(self);
+    if (self->cursor[0] == '/' && self->cursor[1] == '/') {
+        while (*self->cursor != '\n' && *self->cursor != '\0')
+            self->cursor++;
+    }
+
+    if (*self->cursor == '\n') {
+        self->cursor++;
+        self->line++;
+        return true;
+    }
+    if (*self->cursor == '\0')
+        return true;
+    return error(self, "Expected end of line");
+}
+
+// Skips lines containing only spaces and comments.
+static void skip_blank_lines(self_t) {
+    while (true) {
+        const char *start = self->cursor;
+        skip_spaces(self);
+        bool comment = self->cursor[0] == '/' && self->cursor[1] == '/';
+        if (*self->cursor == '\0' || (*self->cursor != '\n' && !comment)) {
+            self->cursor = start;
+            return;
+        }
+        expect_line_end(self);
+    }
+}
+
+static bool expect(self_t, char c) {
+    skip_spaces(self);
+    if (*self->cursor != c) {
+        char message[32];
+        snprintf(message, sizeof(message), "Expected '%c'", c);
+        return error(self, message);
+    }
+    self->cursor++;
+    return true;
+}
+
+static bool accept(self_t, char c) {
+    skip_spaces(self);
+    if (*self->cursor != c)
+        return false;
+    self->cursor++;
+    return true;
+}
+
+// Sets `len` to the length of the identifier at the cursor, which is 0 if there is none.
+static const char *parse_ident(self_t, size_t *len) {
+    skip_spaces(self);
+    const char *start = self->cursor;
+    if (is_ident_start(*self->cursor)) {
+        while (is_ident_start(*self->cursor) || is_digit(*self->cursor))
+            self->cursor++;
+    }
+    *len = self->cursor - start;
+    return start;
+}
+
+static bool accept_keyword(self_t, const char *keyword) {
+    const char *start = self->cursor;
+    size_t len;
+    const char *ident = parse_ident(self, &len);
+    if (len == strlen(keyword) && strncmp(ident, keyword, len) == 0)
+        return true;
+
+    self->cursor = start;
+    return false;
+}
+
+static bool parse_uint(self_t, uint32_t *out) {
+    skip_spaces(self);
+    if (!is_digit(*self->cursor))
+        return error(self, "Expected a number");
+
+    uint64_t value = 0;
+    while (is_digit(*self->cursor)) {
+        value = value * 10 + (*self->cursor - '0');
+        if (value > UINT32_MAX)
+            return error(self, "Number out of range");
+        self->cursor++;
+    }
+    *out = (uint32_t) value;
+    return true;
+}
+
+// Constants are printed as signed 32 bit values, but stored as their bits.
+static bool parse_int(self_t, uint32_t *out) {
+    bool negative = accept(self, '-');
+    uint32_t value;
+    if (!parse_uint(self, &value))
+        return false;
+    if (value > (negative ? (uint32_t) INT32_MAX + 1 : UINT32_MAX))
+        return error(self, "Number out of range");
+
+    *out = negative ? (uint32_t) -(int64_t) value : value;
+    return true;
+}
+
+static int hex_value(char c) {
+    if (is_digit(c)) return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Reads a string literal with the escapes written by the MIR printer. The caller owns the returned string.
+static char *parse_string(self_t) {
+    if (!expect(self, '"'))
+        return NULL;
+
+    size_t size = 0;
+    size_t capacity = 16;
+    char *string = malloc(capacity);
+    while (*self->cursor != '"') {
+        char c = *self->cursor;
+        if (c == '\0' || c == '\n') {
+            free(string);
+            error(self, "Unterminated string literal");
+            return NULL;
+        }
+
+        if (c == '\\') {
+            self->cursor++;
+            switch (*self->cursor) {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case '"': c = '"'; break;
+                case '\\': c = '\\'; break;
+                case 'x': {
+                    int high = hex_value(self->cursor[1]);
+                    int low = high < 0 ? -1 : hex_value(self->cursor[2]);
+                    if (low < 0 || (high == 0 && low == 0)) {
+                        free(string);
+                        error(self, "Invalid hex escape");
+                        return NULL;
+                    }
+                    c = (char) (high * 16 + low);
+                    self->cursor += 2;
+                    break;
+                }
+                default:
+                    free(string);
+                    error(self, "Unknown escape sequence");
+                    return NULL;
+            }
+        }
+        self->cursor++;
+
+        if (size + 2 > capacity) {
+            capacity *= 2;
+            string = realloc(string, capacity);
+        }
+        string[size++] = c;
+    }
+    self->cursor++;
+
+    string[size] = '\0';
+    return string;
+}
+
+// Reads a type written by `type_to_string`, eg `i32` or `*i8`.
+static bool parse_type(self_t, Type *out) {
+    if (accept(self, '*')) {
+        Type inner;
+        if (!parse_type(self, &inner))
+            return false;
+
+        ExtendedType *extended = TRACKED_MALLOC(ALLOC_TAG_EXTENDED_TYPE, sizeof(ExtendedType));
+        extended->tag = TY_PTR;
+        extended->data.inner_type = inner;
+        *out = (Type) {.extended = extended};
+        return true;
+    }
+
+    size_t len;
+    const char *name = parse_ident(self, &len);
+    for (TypeTag tag = TY_VOID; tag <= TypeBool; tag++) {
+        char *tag_name = type_tag_to_string(tag);
+        if (len != 0 && strlen(tag_name) == len && strncmp(tag_name, name, len) == 0) {
+            *out = (Type) {.tag = tag};
+            return true;
+        }
+    }
+    return error(self, "Expected a type");
+}
+
+// SECTION: Function bodies
+
+typedef struct {
+    MirInstList instructions;
+    IndexList extra;
+    MirTypePool types;
+    // Indices in the order they were defined
+    IndexList order;
+} FnBuilder;
+
+static bool parse_fn_type(self_t, FnBuilder *fn, MirTypeIndex *out) {
+    Type type;
+    if (!parse_type(self, &type))
+        return false;
+    *out = mir_type_pool_add(&fn->types, type);
+    return true;
+}
+
+static bool is_defined(FnBuilder *fn, MirIndex index) {
+    return index < fn->instructions.size && mir_inst_list_tag(&fn->instructions, index) != MirReserved;
+}
+
+static bool parse_ref(self_t, FnBuilder *fn, Ref *out) {
+    skip_spaces(self);
+    if (accept(self, '@')) {
+        size_t len;
+        const char *name = parse_ident(self, &len);
+        if (len != 3 || strncmp(name, "ref", 3) != 0 || !expect(self, '.'))
+            return error(self, "Expected '@ref.<name>'");
+
+        name = parse_ident(self, &len);
+        Ref ref = ref_from_string(name, len);
+        if (ref == __REF_LAST)
+            return error(self, "Unknown ref");
+        *out = ref;
+        return true;
+    }
+
+    MirIndex index;
+    if (!expect(self, '%') || !parse_uint(self, &index))
+        return false;
+
+    if (index == 0 || !is_defined(fn, index))
+        return error(self, "Use of an undefined instruction");
+    *out = index_to_ref(index);
+    return true;
+}
+
+static bool parse_bin_op(self_t, FnBuilder *fn, MirInstData *data) {
+    return parse_ref(self, fn, &data->bin_op.lhs) &&
+           expect(self, ',') &&
+           parse_ref(self, fn, &data->bin_op.rhs);
+}
+
+// `call(<fn>, args=_)` or `call(<fn>, args=<ref>, <ref>...)`
+static bool parse_call(self_t, FnBuilder *fn, MirInstData *data) {
+    if (!parse_ref(self, fn, &data->pl_op.operand) || !expect(self, ','))
+        return false;
+    if (!accept_keyword(self, "args") || !expect(self, '='))
+        return error(self, "Expected 'args='");
+
+    IndexList args;
+    index_list_init(&args);
+    if (!accept(self, '_')) {
+        do {
+            Ref arg;
+            if (!parse_ref(self, fn, &arg)) {
+                index_list_free(&args);
+                return false;
+            }
+            index_list_add(&args, arg);
+        } while (accept(self, ','));
+    }
+
+    data->pl_op.payload = fn->extra.size;
+    index_list_add(&fn->extra, args.size);
+    for (uint32_t i = 0; i < args.size; i++) {
+        index_list_add(&fn->extra, args.data[i]);
+    }
+    index_list_free(&args);
+    return true;
+}
+
+static bool parse_constant(self_t, FnBuilder *fn, MirInstData *data) {
+    if (!parse_fn_type(self, fn, &data->ty_pl.ty) || !expect(self, ','))
+        return false;
+
+    skip_spaces(self);
+    if (*self->cursor != '"')
+        return parse_int(self, &data->ty_pl.payload);
+
+    if (type_tag(mir_type_pool_get(&fn->types, data->ty_pl.ty)) != TY_PTR || self->strings == NULL)
+        return error(self, "String literals are only allowed for pointer constants");
+    char *string = parse_string(self);
+    if (string == NULL)
+        return false;
+    data->ty_pl.payload = string_set_add(self->strings, string);
+    free(string);
+    return true;
+}
+
+static bool parse_inst_data(self_t, FnBuilder *fn, MirInstTag tag, uint32_t param_count, MirInstData *data) {
+    switch (tag) {
+        case MirAdd:
+        case MirSub:
+        case MirMul:
+        case MirDiv:
+        case MirEq:
+        case MirNEq:
+        case MirGt:
+        case MirGtEq:
+        case MirLt:
+        case MirLtEq:
+        case MirStore:
+            return parse_bin_op(self, fn, data);
+        case MirLoad:
+        case MirRet:
+            return parse_ref(self, fn, &data->un_op);
+        case MirConstant:
+            return parse_constant(self, fn, data);
+        case MirAlloc:
+            return parse_fn_type(self, fn, &data->ty);
+        case MirArg:
+            if (!parse_fn_type(self, fn, &data->ty_pl.ty) || !expect(self, ',') || !parse_uint(self, &data->ty_pl.payload))
+                return false;
+            if (param_count != UINT32_MAX && data->ty_pl.payload >= param_count)
+                return error(self, "Argument index out of range");
+            return true;
+        case MirCall:
+            return parse_call(self, fn, data);
+        case MirFnPtr: {
+            size_t len;
+            const char *name = parse_ident(self, &len);
+            if (len == 0)
+                return error(self, "Expected a function name");
+            // Resolved to a decl index by the caller, see `MirParser.fn_names`
+            char *owned_name = strndup(name, len);
+            data->fn_decl = string_set_add(&self->fn_names, owned_name);
+            free(owned_name);
+            return true;
+        }
+        default:
+            return error(self, "Instruction cannot appear in a function body");
+    }
+}
+
+// `%<index> = <tag>(<operands>)`
+static bool parse_inst(self_t, FnBuilder *fn, uint32_t param_count) {
+    MirIndex index;
+    if (!expect(self, '%') || !parse_uint(self, &index) || !expect(self, '='))
+        return false;
+    if (index == 0)
+        return error(self, "%0 is reserved for the root block");
+
+    if (is_defined(fn, index))
+        return error(self, "Instruction index defined twice");
+
+    size_t len;
+    const char *name = parse_ident(self, &len);
+    MirInstTag tag = mir_tag_from_string(name, len);
+    if (tag == MirReserved)
+        return error(self, "Unknown instruction");
+
+    MirInstData data = {};
+    if (!expect(self, '(') || !parse_inst_data(self, fn, tag, param_count, &data) || !expect(self, ')'))
+        return false;
+
+    // Instructions are stored at the index they were written with, unused indices stay reserved.
+    while (fn->instructions.size <= index) {
+        mir_inst_list_add(&fn->instructions, MirReserved, (MirInstData) {});
+    }
+    mir_inst_list_set(&fn->instructions, index, tag, data);
+    index_list_add(&fn->order, index);
+
+    return expect_line_end(self);
+}
+
+static void mark_ref(BitSet *operands, Ref ref) {
+    if (ref > __REF_LAST)
+        bit_set_set(operands, ref_to_index(ref));
+}
+
+// Marks every instruction used as an operand, the rest are statements of the root block.
+static void mark_operands(FnBuilder *fn, BitSet *operands) {
+    for (uint32_t i = 0; i < fn->order.size; i++) {
+        MirInst inst = mir_inst_list_get(&fn->instructions, fn->order.data[i]);
+        switch (inst.tag) {
+            case MirLoad:
+            case MirRet:
+                mark_ref(operands, inst.data.un_op);
+                break;
+            case MirCall: {
+                mark_ref(operands, inst.data.pl_op.operand);
+                MirIndex extra_index = inst.data.pl_op.payload;
+                uint32_t arg_count = fn->extra.data[extra_index];
+                for (MirIndex j = extra_index + 1; j <= extra_index + arg_count; j++) {
+                    mark_ref(operands, fn->extra.data[j]);
+                }
+                break;
+            }
+            case MirConstant:
+            case MirAlloc:
+            case MirArg:
+            case MirFnPtr:
+                break;
+            default:
+                mark_ref(operands, inst.data.bin_op.lhs);
+                mark_ref(operands, inst.data.bin_op.rhs);
+                break;
+        }
+    }
+}
+
+static void fn_builder_free(FnBuilder *fn) {
+    mir_inst_list_free(&fn->instructions);
+    index_list_free(&fn->extra);
+    index_list_free(&fn->order);
+    mir_type_pool_free(&fn->types);
+}
+
+bool mir_parse_fn(self_t, uint32_t param_count, Mir *mir) {
+    FnBuilder fn;
+    mir_inst_list_init(&fn.instructions);
+    index_list_init(&fn.extra);
+    index_list_init(&fn.order);
+    mir_type_pool_init(&fn.types);
+
+    // The root block is always the first instruction
+    mir_inst_list_add(&fn.instructions, MirReserved, (MirInstData) {});
+
+    while (true) {
+        skip_blank_lines(self);
+        skip_spaces(self);
+        if (*self->cursor == '\0')
+            break;
+        if (*self->cursor == '}') {
+            self->cursor++;
+            if (!expect_line_end(self)) {
+                fn_builder_free(&fn);
+                return false;
+            }
+            break;
+        }
+
+        if (!parse_inst(self, &fn, param_count)) {
+            fn_builder_free(&fn);
+            return false;
+        }
+    }
+
+    // Block data goes after any call data, like in lowered MIR
+    BitSet operands;
+    bit_set_init(&operands, fn.instructions.size);
+    mark_operands(&fn, &operands);
+
+    MirIndex data_index = fn.extra.size;
+    index_list_add(&fn.extra, 0);
+    for (uint32_t i = 0; i < fn.order.size; i++) {
+        if (bit_set_get(&operands, fn.order.data[i]))
+            continue;
+        index_list_add(&fn.extra, fn.order.data[i]);
+        fn.extra.data[data_index]++;
+    }
+    bit_set_free(&operands);
+
+    mir_inst_list_set(&fn.instructions, 0, MirBlock, (MirInstData) {.ty_pl = {.payload = data_index}});
+    index_list_free(&fn.order);
+
+    *mir = (Mir) {
+        .instructions = fn.instructions,
+        .extra = fn.extra,
+        .types = fn.types,
+    };
+    return true;
+}
+
+// SECTION: Modules
+
+// `[foreign] fn <name>(<type>, ...) [<type>]`, followed by `{` unless foreign.
+static bool parse_fn_header(self_t, Module *module, Decl *decl, bool *foreign) {
+    *foreign = accept_keyword(self, "foreign");
+    if (!accept_keyword(self, "fn"))
+        return error(self, "Expected 'fn'");
+
+    size_t len;
+    const char *name = parse_ident(self, &len);
+    if (len == 0)
+        return error(self, "Expected a function name");
+
+    char *owned_name = strndup(name, len);
+    if (module_find_decl(module, owned_name) != NULL) {
+        free(owned_name);
+        return error(self, "Function defined twice");
+    }
+    decl->name = string_set_add(&module->hir->strings, owned_name);
+    free(owned_name);
+
+    if (!expect(self, '('))
+        return false;
+
+    uint32_t param_count = 0;
+    uint32_t param_capacity = 0;
+    Type *param_types = NULL;
+    if (!accept(self, ')')) {
+        do {
+            if (param_count == param_capacity) {
+                param_capacity = ARRAY_GROW_CAPCITY(param_capacity);
+                param_types = realloc(param_types, sizeof(Type) * param_capacity);
+            }
+            if (!parse_type(self, &param_types[param_count])) {
+                free(param_types);
+                return false;
+            }
+            param_count++;
+        } while (accept(self, ','));
+
+        if (!expect(self, ')')) {
+            free(param_types);
+            return false;
+        }
+    }
+
+    Type ret_type = {.tag = TY_VOID};
+    skip_spaces(self);
+    if (*self->cursor != '{' && *self->cursor != '\n' && *self->cursor != '\0' && *self->cursor != '/') {
+        if (!parse_type(self, &ret_type)) {
+            free(param_types);
+            return false;
+        }
+    }
+
+    DeclFnData *fn_data = malloc(sizeof(DeclFnData));
+    *fn_data = (DeclFnData) {
+        .ret_type = ret_type,
+        .param_count = param_count,
+        .param_types = param_types,
+    };
+    decl->data.fn_data = fn_data;
+
+    if (!*foreign && !expect(self, '{'))
+        return false;
+    return expect_line_end(self);
+}
+
+// Function refs are parsed as keys in `fn_names`, which become decl indices once every decl is known.
+static bool resolve_fn_refs_in(self_t, Module *module, Mir *mir, Decl *owner) {
+    for (MirIndex j = 0; j < mir->instructions.size; j++) {
+        if (mir_inst_list_tag(&mir->instructions, j) != MirFnPtr)
+            continue;
+
+        MirInstData *data = &mir->instructions.data[j];
+        char *name = string_set_get(&self->fn_names, data->fn_decl);
+        Decl *target = module_find_decl(module, name);
+        if (target == NULL) {
+            fprintf(stderr, "%s: Reference to undefined function %s in %s\n",
+                    self->path != NULL ? self->path : "<mir>", name, module_decl_name(module, owner));
+            return false;
+        }
+        data->fn_decl = (DeclIndex) (target - module->decls.data);
+    }
+    return true;
+}
+
+static bool resolve_fn_refs(self_t, Module *module) {
+    for (DeclIndex i = 0; i < module->decls.size; i++) {
+        Mir *mir = module->decls.data[i].mir;
+        if (mir != NULL && !resolve_fn_refs_in(self, module, mir, &module->decls.data[i]))
+            return false;
+    }
+    return true;
+}
+
+bool mir_parse_decl(self_t, Module *module, Decl *decl) {
+    assert(decl->mir == NULL);
+
+    Mir mir;
+    if (!mir_parse_fn(self, decl->data.fn_data->param_count, &mir))
+        return false;
+    if (!resolve_fn_refs_in(self, module, &mir, decl)) {
+        mir_free(&mir);
+        return false;
+    }
+
+    decl->mir = malloc(sizeof(Mir));
+    *decl->mir = mir;
+    return true;
+}
+
+bool mir_parse_module(self_t, Module *module) {
+    assert(module->ast == NULL && module->hir == NULL);
+
+    // Decl names are looked up in the HIR string set, which is the only part of the HIR that is present.
+    module->hir = malloc(sizeof(Hir));
+    hir_inst_list_init(&module->hir->instructions);
+    index_list_init(&module->hir->extra);
+    string_set_init(&module->hir->strings);
+    index_map_init(&module->hir->string_literals);
+    self->strings = &module->hir->strings;
+
+    while (true) {
+        skip_blank_lines(self);
+        if (*self->cursor == '\0')
+            break;
+
+        Decl decl = {
+            .state = DeclStateUnused,
+            .ast_index = ast_index_empty,
+            .mir = NULL,
+        };
+        bool foreign;
+        if (!parse_fn_header(self, module, &decl, &foreign))
+            return false;
+
+        if (foreign) {
+            decl.state = DeclStateGenerated;
+        } else {
+            Mir mir;
+            if (!mir_parse_fn(self, decl.data.fn_data->param_count, &mir))
+                return false;
+            decl.mir = malloc(sizeof(Mir));
+            *decl.mir = mir;
+        }
+
+        decl_list_add(&module->decls, decl);
+    }
+
+    return resolve_fn_refs(self, module);
+}
+
+#undef self_t
@@ -2,47 +2,45 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 #include "array_util.h"
 #include "parser.h"
 #include "ast_to_mir.h"
 #include "ast_lowering.h"
+#include "mir_parser.h"
+#include "writer.h"
+#include "debug/mir_debug.h"
+#include "native/x64.h"
+#include "time_report.h"
+
+extern char **environ;
 
 // SECTION: Declaration
 
 #define self_t Decl *self
 
-void decl_init_from_ast(self_t, Ast *ast, AstIndex ast_index) {
-    AstNode *node = ast_get_node_tagged(ast, ast_index, AST_NAMED_FN);
-    Token name_token = ast->tokens.data[node->main_token + 1];
-
-    size_t str_len = name_token.loc.end - name_token.loc.start;
-    char *name = malloc(str_len + 1);
-    memcpy(name, (const void *) name_token.loc.start, str_len);
-    name[str_len] = '\0';
-
-    self->name = name;
-    self->state = DeclStateUnused;
-    self->ast_index = ast_index;
-    self->mir = NULL;
-    self->llvm_value = NULL;
-}
-
-void decl_free(self_t) {
-    free(self->name);
-    self->name = NULL;
-//    mir_free(self->mir); //todo
-    self->mir = NULL;
-}
-
 Mir *decl_get_mir_in_module(self_t, Module *module) {
     if (self->mir == NULL) {
-        AstToMir lowering;
-        ast_to_mir_init(&lowering, module->ast);
-        Mir mir = lower_ast_fn(&lowering, self->ast_index);
-
-        self->mir = malloc(sizeof(Mir));
-        *self->mir = mir;
+        TimeSpan span = time_phase_begin(TIME_PHASE_MIR);
+        if (module->decl_cache == NULL || !decl_cache_load_mir(module->decl_cache, module, self)) {
+            AstToMir lowering;
+            ast_to_mir_init(&lowering, module->ast, &module->hir->strings);
+            lowering.string_literals = &module->hir->string_literals;
+            Mir mir = lower_ast_fn(&lowering, self->ast_index);
+            ast_to_mir_free(&lowering);
+
+            self->mir = malloc(sizeof(Mir));
+            *self->mir = mir;
+            if (module->decl_cache != NULL)
+                decl_cache_store_mir(module->decl_cache, module, self);
+        }
+        time_phase_end_detail(&span, module_decl_name(module, self), self->mir->instructions.size);
     }
 
     return self->mir;
@@ -89,32 +87,83 @@ Decl *decl_list_get(self_t, DeclIndex index) {
 
 void module_init(self_t, char *path) {
     self->path = path;
-    self->name = strrchr(path, '/') + 1;
+    char *slash = strrchr(path, '/');
+    self->name = slash != NULL ? slash + 1 : path;
 
     self->ast = NULL;
     self->hir = NULL;
     decl_list_init(&self->decls);
-    self->codegen = NULL;
+    self->units = NULL;
+    self->unit_count = 0;
+    self->options = CODEGEN_OPTIONS_DEFAULT;
+    self->decl_cache = NULL;
+    self->shared_context = NULL;
 }
 
-void module_free(self_t) {
-    if (self->codegen != NULL) {
-        codegen_free(self->codegen);
-        free(self->codegen);
-        self->codegen = NULL;
+static void module_free_units(self_t) {
+    for (uint32_t i = 0; i < self->unit_count; i++) {
+        codegen_free(&self->units[i]);
+    }
+    free(self->units);
+    self->units = NULL;
+    self->unit_count = 0;
+}
+
+static void free_decls(DeclList *decls) {
+    for (DeclIndex i = 0; i < decls->size; i++) {
+        Decl *decl = &decls->data[i];
+        if (decl->mir != NULL) {
+            mir_free(decl->mir);
+            free(decl->mir);
+        }
+        if (decl->data.fn_data != NULL) {
+            free(decl->data.fn_data->param_types);
+            free(decl->data.fn_data);
+        }
     }
-    decl_list_free(&self->decls);
-    if (self->ast) {
-//        ast_free(self->ast); //todo
-        free(self->codegen);
-        self->ast = NULL;
+    decl_list_free(decls);
+}
+
+static void free_ast_and_hir(Ast *ast, Hir *hir) {
+    if (ast != NULL) {
+        ast_free(ast);
+        free(ast);
+    }
+    if (hir != NULL) {
+        hir_free(hir);
+        free(hir);
+    }
+}
+
+void module_free(self_t) {
+    module_free_units(self);
+    free_decls(&self->decls);
+    if (self->decl_cache != NULL) {
+        decl_cache_free(self->decl_cache);
+        free(self->decl_cache);
+        self->decl_cache = NULL;
     }
+    free_ast_and_hir(self->ast, self->hir);
+    self->ast = NULL;
+    self->hir = NULL;
 
     self->name = NULL;
     self->path = NULL;
 
 }
 
+bool module_enable_decl_cache(self_t, const char *dir) {
+    assert(self->decl_cache == NULL);
+
+    DeclCache *cache = malloc(sizeof(DeclCache));
+    if (!decl_cache_init(cache, dir, &self->options)) {
+        free(cache);
+        return false;
+    }
+    self->decl_cache = cache;
+    return true;
+}
+
 
 static uint8_t *read_file(const char *path) {
     FILE *file = fopen(path, "rb");
@@ -146,27 +195,69 @@ static uint8_t *read_file(const char *path) {
 }
 
 
+// `source` ownership is given to the ast.
+static void module_parse_source(self_t, uint8_t *source) {
+    // Lex
+    TimeSpan lex_span = time_phase_begin(TIME_PHASE_LEX);
+    Parser parser;
+    parser_init(&parser, source);
+    time_phase_end(&lex_span, parser.tokens.size);
+
+    // Parse
+    TimeSpan parse_span = time_phase_begin(TIME_PHASE_PARSE);
+    self->ast = malloc(sizeof(Ast));
+    *self->ast = parser_parse(&parser);
+    time_phase_end(&parse_span, self->ast->nodes.size);
+}
+
+void module_parse_buffer(self_t, const char *source, size_t len) {
+    assert(self->ast == NULL);
+
+    // The AST owns its source, which is terminated like a file read by `read_file`
+    uint8_t *copy = malloc(len + 1);
+    memcpy(copy, source, len);
+    copy[len] = '\0';
+    module_parse_source(self, copy);
+}
+
 bool module_parse(self_t) {
     assert(self->ast == NULL);
 
     // Read source
-    // `source` ownership is given to the ast.
+    TimeSpan load_span = time_phase_begin(TIME_PHASE_FILE_LOAD);
     uint8_t *source = read_file(self->path);
     if (source == NULL) {
         return false;
     }
+    time_phase_end(&load_span, strlen((char *) source));
 
-    // Lex
-    Parser parser;
-    parser_init(&parser, source);
-
-    // Parse
-    self->ast = malloc(sizeof(Ast));
-    *self->ast = parser_parse(&parser);
+    module_parse_source(self, source);
     return true;
 }
 
-static Decl decl_from_hir(self_t, HirIndex index) {
+bool module_parse_mir(self_t) {
+    assert(self->ast == NULL);
+
+    TimeSpan load_span = time_phase_begin(TIME_PHASE_FILE_LOAD);
+    uint8_t *source = read_file(self->path);
+    if (source == NULL) {
+        return false;
+    }
+    time_phase_end(&load_span, strlen((char *) source));
+
+    // Parsing MIR replaces every frontend phase, so it is reported as MIR lowering.
+    TimeSpan span = time_phase_begin(TIME_PHASE_MIR);
+    MirParser parser;
+    mir_parser_init(&parser, self->path, (char *) source, NULL);
+    bool result = mir_parse_module(&parser, self);
+    mir_parser_free(&parser);
+    time_phase_end(&span, self->decls.size);
+
+    free(source);
+    return result;
+}
+
+static Decl decl_from_hir(self_t, HirIndex index, AstIndex ast_index) {
     HirInst *inst = hir_get_inst(self->hir, index);
 
     if (inst->tag == HIR_CONST_DECL) {
@@ -176,16 +267,19 @@ static Decl decl_from_hir(self_t, HirIndex index) {
             assert(false);
 
         HirFnDecl *fn_data = index_list_get_sized(&self->hir->extra, HirFnDecl, fn_decl->data.extra);
-        HirIndex param_start = fn_decl->data.extra + (sizeof(HirFnDecl) / sizeof(HirInst));
+        HirIndex param_start = fn_decl->data.extra + (sizeof(HirFnDecl) / sizeof(HirIndex));
 
         Type *param_types = malloc(sizeof(Type) * fn_data->param_len);
         for (size_t i = 0; i < fn_data->param_len; i++) {
-            param_types[i] = type_from_hir_inst(self->hir, self->hir->extra.data[param_start + i]);
+            HirInst *param = hir_get_inst_tagged(self->hir, self->hir->extra.data[param_start + i], HIR_FN_PARAM);
+            param_types[i] = type_from_hir_inst(self->hir, param->data.pl_op.operand);
         }
 
         DeclFnData *decl_fn = malloc(sizeof(DeclFnData));
         *decl_fn = (DeclFnData) {
-            .ret_type = type_from_hir_inst(self->hir, fn_data->ret_ty),
+            .ret_type = fn_data->ret_ty == hir_index_empty
+                        ? (Type) {.tag = TY_VOID}
+                        : type_from_hir_inst(self->hir, fn_data->ret_ty),
             .param_count = fn_data->param_len,
             .param_types = param_types,
         };
@@ -193,6 +287,7 @@ static Decl decl_from_hir(self_t, HirIndex index) {
         return (Decl) {
             name,
             (fn_data->flags & HIR_FN_DECL_FLAGS_FOREIGN) ? DeclStateGenerated : DeclStateUnused,
+            .ast_index = ast_index,
             .data = decl_fn,
             .mir = NULL,
         };
@@ -206,10 +301,14 @@ static void extract_decls_from_hir(self_t) {
     HirModule *module_data = index_list_get_sized(&self->hir->extra, HirModule, module_inst->data.extra);
     assert(module_data != NULL);
 
+    // HIR decls are lowered in source order, so they line up with the AST module decls.
+    AstNode *root_node = ast_get_node_tagged(self->ast, ast_index_root, AST_MODULE);
+
     HirIndex decl_start = module_inst->data.extra + (sizeof(HirModule) / sizeof(HirIndex));
     for (HirIndex i = 0; i < module_data->decl_count; i++) {
-        HirIndex decl_index = decl_start + i;
-        Decl decl = decl_from_hir(self, decl_index);
+        HirIndex decl_index = self->hir->extra.data[decl_start + i];
+        AstIndex ast_index = self->ast->extra_data.data[root_node->data.lhs + i];
+        Decl decl = decl_from_hir(self, decl_index, ast_index);
         decl_list_add(&self->decls, decl);
     }
 }
@@ -218,88 +317,603 @@ bool module_lower_ast(self_t) {
     assert(self->ast != NULL);
     assert(self->hir == NULL);
 
+    TimeSpan span = time_phase_begin(TIME_PHASE_HIR);
     self->hir = malloc(sizeof(Hir));
     *self->hir = ast_lower(self->ast);
+    time_phase_end(&span, self->hir->instructions.size);
 
     //todo check for errors
 
     // Extract Decls from HIR
     extract_decls_from_hir(self);
 
-    // We are now done with AST
-//    ast_free(self->ast);
-    free(self->ast);
+    // The AST is kept until MIR is lowered from HIR, see `decl_get_mir_in_module`.
+    return true;
+}
+
+// Adds a decl to the roots given to `module_collect_reachable`.
+static void module_add_root(self_t, Decl *decl, IndexList *reachable) {
+    decl->state = DeclStateReferenced;
+    index_list_add(reachable, (DeclIndex) (decl - self->decls.data));
+}
+
+// Extends the roots in `reachable` with the indices of every decl they reach, in the order they are discovered.
+// Foreign decls are never collected, they are only ever declared.
+static void module_collect_reachable(self_t, IndexList *reachable) {
+    for (uint32_t i = 0; i < reachable->size; i++) {
+        Decl *decl = decl_list_get(&self->decls, reachable->data[i]);
+        Mir *mir = decl_get_mir_in_module(decl, self);
+
+        for (MirIndex j = 0; j < mir->instructions.size; j++) {
+            if (mir_inst_list_tag(&mir->instructions, j) != MirFnPtr)
+                continue;
+
+            Decl *target = decl_list_get(&self->decls, mir->instructions.data[j].fn_decl);
+            if (target != NULL && target->state == DeclStateUnused) {
+                target->state = DeclStateReferenced;
+                index_list_add(reachable, (DeclIndex) (target - self->decls.data));
+            }
+        }
+    }
+}
+
+// SECTION: Reloading
+// A reload parses and lowers the new source to HIR as usual, then moves the MIR of every unchanged decl over from the
+// old decls instead of lowering it again. MIR refers to decls by index and to strings by key, which are both remapped.
+
+// Foreign decls are generated from the start and never have MIR
+static bool decl_is_foreign(Decl *decl) {
+    return decl->state == DeclStateGenerated && decl->mir == NULL;
+}
+
+// Whether the MIR of `old_decl` in `old` is still valid for `decl`: its source is the same and every function it
+// references still exists with the same signature.
+static bool module_can_reuse_mir(self_t, Decl *decl, Module *old, Decl *old_decl) {
+    const char *source, *old_source;
+    size_t len, old_len;
+    if (old_decl->mir == NULL || !module_decl_source(self, decl, &source, &len) ||
+        !module_decl_source(old, old_decl, &old_source, &old_len) || len != old_len ||
+        memcmp(source, old_source, len) != 0)
+        return false;
+
+    Mir *mir = old_decl->mir;
+    bool same = true;
+    for (MirIndex i = 0; i < mir->instructions.size && same; i++) {
+        if (mir_inst_list_tag(&mir->instructions, i) != MirFnPtr)
+            continue;
+
+        Decl *old_target = decl_list_get(&old->decls, mir->instructions.data[i].fn_decl);
+        Decl *target = module_find_decl(self, module_decl_name(old, old_target));
+        if (target == NULL)
+            return false;
+
+        Writer signature, old_signature;
+        writer_init_buffer(&signature);
+        writer_init_buffer(&old_signature);
+        module_write_decl_signature(self, target, &signature);
+        module_write_decl_signature(old, old_target, &old_signature);
+        same = signature.size == old_signature.size && memcmp(signature.data, old_signature.data, signature.size) == 0;
+        writer_free(&signature);
+        writer_free(&old_signature);
+    }
+    return same;
+}
+
+// Moves the MIR of `old_decl` to `decl`, remapping function and string references.
+static void module_take_mir(self_t, Decl *decl, Module *old, Decl *old_decl) {
+    Mir *mir = old_decl->mir;
+    old_decl->mir = NULL;
+
+    for (MirIndex i = 0; i < mir->instructions.size; i++) {
+        MirInstTag tag = mir_inst_list_tag(&mir->instructions, i);
+        MirInstData *data = &mir->instructions.data[i];
+        if (tag == MirFnPtr) {
+            Decl *target = module_find_decl(self, module_decl_name(old, decl_list_get(&old->decls, data->fn_decl)));
+            data->fn_decl = (DeclIndex) (target - self->decls.data);
+        } else if (tag == MirConstant && type_tag(mir_get_type(mir, data->ty_pl.ty)) == TY_PTR) {
+            char *string = string_set_get(&old->hir->strings, data->ty_pl.payload);
+            data->ty_pl.payload = string_set_add(&self->hir->strings, string);
+        }
+    }
+    decl->mir = mir;
+}
+
+// Decls usually keep their position, so the same index is tried before searching by name.
+static Decl *find_old_decl(Module *old, DeclIndex index, char *name) {
+    if (index < old->decls.size) {
+        Decl *decl = decl_list_get(&old->decls, index);
+        if (strcmp(module_decl_name(old, decl), name) == 0)
+            return decl;
+    }
+    return old->hir != NULL ? module_find_decl(old, name) : NULL;
+}
+
+// Takes ownership of `source`.
+static void module_reload_source(self_t, uint8_t *source, ModuleReload *result) {
+    assert(self->ast != NULL);
+    result->changed = false;
+    result->decl_count = 0;
+    result->reused = 0;
+
+    if (strcmp((char *) source, (char *) self->ast->source) == 0) {
+        free(source);
+        return;
+    }
+    result->changed = true;
+
+    // The old module is only read from while its MIR is moved over
+    Module old = *self;
     self->ast = NULL;
+    self->hir = NULL;
+    decl_list_init(&self->decls);
+    module_free_units(self);
+    if (self->decl_cache != NULL)
+        decl_cache_forget_decls(self->decl_cache);
+
+    module_parse_source(self, source);
+    if (self->ast->errors.size == 0) {
+        module_lower_ast(self);
+        result->decl_count = self->decls.size;
+
+        // Everything is checked before any MIR is moved, which changes how the old decls look (see `decl_is_foreign`)
+        Decl **reusable = calloc(self->decls.size, sizeof(Decl *));
+        for (DeclIndex i = 0; i < self->decls.size; i++) {
+            Decl *decl = decl_list_get(&self->decls, i);
+            if (decl_is_foreign(decl) || old.hir == NULL)
+                continue;
+
+            Decl *old_decl = find_old_decl(&old, i, module_decl_name(self, decl));
+            if (old_decl != NULL && module_can_reuse_mir(self, decl, &old, old_decl))
+                reusable[i] = old_decl;
+        }
+
+        for (DeclIndex i = 0; i < self->decls.size; i++) {
+            if (reusable[i] == NULL)
+                continue;
+
+            Decl *decl = decl_list_get(&self->decls, i);
+            module_take_mir(self, decl, &old, reusable[i]);
+            if (self->decl_cache != NULL)
+                decl_cache_track_mir(self->decl_cache, self, decl);
+            result->reused++;
+        }
+        free(reusable);
+    }
+
+    free_decls(&old.decls);
+    free_ast_and_hir(old.ast, old.hir);
+}
 
+bool module_reload(self_t, ModuleReload *result) {
+    TimeSpan load_span = time_phase_begin(TIME_PHASE_FILE_LOAD);
+    uint8_t *source = read_file(self->path);
+    if (source == NULL)
+        return false;
+    time_phase_end(&load_span, strlen((char *) source));
+
+    module_reload_source(self, source, result);
     return true;
 }
 
+void module_reload_buffer(self_t, const char *source, size_t len, ModuleReload *result) {
+    uint8_t *copy = malloc(len + 1);
+    memcpy(copy, source, len);
+    copy[len] = '\0';
+    module_reload_source(self, copy, result);
+}
+
+void module_load_cached_mir(self_t) {
+    if (self->decl_cache == NULL)
+        return;
+
+    for (DeclIndex i = 0; i < self->decls.size; i++) {
+        Decl *decl = decl_list_get(&self->decls, i);
+        if (!decl_is_foreign(decl) && decl->mir == NULL)
+            decl_cache_load_mir(self->decl_cache, self, decl);
+    }
+}
+
+// SECTION: Codegen units
+// Each unit owns its own LLVM context, so units are processed by a small pool of worker threads which
+// take the next unprocessed unit until none remain.
+
+typedef bool (*UnitTask)(Module *module, Codegen *unit, uint32_t unit_index);
+
+typedef struct unit_pool_s {
+    Module *module;
+    UnitTask task;
+    atomic_uint next_unit;
+    atomic_bool ok;
+} UnitPool;
+
+static void *unit_worker(void *arg) {
+    UnitPool *pool = arg;
+    while (true) {
+        uint32_t index = atomic_fetch_add(&pool->next_unit, 1);
+        if (index >= pool->module->unit_count)
+            break;
+
+        if (!pool->task(pool->module, &pool->module->units[index], index))
+            atomic_store(&pool->ok, false);
+    }
+    return NULL;
+}
+
+// Runs `task` once for every unit, using up to `options.jobs` threads including the calling thread.
+static bool module_run_units(self_t, UnitTask task) {
+    UnitPool pool = {.module = self, .task = task};
+    atomic_init(&pool.next_unit, 0);
+    atomic_init(&pool.ok, true);
+
+    uint32_t thread_count = self->options.jobs < self->unit_count ? self->options.jobs : self->unit_count;
+    pthread_t *threads = NULL;
+    uint32_t started = 0;
+    if (thread_count > 1) {
+        threads = malloc(sizeof(pthread_t) * (thread_count - 1));
+        for (; started < thread_count - 1; started++) {
+            if (pthread_create(&threads[started], NULL, unit_worker, &pool) != 0)
+                break;
+        }
+    }
+
+    unit_worker(&pool);
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    return atomic_load(&pool.ok);
+}
+
+// Objects are only reused when every unit holds a single decl and nothing but the object is needed from each unit.
+static bool module_reuses_objects(self_t) {
+    return self->decl_cache != NULL && self->options.codegen_units == 0 &&
+           (self->options.emit & ~(EMIT_OBJ | EMIT_EXE)) == 0;
+}
+
+static bool lower_unit(Module *module, Codegen *unit, uint32_t unit_index) {
+    (void) unit_index;
+    if (unit->cached)
+        return true;
+
+    TraceSpan unit_span = trace_begin("codegen unit");
+    for (uint32_t i = 0; i < unit->decls.size; i++) {
+        codegen_lower_decl(unit, decl_list_get(&module->decls, unit->decls.data[i]));
+    }
+    trace_end(&unit_span, NULL, "decls", unit->decls.size);
+
+    TimeSpan opt_span = time_phase_begin(TIME_PHASE_LLVM_OPT);
+    bool result = codegen_optimize(unit);
+    time_phase_end(&opt_span, 1);
+    return result;
+}
+
+// Lowers the roots in `reachable` and every decl they reach into codegen units, consuming the list.
+static bool module_lower_roots(self_t, IndexList reachable) {
+    // Units are generated independently, so every decl they define has to be known up front.
+    module_collect_reachable(self, &reachable);
+
+    uint32_t unit_count = self->options.codegen_units != 0 ? self->options.codegen_units : self->options.jobs;
+    if (module_reuses_objects(self)) unit_count = reachable.size;
+    if (unit_count > reachable.size) unit_count = reachable.size;
+    if (unit_count == 0) unit_count = 1;
+
+    self->unit_count = unit_count;
+    self->units = malloc(sizeof(Codegen) * unit_count);
+    for (uint32_t i = 0; i < unit_count; i++) {
+        codegen_init(&self->units[i], self, &self->options);
+    }
+    for (uint32_t i = 0; i < reachable.size; i++) {
+        index_list_add(&self->units[i % unit_count].decls, reachable.data[i]);
+    }
+    index_list_free(&reachable);
+
+    if (module_reuses_objects(self)) {
+        for (uint32_t i = 0; i < unit_count; i++) {
+            Decl *decl = decl_list_get(&self->decls, self->units[i].decls.data[0]);
+            self->units[i].cached = decl_cache_has_object(self->decl_cache, self, decl);
+        }
+    }
+
+    // Create the target before starting any workers, this also initializes LLVM targets.
+    if (codegen_target_machine(&self->options) == NULL)
+        return false;
+
+    return module_run_units(self, lower_unit);
+}
+
 bool module_lower_main(self_t) {
     assert(self->hir != NULL);
 
-    // Extract declarations from module
-    AstNode *root_node = ast_get_node_tagged(self->ast, ast_index_root, AST_MODULE);
-    if (root_node->data.lhs == ast_index_empty) {
+    Decl *main = module_find_decl(self, "main");
+    if (main == NULL) {
         fprintf(stderr, "Module has no main function\n");
         return false;
     }
 
-    for (AstIndex index = root_node->data.lhs; index <= root_node->data.rhs; index++) {
-        AstIndex node_index = self->ast->extra_data.data[index];
-        Decl decl;
-        decl_init_from_ast(&decl, self->ast, node_index);
-        decl_list_add(&self->decls, decl);
-    }
-
-    // Initialize codegen
-    self->codegen = malloc(sizeof(Codegen));
-    codegen_init(self->codegen, self);
+    IndexList roots;
+    index_list_init(&roots);
+    module_add_root(self, main, &roots);
+    return module_lower_roots(self, roots);
+}
 
-    // Compile the "main" decl
-    Decl *main = module_find_decl(self, "main");
-    assert(main != NULL);
-    codegen_lower_decl(self->codegen, main);
+bool module_lower_all(self_t) {
+    assert(self->hir != NULL);
 
-    // Lower all other decls that have been referenced
-    //todo this only does one pass, need to replace this with a stack of decls pending generation.
+    IndexList roots;
+    index_list_init(&roots);
     for (DeclIndex i = 0; i < self->decls.size; i++) {
         Decl *decl = decl_list_get(&self->decls, i);
+        if (!decl_is_foreign(decl))
+            module_add_root(self, decl, &roots);
+    }
+    return module_lower_roots(self, roots);
+}
+
+static char *module_output_path(self_t, const char *extension) {
+    char *path = malloc(strlen(self->path) + strlen(extension) + 1);
+    strcpy(path, self->path);
+    strcat(path, extension);
+    return path;
+}
+
+// Outputs of a module with several units are numbered, eg `main.acorn.2.o`.
+static char *module_unit_output_path(self_t, uint32_t unit_index, const char *extension) {
+    if (self->unit_count <= 1)
+        return module_output_path(self, extension);
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%u%s", unit_index, extension);
+    return module_output_path(self, suffix);
+}
+
+char *module_exe_path(self_t) {
+    char *exe_path = strdup(self->path);
+    char *dot_acorn = strstr(exe_path, ".acorn");
+    size_t len = strlen(exe_path);
+    if (dot_acorn) {
+        *dot_acorn = '\0';
+    } else if (len > 4 && strcmp(exe_path + len - 4, ".mir") == 0) {
+        exe_path[len - 4] = '\0';
+    }
+    return exe_path;
+}
+
+// Links the module objects into an executable, removing the objects afterwards unless they were requested.
+static bool module_link(self_t, char **obj_paths, uint32_t obj_count) {
+    TimeSpan span = time_phase_begin(TIME_PHASE_LINK);
+    char *exe_path = module_exe_path(self);
+    bool result = link_objects(obj_paths, obj_count, exe_path);
+    free(exe_path);
+    time_phase_end(&span, obj_count);
+
+    if (!(self->options.emit & EMIT_OBJ)) {
+        for (uint32_t i = 0; i < obj_count; i++)
+            unlink(obj_paths[i]);
+    }
+    return result;
+}
+
+static bool emit_unit_outputs(Module *module, Codegen *unit, uint32_t unit_index) {
+    uint32_t emit = module->options.emit;
 
-        if (decl->state == DeclStateReferenced)
-            codegen_lower_decl(self->codegen, decl);
+    if (emit & EMIT_LL) {
+        char *ll_path = module_unit_output_path(module, unit_index, ".ll");
+        bool result = codegen_write_to_file(unit, ll_path);
+        free(ll_path);
+        if (!result) return false;
+    }
+
+    if (emit & EMIT_BC) {
+        char *bc_path = module_unit_output_path(module, unit_index, ".bc");
+        bool result = codegen_write_to_bc_file(unit, bc_path);
+        free(bc_path);
+        if (!result) return false;
+    }
+
+    if (emit & EMIT_ASM) {
+        char *asm_path = module_unit_output_path(module, unit_index, ".s");
+        bool result = codegen_write_to_asm_file(unit, asm_path);
+        free(asm_path);
+        if (!result) return false;
+    }
+
+    if (emit & (EMIT_OBJ | EMIT_EXE)) {
+        char *obj_path = module_unit_output_path(module, unit_index, ".o");
+        bool result;
+        if (unit->cached) {
+            Decl *decl = decl_list_get(&module->decls, unit->decls.data[0]);
+            result = decl_cache_load_object(module->decl_cache, module, decl, obj_path);
+        } else {
+            result = codegen_write_to_obj_file(unit, obj_path);
+            if (result && module_reuses_objects(module)) {
+                Decl *decl = decl_list_get(&module->decls, unit->decls.data[0]);
+                decl_cache_store_object(module->decl_cache, module, decl, obj_path);
+            }
+        }
+        free(obj_path);
+        if (!result) return false;
     }
 
     return true;
 }
 
+static bool emit_unit(Module *module, Codegen *unit, uint32_t unit_index) {
+    TimeSpan span = time_phase_begin(TIME_PHASE_EMIT);
+    bool result = emit_unit_outputs(module, unit, unit_index);
+    time_phase_end(&span, 1);
+    return result;
+}
+
 bool module_emit_llvm(self_t) {
-    assert(self->codegen != NULL);
+    assert(self->units != NULL);
+
+    if (!module_run_units(self, emit_unit))
+        return false;
+    if (!(self->options.emit & EMIT_EXE))
+        return true;
+
+    // All units are linked with a single invocation
+    char **obj_paths = malloc(sizeof(char *) * self->unit_count);
+    for (uint32_t i = 0; i < self->unit_count; i++) {
+        obj_paths[i] = module_unit_output_path(self, i, ".o");
+    }
+
+    bool result = module_link(self, obj_paths, self->unit_count);
 
-    char *llvm_path = malloc(strlen(self->path) + 3);
-    strcpy(llvm_path, self->path);
-    strcat(llvm_path, ".ll");
+    for (uint32_t i = 0; i < self->unit_count; i++) {
+        free(obj_paths[i]);
+    }
+    free(obj_paths);
+    return result;
+}
 
-    bool result = codegen_write_to_file(self->codegen, llvm_path);
-    free(llvm_path);
-    if (!result) {
+bool module_emit_native(self_t) {
+    if (self->options.emit & ~(EMIT_OBJ | EMIT_EXE)) {
+        fprintf(stderr, "The native backend can only emit obj and exe\n");
         return false;
     }
 
-    char *obj_path = malloc(strlen(self->path) + 2);
-    strcpy(obj_path, self->path);
-    strcat(obj_path, ".o");
+    Decl *main = module_find_decl(self, "main");
+    if (main == NULL) {
+        fprintf(stderr, "Module has no main function\n");
+        return false;
+    }
 
-    result = codegen_write_to_obj_file(self->codegen, obj_path);
+    X64Gen gen;
+    x64_gen_init(&gen, self);
+    x64_gen_lower_decl(&gen, main);
+
+    // Lowering a decl may reference more decls, keep going until none are pending.
+    bool pending = true;
+    while (pending) {
+        pending = false;
+        for (DeclIndex i = 0; i < self->decls.size; i++) {
+            Decl *decl = decl_list_get(&self->decls, i);
+            if (decl->state == DeclStateReferenced) {
+                x64_gen_lower_decl(&gen, decl);
+                pending = true;
+            }
+        }
+    }
+    TimeSpan emit_span = time_phase_begin(TIME_PHASE_EMIT);
+    char *obj_path = module_output_path(self, ".o");
+    bool result = x64_gen_write_to_obj_file(&gen, obj_path);
+    x64_gen_free(&gen);
+    time_phase_end(&emit_span, 1);
+    if (result && (self->options.emit & EMIT_EXE)) {
+        result = module_link(self, &obj_path, 1);
+    }
     free(obj_path);
 
     return result;
 }
 
+char **module_output_paths(self_t, uint32_t *count) {
+    uint32_t emit = self->options.emit;
+    // The native backend writes a single object without any units
+    uint32_t unit_count = self->unit_count > 0 ? self->unit_count : 1;
+    const char *extensions[4];
+    uint32_t extension_count = 0;
+    if (emit & EMIT_LL) extensions[extension_count++] = ".ll";
+    if (emit & EMIT_BC) extensions[extension_count++] = ".bc";
+    if (emit & EMIT_ASM) extensions[extension_count++] = ".s";
+    if (emit & EMIT_OBJ) extensions[extension_count++] = ".o";
+
+    char **paths = malloc(sizeof(char *) * (unit_count * extension_count + 1));
+    *count = 0;
+    for (uint32_t i = 0; i < unit_count; i++) {
+        for (uint32_t j = 0; j < extension_count; j++)
+            paths[(*count)++] = module_unit_output_path(self, i, extensions[j]);
+    }
+    if (emit & EMIT_EXE)
+        paths[(*count)++] = module_exe_path(self);
+    return paths;
+}
+
+bool module_emit_object_to_memory(self_t, char **data, size_t *size) {
+    assert(self->unit_count == 1);
+
+    TimeSpan span = time_phase_begin(TIME_PHASE_EMIT);
+    bool result = codegen_write_to_obj_memory(&self->units[0], data, size);
+    time_phase_end(&span, 1);
+    return result;
+}
+
+bool module_run_jit(self_t, bool lazy, int32_t *exit_code) {
+    // The JIT needs every decl in one LLVM module
+    assert(self->unit_count == 1);
+
+    return codegen_run_jit(&self->units[0], lazy, exit_code);
+}
+
+
+void module_write_decl_signature(self_t, Decl *decl, Writer *out) {
+    DeclFnData *fn_data = decl->data.fn_data;
+
+    writer_printf(out, "%sfn %s(", decl_is_foreign(decl) ? "foreign " : "", module_decl_name(self, decl));
+    for (uint32_t j = 0; j < fn_data->param_count; j++) {
+        char *type_str = type_to_string(fn_data->param_types[j]);
+        writer_printf(out, j == 0 ? "%s" : ", %s", type_str);
+        free(type_str);
+    }
+    writer_puts(out, ")");
+    if (type_tag(fn_data->ret_type) != TY_VOID) {
+        char *type_str = type_to_string(fn_data->ret_type);
+        writer_printf(out, " %s", type_str);
+        free(type_str);
+    }
+}
+
+void module_write_mir(self_t, Writer *out) {
+    MirDebugNames names = {
+        .strings = &self->hir->strings,
+        .decl_names = malloc(sizeof(char *) * self->decls.size),
+        .decl_count = self->decls.size,
+    };
+    for (DeclIndex i = 0; i < self->decls.size; i++) {
+        names.decl_names[i] = module_decl_name(self, decl_list_get(&self->decls, i));
+    }
+
+    for (DeclIndex i = 0; i < self->decls.size; i++) {
+        Decl *decl = decl_list_get(&self->decls, i);
+        module_write_decl_signature(self, decl, out);
+
+        if (decl_is_foreign(decl)) {
+            writer_puts(out, "\n\n");
+            continue;
+        }
+
+        writer_puts(out, " {\n");
+        mir_debug_write_named(decl_get_mir_in_module(decl, self), &names, out);
+        writer_puts(out, "}\n\n");
+    }
+
+    free(names.decl_names);
+}
+
+bool module_emit_mir(self_t) {
+    char *mir_path = module_output_path(self, ".mir");
+    FILE *file = fopen(mir_path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file: %s\n", mir_path);
+        free(mir_path);
+        return false;
+    }
+    free(mir_path);
+
+    Writer out;
+    writer_init_file(&out, file);
+    module_write_mir(self, &out);
+    writer_free(&out);
+    return fclose(file) == 0;
+}
 
-Decl *module_find_decl(self_t, char *name) {
+Decl *module_find_decl(self_t, const char *name) {
     for (DeclIndex index = 0; index < self->decls.size; index++) {
         Decl *decl = decl_list_get(&self->decls, index);
-        if (strcmp(decl->name, name) == 0) {
+        if (strcmp(module_decl_name(self, decl), name) == 0) {
             return decl;
         }
     }
@@ -307,6 +921,65 @@ Decl *module_find_decl(self_t, char *name) {
     return NULL;
 }
 
+char *module_decl_name(self_t, Decl *decl) {
+    return string_set_get(&self->hir->strings, decl->name);
+}
+
+bool module_decl_source(self_t, Decl *decl, const char **start, size_t *len) {
+    Ast *ast = self->ast;
+    if (ast == NULL || decl->ast_index == ast_index_empty)
+        return false;
+
+    TokenIndex first = ast_get_node(ast, decl->ast_index)->main_token;
+    uint32_t depth = 0;
+    for (TokenIndex i = first; i < ast->tokens.size; i++) {
+        Token *token = &ast->tokens.data[i];
+        if (token->type == TOK_LBRACE) {
+            depth++;
+        } else if (token->type == TOK_RBRACE && depth > 0 && --depth == 0) {
+            *start = (const char *) ast->source + ast->tokens.data[first].loc.start;
+            *len = token->loc.end - ast->tokens.data[first].loc.start;
+            return true;
+        }
+    }
+    return false;
+}
+
 #undef self_t
 
 
+// SECTION: Linking
+
+bool link_objects(char **obj_paths, uint32_t obj_count, char *exe_path) {
+    // cc <objects...> -lc -o <exe> NULL
+    char **argv = malloc(sizeof(char *) * (obj_count + 5));
+    uint32_t argc = 0;
+    argv[argc++] = "cc";
+    for (uint32_t i = 0; i < obj_count; i++)
+        argv[argc++] = obj_paths[i];
+    argv[argc++] = "-lc";
+    argv[argc++] = "-o";
+    argv[argc++] = exe_path;
+    argv[argc] = NULL;
+
+    pid_t pid;
+    int spawn_error = posix_spawnp(&pid, "cc", NULL, NULL, argv, environ);
+    free(argv);
+    if (spawn_error != 0) {
+        fprintf(stderr, "Could not run linker: %s\n", strerror(spawn_error));
+        return false;
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) {
+        fprintf(stderr, "Could not wait for linker: %s\n", strerror(errno));
+        return false;
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "cc finished with non-zero exit code: %d\n", WEXITSTATUS(status));
+        return false;
+    }
+
+    return true;
+}
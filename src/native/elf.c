@@ -0,0 +1,354 @@
+#include "native/elf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array_util.h"
+
+// SECTION: Byte list
+
+#define self_t ByteList *self
+
+void byte_list_init(self_t) {
+    self->size = 0;
+    self->capacity = 0;
+    self->data = NULL;
+}
+
+void byte_list_free(self_t) {
+    ARRAY_FREE(uint8_t, self->data);
+    byte_list_init(self);
+}
+
+void byte_list_add(self_t, uint8_t byte) {
+    byte_list_add_multi(self, &byte, 1);
+}
+
+void byte_list_add_multi(self_t, const void *data, size_t size) {
+    if (size == 0) return;
+
+    if (self->capacity < self->size + size) {
+        while (self->capacity < self->size + size)
+            self->capacity = ARRAY_GROW_CAPCITY(self->capacity);
+        self->data = ARRAY_GROW(uint8_t, self->data, self->capacity);
+    }
+
+    memcpy(self->data + self->size, data, size);
+    self->size += size;
+}
+
+#undef self_t
+
+
+// SECTION: ELF file layout
+// Only the fields required for an x86-64 relocatable object are named here, see the System V gABI for details.
+
+#define ELF_SECTION_COUNT 8
+#define SHN_TEXT 1
+#define SHN_RODATA 2
+#define SHN_RELA_TEXT 3
+#define SHN_SYMTAB 4
+#define SHN_STRTAB 5
+#define SHN_SHSTRTAB 6
+#define SHN_NOTE_STACK 7
+
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define STT_FUNC 2
+#define STT_SECTION 3
+
+typedef struct {
+    uint8_t ident[16];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint64_t entry;
+    uint64_t phoff;
+    uint64_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} Elf64Header;
+
+typedef struct {
+    uint32_t name;
+    uint32_t type;
+    uint64_t flags;
+    uint64_t addr;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t link;
+    uint32_t info;
+    uint64_t addralign;
+    uint64_t entsize;
+} Elf64SectionHeader;
+
+typedef struct {
+    uint32_t name;
+    uint8_t info;
+    uint8_t other;
+    uint16_t shndx;
+    uint64_t value;
+    uint64_t size;
+} Elf64Sym;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t info;
+    int64_t addend;
+} Elf64Rela;
+
+
+// SECTION: ELF object
+
+#define self_t ElfObject *self
+
+void elf_object_init(self_t) {
+    byte_list_init(&self->text);
+    byte_list_init(&self->rodata);
+
+    self->symbol_count = 0;
+    self->symbol_capacity = 0;
+    self->symbols = NULL;
+
+    self->reloc_count = 0;
+    self->reloc_capacity = 0;
+    self->relocs = NULL;
+
+    // Section symbol for .rodata, always the only local symbol.
+    self->symbol_capacity = ARRAY_GROW_CAPCITY(0);
+    self->symbols = ARRAY_GROW(ElfSymbol, self->symbols, self->symbol_capacity);
+    self->symbols[0] = (ElfSymbol) {.name = NULL, .section = ELF_SECTION_RODATA};
+    self->symbol_count = 1;
+    self->rodata_symbol = 0;
+}
+
+void elf_object_free(self_t) {
+    for (uint32_t i = 0; i < self->symbol_count; i++)
+        free(self->symbols[i].name);
+    ARRAY_FREE(ElfSymbol, self->symbols);
+    ARRAY_FREE(ElfReloc, self->relocs);
+    byte_list_free(&self->text);
+    byte_list_free(&self->rodata);
+}
+
+ElfSymbolIndex elf_object_symbol(self_t, const char *name) {
+    for (ElfSymbolIndex i = 0; i < self->symbol_count; i++) {
+        if (self->symbols[i].name != NULL && strcmp(self->symbols[i].name, name) == 0)
+            return i;
+    }
+
+    if (self->symbol_capacity < self->symbol_count + 1) {
+        self->symbol_capacity = ARRAY_GROW_CAPCITY(self->symbol_capacity);
+        self->symbols = ARRAY_GROW(ElfSymbol, self->symbols, self->symbol_capacity);
+    }
+
+    self->symbols[self->symbol_count] = (ElfSymbol) {
+        .name = strdup(name),
+        .section = ELF_SECTION_UNDEF,
+        .value = 0,
+        .size = 0,
+    };
+    return self->symbol_count++;
+}
+
+void elf_object_define(self_t, ElfSymbolIndex symbol, uint64_t value, uint64_t size) {
+    assert(symbol < self->symbol_count);
+    ElfSymbol *sym = &self->symbols[symbol];
+    assert(sym->section == ELF_SECTION_UNDEF);
+
+    sym->section = ELF_SECTION_TEXT;
+    sym->value = value;
+    sym->size = size;
+}
+
+uint64_t elf_object_add_string(self_t, const char *str, size_t len) {
+    uint64_t offset = self->rodata.size;
+    byte_list_add_multi(&self->rodata, str, len);
+    byte_list_add(&self->rodata, '\0');
+    return offset;
+}
+
+void elf_object_add_reloc(self_t, uint64_t offset, ElfSymbolIndex symbol, ElfRelocType type, int64_t addend) {
+    if (self->reloc_capacity < self->reloc_count + 1) {
+        self->reloc_capacity = ARRAY_GROW_CAPCITY(self->reloc_capacity);
+        self->relocs = ARRAY_GROW(ElfReloc, self->relocs, self->reloc_capacity);
+    }
+
+    self->relocs[self->reloc_count++] = (ElfReloc) {
+        .offset = offset,
+        .symbol = symbol,
+        .type = type,
+        .addend = addend,
+    };
+}
+
+static uint32_t add_str(ByteList *table, const char *str) {
+    uint32_t offset = table->size;
+    byte_list_add_multi(table, str, strlen(str) + 1);
+    return offset;
+}
+
+static void align_to(ByteList *out, uint32_t alignment) {
+    while (out->size % alignment != 0)
+        byte_list_add(out, 0);
+}
+
+// Final symbol table index. Null symbol first, then the rodata section symbol (the only local), then globals.
+static uint32_t final_symbol_index(ElfSymbolIndex symbol) {
+    return symbol + 1;
+}
+
+bool elf_object_write_to_file(self_t, const char *path) {
+    Elf64SectionHeader sections[ELF_SECTION_COUNT];
+    memset(sections, 0, sizeof(sections));
+
+    // Section name table
+    ByteList shstrtab;
+    byte_list_init(&shstrtab);
+    byte_list_add(&shstrtab, '\0');
+    sections[SHN_TEXT].name = add_str(&shstrtab, ".text");
+    sections[SHN_RODATA].name = add_str(&shstrtab, ".rodata");
+    sections[SHN_RELA_TEXT].name = add_str(&shstrtab, ".rela.text");
+    sections[SHN_SYMTAB].name = add_str(&shstrtab, ".symtab");
+    sections[SHN_STRTAB].name = add_str(&shstrtab, ".strtab");
+    sections[SHN_SHSTRTAB].name = add_str(&shstrtab, ".shstrtab");
+    sections[SHN_NOTE_STACK].name = add_str(&shstrtab, ".note.GNU-stack");
+
+    // Symbol and string tables
+    ByteList strtab, symtab;
+    byte_list_init(&strtab);
+    byte_list_init(&symtab);
+    byte_list_add(&strtab, '\0');
+
+    Elf64Sym null_sym = {0};
+    byte_list_add_multi(&symtab, &null_sym, sizeof(Elf64Sym));
+    for (ElfSymbolIndex i = 0; i < self->symbol_count; i++) {
+        ElfSymbol *symbol = &self->symbols[i];
+        Elf64Sym sym = {0};
+        if (i == self->rodata_symbol) {
+            sym.info = (STB_LOCAL << 4) | STT_SECTION;
+            sym.shndx = SHN_RODATA;
+        } else if (symbol->section == ELF_SECTION_TEXT) {
+            sym.name = add_str(&strtab, symbol->name);
+            sym.info = (STB_GLOBAL << 4) | STT_FUNC;
+            sym.shndx = SHN_TEXT;
+            sym.value = symbol->value;
+            sym.size = symbol->size;
+        } else {
+            sym.name = add_str(&strtab, symbol->name);
+            sym.info = (STB_GLOBAL << 4) | STT_NOTYPE;
+        }
+        byte_list_add_multi(&symtab, &sym, sizeof(Elf64Sym));
+    }
+
+    ByteList rela;
+    byte_list_init(&rela);
+    for (uint32_t i = 0; i < self->reloc_count; i++) {
+        ElfReloc *reloc = &self->relocs[i];
+        Elf64Rela entry = {
+            .offset = reloc->offset,
+            .info = ((uint64_t) final_symbol_index(reloc->symbol) << 32) | reloc->type,
+            .addend = reloc->addend,
+        };
+        byte_list_add_multi(&rela, &entry, sizeof(Elf64Rela));
+    }
+
+    // Lay out the file: header, section contents, section headers.
+    ByteList out;
+    byte_list_init(&out);
+    Elf64Header header = {0};
+    byte_list_add_multi(&out, &header, sizeof(Elf64Header));
+
+#define place(index, list, alignment) \
+    align_to(&out, alignment); \
+    sections[index].offset = out.size; \
+    sections[index].size = (list).size; \
+    sections[index].addralign = alignment; \
+    byte_list_add_multi(&out, (list).data, (list).size);
+
+    place(SHN_TEXT, self->text, 16)
+    sections[SHN_TEXT].type = SHT_PROGBITS;
+    sections[SHN_TEXT].flags = SHF_ALLOC | SHF_EXECINSTR;
+
+    place(SHN_RODATA, self->rodata, 1)
+    sections[SHN_RODATA].type = SHT_PROGBITS;
+    // Not marked mergeable, strings are addressed via the section symbol which the linker rejects for
+    // merged sections when the addend points before the string.
+    sections[SHN_RODATA].flags = SHF_ALLOC;
+
+    place(SHN_RELA_TEXT, rela, 8)
+    sections[SHN_RELA_TEXT].type = SHT_RELA;
+    sections[SHN_RELA_TEXT].flags = SHF_INFO_LINK;
+    sections[SHN_RELA_TEXT].link = SHN_SYMTAB;
+    sections[SHN_RELA_TEXT].info = SHN_TEXT;
+    sections[SHN_RELA_TEXT].entsize = sizeof(Elf64Rela);
+
+    place(SHN_SYMTAB, symtab, 8)
+    sections[SHN_SYMTAB].type = SHT_SYMTAB;
+    sections[SHN_SYMTAB].link = SHN_STRTAB;
+    sections[SHN_SYMTAB].info = final_symbol_index(self->rodata_symbol) + 1; // First global
+    sections[SHN_SYMTAB].entsize = sizeof(Elf64Sym);
+
+    place(SHN_STRTAB, strtab, 1)
+    sections[SHN_STRTAB].type = SHT_STRTAB;
+
+    place(SHN_SHSTRTAB, shstrtab, 1)
+    sections[SHN_SHSTRTAB].type = SHT_STRTAB;
+
+    sections[SHN_NOTE_STACK].type = SHT_PROGBITS;
+    sections[SHN_NOTE_STACK].offset = out.size;
+    sections[SHN_NOTE_STACK].addralign = 1;
+
+#undef place
+
+    align_to(&out, 8);
+    uint64_t section_offset = out.size;
+    byte_list_add_multi(&out, sections, sizeof(sections));
+
+    // Fill in the header now that the section header offset is known
+    header = (Elf64Header) {
+        .ident = {0x7f, 'E', 'L', 'F', 2 /* 64 bit */, 1 /* little endian */, 1 /* version */},
+        .type = 1, // ET_REL
+        .machine = 62, // EM_X86_64
+        .version = 1,
+        .shoff = section_offset,
+        .ehsize = sizeof(Elf64Header),
+        .shentsize = sizeof(Elf64SectionHeader),
+        .shnum = ELF_SECTION_COUNT,
+        .shstrndx = SHN_SHSTRTAB,
+    };
+    memcpy(out.data, &header, sizeof(Elf64Header));
+
+    bool result = false;
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file: %s\n", path);
+    } else {
+        result = fwrite(out.data, 1, out.size, file) == out.size;
+        fclose(file);
+    }
+
+    byte_list_free(&out);
+    byte_list_free(&rela);
+    byte_list_free(&symtab);
+    byte_list_free(&strtab);
+    byte_list_free(&shstrtab);
+    return result;
+}
+
+#undef self_t
@@ -0,0 +1,784 @@
+#include "native/x64.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "module.h"
+#include "time_report.h"
+
+//todo put me a better place, it is duplicated from mir_debug.c
+#define mir_get_inst(mir, index) mir_inst_list_get(&(mir)->instructions, (index))
+#define mir_get_extra(mir, index) *index_list_get(&(mir)->extra, (index))
+
+typedef enum x64_reg_s {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+} X64Reg;
+
+// Values are only ever allocated to callee saved registers, so nothing needs to be saved around calls.
+// Caller saved registers are used as scratch space within a single instruction.
+static const X64Reg alloc_regs[] = {RBX, R12, R13, R14, R15};
+#define ALLOC_REG_COUNT (sizeof(alloc_regs) / sizeof(X64Reg))
+
+static const X64Reg arg_regs[] = {RDI, RSI, RDX, RCX, R8, R9};
+#define ARG_REG_COUNT (sizeof(arg_regs) / sizeof(X64Reg))
+
+#define self_t X64Gen *self
+
+// SECTION: Encoding
+// Raw instruction encoding. Memory operands always use a 32 bit displacement to keep things simple.
+
+#define text_offset(self) ((self)->obj.text.size)
+
+static void emit8(self_t, uint8_t byte) {
+    byte_list_add(&self->obj.text, byte);
+}
+
+static void emit32(self_t, uint32_t value) {
+    byte_list_add_multi(&self->obj.text, &value, sizeof(uint32_t));
+}
+
+static void emit64(self_t, uint64_t value) {
+    byte_list_add_multi(&self->obj.text, &value, sizeof(uint64_t));
+}
+
+static void patch32(self_t, uint32_t offset, uint32_t value) {
+    memcpy(self->obj.text.data + offset, &value, sizeof(uint32_t));
+}
+
+// `force` is required to access the low byte of rsp/rbp/rsi/rdi instead of ah/ch/dh/bh
+static void emit_rex(self_t, bool wide, uint8_t reg, uint8_t base, bool force) {
+    uint8_t rex = 0x40 | (wide ? 0x8 : 0) | ((reg >> 3) << 2) | (base >> 3);
+    if (rex != 0x40 || force)
+        emit8(self, rex);
+}
+
+static void emit_modrm_reg(self_t, uint8_t reg, uint8_t rm) {
+    emit8(self, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void emit_modrm_mem(self_t, uint8_t reg, uint8_t base, int32_t disp) {
+    emit8(self, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP)
+        emit8(self, 0x24); // SIB with no index
+    emit32(self, (uint32_t) disp);
+}
+
+// Emits `op reg, rm` or `op rm, reg` depending on opcode
+static void emit_rr(self_t, bool wide, uint8_t opcode, uint8_t reg, uint8_t rm) {
+    emit_rex(self, wide, reg, rm, false);
+    emit8(self, opcode);
+    emit_modrm_reg(self, reg, rm);
+}
+
+static void emit_rr_0f(self_t, bool wide, uint8_t opcode, uint8_t reg, uint8_t rm, bool force) {
+    emit_rex(self, wide, reg, rm, force);
+    emit8(self, 0x0F);
+    emit8(self, opcode);
+    emit_modrm_reg(self, reg, rm);
+}
+
+static void emit_mov_rr(self_t, X64Reg dst, X64Reg src) {
+    if (dst != src)
+        emit_rr(self, true, 0x89, src, dst);
+}
+
+static void emit_mov_ri(self_t, X64Reg dst, int64_t imm) {
+    if (imm == 0) {
+        // xor r32, r32
+        emit_rr(self, false, 0x31, dst, dst);
+    } else if (imm >= INT32_MIN && imm <= INT32_MAX) {
+        emit_rex(self, true, 0, dst, false);
+        emit8(self, 0xC7);
+        emit_modrm_reg(self, 0, dst);
+        emit32(self, (uint32_t) imm);
+    } else {
+        emit_rex(self, true, 0, dst, false);
+        emit8(self, 0xB8 | (dst & 7));
+        emit64(self, (uint64_t) imm);
+    }
+}
+
+// Sign extending load of `bits` from [base + disp] into the full 64 bit register
+static void emit_load(self_t, X64Reg dst, X64Reg base, int32_t disp, uint8_t bits) {
+    emit_rex(self, true, dst, base, false);
+    switch (bits) {
+        case 8: emit8(self, 0x0F); emit8(self, 0xBE); break;  // movsx r64, m8
+        case 16: emit8(self, 0x0F); emit8(self, 0xBF); break; // movsx r64, m16
+        case 32: emit8(self, 0x63); break;                    // movsxd r64, m32
+        case 64: emit8(self, 0x8B); break;                    // mov r64, m64
+        default: assert(false);
+    }
+    emit_modrm_mem(self, dst, base, disp);
+}
+
+static void emit_store(self_t, X64Reg base, int32_t disp, X64Reg src, uint8_t bits) {
+    if (bits == 16)
+        emit8(self, 0x66);
+    emit_rex(self, bits == 64, src, base, bits == 8 && src >= RSP && src <= RDI);
+    emit8(self, bits == 8 ? 0x88 : 0x89);
+    emit_modrm_mem(self, src, base, disp);
+}
+
+static void emit_lea(self_t, X64Reg dst, X64Reg base, int32_t disp) {
+    emit_rex(self, true, dst, base, false);
+    emit8(self, 0x8D);
+    emit_modrm_mem(self, dst, base, disp);
+}
+
+// Emits `opcode reg, [rip + disp32]` with a relocation for the displacement
+static void emit_rip_relative(self_t, uint8_t opcode, X64Reg reg, ElfSymbolIndex symbol, ElfRelocType type, int64_t addend) {
+    emit_rex(self, true, reg, 0, false);
+    emit8(self, opcode);
+    emit8(self, 0x05 | ((reg & 7) << 3));
+    elf_object_add_reloc(&self->obj, text_offset(self), symbol, type, addend - 4);
+    emit32(self, 0);
+}
+
+// Sign extends the low `bits` of the register into the full 64 bits
+static void emit_sign_extend(self_t, X64Reg reg, uint8_t bits) {
+    switch (bits) {
+        case 8: emit_rr_0f(self, true, 0xBE, reg, reg, false); break;
+        case 16: emit_rr_0f(self, true, 0xBF, reg, reg, false); break;
+        case 32: emit_rr(self, true, 0x63, reg, reg); break;
+        case 64: break;
+        default: assert(false);
+    }
+}
+
+static void emit_push(self_t, X64Reg reg) {
+    emit_rex(self, false, 0, reg, false);
+    emit8(self, 0x50 | (reg & 7));
+}
+
+static void emit_pop(self_t, X64Reg reg) {
+    emit_rex(self, false, 0, reg, false);
+    emit8(self, 0x58 | (reg & 7));
+}
+
+static void emit_rsp_adjust(self_t, int32_t amount) {
+    if (amount == 0) return;
+    // add/sub rsp, imm32
+    emit8(self, 0x48);
+    emit8(self, 0x81);
+    emit8(self, amount > 0 ? 0xC4 : 0xEC);
+    emit32(self, (uint32_t) (amount > 0 ? amount : -amount));
+}
+
+
+// SECTION: Analysis
+// Scheduling, typing and register allocation of a function before any code is emitted.
+
+static uint8_t type_bits(Type type) {
+    switch (type_tag(type)) {
+        case TypeBool:
+        case TypeI8:
+            return 8;
+        case TypeI16:
+            return 16;
+        case TypeI32:
+            return 32;
+        case TypeI64:
+        case TypeISize:
+        case TY_PTR:
+            return 64;
+        default:
+            fprintf(stderr, "Unsupported type for native backend: %s\n", type_tag_to_string(type_tag(type)));
+            assert(false);
+    }
+}
+
+static bool ref_is_index(Ref ref) {
+    return ref > __REF_LAST;
+}
+
+// Calls `fn` for each instruction operand of the given instruction.
+#define for_each_operand(self, inst, fn, ...) { \
+    switch ((inst)->tag) { \
+        case MirAdd: case MirSub: case MirMul: case MirDiv: \
+        case MirEq: case MirNEq: case MirGt: case MirGtEq: case MirLt: case MirLtEq: \
+        case MirStore: \
+            fn(self, (inst)->data.bin_op.lhs, __VA_ARGS__); \
+            fn(self, (inst)->data.bin_op.rhs, __VA_ARGS__); \
+            break; \
+        case MirLoad: \
+        case MirRet: \
+            fn(self, (inst)->data.un_op, __VA_ARGS__); \
+            break; \
+        case MirCall: { \
+            fn(self, (inst)->data.pl_op.operand, __VA_ARGS__); \
+            MirIndex extra_ = (inst)->data.pl_op.payload; \
+            uint32_t arg_count_ = mir_get_extra((self)->mir, extra_); \
+            for (uint32_t i_ = 1; i_ <= arg_count_; i_++) \
+                fn(self, mir_get_extra((self)->mir, extra_ + i_), __VA_ARGS__); \
+            break; \
+        } \
+        default: \
+            break; \
+    } \
+}
+
+static void schedule_inst(self_t, MirIndex index, bool *visited);
+
+static void schedule_ref(self_t, Ref ref, bool *visited) {
+    if (ref_is_index(ref))
+        schedule_inst(self, ref_to_index(ref), visited);
+}
+
+// Operands are evaluated on demand (like `codegen_inst`), so the evaluation order is a post order walk of the block.
+static void schedule_inst(self_t, MirIndex index, bool *visited) {
+    if (visited[index]) return;
+    visited[index] = true;
+
+    MirInst inst = mir_get_inst(self->mir, index);
+    assert(inst.tag != MirBlock && inst.tag != MirReserved);
+    for_each_operand(self, &inst, schedule_ref, visited)
+
+    index_list_add(&self->schedule, index);
+}
+
+static void build_schedule(self_t) {
+    uint32_t inst_count = self->mir->instructions.size;
+    bool *visited = calloc(inst_count, sizeof(bool));
+
+    // Arguments are always copied to their home in the prologue
+    for (MirIndex i = 0; i < inst_count; i++) {
+        if (mir_inst_list_tag(&self->mir->instructions, i) == MirArg) {
+            visited[i] = true;
+            index_list_add(&self->schedule, i);
+        }
+    }
+
+    MirInst root = mir_get_inst(self->mir, 0);
+    assert(root.tag == MirBlock);
+    MirIndex data_index = root.data.ty_pl.payload;
+    uint32_t stmt_count = mir_get_extra(self->mir, data_index);
+    for (uint32_t i = data_index + 1; i <= data_index + stmt_count; i++) {
+        schedule_inst(self, mir_get_extra(self->mir, i), visited);
+    }
+
+    free(visited);
+}
+
+static Type ref_type(self_t, Ref ref) {
+    if (ref_is_index(ref))
+        return self->types[ref_to_index(ref)];
+
+    // Untyped refs are widened like any other immediate
+    TypeTag tag = ref_value_type(ref);
+    return (Type) {.tag = tag == TypeUnknown ? TypeI64 : tag};
+}
+
+static Type infer_type(self_t, MirInst *inst) {
+    switch (inst->tag) {
+        case MirConstant:
+        case MirArg:
+            return mir_get_type(self->mir, inst->data.ty_pl.ty);
+        case MirAlloc:
+            return mir_get_type(self->mir, inst->data.ty);
+        case MirLoad: {
+            Ref ptr = inst->data.un_op;
+            MirInst ptr_inst = mir_get_inst(self->mir, ref_to_index(ptr));
+            if (ptr_inst.tag == MirAlloc)
+                return mir_get_type(self->mir, ptr_inst.data.ty);
+            Type ptr_type = ref_type(self, ptr);
+            if (type_tag(ptr_type) == TY_PTR)
+                return ptr_type.extended->data.inner_type;
+            return (Type) {.tag = TypeI64};
+        }
+        case MirAdd:
+        case MirSub:
+        case MirMul:
+        case MirDiv:
+            return ref_type(self, ref_is_index(inst->data.bin_op.lhs) ? inst->data.bin_op.lhs : inst->data.bin_op.rhs);
+        case MirEq:
+        case MirNEq:
+        case MirGt:
+        case MirGtEq:
+        case MirLt:
+        case MirLtEq:
+            return (Type) {.tag = TypeBool};
+        case MirCall: {
+            MirInst callee = mir_get_inst(self->mir, ref_to_index(inst->data.pl_op.operand));
+            if (callee.tag == MirFnPtr) {
+                Decl *decl = decl_list_get(&self->module->decls, callee.data.fn_decl);
+                if (decl != NULL)
+                    return decl->data.fn_data->ret_type;
+            }
+            return (Type) {.tag = TypeI64};
+        }
+        default:
+            return (Type) {.tag = TY_VOID};
+    }
+}
+
+static void note_use(self_t, Ref ref, uint32_t position) {
+    if (ref_is_index(ref))
+        self->last_use[ref_to_index(ref)] = position;
+}
+
+// Linear scan over the live intervals of every value which needs a register, in schedule order.
+// When no register is free, whichever interval ends last is spilled to a stack slot.
+static void allocate_registers(self_t) {
+    uint32_t active[ALLOC_REG_COUNT];
+    uint32_t active_count = 0;
+    bool reg_free[16];
+    for (uint32_t i = 0; i < 16; i++) reg_free[i] = false;
+    for (uint32_t i = 0; i < ALLOC_REG_COUNT; i++) reg_free[alloc_regs[i]] = true;
+
+    for (uint32_t p = 0; p < self->schedule.size; p++) {
+        MirIndex index = self->schedule.data[p];
+        X64Loc *loc = &self->locs[index];
+        if (loc->kind != X64_LOC_REG)
+            continue;
+
+        // Expire intervals which ended at or before this instruction. Operands are always read into
+        // scratch registers before the result is written, so the result may reuse an operand register.
+        for (uint32_t i = 0; i < active_count;) {
+            if (self->last_use[active[i]] <= p) {
+                reg_free[self->locs[active[i]].data.reg] = true;
+                active[i] = active[--active_count];
+            } else i++;
+        }
+
+        uint8_t reg = UINT8_MAX;
+        for (uint32_t i = 0; i < ALLOC_REG_COUNT; i++) {
+            if (reg_free[alloc_regs[i]]) {
+                reg = alloc_regs[i];
+                break;
+            }
+        }
+
+        if (reg != UINT8_MAX) {
+            reg_free[reg] = false;
+            loc->data.reg = reg;
+            active[active_count++] = index;
+            self->used_regs |= 1 << reg;
+            continue;
+        }
+
+        // Spill whichever of the candidates lives the longest
+        uint32_t furthest = 0;
+        for (uint32_t i = 1; i < active_count; i++) {
+            if (self->last_use[active[i]] > self->last_use[active[furthest]])
+                furthest = i;
+        }
+
+        MirIndex victim = active[furthest];
+        if (self->last_use[victim] > self->last_use[index]) {
+            *loc = self->locs[victim];
+            active[furthest] = index;
+            loc = &self->locs[victim];
+        }
+
+        loc->kind = X64_LOC_STACK;
+        loc->data.offset = (int32_t) self->slot_count++;
+    }
+}
+
+// Stack slots are numbered during allocation, they become rbp offsets once the saved register count is known.
+static int32_t slot_offset(self_t, int32_t slot) {
+    return -(int32_t) (8 * self->saved_reg_count + 8 * (slot + 1));
+}
+
+static void assign_locations(self_t) {
+    for (uint32_t p = 0; p < self->schedule.size; p++) {
+        MirIndex index = self->schedule.data[p];
+        MirInst inst = mir_get_inst(self->mir, index);
+        self->types[index] = infer_type(self, &inst);
+        self->last_use[index] = UINT32_MAX;
+        for_each_operand(self, &inst, note_use, p)
+    }
+
+    for (uint32_t p = 0; p < self->schedule.size; p++) {
+        MirIndex index = self->schedule.data[p];
+        MirInst inst = mir_get_inst(self->mir, index);
+        X64Loc *loc = &self->locs[index];
+
+        switch (inst.tag) {
+            case MirConstant: {
+                if (type_tag(mir_get_type(self->mir, inst.data.ty_pl.ty)) != TY_PTR) {
+                    *loc = (X64Loc) {.kind = X64_LOC_IMM, .data.imm = inst.data.ty_pl.payload};
+                    break;
+                }
+
+                // String constant, payload is the interned content. Each string is only written once per object.
+                StringKey key = inst.data.ty_pl.payload;
+                size_t *offset = index_ptr_map_get(&self->string_offsets, key);
+                if (offset == NULL || *offset == 0) {
+                    char *content = string_set_get(&self->module->hir->strings, key);
+                    // Stored off by one, since zero marks a missing entry
+                    index_ptr_map_put(&self->string_offsets, key, elf_object_add_string(&self->obj, content, strlen(content)) + 1);
+                    offset = index_ptr_map_get(&self->string_offsets, key);
+                }
+                *loc = (X64Loc) {.kind = X64_LOC_STRING, .data.rodata_offset = *offset - 1};
+                break;
+            }
+            case MirAlloc:
+                *loc = (X64Loc) {.kind = X64_LOC_FRAME, .data.offset = (int32_t) self->slot_count++};
+                break;
+            case MirFnPtr: {
+                char *name = module_decl_name(self->module, decl_list_get(&self->module->decls, inst.data.fn_decl));
+                *loc = (X64Loc) {.kind = X64_LOC_SYMBOL, .data.symbol = elf_object_symbol(&self->obj, name)};
+                break;
+            }
+            case MirStore:
+            case MirRet:
+                *loc = (X64Loc) {.kind = X64_LOC_NONE};
+                break;
+            default:
+                // Arguments are live from the prologue, even if they are never read
+                if (self->last_use[index] == UINT32_MAX && inst.tag != MirArg) {
+                    *loc = (X64Loc) {.kind = X64_LOC_NONE};
+                } else {
+                    if (self->last_use[index] == UINT32_MAX)
+                        self->last_use[index] = 0;
+                    *loc = (X64Loc) {.kind = X64_LOC_REG};
+                }
+                break;
+        }
+    }
+
+    allocate_registers(self);
+
+    self->saved_reg_count = 0;
+    for (uint32_t i = 0; i < ALLOC_REG_COUNT; i++) {
+        if (self->used_regs & (1 << alloc_regs[i]))
+            self->saved_reg_count++;
+    }
+
+    for (uint32_t p = 0; p < self->schedule.size; p++) {
+        X64Loc *loc = &self->locs[self->schedule.data[p]];
+        if (loc->kind == X64_LOC_STACK || loc->kind == X64_LOC_FRAME)
+            loc->data.offset = slot_offset(self, loc->data.offset);
+    }
+}
+
+
+// SECTION: Instruction selection
+
+static void load_ref(self_t, Ref ref, X64Reg dst) {
+    if (!ref_is_index(ref)) {
+        emit_mov_ri(self, dst, (int64_t) ref_int_value(ref));
+        return;
+    }
+
+    X64Loc *loc = &self->locs[ref_to_index(ref)];
+    switch (loc->kind) {
+        case X64_LOC_REG:
+            emit_mov_rr(self, dst, loc->data.reg);
+            break;
+        case X64_LOC_STACK:
+            emit_load(self, dst, RBP, loc->data.offset, 64);
+            break;
+        case X64_LOC_IMM:
+            emit_mov_ri(self, dst, loc->data.imm);
+            break;
+        case X64_LOC_FRAME:
+            emit_lea(self, dst, RBP, loc->data.offset);
+            break;
+        case X64_LOC_STRING:
+            emit_rip_relative(self, 0x8D, dst, self->obj.rodata_symbol, ELF_R_X86_64_PC32, (int64_t) loc->data.rodata_offset);
+            break;
+        case X64_LOC_SYMBOL:
+            emit_rip_relative(self, 0x8B, dst, loc->data.symbol, ELF_R_X86_64_GOTPCREL, 0);
+            break;
+        default:
+            assert(false);
+    }
+}
+
+static void store_result(self_t, MirIndex index, X64Reg src) {
+    X64Loc *loc = &self->locs[index];
+    if (loc->kind == X64_LOC_REG)
+        emit_mov_rr(self, loc->data.reg, src);
+    else if (loc->kind == X64_LOC_STACK)
+        emit_store(self, RBP, loc->data.offset, src, 64);
+}
+
+static void gen_binary_op(self_t, MirIndex index, MirInst *inst) {
+    load_ref(self, inst->data.bin_op.lhs, RAX);
+    load_ref(self, inst->data.bin_op.rhs, RCX);
+
+    uint8_t setcc = 0;
+    switch (inst->tag) {
+        case MirAdd: emit_rr(self, true, 0x01, RCX, RAX); break;
+        case MirSub: emit_rr(self, true, 0x29, RCX, RAX); break;
+        case MirMul: emit_rr_0f(self, true, 0xAF, RAX, RCX, false); break;
+        case MirDiv:
+            emit8(self, 0x48); emit8(self, 0x99); // cqo
+            emit_rr(self, true, 0xF7, 7, RCX);    // idiv rcx
+            break;
+        case MirEq: setcc = 0x94; break;
+        case MirNEq: setcc = 0x95; break;
+        case MirLt: setcc = 0x9C; break;
+        case MirLtEq: setcc = 0x9E; break;
+        case MirGt: setcc = 0x9F; break;
+        case MirGtEq: setcc = 0x9D; break;
+        default: assert(false);
+    }
+
+    if (setcc != 0) {
+        emit_rr(self, true, 0x39, RCX, RAX);            // cmp rax, rcx
+        emit_rr_0f(self, false, setcc, 0, RAX, false);  // setcc al
+        emit_rr_0f(self, true, 0xB6, RAX, RAX, false);  // movzx rax, al
+    } else {
+        emit_sign_extend(self, RAX, type_bits(self->types[index]));
+    }
+
+    store_result(self, index, RAX);
+}
+
+static void gen_load(self_t, MirIndex index, MirInst *inst) {
+    uint8_t bits = type_bits(self->types[index]);
+    X64Loc *ptr = &self->locs[ref_to_index(inst->data.un_op)];
+
+    if (ptr->kind == X64_LOC_FRAME) {
+        emit_load(self, RAX, RBP, ptr->data.offset, bits);
+    } else {
+        load_ref(self, inst->data.un_op, RCX);
+        emit_load(self, RAX, RCX, 0, bits);
+    }
+
+    store_result(self, index, RAX);
+}
+
+static void gen_store(self_t, MirInst *inst) {
+    Ref ptr_ref = inst->data.bin_op.lhs;
+    load_ref(self, inst->data.bin_op.rhs, RAX);
+
+    X64Loc *ptr = &self->locs[ref_to_index(ptr_ref)];
+    if (ptr->kind == X64_LOC_FRAME) {
+        emit_store(self, RBP, ptr->data.offset, RAX, type_bits(self->types[ref_to_index(ptr_ref)]));
+    } else {
+        load_ref(self, ptr_ref, RCX);
+        emit_store(self, RCX, 0, RAX, type_bits(ref_type(self, inst->data.bin_op.rhs)));
+    }
+}
+
+static void gen_call(self_t, MirIndex index, MirInst *inst) {
+    MirIndex extra_index = inst->data.pl_op.payload;
+    uint32_t arg_count = mir_get_extra(self->mir, extra_index);
+
+    // The frame keeps rsp 16 byte aligned, so only stack arguments need padding
+    uint32_t stack_args = arg_count > ARG_REG_COUNT ? arg_count - ARG_REG_COUNT : 0;
+    int32_t padding = (stack_args % 2) ? 8 : 0;
+    emit_rsp_adjust(self, -padding);
+    for (uint32_t i = arg_count; i > ARG_REG_COUNT; i--) {
+        load_ref(self, mir_get_extra(self->mir, extra_index + i), RAX);
+        emit_push(self, RAX);
+    }
+
+    // Values never live in argument registers, so they can be filled in any order
+    for (uint32_t i = 0; i < arg_count && i < ARG_REG_COUNT; i++) {
+        load_ref(self, mir_get_extra(self->mir, extra_index + 1 + i), arg_regs[i]);
+    }
+
+    // Variadic callees read the vector register count from al
+    emit_mov_ri(self, RAX, 0);
+
+    X64Loc *callee = &self->locs[ref_to_index(inst->data.pl_op.operand)];
+    if (callee->kind == X64_LOC_SYMBOL) {
+        emit8(self, 0xE8);
+        elf_object_add_reloc(&self->obj, text_offset(self), callee->data.symbol, ELF_R_X86_64_PLT32, -4);
+        emit32(self, 0);
+    } else {
+        load_ref(self, inst->data.pl_op.operand, R11);
+        emit_rr(self, false, 0xFF, 2, R11); // call r11
+    }
+
+    emit_rsp_adjust(self, (int32_t) (stack_args * 8) + padding);
+
+    emit_sign_extend(self, RAX, type_bits(self->types[index]));
+    store_result(self, index, RAX);
+}
+
+static void gen_ret(self_t, MirInst *inst) {
+    load_ref(self, inst->data.un_op, RAX);
+
+    // Jump to the shared epilogue, patched once the function is complete
+    emit8(self, 0xE9);
+    index_list_add(&self->ret_patches, text_offset(self));
+    emit32(self, 0);
+}
+
+static void gen_prologue(self_t) {
+    emit_push(self, RBP);
+    emit_mov_rr(self, RBP, RSP);
+    for (uint32_t i = 0; i < ALLOC_REG_COUNT; i++) {
+        if (self->used_regs & (1 << alloc_regs[i]))
+            emit_push(self, alloc_regs[i]);
+    }
+
+    // Return address and rbp are 16 bytes, keep rsp 16 byte aligned after the saved registers and slots.
+    uint32_t frame_size = 8 * (self->saved_reg_count + self->slot_count);
+    if (frame_size % 16 != 0)
+        frame_size += 8;
+    emit_rsp_adjust(self, -(int32_t) (frame_size - 8 * self->saved_reg_count));
+
+    // Move arguments to their homes
+    for (uint32_t p = 0; p < self->schedule.size; p++) {
+        MirIndex index = self->schedule.data[p];
+        MirInst inst = mir_get_inst(self->mir, index);
+        if (inst.tag != MirArg)
+            continue;
+
+        uint32_t arg_index = inst.data.ty_pl.payload;
+        if (arg_index < ARG_REG_COUNT) {
+            emit_mov_rr(self, RAX, arg_regs[arg_index]);
+        } else {
+            emit_load(self, RAX, RBP, (int32_t) (16 + 8 * (arg_index - ARG_REG_COUNT)), 64);
+        }
+        emit_sign_extend(self, RAX, type_bits(self->types[index]));
+        store_result(self, index, RAX);
+    }
+}
+
+static void gen_epilogue(self_t) {
+    // Falling off the end of a function returns zero
+    emit_mov_ri(self, RAX, 0);
+
+    uint32_t epilogue = text_offset(self);
+    for (uint32_t i = 0; i < self->ret_patches.size; i++) {
+        uint32_t patch = self->ret_patches.data[i];
+        patch32(self, patch, epilogue - (patch + 4));
+    }
+
+    emit_lea(self, RSP, RBP, -(int32_t) (8 * self->saved_reg_count));
+    for (uint32_t i = ALLOC_REG_COUNT; i > 0; i--) {
+        if (self->used_regs & (1 << alloc_regs[i - 1]))
+            emit_pop(self, alloc_regs[i - 1]);
+    }
+    emit_pop(self, RBP);
+    emit8(self, 0xC3);
+}
+
+static void gen_inst(self_t, MirIndex index) {
+    MirInst inst = mir_get_inst(self->mir, index);
+    switch (inst.tag) {
+        case MirAdd:
+        case MirSub:
+        case MirMul:
+        case MirDiv:
+        case MirEq:
+        case MirNEq:
+        case MirGt:
+        case MirGtEq:
+        case MirLt:
+        case MirLtEq:
+            gen_binary_op(self, index, &inst);
+            break;
+        case MirLoad:
+            gen_load(self, index, &inst);
+            break;
+        case MirStore:
+            gen_store(self, &inst);
+            break;
+        case MirCall:
+            gen_call(self, index, &inst);
+            break;
+        case MirRet:
+            gen_ret(self, &inst);
+            break;
+        case MirArg:
+        case MirAlloc:
+        case MirConstant:
+        case MirFnPtr:
+            // Handled by the prologue or rematerialized at each use
+            break;
+        case MirReserved: {
+            printf("Illegal reserved tag present in MIR\n");
+            assert(false);
+        }
+        default: {
+            printf("Unhandled tag for native codegen: %s\n", mir_tag_to_string(inst.tag));
+            assert(false);
+        }
+    }
+}
+
+
+// SECTION: Public API
+
+void x64_gen_init(self_t, Module *module) {
+    assert(module != NULL);
+    self->module = module;
+    elf_object_init(&self->obj);
+
+    self->mir = NULL;
+    index_list_init(&self->schedule);
+    index_list_init(&self->ret_patches);
+    index_ptr_map_init(&self->string_offsets);
+    self->locs = NULL;
+    self->types = NULL;
+    self->last_use = NULL;
+}
+
+void x64_gen_free(self_t) {
+    elf_object_free(&self->obj);
+    index_list_free(&self->schedule);
+    index_list_free(&self->ret_patches);
+    index_ptr_map_free(&self->string_offsets);
+    self->module = NULL;
+}
+
+bool x64_gen_write_to_obj_file(self_t, char *path) {
+    return elf_object_write_to_file(&self->obj, path);
+}
+
+void x64_gen_lower_decl(self_t, Decl *decl) {
+    assert(decl != NULL);
+
+    Mir *mir = decl_get_mir_in_module(decl, self->module);
+    self->mir = mir;
+    TimeSpan span = time_phase_begin(TIME_PHASE_NATIVE);
+
+    uint32_t inst_count = mir->instructions.size;
+    self->locs = calloc(inst_count, sizeof(X64Loc));
+    self->types = calloc(inst_count, sizeof(Type));
+    self->last_use = calloc(inst_count, sizeof(uint32_t));
+    self->used_regs = 0;
+    self->slot_count = 0;
+
+    build_schedule(self);
+    assign_locations(self);
+
+    // Align functions to 16 bytes with int3 padding
+    while (text_offset(self) % 16 != 0)
+        emit8(self, 0xCC);
+    uint32_t start = text_offset(self);
+
+    gen_prologue(self);
+    for (uint32_t p = 0; p < self->schedule.size; p++) {
+        gen_inst(self, self->schedule.data[p]);
+    }
+    gen_epilogue(self);
+
+    ElfSymbolIndex symbol = elf_object_symbol(&self->obj, module_decl_name(self->module, decl));
+    elf_object_define(&self->obj, symbol, start, text_offset(self) - start);
+
+    // Referenced functions are generated afterwards by the module
+    for (uint32_t p = 0; p < self->schedule.size; p++) {
+        MirIndex index = self->schedule.data[p];
+        if (mir_inst_list_tag(&mir->instructions, index) != MirFnPtr)
+            continue;
+
+        Decl *target = decl_list_get(&self->module->decls, mir->instructions.data[index].fn_decl);
+        if (target != NULL && target->state == DeclStateUnused)
+            target->state = DeclStateReferenced;
+    }
+    decl->state = DeclStateGenerated;
+    time_phase_end_detail(&span, module_decl_name(self->module, decl), inst_count);
+
+    free(self->locs);
+    free(self->types);
+    free(self->last_use);
+    self->locs = NULL;
+    self->types = NULL;
+    self->last_use = NULL;
+    index_list_free(&self->schedule);
+    index_list_free(&self->ret_patches);
+    self->mir = NULL;
+}
+
+#undef self_t
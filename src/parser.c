@@ -12,8 +12,12 @@ void parser_init(self_t, uint8_t *source) {
     token_list_init(&self->tokens);
     self->tok_index = 0;
 
+    line_index_init(&self->lines);
+    line_index_add(&self->lines, 0);
+
     Lexer lexer;
     lexer_init(&lexer, source);
+    lexer.lines = &self->lines;
     Token tok;
     while ((tok = lexer_next(&lexer)).type != TOK_EOF)
         token_list_insert(&self->tokens, tok);
@@ -24,6 +28,7 @@ void parser_init(self_t, uint8_t *source) {
     index_list_init(&self->extra_data);
 
     error_list_init(&self->errors);
+    self->abandoned = false;
 }
 
 Ast parser_parse(self_t) {
@@ -32,6 +37,7 @@ Ast parser_parse(self_t) {
     return (Ast) {
         .source = self->source,
         .tokens = self->tokens,
+        .lines = self->lines,
         .nodes = self->nodes,
         .extra_data = self->extra_data,
         .errors = self->errors,
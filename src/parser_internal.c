@@ -38,23 +38,17 @@ bool parse_match_advance(self_t, TokenType type) {
     return true;
 }
 
-TokenIndex parse_assert(self_t, TokenType type) {
-    Token tok = parse_advance(self);
-    if (tok.type != type) {
-        printf("Expected token of type %s, got %s\n", token_type_to_string(type), token_type_to_string(tok.type));
-        assert(false);
-    }
-    return self->tok_index - 1;
-}
-
 static AstIndex error(self_t, AstError code) {
-    Token current_tok = parse_peek_curr(self);
-    error_list_add(&self->errors, (CompileError) {
-        .error_code = code,
-        .node = ast_index_empty,
-        .location = {current_tok.loc.start, UINT32_MAX},
-        .message = ast_error_to_string(code),
-    });
+    // Once abandoned, every remaining token is the EOF, which is not worth reporting
+    if (!self->abandoned) {
+        Token current_tok = parse_peek_curr(self);
+        error_list_add(&self->errors, (CompileError) {
+            .error_code = code,
+            .node = ast_index_empty,
+            .location = {current_tok.loc.start, UINT32_MAX},
+            .message = ast_error_to_string(code),
+        });
+    }
     ast_node_list_add(&self->nodes, (AstNode) {
         .tag = AST_ERROR,
         .main_token = UINT32_MAX,
@@ -63,11 +57,35 @@ static AstIndex error(self_t, AstError code) {
     return self->nodes.size - 1;
 }
 
+// Skips to the EOF, so that every loop of the parser ends. The errors after the first one would only be noise.
+static void abandon(self_t) {
+    self->abandoned = true;
+    self->tok_index = self->tokens.size - 1;
+}
+
+TokenIndex parse_assert(self_t, TokenType type) {
+    if (!parse_match(self, type)) {
+        error(self, parse_match(self, TOK_EOF) ? AST_ERR_UNEXPECTED_EOF : AST_ERR_UNEXPECTED_TOKEN);
+        abandon(self);
+        return self->tok_index;
+    }
+
+    parse_advance(self);
+    return self->tok_index - 1;
+}
+
+// Neither the EOF nor a token the lexer could not make sense of (eg an unterminated string) can be parsed past
 AstIndex parse_error(self_t) {
+    AstIndex result;
     if (parse_peek_curr(self).type == TOK_EOF) {
-        return error(self, AST_ERR_UNEXPECTED_EOF);
+        result = error(self, AST_ERR_UNEXPECTED_EOF);
+    } else {
+        assert(parse_match(self, TOK_ERROR));
+        result = error(self, AST_ERR_INVALID_TOKEN);
     }
-    assert(false);
+
+    abandon(self);
+    return result;
 }
 
 
@@ -93,11 +111,13 @@ AstIndex int_module(self_t) {
     // Parse inner expressions
     while (!parse_match(self, TOK_EOF)) {
         AstIndex idx = int_top_level_decl(self);
-        index_list_add(&inner_indices, idx);
-
         if (idx == ast_index_empty) {
-            assert(false);
+            error(self, AST_ERR_UNEXPECTED_TOKEN);
+            abandon(self);
+            break;
         }
+
+        index_list_add(&inner_indices, idx);
     }
 
     // First node
@@ -313,7 +333,7 @@ AstIndex int_expr_bp(self_t) {
             // This is kind of a hack, we need to treat lparen as a call, not parens when its not in a prefix position.
             bool is_postfix = res.min_bp == 100;
             if (self->tokens.data[res.op_idx].type == TOK_LPAREN && !is_postfix) {
-                assert(parse_advance(self).type == TOK_RPAREN);
+                parse_assert(self, TOK_RPAREN);
                 top.lhs = res.lhs;
                 continue;
             }
@@ -378,8 +398,8 @@ AstIndex int_expr_bp(self_t) {
 AstIndex expr_literal(self_t) {
     Token next = parse_peek_curr(self);
 
-    // If we are at EOF, nothing can be parsed
-    if (next.type == TOK_EOF) {
+    // If we are at EOF or an invalid token, nothing can be parsed
+    if (next.type == TOK_EOF || next.type == TOK_ERROR) {
         return parse_error(self);
     }
 
@@ -431,7 +451,6 @@ static AstIndex _wrap_in_iret(self_t, AstIndex idx) {
 }
 
 AstIndex expr_block(self_t) {
-    assert(parse_peek_curr(self).type == TOK_LBRACE);
     TokenIndex main_token = self->tok_index;
 
     AstIndexPair data = int_parse_list(self, int_stmt, TOK_LBRACE, TOK_RBRACE, TOK_SEMI, _wrap_in_iret);
@@ -638,8 +657,9 @@ int_parse_list(self_t, AstIndex (*parse_fn)(self_t), TokenType open, TokenType c
     IndexList inner_indices;
     index_list_init(&inner_indices);
 
-    // Parse inner expressions
-    while (parse_peek_curr(self).type != close) {
+    // Parse inner expressions, an unterminated list ends at the EOF and fails below
+    while (parse_peek_curr(self).type != close && parse_peek_curr(self).type != TOK_EOF) {
+        TokenIndex start = self->tok_index;
         AstIndex idx = parse_fn(self);
 
         if (idx == ast_index_empty) {
@@ -652,7 +672,7 @@ int_parse_list(self_t, AstIndex (*parse_fn)(self_t), TokenType open, TokenType c
         } else if (parse_peek_curr(self).type == close) {
             if (wrap_func != NULL)
                 idx = wrap_func(self, idx);
-        } else {
+        } else if (!self->abandoned) {
             // Insert an error, however we can still continue trying to parse this
             //  eg this is a non-fatal parse error.
             error_list_add(&self->errors, (CompileError) {
@@ -661,6 +681,10 @@ int_parse_list(self_t, AstIndex (*parse_fn)(self_t), TokenType open, TokenType c
                 .location = {parse_peek_curr(self).loc.start, UINT32_MAX},
                 .message = "Missing semicolon",
             });
+
+            // Nothing was parsed, so trying again would never end
+            if (self->tok_index == start)
+                abandon(self);
         }
 
         index_list_add(&inner_indices, idx);
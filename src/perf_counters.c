@@ -0,0 +1,134 @@
+#include "perf_counters.h"
+
+#include <stdatomic.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static atomic_bool enabled = false;
+
+char *perf_counter_to_string(PerfCounter counter) {
+    switch (counter) {
+        case PERF_COUNTER_CYCLES:           return "cycles";
+        case PERF_COUNTER_INSTRUCTIONS:     return "instructions";
+        case PERF_COUNTER_CACHE_MISSES:     return "cache misses";
+        case PERF_COUNTER_BRANCH_MISSES:    return "branch misses";
+        default:                            return "<?>";
+    }
+}
+
+#ifdef __linux__
+
+static _Thread_local bool thread_opened = false;
+static _Thread_local int thread_fds[__PERF_COUNTER_LAST];
+
+// Closes the counters of a thread when it exits, so worker threads do not leak descriptors.
+static pthread_once_t close_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t close_key;
+
+static void perf_counters_close_thread(void *unused) {
+    (void) unused;
+    for (PerfCounter i = 0; i < __PERF_COUNTER_LAST; i++) {
+        if (thread_fds[i] >= 0)
+            close(thread_fds[i]);
+        thread_fds[i] = -1;
+    }
+}
+
+static void perf_counters_create_close_key(void) {
+    pthread_key_create(&close_key, perf_counters_close_thread);
+}
+
+static uint64_t perf_counter_config(PerfCounter counter) {
+    switch (counter) {
+        case PERF_COUNTER_CYCLES:           return PERF_COUNT_HW_CPU_CYCLES;
+        case PERF_COUNTER_INSTRUCTIONS:     return PERF_COUNT_HW_INSTRUCTIONS;
+        case PERF_COUNTER_CACHE_MISSES:     return PERF_COUNT_HW_CACHE_MISSES;
+        case PERF_COUNTER_BRANCH_MISSES:    return PERF_COUNT_HW_BRANCH_MISSES;
+        default:                            assert(false);
+    }
+}
+
+// Counts only this thread in user space, which works with the default `perf_event_paranoid` of 2.
+static int perf_counter_open(PerfCounter counter) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = perf_counter_config(counter);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint32_t perf_counters_open_thread(void) {
+    uint32_t opened = 0;
+    for (PerfCounter i = 0; i < __PERF_COUNTER_LAST; i++) {
+        thread_fds[i] = perf_counter_open(i);
+        if (thread_fds[i] >= 0)
+            opened |= 1u << i;
+    }
+
+    thread_opened = true;
+    pthread_once(&close_key_once, perf_counters_create_close_key);
+    pthread_setspecific(close_key, &thread_opened);
+    return opened;
+}
+
+bool perf_counters_enable(void) {
+    uint32_t opened = perf_counters_open_thread();
+    if (opened == 0) {
+        fprintf(stderr, "Hardware performance counters are unavailable: %s\n", strerror(errno));
+        return false;
+    }
+
+    for (PerfCounter i = 0; i < __PERF_COUNTER_LAST; i++) {
+        if (!(opened & (1u << i)))
+            fprintf(stderr, "Hardware performance counter unavailable: %s\n", perf_counter_to_string(i));
+    }
+
+    atomic_store(&enabled, true);
+    return true;
+}
+
+PerfSample perf_counters_read(void) {
+    PerfSample sample = {.valid = 0};
+    if (!perf_counters_enabled())
+        return sample;
+
+    if (!thread_opened)
+        perf_counters_open_thread();
+
+    for (PerfCounter i = 0; i < __PERF_COUNTER_LAST; i++) {
+        if (thread_fds[i] < 0)
+            continue;
+        if (read(thread_fds[i], &sample.values[i], sizeof(uint64_t)) == sizeof(uint64_t))
+            sample.valid |= 1u << i;
+    }
+
+    return sample;
+}
+
+#else
+
+bool perf_counters_enable(void) {
+    fprintf(stderr, "Hardware performance counters are only supported on Linux\n");
+    return false;
+}
+
+PerfSample perf_counters_read(void) {
+    return (PerfSample) {.valid = 0};
+}
+
+#endif
+
+bool perf_counters_enabled(void) {
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
@@ -0,0 +1,215 @@
+#include "time_report.h"
+
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/resource.h>
+
+typedef struct time_phase_totals_s {
+    atomic_uint_fast64_t wall_ns;
+    atomic_uint_fast64_t cpu_ns;
+    atomic_int_fast64_t max_rss_delta_kb;
+    atomic_uint_fast64_t spans;
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t perf[__PERF_COUNTER_LAST];
+    // Bit per counter, set once any span of the phase read it
+    atomic_uint perf_valid;
+} TimePhaseTotals;
+
+static atomic_bool enabled = false;
+static uint64_t report_start_ns = 0;
+static int64_t report_start_rss_kb = 0;
+static TimePhaseTotals totals[__TIME_PHASE_LAST];
+
+char *time_phase_to_string(TimePhase phase) {
+    switch (phase) {
+        case TIME_PHASE_FILE_LOAD:  return "file load";
+        case TIME_PHASE_LEX:        return "lex";
+        case TIME_PHASE_PARSE:      return "parse";
+        case TIME_PHASE_HIR:        return "hir";
+        case TIME_PHASE_MIR:        return "mir";
+        case TIME_PHASE_LLVM_IR:    return "llvm ir";
+        case TIME_PHASE_LLVM_OPT:   return "llvm opt";
+        case TIME_PHASE_NATIVE:     return "native codegen";
+        case TIME_PHASE_EMIT:       return "emit";
+        case TIME_PHASE_LINK:       return "link";
+        default:                    return "<?>";
+    }
+}
+
+// The thing counted by `time_phase_end` for each phase
+static char *time_phase_count_unit(TimePhase phase) {
+    switch (phase) {
+        case TIME_PHASE_FILE_LOAD:  return "bytes";
+        case TIME_PHASE_LEX:        return "tokens";
+        case TIME_PHASE_PARSE:      return "ast nodes";
+        case TIME_PHASE_HIR:        return "hir insts";
+        case TIME_PHASE_MIR:        return "mir insts";
+        case TIME_PHASE_LLVM_IR:    return "mir insts";
+        case TIME_PHASE_LLVM_OPT:   return "units";
+        case TIME_PHASE_NATIVE:     return "mir insts";
+        case TIME_PHASE_EMIT:       return "units";
+        case TIME_PHASE_LINK:       return "objects";
+        default:                    return "items";
+    }
+}
+
+static uint64_t clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// Peak resident set size of the process so far, in KiB.
+static int64_t max_rss_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void time_report_enable(void) {
+    report_start_ns = clock_ns(CLOCK_MONOTONIC);
+    report_start_rss_kb = max_rss_kb();
+    atomic_store(&enabled, true);
+}
+
+bool time_report_enabled(void) {
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+TimeSpan time_phase_begin(TimePhase phase) {
+    TimeSpan span = {.phase = phase, .trace = trace_begin(time_phase_to_string(phase))};
+    if (time_report_enabled()) {
+        span.wall_start = clock_ns(CLOCK_MONOTONIC);
+        span.cpu_start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+        span.max_rss_start = max_rss_kb();
+        span.perf_start = perf_counters_read();
+    }
+
+    return span;
+}
+
+void time_phase_end(TimeSpan *span, uint64_t count) {
+    time_phase_end_detail(span, NULL, count);
+}
+
+void time_phase_end_detail(TimeSpan *span, const char *detail, uint64_t count) {
+    trace_end(&span->trace, detail, time_phase_count_unit(span->phase), count);
+    if (span->wall_start == 0)
+        return;
+
+    TimePhaseTotals *phase = &totals[span->phase];
+    if (span->perf_start.valid != 0) {
+        PerfSample perf_end = perf_counters_read();
+        uint32_t valid = span->perf_start.valid & perf_end.valid;
+        for (PerfCounter i = 0; i < __PERF_COUNTER_LAST; i++) {
+            if (valid & (1u << i))
+                atomic_fetch_add(&phase->perf[i], perf_end.values[i] - span->perf_start.values[i]);
+        }
+        atomic_fetch_or(&phase->perf_valid, valid);
+    }
+
+    atomic_fetch_add(&phase->wall_ns, clock_ns(CLOCK_MONOTONIC) - span->wall_start);
+    atomic_fetch_add(&phase->cpu_ns, clock_ns(CLOCK_THREAD_CPUTIME_ID) - span->cpu_start);
+    atomic_fetch_add(&phase->max_rss_delta_kb, max_rss_kb() - span->max_rss_start);
+    atomic_fetch_add(&phase->spans, 1);
+    atomic_fetch_add(&phase->count, count);
+    span->wall_start = 0;
+}
+
+void time_report_print(FILE *out) {
+    fprintf(out, "%-16s %12s %12s %14s %8s  %s\n", "phase", "wall (ms)", "cpu (ms)", "peak rss (KiB)", "spans", "count");
+
+    for (TimePhase i = 0; i < __TIME_PHASE_LAST; i++) {
+        TimePhaseTotals *phase = &totals[i];
+        uint64_t spans = atomic_load(&phase->spans);
+        if (spans == 0)
+            continue;
+
+        fprintf(out, "%-16s %12.3f %12.3f %+14lld %8llu  %llu %s\n",
+                time_phase_to_string(i),
+                (double) atomic_load(&phase->wall_ns) / 1e6,
+                (double) atomic_load(&phase->cpu_ns) / 1e6,
+                (long long) atomic_load(&phase->max_rss_delta_kb),
+                (unsigned long long) spans,
+                (unsigned long long) atomic_load(&phase->count),
+                time_phase_count_unit(i));
+    }
+
+    fprintf(out, "%-16s %12.3f %12s %+14lld\n", "total",
+            (double) (clock_ns(CLOCK_MONOTONIC) - report_start_ns) / 1e6, "",
+            (long long) (max_rss_kb() - report_start_rss_kb));
+}
+
+void time_report_print_json(FILE *out) {
+    fprintf(out, "{\"phases\":[");
+
+    bool first = true;
+    for (TimePhase i = 0; i < __TIME_PHASE_LAST; i++) {
+        TimePhaseTotals *phase = &totals[i];
+        uint64_t spans = atomic_load(&phase->spans);
+        if (spans == 0)
+            continue;
+
+        fprintf(out, "%s{\"name\":\"%s\",\"wall_ns\":%llu,\"cpu_ns\":%llu,\"max_rss_delta_kb\":%lld,"
+                     "\"spans\":%llu,\"count\":%llu,\"count_unit\":\"%s\"}",
+                first ? "" : ",",
+                time_phase_to_string(i),
+                (unsigned long long) atomic_load(&phase->wall_ns),
+                (unsigned long long) atomic_load(&phase->cpu_ns),
+                (long long) atomic_load(&phase->max_rss_delta_kb),
+                (unsigned long long) spans,
+                (unsigned long long) atomic_load(&phase->count),
+                time_phase_count_unit(i));
+        first = false;
+    }
+
+    fprintf(out, "],\"total_wall_ns\":%llu,\"max_rss_kb\":%lld}\n",
+            (unsigned long long) (clock_ns(CLOCK_MONOTONIC) - report_start_ns),
+            (long long) max_rss_kb());
+}
+
+// Prints a counter column, or n/a if the counter was never read
+static void print_perf_value(FILE *out, TimePhaseTotals *phase, PerfCounter counter, uint64_t divisor) {
+    if (!(atomic_load(&phase->perf_valid) & (1u << counter)) || divisor == 0) {
+        fprintf(out, " %14s", "n/a");
+    } else if (divisor == 1) {
+        fprintf(out, " %14llu", (unsigned long long) atomic_load(&phase->perf[counter]));
+    } else {
+        fprintf(out, " %14.3f", (double) atomic_load(&phase->perf[counter]) / (double) divisor);
+    }
+}
+
+void time_report_print_perf(FILE *out) {
+    uint64_t tokens = atomic_load(&totals[TIME_PHASE_LEX].count);
+    uint64_t nodes = atomic_load(&totals[TIME_PHASE_PARSE].count);
+
+    fprintf(out, "%-16s %14s %14s %6s %14s %14s %14s %14s %14s %14s\n", "phase", "cycles", "instructions", "ipc",
+            "cache misses", "branch misses", "cache/token", "cache/node", "branch/token", "branch/node");
+
+    for (TimePhase i = 0; i < __TIME_PHASE_LAST; i++) {
+        TimePhaseTotals *phase = &totals[i];
+        if (atomic_load(&phase->spans) == 0)
+            continue;
+
+        fprintf(out, "%-16s", time_phase_to_string(i));
+        print_perf_value(out, phase, PERF_COUNTER_CYCLES, 1);
+        print_perf_value(out, phase, PERF_COUNTER_INSTRUCTIONS, 1);
+
+        uint32_t valid = atomic_load(&phase->perf_valid);
+        uint32_t ipc_counters = (1u << PERF_COUNTER_CYCLES) | (1u << PERF_COUNTER_INSTRUCTIONS);
+        uint64_t cycles = atomic_load(&phase->perf[PERF_COUNTER_CYCLES]);
+        if ((valid & ipc_counters) == ipc_counters && cycles != 0) {
+            fprintf(out, " %6.2f", (double) atomic_load(&phase->perf[PERF_COUNTER_INSTRUCTIONS]) / (double) cycles);
+        } else {
+            fprintf(out, " %6s", "n/a");
+        }
+
+        print_perf_value(out, phase, PERF_COUNTER_CACHE_MISSES, 1);
+        print_perf_value(out, phase, PERF_COUNTER_BRANCH_MISSES, 1);
+        print_perf_value(out, phase, PERF_COUNTER_CACHE_MISSES, tokens);
+        print_perf_value(out, phase, PERF_COUNTER_CACHE_MISSES, nodes);
+        print_perf_value(out, phase, PERF_COUNTER_BRANCH_MISSES, tokens);
+        print_perf_value(out, phase, PERF_COUNTER_BRANCH_MISSES, nodes);
+        fprintf(out, "\n");
+    }
+}
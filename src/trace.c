@@ -0,0 +1,215 @@
+#include "trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Events per thread before the oldest are overwritten
+#define TRACE_BUFFER_CAPACITY 16384
+
+typedef struct trace_event_s {
+    const char *name;
+    const char *count_name;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t count;
+    char detail[TRACE_DETAIL_LEN];
+} TraceEvent;
+
+typedef struct trace_buffer_s {
+    uint32_t thread_id;
+    // Total number of events recorded, the ring holds the last `TRACE_BUFFER_CAPACITY` of them.
+    uint64_t recorded;
+    TraceEvent events[TRACE_BUFFER_CAPACITY];
+    struct trace_buffer_s *next;
+    // Only used while the buffer is idle
+    struct trace_buffer_s *next_idle;
+} TraceBuffer;
+
+static atomic_bool enabled = false;
+static char *trace_path = NULL;
+
+// Every buffer ever created, buffers live until the process exits.
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceBuffer *buffers = NULL;
+static uint32_t buffer_count = 0;
+
+// Buffers of threads which exited. Worker threads are created for every compile, so a new thread continues the buffer
+// of one which exited instead of allocating its own, and the buffers are bounded by the threads recording at once.
+static TraceBuffer *idle_buffers = NULL;
+static pthread_once_t release_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t release_key;
+
+static _Thread_local TraceBuffer *thread_buffer = NULL;
+
+static void release_thread_buffer(void *buffer) {
+    pthread_mutex_lock(&buffers_lock);
+    ((TraceBuffer *) buffer)->next_idle = idle_buffers;
+    idle_buffers = buffer;
+    pthread_mutex_unlock(&buffers_lock);
+}
+
+static void create_release_key(void) {
+    pthread_key_create(&release_key, release_thread_buffer);
+}
+
+// Returns NULL if no buffer could be allocated, in which case the event is dropped.
+static TraceBuffer *trace_thread_buffer(void) {
+    if (thread_buffer != NULL)
+        return thread_buffer;
+
+    pthread_once(&release_key_once, create_release_key);
+    pthread_mutex_lock(&buffers_lock);
+    TraceBuffer *buffer = idle_buffers;
+    if (buffer != NULL) {
+        idle_buffers = buffer->next_idle;
+    } else {
+        buffer = malloc(sizeof(TraceBuffer));
+        if (buffer != NULL) {
+            buffer->recorded = 0;
+            buffer->thread_id = ++buffer_count;
+            buffer->next = buffers;
+            buffers = buffer;
+        }
+    }
+    pthread_mutex_unlock(&buffers_lock);
+
+    if (buffer == NULL)
+        return NULL;
+    pthread_setspecific(release_key, buffer);
+    thread_buffer = buffer;
+    return buffer;
+}
+
+void trace_enable(const char *path) {
+    free(trace_path);
+    trace_path = strdup(path);
+    atomic_store(&enabled, true);
+}
+
+bool trace_enabled(void) {
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+uint64_t trace_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+TraceSpan trace_begin(const char *name) {
+    if (!trace_enabled())
+        return (TraceSpan) {.name = name, .start_ns = 0};
+
+    return (TraceSpan) {.name = name, .start_ns = trace_now_ns()};
+}
+
+void trace_end(TraceSpan *span, const char *detail, const char *count_name, uint64_t count) {
+    if (span->start_ns == 0)
+        return;
+
+    TraceBuffer *buffer = trace_thread_buffer();
+    if (buffer == NULL) {
+        span->start_ns = 0;
+        return;
+    }
+
+    TraceEvent *event = &buffer->events[buffer->recorded % TRACE_BUFFER_CAPACITY];
+    event->name = span->name;
+    event->count_name = count_name;
+    event->start_ns = span->start_ns;
+    event->end_ns = trace_now_ns();
+    event->count = count;
+    if (detail != NULL) {
+        strncpy(event->detail, detail, TRACE_DETAIL_LEN - 1);
+        event->detail[TRACE_DETAIL_LEN - 1] = '\0';
+    } else {
+        event->detail[0] = '\0';
+    }
+
+    buffer->recorded++;
+    span->start_ns = 0;
+}
+
+// Detail strings come from source identifiers, but are escaped anyway so the output is always valid JSON.
+static void write_json_chars(FILE *out, const char *str) {
+    for (const char *c = str; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        } else if ((unsigned char) *c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        } else {
+            fputc(*c, out);
+        }
+    }
+}
+
+static void write_event(FILE *out, TraceEvent *event, uint32_t thread_id, int pid) {
+    fprintf(out, ",\n{\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+            pid, thread_id, (double) event->start_ns / 1e3, (double) (event->end_ns - event->start_ns) / 1e3);
+    // Decl spans are named after the decl as well, so they can be told apart at a glance.
+    fprintf(out, "\"%s", event->name);
+    if (event->detail[0] != '\0') {
+        fputc(' ', out);
+        write_json_chars(out, event->detail);
+    }
+    fputc('"', out);
+
+    fprintf(out, ",\"cat\":\"acorn\",\"args\":{");
+    if (event->detail[0] != '\0') {
+        fprintf(out, "\"decl\":\"");
+        write_json_chars(out, event->detail);
+        fputc('"', out);
+    }
+    if (event->count_name != NULL) {
+        fprintf(out, "%s\"%s\":%llu", event->detail[0] != '\0' ? "," : "", event->count_name,
+                (unsigned long long) event->count);
+    }
+    fprintf(out, "}}");
+}
+
+bool trace_write(void) {
+    if (!trace_enabled())
+        return true;
+
+    FILE *out = fopen(trace_path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Could not open trace file: %s\n", trace_path);
+        return false;
+    }
+
+    int pid = (int) getpid();
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(out, "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"acorn\"}}", pid);
+
+    uint64_t dropped = 0;
+    pthread_mutex_lock(&buffers_lock);
+    for (TraceBuffer *buffer = buffers; buffer != NULL; buffer = buffer->next) {
+        // The main thread always records first
+        fprintf(out, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", pid, buffer->thread_id);
+        if (buffer->thread_id == 1)
+            fprintf(out, "\"main\"}}");
+        else
+            fprintf(out, "\"worker %u\"}}", buffer->thread_id - 1);
+
+        uint64_t first = buffer->recorded > TRACE_BUFFER_CAPACITY ? buffer->recorded - TRACE_BUFFER_CAPACITY : 0;
+        dropped += first;
+        for (uint64_t i = first; i < buffer->recorded; i++) {
+            write_event(out, &buffer->events[i % TRACE_BUFFER_CAPACITY], buffer->thread_id, pid);
+        }
+    }
+    pthread_mutex_unlock(&buffers_lock);
+
+    fprintf(out, "\n]}\n");
+    bool result = fclose(out) == 0;
+    if (!result)
+        fprintf(stderr, "Could not write trace file: %s\n", trace_path);
+    if (dropped != 0)
+        fprintf(stderr, "Trace buffers overflowed, the oldest %llu events were dropped\n", (unsigned long long) dropped);
+
+    return result;
+}
@@ -3,6 +3,7 @@
 
 #include "string.h"
 #include "hir.h"
+#include "alloc_tracker.h"
 
 char *type_tag_to_string(TypeTag tag) {
     switch (tag) {
@@ -140,9 +141,10 @@ Type type_from_hir_inst(Hir *hir, HirIndex index) {
     HirInst *type_inst = hir_get_inst_tagged(hir, index, HIR_TYPE);
 
     if (type_inst->data.ty.is_ptr) {
-        ExtendedType *ext_ty = malloc(sizeof(ExtendedType));
+        ExtendedType *ext_ty = TRACKED_MALLOC(ALLOC_TAG_EXTENDED_TYPE, sizeof(ExtendedType));
         ext_ty->tag = TY_PTR;
         ext_ty->data.inner_type = type_from_hir_inst(hir, type_inst->data.ty.inner);
+        return (Type) {.extended = ext_ty};
     }
 
     // Name is borrowed from the string set
@@ -0,0 +1,138 @@
+#include "writer.h"
+#include "array_util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Staging size for file and callback writers, and the initial size of buffer writers.
+#define WRITER_STAGING_SIZE 4096
+
+#define self_t Writer *self
+
+static void writer_init(self_t, WriterSink sink) {
+    self->sink = sink;
+    self->file = NULL;
+    self->callback = NULL;
+    self->context = NULL;
+
+    self->capacity = WRITER_STAGING_SIZE;
+    self->data = ARRAY_GROW(char, NULL, self->capacity);
+    self->data[0] = '\0';
+    self->size = 0;
+}
+
+void writer_init_file(self_t, FILE *file) {
+    writer_init(self, WRITER_SINK_FILE);
+    self->file = file;
+}
+
+void writer_init_buffer(self_t) {
+    writer_init(self, WRITER_SINK_BUFFER);
+}
+
+void writer_init_callback(self_t, WriterCallback callback, void *context) {
+    writer_init(self, WRITER_SINK_CALLBACK);
+    self->callback = callback;
+    self->context = context;
+}
+
+void writer_free(self_t) {
+    writer_flush(self);
+    ARRAY_FREE(char, self->data);
+    self->data = NULL;
+    self->size = 0;
+    self->capacity = 0;
+}
+
+void writer_flush(self_t) {
+    if (self->size == 0)
+        return;
+
+    switch (self->sink) {
+        case WRITER_SINK_FILE:
+            fwrite(self->data, 1, self->size, self->file);
+            break;
+        case WRITER_SINK_CALLBACK:
+            self->callback(self->context, self->data, self->size);
+            break;
+        case WRITER_SINK_BUFFER:
+            return;
+    }
+
+    self->size = 0;
+    self->data[0] = '\0';
+}
+
+// Makes room for `len` more bytes and a null terminator, flushing first when the sink allows it.
+static void writer_reserve(self_t, size_t len) {
+    if (self->size + len + 1 <= self->capacity)
+        return;
+
+    writer_flush(self);
+
+    size_t capacity = self->capacity;
+    while (self->size + len + 1 > capacity)
+        capacity = ARRAY_GROW_CAPCITY(capacity);
+    if (capacity != self->capacity) {
+        self->capacity = capacity;
+        self->data = ARRAY_GROW(char, self->data, self->capacity);
+    }
+}
+
+void writer_write(self_t, const char *data, size_t len) {
+    writer_reserve(self, len);
+    memcpy(self->data + self->size, data, len);
+    self->size += len;
+    self->data[self->size] = '\0';
+}
+
+void writer_puts(self_t, const char *string) {
+    writer_write(self, string, strlen(string));
+}
+
+void writer_vprintf(self_t, const char *format, va_list args) {
+    va_list retry;
+    va_copy(retry, args);
+
+    size_t available = self->capacity - self->size;
+    int len = vsnprintf(self->data + self->size, available, format, args);
+    assert(len >= 0);
+
+    // Did not fit, make room and format again
+    if ((size_t) len >= available) {
+        if (available != 0) self->data[self->size] = '\0';
+        writer_reserve(self, len);
+        vsnprintf(self->data + self->size, self->capacity - self->size, format, retry);
+    }
+    va_end(retry);
+
+    self->size += len;
+}
+
+void writer_printf(self_t, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    writer_vprintf(self, format, args);
+    va_end(args);
+}
+
+char *writer_take_buffer(self_t) {
+    assert(self->sink == WRITER_SINK_BUFFER);
+
+    // Writes after this start a new buffer
+    char *result = self->data;
+#ifdef ACORN_ALLOC_TRACKING
+    // Tracked allocations carry a header, the caller gets an untracked copy of the same capacity it can pass to `free`
+    if (result != NULL) {
+        result = malloc(self->capacity);
+        memcpy(result, self->data, self->size + 1);
+        ARRAY_FREE(char, self->data);
+    }
+#endif
+    self->data = NULL;
+    self->size = 0;
+    self->capacity = 0;
+    return result;
+}
+
+#undef self_t
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <string>
+#include <thread>
+
+#include "../temp_dir_test.h"
+
+extern "C" {
+#include "driver.h"
+#include "watch.h"
+}
+
+class WatchTest : public TempDirTest {
+protected:
+    std::string path;
+
+    void SetUp() override {
+        TempDirTest::SetUp();
+        path = dir + "/w.acorn";
+    }
+
+    // Replaces the file the way an editor does, by renaming a complete copy over it.
+    void save(const char *source) {
+        std::string temp_path = dir + "/.w.acorn.tmp";
+        write_file(temp_path, source);
+        ASSERT_EQ(rename(temp_path.c_str(), path.c_str()), 0);
+    }
+
+    // Waits for the executable to exit with `expected`, which it does once the watcher rebuilt it.
+    bool wait_for_exit_code(int expected) {
+        std::string command = dir + "/w > /dev/null 2>&1";
+        for (int attempt = 0; attempt < 300; attempt++) {
+            int status = system(command.c_str());
+            if (WIFEXITED(status) && WEXITSTATUS(status) == expected)
+                return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return false;
+    }
+};
+
+TEST_F(WatchTest, RebuildsOnSaveAndSurvivesCrashingCompiles) {
+    save("fn main() i32 { return 3; }\n");
+
+    // The path has a directory, whose events name only the file
+    Invocation invocation;
+    char *argv[] = {(char *) "--watch", (char *) path.c_str()};
+    ASSERT_TRUE(invocation_parse(&invocation, "acorn", 2, argv));
+
+    std::packaged_task<int32_t()> task([&invocation] { return watch_run(&invocation); });
+    std::future<int32_t> exit_code = task.get_future();
+    std::thread watcher(std::move(task));
+
+    EXPECT_TRUE(wait_for_exit_code(3));
+    save("fn main() i32 { return 4; }\n");
+    EXPECT_TRUE(wait_for_exit_code(4));
+
+    // An assert in the frontend only fails that build
+    save("fn main() i32 { let r = 5; return r; }\n");
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    save("fn two() i32 { return 2; }\nfn main() i32 { return two() + 3; }\n");
+    EXPECT_TRUE(wait_for_exit_code(5));
+
+    // The signal may arrive before the watcher blocks, so it is sent until the watcher stops
+    while (exit_code.wait_for(std::chrono::milliseconds(100)) != std::future_status::ready)
+        pthread_kill(watcher.native_handle(), SIGTERM);
+    watcher.join();
+    EXPECT_EQ(exit_code.get(), 0);
+    invocation_free(&invocation);
+}
@@ -27,6 +27,7 @@ testing::AssertionResult lower_check_generic(LowerFn lower, ParseFn parse, const
         .instructions = lowering.instructions,
         .extra = lowering.extra,
         .strings = lowering.strings,
+        .string_literals = lowering.string_literals,
     };
 
     ast_lowering_free(&lowering);
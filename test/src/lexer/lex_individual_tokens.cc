@@ -75,6 +75,7 @@ TEST(Lexer, SingleTokensLiteralString) {
     EXPECT_PRED2(check, "\"\"", TOK_STRING);
     EXPECT_PRED2(check, "\"123\"", TOK_STRING);
     EXPECT_PRED2(check, "\"Hello, World\"", TOK_STRING);
+    EXPECT_PRED2(check, "\"Hello, \\\"World\\\"\\n\"", TOK_STRING);
 }
 
 TEST(Lexer, SingleTokensLiteralIdent) {
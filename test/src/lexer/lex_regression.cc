@@ -42,9 +42,8 @@ TEST(Lexer, LexTwoDifferentWords) {
 }
 
 TEST(Lexer, StringLiteralAcrossNewline) {
-    EXPECT_DEATH({
-        CHECK("\"Hello, \nWorld\"", "STRING~Hello, World");
-    }, "Assertion failed: \\(false\\), function lex_string, file lexer_internal\\.c");
+    // A string ends at the newline as an error, the closing quote starts another one
+    CHECK("\"Hello, \nWorld\"", "<err>~\"Hello,  IDENT~World <err>~\"");
 }
 
 
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "lexer.h"
+#include "parser.h"
+}
+
+static LineIndex lex_lines(const char *input) {
+    Parser parser;
+    parser_init(&parser, (uint8_t *) input);
+    token_list_free(&parser.tokens);
+    return parser.lines;
+}
+
+TEST(LineIndex, RecordsLineStarts) {
+    LineIndex lines = lex_lines("let a\n  // comment\n\nb");
+    ASSERT_EQ(lines.size, 4);
+    EXPECT_EQ(lines.data[0], 0);
+    EXPECT_EQ(lines.data[1], 6);
+    EXPECT_EQ(lines.data[2], 19);
+    EXPECT_EQ(lines.data[3], 20);
+    line_index_free(&lines);
+}
+
+TEST(LineIndex, LookupLineAndColumn) {
+    LineIndex lines = lex_lines("ab\ncd\n\nef");
+
+    SourceLoc first = line_index_lookup(&lines, 0);
+    EXPECT_EQ(first.line, 1);
+    EXPECT_EQ(first.col, 0);
+
+    SourceLoc end_of_first = line_index_lookup(&lines, 2);
+    EXPECT_EQ(end_of_first.line, 1);
+    EXPECT_EQ(end_of_first.col, 2);
+
+    SourceLoc second = line_index_lookup(&lines, 4);
+    EXPECT_EQ(second.line, 2);
+    EXPECT_EQ(second.col, 1);
+
+    SourceLoc last = line_index_lookup(&lines, 8);
+    EXPECT_EQ(last.line, 4);
+    EXPECT_EQ(last.col, 1);
+
+    line_index_free(&lines);
+}
+
+TEST(LineIndex, LineRangeExcludesLineBreak) {
+    const char *input = "ab\r\ncd\nlast";
+    LineIndex lines = lex_lines(input);
+
+    TokenLoc first = line_index_line(&lines, (const uint8_t *) input, 1);
+    EXPECT_EQ(first.start, 0);
+    EXPECT_EQ(first.end, 2);
+
+    TokenLoc second = line_index_line(&lines, (const uint8_t *) input, 2);
+    EXPECT_EQ(second.start, 4);
+    EXPECT_EQ(second.end, 6);
+
+    TokenLoc last = line_index_line(&lines, (const uint8_t *) input, 3);
+    EXPECT_EQ(last.start, 7);
+    EXPECT_EQ(last.end, 11);
+
+    line_index_free(&lines);
+}
+
+TEST(LineIndex, NotRecordedWithoutIndex) {
+    Lexer lexer;
+    lexer_init(&lexer, (const uint8_t *) "a\nb");
+    EXPECT_EQ(lexer.lines, nullptr);
+    EXPECT_EQ(lexer_next(&lexer).type, TOK_IDENT);
+    EXPECT_EQ(lexer_next(&lexer).type, TOK_IDENT);
+}
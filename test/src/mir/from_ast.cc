@@ -63,10 +63,30 @@ fn foo() i32 {
 }
 )#";
     auto expected = R"#(
-%1 = constant(i32, 2)
-%2 = constant(i32, 3)
-%3 = add(%1, %2)
-%4 = ret(%3)
+%1 = add(@ref.i32_2, @ref.i32_3)
+%2 = ret(%1)
+)#";
+    EXPECT_MIR(input, expected);
+}
+
+TEST(AstToMir, KnownConstants) {
+    auto input = R"#(
+fn foo() {
+    let a: bool = true;
+    let b: i8 = 15;
+    let c: i8 = 16;
+    return;
+}
+)#";
+    auto expected = R"#(
+%1 = alloc(bool)
+%2 = store(%1, @ref.bool_true)
+%3 = alloc(i8)
+%4 = store(%3, @ref.i8_15)
+%5 = alloc(i8)
+%6 = constant(i8, 16)
+%7 = store(%5, %6)
+%8 = ret(@ref.void_value)
 )#";
     EXPECT_MIR(input, expected);
 }
@@ -78,10 +98,8 @@ fn foo() bool {
 }
 )#";
     auto expected = R"#(
-%1 = constant(i64, 2)
-%2 = constant(i64, 3)
-%3 = lt(%1, %2)
-%4 = ret(%3)
+%1 = lt(@ref.i64_2, @ref.i64_3)
+%2 = ret(%1)
 )#";
     EXPECT_MIR(input, expected);
 }
@@ -127,10 +145,8 @@ fn foo() {
 )#";
     auto expected = R"#(
 %1 = alloc(bool)
-%2 = constant(i64, 1)
-%3 = constant(i64, 2)
-%4 = lt(%2, %3)
-%5 = store(%1, %4)
+%2 = lt(@ref.i64_1, @ref.i64_2)
+%3 = store(%1, %2)
 )#";
     EXPECT_MIR(input, expected);
 }
@@ -143,8 +159,7 @@ fn foo() {
 )#";
     auto expected = R"#(
 %1 = alloc(*i32)
-%2 = constant(i64, 1)
-%3 = store(%1, %2)
+%2 = store(%1, @ref.i64_1)
 )#";
     EXPECT_MIR(input, expected);
 }
@@ -157,8 +172,7 @@ fn foo() {
 )#";
     auto expected = R"#(
 %1 = alloc(**i32)
-%2 = constant(i64, 1)
-%3 = store(%1, %2)
+%2 = store(%1, @ref.i64_1)
 )#";
     EXPECT_MIR(input, expected);
 }
@@ -170,10 +184,8 @@ fn foo() i32 {
 }
 )#";
     auto expected = R"#(
-%1 = constant(i64, 2)
-%2 = constant(i64, 3)
-%3 = lt(%1, %2)
-%4 = ret(%3)
+%1 = lt(@ref.i64_2, @ref.i64_3)
+%2 = ret(%1)
 )#";
     ASSERT_DEATH({
         EXPECT_MIR(input, expected);
@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <cstring>
+
+extern "C" {
+#include "parser.h"
+#include "ast_to_mir.h"
+#include "mir_parser.h"
+#include "module.h"
+#include "debug/mir_debug.h"
+}
+
+static bool parse_fn(const char *input, Mir *mir, StringSet *strings = nullptr) {
+    MirParser parser;
+    mir_parser_init(&parser, nullptr, input, strings);
+    bool result = mir_parse_fn(&parser, UINT32_MAX, mir);
+    mir_parser_free(&parser);
+    return result;
+}
+
+static std::string print(Mir *mir, StringSet *strings = nullptr, StringSet *decl_names = nullptr) {
+    MirDebugNames names = {
+        .strings = strings,
+        .decl_names = decl_names != nullptr ? decl_names->data : nullptr,
+        .decl_count = decl_names != nullptr ? decl_names->size : 0,
+    };
+
+    Writer out;
+    writer_init_buffer(&out);
+    mir_debug_write_named(mir, &names, &out);
+    std::string result = out.data;
+    writer_free(&out);
+    return result;
+}
+
+// Lowers every function in `source` and checks that its printed MIR parses back to the same text.
+static void expect_round_trip(const char *source) {
+    Parser parser;
+    parser_init(&parser, (uint8_t *) source);
+    Ast ast = parser_parse(&parser);
+    AstNode *module = ast_get_node_tagged(&ast, ast_index_root, AST_MODULE);
+
+    StringSet strings;
+    string_set_init(&strings);
+    // Decl names in module order, so the keys are decl indices
+    StringSet decl_names;
+    string_set_init(&decl_names);
+    for (AstIndex i = module->data.lhs; i <= module->data.rhs; i++) {
+        AstNode *fn_node = ast_get_node(&ast, ast.extra_data.data[i]);
+        char *name = ast_get_token_content(&ast, fn_node->main_token + 1);
+        string_set_add(&decl_names, name);
+        free(name);
+    }
+
+    for (AstIndex i = module->data.lhs; i <= module->data.rhs; i++) {
+        AstToMir lowering;
+        ast_to_mir_init(&lowering, &ast, &strings);
+        Mir lowered = lower_ast_fn(&lowering, ast.extra_data.data[i]);
+        std::string expected = print(&lowered, &strings, &decl_names);
+
+        MirParser parser;
+        mir_parser_init(&parser, nullptr, expected.c_str(), &strings);
+        Mir parsed;
+        ASSERT_TRUE(mir_parse_fn(&parser, UINT32_MAX, &parsed)) << expected;
+        EXPECT_EQ(print(&parsed, &strings, &parser.fn_names), expected);
+        EXPECT_EQ(parsed.instructions.size, lowered.instructions.size);
+
+        mir_parser_free(&parser);
+        mir_free(&parsed);
+        mir_free(&lowered);
+        ast_to_mir_free(&lowering);
+    }
+    string_set_free(&decl_names);
+    string_set_free(&strings);
+}
+
+TEST(MirParser, RoundTripArithmetic) {
+    expect_round_trip(R"#(
+fn foo(a: i32, b: i32) i32 {
+    let c: i32 = a * b + 3;
+    let d: i32 = c - a / 2;
+    return d;
+}
+)#");
+}
+
+TEST(MirParser, RoundTripCalls) {
+    expect_round_trip(R"#(
+fn add(a: i32, b: i32) i32 {
+    return a + b;
+}
+fn main() i32 {
+    let s: *i8 = "quoted \"text\"\n";
+    let a: i32 = 1;
+    let b: i32 = add(a, a);
+    return b;
+}
+)#");
+}
+
+TEST(MirParser, BlockHoldsUnusedInstructions) {
+    Mir mir;
+    ASSERT_TRUE(parse_fn(R"#(
+// Comments and blank lines are ignored
+
+%1 = alloc(i32)
+%2 = constant(i32, -7)
+%3 = store(%1, %2)
+%4 = load(%1)
+%5 = ret(%4)
+)#", &mir));
+
+    MirInst block = mir_inst_list_get(&mir.instructions, 0);
+    ASSERT_EQ(block.tag, MirBlock);
+    uint32_t data_index = block.data.ty_pl.payload;
+    ASSERT_EQ(mir.extra.data[data_index], 2);
+    EXPECT_EQ(mir.extra.data[data_index + 1], 3);
+    EXPECT_EQ(mir.extra.data[data_index + 2], 5);
+    EXPECT_EQ((int32_t) mir.instructions.data[2].ty_pl.payload, -7);
+
+    mir_free(&mir);
+}
+
+TEST(MirParser, KnownRefs) {
+    Mir mir;
+    ASSERT_TRUE(parse_fn("%1 = add(@ref.zero, @ref.one)\n%2 = ret(%1)\n", &mir));
+    EXPECT_EQ(mir.instructions.data[1].bin_op.lhs, RefZero);
+    EXPECT_EQ(mir.instructions.data[1].bin_op.rhs, RefOne);
+    EXPECT_EQ(print(&mir), "%1 = add(@ref.zero, @ref.one)\n%2 = ret(%1)\n\n");
+    mir_free(&mir);
+}
+
+TEST(MirParser, AllKnownRefs) {
+    for (Ref ref = RefNone; ref < __REF_LAST; ref = (Ref) (ref + 1)) {
+        const char *name = ref_to_string(ref);
+        EXPECT_EQ(ref_from_string(name, strlen(name)), ref) << name;
+    }
+
+    EXPECT_EQ(ref_from_int((Type) {.tag = TypeI32}, 7), ref_from_string("i32_7", 5));
+    EXPECT_EQ(ref_value_type(ref_from_int((Type) {.tag = TypeI64}, 15)), TypeI64);
+    EXPECT_EQ(ref_int_value(ref_from_int((Type) {.tag = TypeI8}, 15)), 15);
+    EXPECT_EQ(ref_from_int((Type) {.tag = TypeI32}, REF_SMALL_INT_COUNT), __REF_LAST);
+    EXPECT_EQ(ref_from_int((Type) {.tag = TypeBool}, 1), RefBoolTrue);
+    EXPECT_EQ(ref_to_type(ref_from_type((Type) {.tag = TypeF64})).tag, TypeF64);
+}
+
+TEST(MirParser, RejectsInvalidInput) {
+    const char *inputs[] = {
+        "%1 = ret(%2)\n",                       // Use before definition
+        "%1 = constant(i32, 1)\n%1 = ret(%1)\n", // Defined twice
+        "%0 = constant(i32, 1)\n",             // Root block
+        "%1 = frobnicate(i32)\n",              // Unknown tag
+        "%1 = constant(u7, 1)\n",              // Unknown type
+        "%1 = add(@ref.two, @ref.one)\n",      // Unknown ref
+        "%1 = constant(i32, 1) trailing\n",
+        "%1 = constant(i32, \"not a pointer\")\n",
+    };
+
+    for (const char *input : inputs) {
+        Mir mir;
+        EXPECT_FALSE(parse_fn(input, &mir)) << input;
+    }
+}
+
+TEST(MirParser, ParsesModule) {
+    const char *input = R"#(
+foreign fn puts(*i8) i32
+
+fn two() i32 {
+%1 = constant(i32, 2)
+%2 = ret(%1)
+}
+
+fn main() i32 {
+%1 = fn_ptr(two)
+%2 = call(%1, args=_)
+%3 = ret(%2)
+}
+)#";
+
+    Module module;
+    module_init(&module, (char *) "./test.mir");
+    MirParser parser;
+    mir_parser_init(&parser, module.path, input, nullptr);
+    ASSERT_TRUE(mir_parse_module(&parser, &module));
+    mir_parser_free(&parser);
+
+    ASSERT_EQ(module.decls.size, 3);
+    Decl *puts = module_find_decl(&module, (char *) "puts");
+    ASSERT_NE(puts, nullptr);
+    EXPECT_EQ(puts->state, DeclStateGenerated);
+    EXPECT_EQ(puts->mir, nullptr);
+    EXPECT_EQ(puts->data.fn_data->param_count, 1);
+
+    Decl *main = module_find_decl(&module, (char *) "main");
+    ASSERT_NE(main, nullptr);
+    ASSERT_NE(main->mir, nullptr);
+    EXPECT_EQ(mir_inst_list_tag(&main->mir->instructions, 2), MirCall);
+    EXPECT_EQ(main->mir->instructions.data[1].fn_decl, 1);
+
+    Writer out;
+    writer_init_buffer(&out);
+    module_write_mir(&module, &out);
+    EXPECT_STREQ(out.data, "foreign fn puts(*i8) i32\n\n"
+                           "fn two() i32 {\n%1 = constant(i32, 2)\n%2 = ret(%1)\n\n}\n\n"
+                           "fn main() i32 {\n%1 = fn_ptr(two)\n%2 = call(%1, args=_)\n%3 = ret(%2)\n\n}\n\n");
+    writer_free(&out);
+    module_free(&module);
+}
+
+TEST(MirParser, RejectsUndefinedFunction) {
+    Module module;
+    module_init(&module, (char *) "./test.mir");
+    MirParser parser;
+    mir_parser_init(&parser, module.path, "fn main() {\n%1 = fn_ptr(missing)\n}\n", nullptr);
+    EXPECT_FALSE(mir_parse_module(&parser, &module));
+    mir_parser_free(&parser);
+    module_free(&module);
+}
+
+TEST(MirParser, CompactInstructions) {
+    EXPECT_EQ(sizeof(MirInstData), 8);
+
+    Mir mir;
+    ASSERT_TRUE(parse_fn("%1 = alloc(*i8)\n%2 = alloc(*i8)\n%3 = alloc(**i8)\n%4 = alloc(i32)\n", &mir));
+    // Equal extended types share a pool entry, simple types are not pooled
+    EXPECT_EQ(mir.instructions.data[1].ty, mir.instructions.data[2].ty);
+    EXPECT_NE(mir.instructions.data[1].ty, mir.instructions.data[3].ty);
+    EXPECT_EQ(mir.instructions.data[4].ty, (MirTypeIndex) TypeI32);
+    EXPECT_EQ(mir.types.size, 2);
+    mir_free(&mir);
+}
@@ -1,11 +1,22 @@
 #include "parse_test_check.h"
 
+#include <vector>
+
 extern "C" {
 #include "parser.h"
 #include "ast_to_mir.h"
 #include "debug/mir_debug.h"
 }
 
+static char *print_mir(Mir *mir, MirDebugNames *names) {
+    Writer out;
+    writer_init_buffer(&out);
+    mir_debug_write_named(mir, names, &out);
+    char *result = writer_take_buffer(&out);
+    writer_free(&out);
+    return result;
+}
+
 testing::AssertionResult parse_check_mir(bool extended, const char *expr, const char *expected) {
     Parser parser;
     parser_init(&parser, (uint8_t *) expr);
@@ -17,6 +28,21 @@ testing::AssertionResult parse_check_mir(bool extended, const char *expr, const
     assert(ast_module->data.lhs != ast_index_empty); // Ensure there is at least one function
 
 
+    StringSet strings;
+    string_set_init(&strings);
+
+    // Function refs are decl indices, which are the positions of the functions in the module
+    std::vector<char *> decl_names;
+    for (AstIndex index = ast_module->data.lhs; index <= ast_module->data.rhs; index++) {
+        AstNode *fn_node = ast_get_node(&ast, ast.extra_data.data[index]);
+        decl_names.push_back(ast_get_token_content(&ast, fn_node->main_token + 1));
+    }
+    MirDebugNames names = {
+        .strings = nullptr,
+        .decl_names = decl_names.data(),
+        .decl_count = (uint32_t) decl_names.size(),
+    };
+
     char *actual = static_cast<char *>(malloc(1024 * 16));
     memset(actual, 0, 1024 * 16);
 
@@ -24,10 +50,10 @@ testing::AssertionResult parse_check_mir(bool extended, const char *expr, const
         AstIndex idx = ast.extra_data.data[ast_module->data.lhs];
 
         AstToMir lower;
-        ast_to_mir_init(&lower, &ast);
+        ast_to_mir_init(&lower, &ast, &strings);
         Mir mir = lower_ast_fn(&lower, idx);
 
-        char *mir_str = mir_debug_print(&mir);
+        char *mir_str = print_mir(&mir, &names);
         sprintf(actual + strlen(actual), "%s", mir_str);
         free(mir_str);
     } else {
@@ -40,10 +66,10 @@ testing::AssertionResult parse_check_mir(bool extended, const char *expr, const
             sprintf(actual + strlen(actual), "// begin fn %s\n", str);
 
             AstToMir lower;
-            ast_to_mir_init(&lower, &ast);
+            ast_to_mir_init(&lower, &ast, &strings);
             Mir mir = lower_ast_fn(&lower, idx);
 
-            char *mir_str = mir_debug_print(&mir);
+            char *mir_str = print_mir(&mir, &names);
             sprintf(actual + strlen(actual), "%s", mir_str);
             free(mir_str);
 
@@ -60,6 +86,10 @@ testing::AssertionResult parse_check_mir(bool extended, const char *expr, const
         actual_len -= 1;
     }
 
+    string_set_free(&strings);
+    for (char *name : decl_names)
+        free(name);
+
     bool result = actual_len == strlen(expected) && strcmp(actual, expected) == 0;
     if (!result) {
         printf("Expected:\n%s\n", expected);
@@ -0,0 +1,88 @@
+#include <string>
+#include <sys/stat.h>
+
+#include "../temp_dir_test.h"
+
+extern "C" {
+#include "artifact_cache.h"
+#include "cache_util.h"
+}
+
+class ArtifactCacheTest : public TempDirTest {
+protected:
+    void write(const std::string &path, const std::string &content) {
+        ASSERT_TRUE(cache_write_file(path.c_str(), content.data(), content.size()));
+    }
+
+    std::string read(const std::string &path) {
+        size_t len;
+        char *data = cache_read_file(path.c_str(), &len);
+        if (data == nullptr)
+            return "<missing>";
+        std::string result(data, len);
+        free(data);
+        return result;
+    }
+
+    // Pretends to compile `source`, storing an executable named `main` next to it.
+    void compile(ArtifactCache *cache, const std::string &source, const char *flags, const std::string &exe) {
+        std::string source_path = dir + "/main.acorn";
+        std::string exe_path = dir + "/main";
+        write(source_path, source);
+        ASSERT_TRUE(artifact_cache_begin(cache, source_path.c_str(), flags));
+        if (artifact_cache_restore(cache))
+            return;
+
+        write(exe_path, exe);
+        chmod(exe_path.c_str(), 0755);
+        char *paths[] = {(char *) exe_path.c_str()};
+        artifact_cache_store(cache, paths, 1);
+    }
+};
+
+TEST_F(ArtifactCacheTest, RestoresOutputsOfSameInputs) {
+    ArtifactCache cache;
+    ASSERT_TRUE(artifact_cache_init(&cache, (dir + "/cache").c_str(), 1 << 20));
+    compile(&cache, "fn main() i32 { return 1; }", "-O0", "first");
+    EXPECT_EQ(cache.misses, 1);
+
+    remove((dir + "/main").c_str());
+    compile(&cache, "fn main() i32 { return 1; }", "-O0", "unused");
+    EXPECT_EQ(cache.hits, 1);
+    EXPECT_EQ(read(dir + "/main"), "first");
+    struct stat exe;
+    ASSERT_EQ(stat((dir + "/main").c_str(), &exe), 0);
+    EXPECT_EQ(exe.st_mode & 0777, 0755);
+
+    // Changing the source or flags misses
+    compile(&cache, "fn main() i32 { return 2; }", "-O0", "second");
+    compile(&cache, "fn main() i32 { return 1; }", "-O2", "third");
+    EXPECT_EQ(cache.hits, 1);
+    EXPECT_EQ(cache.misses, 3);
+    artifact_cache_free(&cache);
+}
+
+TEST_F(ArtifactCacheTest, EvictsLeastRecentlyUsed) {
+    // Room for two entries of one output each
+    std::string output(4000, 'x');
+    size_t manifest_size = 300;
+    ArtifactCache cache;
+    ASSERT_TRUE(artifact_cache_init(&cache, (dir + "/cache").c_str(), 2 * (output.size() + manifest_size)));
+
+    compile(&cache, "a", "", output);
+    compile(&cache, "b", "", output);
+    // Using `a` again makes `b` the oldest entry
+    struct timespec pause = {0, 10 * 1000 * 1000};
+    nanosleep(&pause, nullptr);
+    compile(&cache, "a", "", output);
+    EXPECT_EQ(cache.hits, 1);
+    nanosleep(&pause, nullptr);
+    compile(&cache, "c", "", output);
+    EXPECT_EQ(cache.evicted, 1);
+
+    compile(&cache, "a", "", output);
+    EXPECT_EQ(cache.hits, 2);
+    compile(&cache, "b", "", output);
+    EXPECT_EQ(cache.hits, 2);
+    artifact_cache_free(&cache);
+}
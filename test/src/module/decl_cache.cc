@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../temp_dir_test.h"
+
+extern "C" {
+#include "cache_util.h"
+#include "module.h"
+}
+
+class DeclCacheTest : public TempDirTest {
+protected:
+    // Parses `source` into `module` with the cache enabled. The path must outlive the module.
+    void open_module(Module *module, std::string &path, const char *source) {
+        path = dir + "/main.acorn";
+        write_file(path, source);
+
+        module_init(module, (char *) path.c_str());
+        ASSERT_TRUE(module_parse(module));
+        ASSERT_TRUE(module_lower_ast(module));
+        ASSERT_TRUE(module_enable_decl_cache(module, (dir + "/cache").c_str()));
+    }
+};
+
+static const char *source = R"#(
+fn add(a: i32, b: i32) i32 {
+    return a + b;
+}
+
+fn main() i32 {
+    let s: *i8 = "text";
+    let a: i32 = 40;
+    return add(a, a);
+}
+)#";
+
+TEST_F(DeclCacheTest, ReusesUnchangedDecls) {
+    std::string path;
+    Module first;
+    open_module(&first, path, source);
+    for (DeclIndex i = 0; i < first.decls.size; i++) {
+        EXPECT_FALSE(decl_cache_load_mir(first.decl_cache, &first, &first.decls.data[i]));
+        decl_get_mir_in_module(&first.decls.data[i], &first);
+    }
+    std::string expected = write_mir(&first);
+    module_free(&first);
+
+    Module second;
+    open_module(&second, path, source);
+    for (DeclIndex i = 0; i < second.decls.size; i++) {
+        EXPECT_TRUE(decl_cache_load_mir(second.decl_cache, &second, &second.decls.data[i]));
+    }
+    EXPECT_EQ(write_mir(&second), expected);
+    module_free(&second);
+}
+
+TEST_F(DeclCacheTest, InvalidatesChangedDecls) {
+    std::string path;
+    Module first;
+    open_module(&first, path, source);
+    decl_get_mir_in_module(module_find_decl(&first, (char *) "main"), &first);
+    decl_get_mir_in_module(module_find_decl(&first, (char *) "add"), &first);
+    module_free(&first);
+
+    // A new body only invalidates the decl itself
+    std::string changed_body = source;
+    changed_body.replace(changed_body.find("a + b"), 5, "b + a");
+    Module second;
+    open_module(&second, path, changed_body.c_str());
+    EXPECT_FALSE(decl_cache_load_mir(second.decl_cache, &second, module_find_decl(&second, (char *) "add")));
+    EXPECT_TRUE(decl_cache_load_mir(second.decl_cache, &second, module_find_decl(&second, (char *) "main")));
+    module_free(&second);
+
+    // A new signature also invalidates every caller
+    std::string changed_signature = source;
+    changed_signature.replace(changed_signature.find(") i32 {"), 7, ") i64 {");
+    Module third;
+    open_module(&third, path, changed_signature.c_str());
+    EXPECT_FALSE(decl_cache_load_mir(third.decl_cache, &third, module_find_decl(&third, (char *) "main")));
+    module_free(&third);
+}
+
+TEST_F(DeclCacheTest, ConcurrentWritesOfOneEntryStayWhole) {
+    // Files built at once may store the same decl, each thread writes a different (large) version of the entry
+    std::string path = dir + "/entry";
+    std::vector<std::string> versions;
+    for (char fill = 'a'; fill < 'i'; fill++)
+        versions.push_back(std::string(1 << 20, fill));
+
+    std::vector<std::thread> writers;
+    for (const std::string &version : versions) {
+        writers.emplace_back([&path, &version] {
+            for (int i = 0; i < 8; i++)
+                EXPECT_TRUE(cache_write_file(path.c_str(), version.data(), version.size()));
+        });
+    }
+    for (std::thread &writer : writers)
+        writer.join();
+
+    size_t len;
+    char *data = cache_read_file(path.c_str(), &len);
+    ASSERT_NE(data, nullptr);
+    std::string written(data, len);
+    free(data);
+    EXPECT_NE(std::find(versions.begin(), versions.end(), written), versions.end());
+}
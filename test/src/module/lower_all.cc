@@ -0,0 +1,57 @@
+#include <string>
+
+#include "../temp_dir_test.h"
+
+extern "C" {
+#include "module.h"
+}
+
+class LowerAllTest : public TempDirTest {
+protected:
+    std::string path;
+
+    void SetUp() override {
+        TempDirTest::SetUp();
+        path = dir + "/lib.acorn";
+    }
+
+    void open_module(Module *module, const char *source) {
+        write_file(path, source);
+        module_init(module, (char *) path.c_str());
+        ASSERT_TRUE(module_parse(module));
+        ASSERT_TRUE(module_lower_ast(module));
+    }
+};
+
+static const char *library = R"#(
+foreign fn puts(str: *i8) i32;
+
+fn add(a: i32, b: i32) i32 {
+    return a + b;
+}
+
+fn unused(a: i32) i32 {
+    return a;
+}
+)#";
+
+TEST_F(LowerAllTest, LowersEveryDeclWithoutMain) {
+    Module module;
+    open_module(&module, library);
+    ASSERT_TRUE(module_lower_all(&module));
+
+    uint32_t lowered = 0;
+    for (uint32_t i = 0; i < module.unit_count; i++)
+        lowered += module.units[i].decls.size;
+    EXPECT_EQ(lowered, 2);
+    EXPECT_EQ(module_find_decl(&module, "add")->state, DeclStateGenerated);
+    EXPECT_EQ(module_find_decl(&module, "unused")->state, DeclStateGenerated);
+    module_free(&module);
+}
+
+TEST_F(LowerAllTest, MainRequiresMain) {
+    Module module;
+    open_module(&module, library);
+    EXPECT_FALSE(module_lower_main(&module));
+    module_free(&module);
+}
@@ -0,0 +1,119 @@
+#include <string>
+
+#include "../temp_dir_test.h"
+
+extern "C" {
+#include "module.h"
+}
+
+class ModuleReloadTest : public TempDirTest {
+protected:
+    std::string path;
+
+    void SetUp() override {
+        TempDirTest::SetUp();
+        path = dir + "/main.acorn";
+    }
+
+    void write_source(const char *source) {
+        write_file(path, source);
+    }
+
+    std::string compile(const char *source) {
+        write_source(source);
+        Module module;
+        module_init(&module, (char *) path.c_str());
+        EXPECT_TRUE(module_parse(&module));
+        EXPECT_TRUE(module_lower_ast(&module));
+        std::string result = write_mir(&module);
+        module_free(&module);
+        return result;
+    }
+};
+
+static const char *before = R"#(
+fn add(a: i32, b: i32) i32 {
+    return a + b;
+}
+
+fn twice(a: i32) i32 {
+    return add(a, a);
+}
+
+fn main() i32 {
+    let s: *i8 = "text";
+    let a: i32 = 20;
+    return add(a, twice(a));
+}
+)#";
+
+// A new decl moves every other one, adding a string moves the existing ones, and `twice` changes.
+static const char *after = R"#(
+fn first() *i8 {
+    let s: *i8 = "other";
+    return s;
+}
+
+fn add(a: i32, b: i32) i32 {
+    return a + b;
+}
+
+fn twice(a: i32) i32 {
+    let b: i32 = add(a, a);
+    return add(b, a);
+}
+
+fn main() i32 {
+    let s: *i8 = "text";
+    let a: i32 = 20;
+    return add(a, twice(a));
+}
+)#";
+
+TEST_F(ModuleReloadTest, ReusesMirOfUnchangedDecls) {
+    std::string expected = compile(after);
+
+    write_source(before);
+    Module module;
+    module_init(&module, (char *) path.c_str());
+    ASSERT_TRUE(module_parse(&module));
+    ASSERT_TRUE(module_lower_ast(&module));
+    write_mir(&module);
+
+    write_source(after);
+    ModuleReload reload;
+    ASSERT_TRUE(module_reload(&module, &reload));
+    EXPECT_TRUE(reload.changed);
+    EXPECT_EQ(reload.decl_count, 4);
+    EXPECT_EQ(reload.reused, 2);
+    EXPECT_NE(module_find_decl(&module, "add")->mir, nullptr);
+    EXPECT_NE(module_find_decl(&module, "main")->mir, nullptr);
+    EXPECT_EQ(module_find_decl(&module, "twice")->mir, nullptr);
+    EXPECT_EQ(write_mir(&module), expected);
+
+    ASSERT_TRUE(module_reload(&module, &reload));
+    EXPECT_FALSE(reload.changed);
+    module_free(&module);
+}
+
+TEST_F(ModuleReloadTest, RecoversFromSyntaxErrors) {
+    std::string expected = compile(before);
+
+    write_source(before);
+    Module module;
+    module_init(&module, (char *) path.c_str());
+    ASSERT_TRUE(module_parse(&module));
+    ASSERT_TRUE(module_lower_ast(&module));
+
+    write_source("fn main() i32 {\n    retur 1;\n}\n");
+    ModuleReload reload;
+    ASSERT_TRUE(module_reload(&module, &reload));
+    EXPECT_GT(module.ast->errors.size, 0);
+    EXPECT_EQ(module.decls.size, 0);
+
+    write_source(before);
+    ASSERT_TRUE(module_reload(&module, &reload));
+    EXPECT_EQ(reload.decl_count, 3);
+    EXPECT_EQ(write_mir(&module), expected);
+    module_free(&module);
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include "acorn_session.h"
+}
+
+static const char *library = R"#(
+fn add(a: i32, b: i32) i32 {
+    return a + b;
+}
+
+fn twice(a: i32) i32 {
+    let r: i32 = add(a, a);
+    return r;
+}
+)#";
+
+static bool contains(const AcornResult &result, const char *text) {
+    std::string object(result.object, result.object_size);
+    return object.find(text) != std::string::npos;
+}
+
+TEST(Session, CompilesSourcesIntoObjects) {
+    AcornSessionOptions options = ACORN_SESSION_OPTIONS_DEFAULT;
+    AcornSession *session = acorn_session_create(&options);
+    ASSERT_NE(session, nullptr);
+
+    AcornResult result;
+    ASSERT_TRUE(acorn_session_compile(session, "library.acorn", library, strlen(library), &result));
+    EXPECT_EQ(result.diagnostic_count, 0);
+    ASSERT_GT(result.object_size, 4);
+    EXPECT_EQ(memcmp(result.object, "\x7f" "ELF", 4), 0);
+    // Every function is exported, without a `main`
+    EXPECT_TRUE(contains(result, "add"));
+    EXPECT_TRUE(contains(result, "twice"));
+    acorn_result_free(&result);
+    acorn_session_destroy(session);
+}
+
+TEST(Session, ReportsSyntaxErrors) {
+    AcornSessionOptions options = ACORN_SESSION_OPTIONS_DEFAULT;
+    AcornSession *session = acorn_session_create(&options);
+    ASSERT_NE(session, nullptr);
+
+    // Not terminated after the given length
+    const char *source = "fn main() i32 {\n    retur 1;\n}\nxyz";
+    AcornResult result;
+    EXPECT_FALSE(acorn_session_compile(session, "broken.acorn", source, strlen(source) - 3, &result));
+    EXPECT_EQ(result.object, nullptr);
+    ASSERT_EQ(result.diagnostic_count, 1);
+    EXPECT_EQ(result.diagnostics[0].kind, ACORN_DIAGNOSTIC_SYNTAX);
+    EXPECT_STREQ(result.diagnostics[0].message, "Missing semicolon");
+    EXPECT_EQ(result.diagnostics[0].line, 2);
+    EXPECT_EQ(result.diagnostics[0].column, 11);
+    EXPECT_EQ(result.diagnostics[0].offset, 26);
+    acorn_result_free(&result);
+    acorn_session_destroy(session);
+}
+
+TEST(Session, ReportsUnrecoverableSyntaxErrors) {
+    AcornSessionOptions options = ACORN_SESSION_OPTIONS_DEFAULT;
+    AcornSession *session = acorn_session_create(&options);
+    ASSERT_NE(session, nullptr);
+
+    // Each of these used to abort or never return
+    const char *sources[] = {"fn main() i32 {", "fn main() i32 { return (1; }", "fn main() i32 { return f(1,; }",
+                             "fn main() i32 { return \"abc; }", "let x = 1;"};
+    for (const char *source : sources) {
+        AcornResult result;
+        EXPECT_FALSE(acorn_session_compile(session, "broken.acorn", source, strlen(source), &result)) << source;
+        ASSERT_GE(result.diagnostic_count, 1) << source;
+        EXPECT_EQ(result.diagnostics[0].kind, ACORN_DIAGNOSTIC_SYNTAX) << source;
+        acorn_result_free(&result);
+    }
+    acorn_session_destroy(session);
+}
+
+TEST(Session, ReportsSemanticErrors) {
+    AcornSessionOptions options = ACORN_SESSION_OPTIONS_DEFAULT;
+    AcornSession *session = acorn_session_create(&options);
+    ASSERT_NE(session, nullptr);
+
+    const char *source = "fn f() i32 {\n    let x = 1;\n    return y;\n}\n\nfn g() i64 {\n    return f();\n}\n";
+    AcornResult result;
+    EXPECT_FALSE(acorn_session_compile(session, "broken.acorn", source, strlen(source), &result));
+    EXPECT_EQ(result.object, nullptr);
+    ASSERT_EQ(result.diagnostic_count, 3);
+    for (uint32_t i = 0; i < result.diagnostic_count; i++)
+        EXPECT_EQ(result.diagnostics[i].kind, ACORN_DIAGNOSTIC_SEMANTIC);
+    EXPECT_STREQ(result.diagnostics[0].message, "A `let` requires a type for now");
+    EXPECT_EQ(result.diagnostics[0].line, 2);
+    EXPECT_EQ(result.diagnostics[0].column, 9);
+    EXPECT_STREQ(result.diagnostics[1].message, "Undefined name");
+    EXPECT_EQ(result.diagnostics[1].line, 3);
+    EXPECT_EQ(result.diagnostics[1].column, 12);
+    EXPECT_STREQ(result.diagnostics[2].message, "Mismatched types");
+    EXPECT_EQ(result.diagnostics[2].line, 7);
+    acorn_result_free(&result);
+    acorn_session_destroy(session);
+}
+
+TEST(Session, ReportsWhatCannotBeGenerated) {
+    AcornSessionOptions options = ACORN_SESSION_OPTIONS_DEFAULT;
+    AcornSession *session = acorn_session_create(&options);
+    ASSERT_NE(session, nullptr);
+
+    const char *sources[] = {"fn f() bool { return 1 < 2; }", "fn f() i32 { if 1 { return 1; }; return 0; }",
+                             "fn f() i32 { let x: i32 = 1; }", "fn f() { return 1; }", "fn f() i32 { return g(); }",
+                             "fn f(a: i32) i32 { return f(); }", "const x = 1", "fn f() void {}",
+                             "fn f() i32 { return 1.5; }", "fn f() i64 { return 99999999999999999999999; }",
+                             "fn f() i8 { return 128; }", "fn f(a: i32, a: i32) i32 { return a; }"};
+    for (const char *source : sources) {
+        AcornResult result;
+        EXPECT_FALSE(acorn_session_compile(session, "broken.acorn", source, strlen(source), &result)) << source;
+        ASSERT_EQ(result.diagnostic_count, 1) << source;
+        EXPECT_EQ(result.diagnostics[0].kind, ACORN_DIAGNOSTIC_SEMANTIC) << source;
+        acorn_result_free(&result);
+    }
+    acorn_session_destroy(session);
+}
+
+TEST(Session, CompilesCallsAndArithmetic) {
+    AcornSessionOptions options = ACORN_SESSION_OPTIONS_DEFAULT;
+    AcornSession *session = acorn_session_create(&options);
+    ASSERT_NE(session, nullptr);
+
+    // The value of `puts` is unused, and `greet` has no `return`
+    const char *source = R"#(
+foreign fn puts(s: *i8) i32;
+
+fn greet() {
+    puts("hello");
+}
+
+fn widen(a: i64, b: i32) i64 {
+    let small: i8 = 127;
+    return a + 4294967295;
+}
+
+fn run(a: i32) i32 {
+    greet();
+    let b: i32 = a * 2;
+    let c: i64 = widen(5, b);
+    return b + 1;
+}
+)#";
+    AcornResult result;
+    ASSERT_TRUE(acorn_session_compile(session, "calls.acorn", source, strlen(source), &result));
+    EXPECT_EQ(result.diagnostic_count, 0);
+    EXPECT_TRUE(contains(result, "run"));
+    acorn_result_free(&result);
+    acorn_session_destroy(session);
+}
+
+TEST(Session, IsReusedAcrossCompiles) {
+    AcornSessionOptions options = ACORN_SESSION_OPTIONS_DEFAULT;
+    options.opt_level = ACORN_OPT_O2;
+    AcornSession *session = acorn_session_create(&options);
+    ASSERT_NE(session, nullptr);
+
+    AcornResult first;
+    ASSERT_TRUE(acorn_session_compile(session, "library.acorn", library, strlen(library), &first));
+    for (int i = 0; i < 20; i++) {
+        AcornResult again;
+        ASSERT_TRUE(acorn_session_compile(session, "library.acorn", library, strlen(library), &again));
+        ASSERT_EQ(again.object_size, first.object_size);
+        EXPECT_EQ(memcmp(again.object, first.object, first.object_size), 0);
+        acorn_result_free(&again);
+    }
+    acorn_result_free(&first);
+    acorn_session_destroy(session);
+}
+
+TEST(Session, RejectsUnknownTargets) {
+    AcornSessionOptions options = ACORN_SESSION_OPTIONS_DEFAULT;
+    options.target = "not-a-target";
+    EXPECT_EQ(acorn_session_create(&options), nullptr);
+}
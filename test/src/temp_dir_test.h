@@ -0,0 +1,58 @@
+#ifndef ACORNC_TEMP_DIR_TEST_H
+#define ACORNC_TEMP_DIR_TEST_H
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <ftw.h>
+#include <unistd.h>
+
+extern "C" {
+#include "module.h"
+}
+
+// A test which works in a fresh temporary directory, removed with everything in it afterwards.
+class TempDirTest : public testing::Test {
+protected:
+    std::string dir;
+
+    void SetUp() override {
+        char dir_template[] = "/tmp/acorn_test_XXXXXX";
+        ASSERT_NE(mkdtemp(dir_template), nullptr);
+        dir = dir_template;
+    }
+
+    void TearDown() override {
+        nftw(dir.c_str(), remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+
+    // Replaces the file at `path` with `content`.
+    static void write_file(const std::string &path, const char *content) {
+        FILE *file = fopen(path.c_str(), "w");
+        ASSERT_NE(file, nullptr);
+        fputs(content, file);
+        fclose(file);
+    }
+
+    // Prints every decl of the module as MIR, lowering the decls which have none yet.
+    static std::string write_mir(Module *module) {
+        Writer out;
+        writer_init_buffer(&out);
+        module_write_mir(module, &out);
+        std::string result = out.data;
+        writer_free(&out);
+        return result;
+    }
+
+private:
+    // Directories are visited after everything in them
+    static int remove_entry(const char *path, const struct stat *info, int type, struct FTW *ftw) {
+        (void) info;
+        (void) ftw;
+        return type == FTW_DP ? rmdir(path) : unlink(path);
+    }
+};
+
+#endif //ACORNC_TEMP_DIR_TEST_H
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+extern "C" {
+#include "writer.h"
+#include "array_util.h"
+#include "parser.h"
+#include "ast_to_mir.h"
+#include "debug/mir_debug.h"
+}
+
+static void append_to_string(void *context, const char *data, size_t len) {
+    static_cast<std::string *>(context)->append(data, len);
+}
+
+TEST(Writer, BufferGrows) {
+    Writer out;
+    writer_init_buffer(&out);
+
+    std::string expected;
+    for (int i = 0; i < 10000; i++) {
+        writer_printf(&out, "%d,", i);
+        expected += std::to_string(i) + ",";
+    }
+    writer_puts(&out, "end");
+    expected += "end";
+
+    char *actual = writer_take_buffer(&out);
+    EXPECT_STREQ(actual, expected.c_str());
+    free(actual);
+    writer_free(&out);
+}
+
+TEST(Writer, CallbackReceivesEverythingInOrder) {
+    std::string actual;
+    Writer out;
+    writer_init_callback(&out, append_to_string, &actual);
+
+    std::string expected;
+    std::string long_line(10000, 'x');
+    for (int i = 0; i < 100; i++) {
+        writer_printf(&out, "line %d %s\n", i, i % 10 == 0 ? long_line.c_str() : "");
+        expected += "line " + std::to_string(i) + " " + (i % 10 == 0 ? long_line : "") + "\n";
+    }
+
+    writer_free(&out);
+    EXPECT_EQ(actual, expected);
+}
+
+TEST(Writer, FileIsFlushed) {
+    FILE *file = tmpfile();
+    Writer out;
+    writer_init_file(&out, file);
+    for (int i = 0; i < 2000; i++) {
+        writer_printf(&out, "%04d\n", i);
+    }
+    writer_free(&out);
+
+    EXPECT_EQ(ftell(file), 2000 * 5);
+    fclose(file);
+}
+
+TEST(BitSet, SetAndGet) {
+    BitSet set;
+    bit_set_init(&set, 130);
+    EXPECT_FALSE(bit_set_get(&set, 0));
+    EXPECT_FALSE(bit_set_get(&set, 129));
+
+    bit_set_set(&set, 0);
+    bit_set_set(&set, 64);
+    bit_set_set(&set, 129);
+    EXPECT_TRUE(bit_set_get(&set, 0));
+    EXPECT_TRUE(bit_set_get(&set, 64));
+    EXPECT_TRUE(bit_set_get(&set, 129));
+    EXPECT_FALSE(bit_set_get(&set, 63));
+    EXPECT_FALSE(bit_set_get(&set, 65));
+    bit_set_free(&set);
+}
+
+// Larger than any fixed dump buffer, and quadratic with a linear visited scan
+TEST(Writer, DumpsLargeMir) {
+    std::string source = "fn main() i32 {\n";
+    for (int i = 0; i < 5000; i++) {
+        source += "    let a" + std::to_string(i) + ": i32 = 1;\n";
+    }
+    source += "    return a0;\n}\n";
+
+    Parser parser;
+    parser_init(&parser, (uint8_t *) source.c_str());
+    Ast ast = parser_parse(&parser);
+    AstNode *module = ast_get_node_tagged(&ast, ast_index_root, AST_MODULE);
+
+    StringSet strings;
+    string_set_init(&strings);
+    AstToMir lowering;
+    ast_to_mir_init(&lowering, &ast, &strings);
+    Mir mir = lower_ast_fn(&lowering, ast.extra_data.data[module->data.lhs]);
+
+    char *dump = mir_debug_print(&mir);
+    EXPECT_NE(strstr(dump, "ret("), nullptr);
+    EXPECT_GT(strlen(dump), (size_t) 5000 * 20);
+    free(dump);
+}
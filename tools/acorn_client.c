@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "daemon.h"
+
+// Forwards its arguments to `acorn --daemon` (see `daemon.h`). Unlike `acorn --client` it does not load LLVM, so a
+// request costs little more than the compile itself. Without a daemon, or for a request the daemon declines, it runs
+// the `acorn` next to it instead.
+// The socket is taken from `ACORN_SOCKET`, or the daemon default.
+
+// `acorn` in the directory of this executable.
+static char *compiler_path(void) {
+    char self[4096];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len <= 0)
+        return strdup("acorn");
+    self[len] = '\0';
+
+    char *slash = strrchr(self, '/');
+    *slash = '\0';
+    size_t path_len = strlen(self) + strlen("/acorn") + 1;
+    char *path = malloc(path_len);
+    snprintf(path, path_len, "%s/acorn", self);
+    return path;
+}
+
+int main(int32_t argc, char *argv[]) {
+    const char *socket_path = getenv("ACORN_SOCKET");
+    char *default_socket = socket_path == NULL ? daemon_default_socket() : NULL;
+    if (default_socket != NULL)
+        socket_path = default_socket;
+
+    int32_t exit_code;
+    bool ran = daemon_forward(socket_path, argc - 1, argv + 1, &exit_code);
+    free(default_socket);
+    if (ran)
+        return exit_code;
+
+    char *compiler = compiler_path();
+    argv[0] = compiler;
+    execv(compiler, argv);
+    fprintf(stderr, "Could not run %s\n", compiler);
+    return 64;
+}
@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "module.h"
+#include "time_report.h"
+
+// Runs the backends directly on a textual MIR module (see `mir_parser.h`), skipping the frontend entirely.
+// Modules can be written by hand or from a source file with `acorn --emit=mir`.
+
+typedef enum run_mode_s {
+    RUN_MODE_EMIT,
+    RUN_MODE_PRINT,
+    RUN_MODE_JIT,
+    RUN_MODE_JIT_LAZY,
+} RunMode;
+
+static void print_time_report(void) {
+    time_report_print(stderr);
+}
+
+static void usage(char *name) {
+    fprintf(stderr, "Usage: %s [--print] [--jit[=lazy]] [--backend=llvm|native] [-O0|-O1|-O2|-O3|-Os] [--emit=obj,asm,bc,ll,exe] [-j <jobs>] [--codegen-units=<n>] [--time-report] <file.mir>\n", name);
+    exit(64);
+}
+
+int main(int32_t argc, char *argv[]) {
+    RunMode mode = RUN_MODE_EMIT;
+    bool native = false;
+    CodegenOptions options = CODEGEN_OPTIONS_DEFAULT;
+    char *path = NULL;
+
+    for (int32_t i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--print") == 0) {
+            mode = RUN_MODE_PRINT;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            mode = RUN_MODE_JIT;
+        } else if (strcmp(argv[i], "--jit=lazy") == 0) {
+            mode = RUN_MODE_JIT_LAZY;
+        } else if (strcmp(argv[i], "--backend=llvm") == 0) {
+            native = false;
+        } else if (strcmp(argv[i], "--backend=native") == 0) {
+            native = true;
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            options.opt_level = CODEGEN_OPT_O0;
+        } else if (strcmp(argv[i], "-O1") == 0) {
+            options.opt_level = CODEGEN_OPT_O1;
+        } else if (strcmp(argv[i], "-O2") == 0) {
+            options.opt_level = CODEGEN_OPT_O2;
+        } else if (strcmp(argv[i], "-O3") == 0) {
+            options.opt_level = CODEGEN_OPT_O3;
+        } else if (strcmp(argv[i], "-Os") == 0) {
+            options.opt_level = CODEGEN_OPT_OS;
+        } else if (strncmp(argv[i], "--emit=", 7) == 0) {
+            if (!codegen_parse_emit_kinds(argv[i] + 7, &options.emit) || (options.emit & EMIT_MIR)) {
+                fprintf(stderr, "Unknown emit kind in: %s\n", argv[i]);
+                exit(64);
+            }
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            options.jobs = (uint32_t) strtoul(argv[++i], NULL, 10);
+        } else if (strncmp(argv[i], "--codegen-units=", 16) == 0) {
+            options.codegen_units = (uint32_t) strtoul(argv[i] + 16, NULL, 10);
+        } else if (strcmp(argv[i], "--time-report") == 0) {
+            time_report_enable();
+            atexit(print_time_report);
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+        }
+    }
+
+    if (path == NULL)
+        usage(argv[0]);
+    if (native && (mode == RUN_MODE_JIT || mode == RUN_MODE_JIT_LAZY)) {
+        fprintf(stderr, "The JIT requires the llvm backend\n");
+        exit(64);
+    }
+
+    if (options.jobs == 0)
+        options.jobs = 1;
+    if (mode == RUN_MODE_JIT || mode == RUN_MODE_JIT_LAZY)
+        options.codegen_units = 1;
+
+    Module module;
+    module_init(&module, path);
+    module.options = options;
+
+    if (!module_parse_mir(&module)) {
+        fprintf(stderr, "Could not parse MIR file: %s\n", path);
+        exit(1);
+    }
+
+    if (mode == RUN_MODE_PRINT) {
+        Writer out;
+        writer_init_file(&out, stdout);
+        module_write_mir(&module, &out);
+        writer_free(&out);
+
+        module_free(&module);
+        exit(0);
+    }
+
+    if (native) {
+        if (!module_emit_native(&module)) {
+            fprintf(stderr, "Could not emit native code for file: %s\n", path);
+            exit(64);
+        }
+
+        module_free(&module);
+        exit(0);
+    }
+
+    if (!module_lower_main(&module)) {
+        fprintf(stderr, "Could not lower main for file: %s\n", path);
+        exit(64);
+    }
+
+    if (mode == RUN_MODE_JIT || mode == RUN_MODE_JIT_LAZY) {
+        int32_t exit_code = 0;
+        if (!module_run_jit(&module, mode == RUN_MODE_JIT_LAZY, &exit_code)) {
+            fprintf(stderr, "Could not run JIT for file: %s\n", path);
+            exit(64);
+        }
+
+        module_free(&module);
+        exit(exit_code);
+    }
+
+    if (!module_emit_llvm(&module)) {
+        fprintf(stderr, "Could not emit LLVM for file: %s\n", path);
+        exit(64);
+    }
+
+    module_free(&module);
+    return 0;
+}